@@ -37,6 +37,10 @@
     "test/cxx/Core/ApplicationPool/ProcessTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/Core/ApplicationPool/PoolTest.o" =>
     "test/cxx/Core/ApplicationPool/PoolTest.cpp",
+  "#{TEST_OUTPUT_DIR}cxx/Core/ApplicationPool/ProcessHealthMonitorTest.o" =>
+    "test/cxx/Core/ApplicationPool/ProcessHealthMonitorTest.cpp",
+  "#{TEST_OUTPUT_DIR}cxx/Core/ApplicationPool/QueueDelayMonitorTest.o" =>
+    "test/cxx/Core/ApplicationPool/QueueDelayMonitorTest.cpp",
 
   "#{TEST_OUTPUT_DIR}cxx/Core/SpawningKit/ConfigTest.o" =>
     "test/cxx/Core/SpawningKit/ConfigTest.cpp",
@@ -67,6 +71,8 @@
 
   "#{TEST_OUTPUT_DIR}cxx/ServerKit/ChannelTest.o" =>
     "test/cxx/ServerKit/ChannelTest.cpp",
+  "#{TEST_OUTPUT_DIR}cxx/ServerKit/ContextTest.o" =>
+    "test/cxx/ServerKit/ContextTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/ServerKit/FileBufferedChannelTest.o" =>
     "test/cxx/ServerKit/FileBufferedChannelTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/ServerKit/HeaderTableTest.o" =>
@@ -94,6 +100,8 @@
     "test/cxx/MemoryKit/MbufTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/MemoryKit/PallocTest.o" =>
     "test/cxx/MemoryKit/PallocTest.cpp",
+  "#{TEST_OUTPUT_DIR}cxx/MemoryKit/SlabTest.o" =>
+    "test/cxx/MemoryKit/SlabTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/DataStructures/LStringTest.o" =>
     "test/cxx/DataStructures/LStringTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/DataStructures/StringKeyTableTest.o" =>
@@ -114,6 +122,8 @@
     "test/cxx/SystemTools/ProcessMetricsCollectorTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/SystemTools/SystemTimeTest.o" =>
     "test/cxx/SystemTools/SystemTimeTest.cpp",
+  "#{TEST_OUTPUT_DIR}cxx/SystemTools/CpuTopologyTest.o" =>
+    "test/cxx/SystemTools/CpuTopologyTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/CachedFileStatTest.o" =>
     "test/cxx/CachedFileStatTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/IOTools/BufferedIOTest.o" =>
@@ -124,6 +134,8 @@
     "test/cxx/IOTools/MessageIOTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/MessagePassingTest.o" =>
     "test/cxx/MessagePassingTest.cpp",
+  "#{TEST_OUTPUT_DIR}cxx/SafeLibevTest.o" =>
+    "test/cxx/SafeLibevTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/VariantMapTest.o" =>
     "test/cxx/VariantMapTest.cpp",
   "#{TEST_OUTPUT_DIR}cxx/DateParsingTest.o" =>
@@ -0,0 +1,101 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+/*
+ * Microbenchmark for the rate at which other threads can hand off callbacks
+ * to an event loop thread through SafeLibev::runLater(). This is the path
+ * taken by AcceptLoadBalancer, by sessions checked out from another thread
+ * and by ApiServer inspection requests.
+ *
+ * Compile and run with:
+ *
+ *   rake compile_app SOURCE=dev/benchmarks/SafeLibevHandoff.cpp OPTIMIZE=1
+ *   ./dev/benchmarks/SafeLibevHandoff [PRODUCERS] [HANDOFFS_PER_PRODUCER]
+ */
+
+#include <BackgroundEventLoop.cpp>
+#include <SafeLibev.h>
+#include <oxt/initialize.hpp>
+#include <oxt/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind/bind.hpp>
+#include <LoggingKit/Context.h>
+#include <Utils/Timer.h>
+#include <StrIntTools/StrIntUtils.h>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace Passenger;
+
+static boost::atomic<unsigned long long> handled(0);
+
+static void
+handoff() {
+	handled.fetch_add(1, boost::memory_order_relaxed);
+}
+
+static void
+produce(SafeLibev *libev, unsigned long long count) {
+	for (unsigned long long i = 0; i < count; i++) {
+		libev->runLater(handoff);
+	}
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int producers = (argc > 1) ? atoi(argv[1]) : 4;
+	unsigned long long count = (argc > 2) ? atoll(argv[2]) : 1000000;
+	unsigned long long total = producers * count;
+	vector<oxt::thread *> threads;
+
+	oxt::initialize();
+	LoggingKit::initialize();
+	BackgroundEventLoop bg(false, false);
+	bg.start("Consumer", 0);
+
+	Timer<SystemTime::GRAN_1USEC> timer;
+	for (unsigned int i = 0; i < producers; i++) {
+		threads.push_back(new oxt::thread(boost::bind(produce, bg.safe.get(), count),
+			"Producer " + toString(i + 1)));
+	}
+	for (unsigned int i = 0; i < producers; i++) {
+		threads[i]->join();
+		delete threads[i];
+	}
+	while (handled.load(boost::memory_order_relaxed) < total) {
+		usleep(1000);
+	}
+	unsigned long long elapsed = timer.usecElapsed();
+	bg.stop();
+
+	printf("Producers         : %u\n", producers);
+	printf("Handoffs          : %llu\n", total);
+	printf("Time              : %.3f sec\n", elapsed / 1000000.0);
+	printf("Handoffs per sec  : %.0f\n", total / (elapsed / 1000000.0));
+	return 0;
+}
@@ -0,0 +1,260 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+/*
+ * Measures the request throughput of a WSGI loader over the "session"
+ * protocol, the way the Core talks to it:
+ *
+ *  - "close": one connection per request, with the end of the request
+ *    signaled by a half-close. This is what the Core does for apps that
+ *    don't advertise `framed_request_bodies`.
+ *  - "keepalive": all requests over a single connection. Only measured if
+ *    the loader advertises `framed_request_bodies`.
+ *
+ * The loader is started directly, without SpawningKit, on the stub WSGI
+ * app. To compare against an older loader, pass its path, e.g. one
+ * extracted with `git show <commit>:src/helper-scripts/wsgi-loader.py`.
+ *
+ * Compile and run with:
+ *
+ *   rake compile_app SOURCE=dev/benchmarks/SessionKeepAlive.cpp OPTIMIZE=1
+ *   ./dev/benchmarks/SessionKeepAlive [REQUESTS] [LOADER] [APP_ROOT] [PYTHON]
+ */
+
+#include <jsoncpp/json.h>
+#include <FileTools/FileManip.h>
+#include <FileTools/PathManip.h>
+#include <IOTools/IOUtils.h>
+#include <IOTools/MessageSerialization.h>
+#include <LoggingKit/Context.h>
+#include <StrIntTools/StrIntUtils.h>
+#include <Utils/Timer.h>
+#include <oxt/initialize.hpp>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+using namespace std;
+using namespace Passenger;
+
+static string
+makeRequest() {
+	const char * const headers[] = {
+		"REQUEST_URI", "/pid",
+		"PATH_INFO", "/pid",
+		"SCRIPT_NAME", "",
+		"QUERY_STRING", "",
+		"REQUEST_METHOD", "GET",
+		"SERVER_NAME", "localhost",
+		"SERVER_PORT", "80",
+		"SERVER_PROTOCOL", "HTTP/1.1",
+		"HTTP_HOST", "localhost",
+		NULL
+	};
+	string data;
+	for (unsigned int i = 0; headers[i] != NULL; i++) {
+		data.append(headers[i], strlen(headers[i]) + 1);
+	}
+
+	char sizeHeader[sizeof(uint32_t)];
+	Uint32Message::generate(sizeHeader, data.size());
+	return string(sizeHeader, sizeof(uint32_t)) + data;
+}
+
+static pid_t
+startLoader(const string &python, const string &loader, const string &appRoot,
+	const string &workDir, int *ownerPipe)
+{
+	const char *steps[] = {
+		"subprocess_exec_wrapper",
+		"subprocess_wrapper_preparation",
+		"subprocess_app_load_or_exec",
+		"subprocess_listen",
+		NULL
+	};
+	makeDirTree(workDir + "/response/steps");
+	for (unsigned int i = 0; steps[i] != NULL; i++) {
+		makeDirTree(workDir + "/response/steps/" + steps[i]);
+	}
+	createFile(workDir + "/args.json", "{ \"startup_file\": \"passenger_wsgi.py\" }");
+
+	int fds[2];
+	if (pipe(fds) == -1) {
+		perror("pipe");
+		exit(1);
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(fds[0], 0);
+		close(fds[0]);
+		close(fds[1]);
+		if (chdir(appRoot.c_str()) == -1) {
+			perror("chdir");
+			_exit(1);
+		}
+		setenv("PASSENGER_SPAWN_WORK_DIR", workDir.c_str(), 1);
+		setenv("PYTHONDONTWRITEBYTECODE", "1", 1);
+		execlp(python.c_str(), python.c_str(), loader.c_str(), (const char *) 0);
+		perror("exec");
+		_exit(1);
+	} else if (pid == -1) {
+		perror("fork");
+		exit(1);
+	}
+
+	close(fds[0]);
+	*ownerPipe = fds[1];
+	return pid;
+}
+
+static Json::Value
+waitForSocket(const string &workDir, pid_t pid) {
+	for (unsigned int i = 0; i < 1000; i++) {
+		if (fileExists(workDir + "/response/finish")) {
+			Json::Value doc;
+			Json::Reader reader;
+			if (!reader.parse(unsafeReadFile(workDir + "/response/properties.json"), doc)) {
+				fprintf(stderr, "Cannot parse properties.json\n");
+				exit(1);
+			}
+			return doc["sockets"][0];
+		}
+		if (waitpid(pid, NULL, WNOHANG) == pid) {
+			break;
+		}
+		usleep(10000);
+	}
+	fprintf(stderr, "The loader did not start\n");
+	exit(1);
+}
+
+// Reads one response, whose size is given by its Content-Length header.
+// Data that arrives after it is left in `buffer`.
+static void
+readResponse(int fd, string &buffer) {
+	char tmp[1024 * 16];
+	string::size_type headerEnd, pos;
+
+	while ((headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+		ssize_t ret = read(fd, tmp, sizeof(tmp));
+		if (ret <= 0) {
+			fprintf(stderr, "Connection closed before the end of the response headers\n");
+			exit(1);
+		}
+		buffer.append(tmp, ret);
+	}
+
+	pos = buffer.find("\r\nContent-Length: ");
+	if (pos == string::npos || pos > headerEnd) {
+		fprintf(stderr, "Response has no Content-Length header\n");
+		exit(1);
+	}
+	string::size_type end = headerEnd + 4
+		+ stringToUint(buffer.substr(pos + sizeof("\r\nContent-Length: ") - 1));
+
+	while (buffer.size() < end) {
+		ssize_t ret = read(fd, tmp, sizeof(tmp));
+		if (ret <= 0) {
+			fprintf(stderr, "Connection closed before the end of the response body\n");
+			exit(1);
+		}
+		buffer.append(tmp, ret);
+	}
+	buffer.erase(0, end);
+}
+
+static double
+benchmarkClose(const string &address, const string &request, unsigned int count) {
+	Timer<SystemTime::GRAN_1USEC> timer;
+	for (unsigned int i = 0; i < count; i++) {
+		FileDescriptor fd(connectToServer(address, __FILE__, __LINE__), NULL, 0);
+		writeExact(fd, request);
+		shutdown(fd, SHUT_WR);
+		readAll(fd, 1024 * 1024);
+	}
+	return count / (timer.usecElapsed() / 1000000.0);
+}
+
+static double
+benchmarkKeepAlive(const string &address, const string &request, unsigned int count) {
+	Timer<SystemTime::GRAN_1USEC> timer;
+	FileDescriptor fd(connectToServer(address, __FILE__, __LINE__), NULL, 0);
+	string buffer;
+	for (unsigned int i = 0; i < count; i++) {
+		writeExact(fd, request);
+		readResponse(fd, buffer);
+	}
+	return count / (timer.usecElapsed() / 1000000.0);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int count = (argc > 1) ? atoi(argv[1]) : 20000;
+	string loader = absolutizePath((argc > 2) ? argv[2] : "src/helper-scripts/wsgi-loader.py");
+	string appRoot = absolutizePath((argc > 3) ? argv[3] : "test/stub/wsgi");
+	string python = (argc > 4) ? argv[4] : "python3";
+
+	oxt::initialize();
+	LoggingKit::initialize();
+	signal(SIGPIPE, SIG_IGN);
+
+	char workDirTemplate[] = "/tmp/passenger-benchmark.XXXXXX";
+	if (mkdtemp(workDirTemplate) == NULL) {
+		perror("mkdtemp");
+		return 1;
+	}
+	string workDir = workDirTemplate;
+
+	int ownerPipe;
+	pid_t pid = startLoader(python, loader, appRoot, workDir, &ownerPipe);
+	Json::Value socket = waitForSocket(workDir, pid);
+	string address = socket["address"].asString();
+	string request = makeRequest();
+
+	// Warm up.
+	benchmarkClose(address, request, 100);
+
+	printf("Loader               : %s\n", loader.c_str());
+	printf("Requests             : %u\n", count);
+	printf("close (req/sec)      : %.0f\n", benchmarkClose(address, request, count));
+	if (socket["framed_request_bodies"].asBool()) {
+		printf("keepalive (req/sec)  : %.0f\n", benchmarkKeepAlive(address, request, count));
+	} else {
+		printf("keepalive (req/sec)  : not supported by this loader\n");
+	}
+
+	close(ownerPipe);
+	waitpid(pid, NULL, 0);
+	removeDirTree(workDir);
+	return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+/*
+ * Compares MemoryKit::slab_allocator with malloc() for the allocation
+ * patterns of mbuf_blocks and ServerKit client objects: a large number of
+ * live fixed-size objects, with random objects being freed and reallocated.
+ * Reports throughput and the resident set size after filling and after
+ * freeing everything.
+ *
+ * Compile and run with:
+ *
+ *   rake compile_app SOURCE=dev/benchmarks/SlabAllocator.cpp OPTIMIZE=1
+ *   ./dev/benchmarks/SlabAllocator [OBJECT_SIZE] [LIVE_OBJECTS] [OPERATIONS] [none|madvise|hugetlb]
+ */
+
+#include <MemoryKit/slab.h>
+#include <oxt/initialize.hpp>
+#include <LoggingKit/Context.h>
+#include <Utils/Timer.h>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+using namespace Passenger;
+using namespace Passenger::MemoryKit;
+
+static size_t
+getRss() {
+	FILE *f = fopen("/proc/self/statm", "r");
+	unsigned long size, resident;
+
+	if (f == NULL) {
+		return 0;
+	}
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+		resident = 0;
+	}
+	fclose(f);
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+struct MallocAllocator {
+	size_t size;
+
+	void *alloc() {
+		return malloc(size);
+	}
+
+	void free(void *object) {
+		::free(object);
+	}
+
+	void releaseIdle() { }
+};
+
+struct SlabAllocator {
+	struct slab_allocator allocator;
+
+	void *alloc() {
+		return slab_alloc(&allocator);
+	}
+
+	void free(void *object) {
+		slab_free(&allocator, object);
+	}
+
+	void releaseIdle() {
+		slab_allocator_release_idle(&allocator);
+	}
+};
+
+template<typename Allocator>
+static void
+run(const char *name, Allocator &allocator, size_t objectSize,
+	unsigned int liveObjects, unsigned long long operations)
+{
+	vector<void *> objects(liveObjects);
+	size_t rssBefore = getRss();
+	unsigned int seed = 1;
+
+	Timer<SystemTime::GRAN_1USEC> timer;
+	for (unsigned int i = 0; i < liveObjects; i++) {
+		objects[i] = allocator.alloc();
+		memset(objects[i], 0, objectSize);
+	}
+	unsigned long long fillTime = timer.usecElapsed();
+	size_t rssFilled = getRss();
+
+	timer.start();
+	for (unsigned long long i = 0; i < operations; i++) {
+		unsigned int index = rand_r(&seed) % liveObjects;
+		allocator.free(objects[index]);
+		objects[index] = allocator.alloc();
+		*(char *) objects[index] = 1;
+	}
+	unsigned long long churnTime = timer.usecElapsed();
+
+	for (unsigned int i = 0; i < liveObjects; i++) {
+		allocator.free(objects[i]);
+	}
+	allocator.releaseIdle();
+	size_t rssFreed = getRss();
+
+	printf("%s\n", name);
+	printf("  Fill              : %.3f sec\n", fillTime / 1000000.0);
+	printf("  Churn ops per sec : %.0f\n", operations / (churnTime / 1000000.0));
+	printf("  RSS growth filled : %.1f MB\n", (double) (rssFilled - rssBefore) / 1024 / 1024);
+	printf("  RSS after free    : %+.1f MB\n",
+		((double) rssFreed - (double) rssBefore) / 1024 / 1024);
+}
+
+int
+main(int argc, char *argv[]) {
+	size_t objectSize = (argc > 1) ? atoi(argv[1]) : 4096;
+	unsigned int liveObjects = (argc > 2) ? atoi(argv[2]) : 100000;
+	unsigned long long operations = (argc > 3) ? atoll(argv[3]) : 10000000;
+	slab_hugepages_mode mode = SLAB_HUGEPAGES_MADVISE;
+
+	oxt::initialize();
+	LoggingKit::initialize();
+	if (argc > 4 && !parse_slab_hugepages_mode(argv[4], mode)) {
+		fprintf(stderr, "Invalid huge page mode: %s\n", argv[4]);
+		return 1;
+	}
+
+	printf("Object size       : %u\n", (unsigned int) objectSize);
+	printf("Live objects      : %u\n", liveObjects);
+	printf("Churn operations  : %llu\n\n", operations);
+
+	MallocAllocator mallocAllocator;
+	mallocAllocator.size = objectSize;
+	run("malloc()", mallocAllocator, objectSize, liveObjects, operations);
+
+	SlabAllocator slabAllocator;
+	slab_allocator_init(&slabAllocator.allocator, objectSize, mode, 1);
+	run((string("slab_allocator (") + slab_hugepages_mode_to_string(mode) + ")").c_str(),
+		slabAllocator, objectSize, liveObjects, operations);
+	printf("  Peak slabs        : %u (%u hugetlb)\n",
+		(unsigned int) slabAllocator.allocator.peak_nslabs,
+		(unsigned int) slabAllocator.allocator.nhugetlb_slabs);
+	slab_allocator_deinit(&slabAllocator.allocator);
+
+	return 0;
+}
@@ -167,6 +167,8 @@ private:
 			processPoolRestartAppGroup(client, req);
 		} else if (path == P_STATIC_STRING("/pool/detach_process.json")) {
 			processPoolDetachProcess(client, req);
+		} else if (path == P_STATIC_STRING("/pool/spawn_timings.json")) {
+			processPoolSpawnTimings(client, req);
 		} else if (path == P_STATIC_STRING("/backtraces.txt")) {
 			apiServerProcessBacktraces(this, client, req);
 		} else if (path == P_STATIC_STRING("/ping.json")) {
@@ -465,11 +467,40 @@ private:
 		}
 	}
 
+	void processPoolSpawnTimings(Client *client, Request *req) {
+		Authorization auth(authorize(this, client, req));
+		if (!auth.canReadPool) {
+			apiServerRespondWith401(this, client, req);
+			return;
+		}
+
+		ApplicationPool2::Pool::ToJsonOptions options;
+		options.uid = auth.uid;
+		options.apiKey = auth.apiKey;
+
+		Json::Value doc;
+		try {
+			doc = appPool->inspectSpawnTimingsAsJson(options);
+		} catch (const SecurityException &) {
+			apiServerRespondWith401(this, client, req);
+			return;
+		}
+
+		HeaderTable headers;
+		headers.insert(req->pool, "Content-Type", "application/json");
+		headers.insert(req->pool, "Cache-Control", "no-cache, no-store, must-revalidate");
+		writeSimpleResponse(client, 200, &headers,
+			psg_pstrdup(req->pool, doc.toStyledString()));
+		if (!req->ended()) {
+			endRequest(&client, &req);
+		}
+	}
+
 	static void garbageCollect(Controller *controller) {
 		ServerKit::Context *ctx = controller->getContext();
 		unsigned int count;
 
-		count = mbuf_pool_compact(&ctx->mbuf_pool);
+		count = ctx->compactMbufPools();
 		SKS_NOTICE_FROM_STATIC(controller, "Freed " << count << " mbufs");
 
 		controller->compact(LoggingKit::NOTICE);
@@ -55,10 +55,38 @@ public:
 	virtual int fd() const = 0;
 	virtual bool isClosed() const = 0;
 
+	/**
+	 * Whether the app reads "session" protocol request bodies up to
+	 * CONTENT_LENGTH, so that the end of the body need not be signaled
+	 * with a half-close and the connection can be kept alive.
+	 */
+	virtual bool hasFramedRequestBodies() const { return false; }
+
+	/**
+	 * The highest binary "session" protocol header encoding version that
+	 * the app supports, or 0 if it only supports the NUL-separated encoding.
+	 */
+	virtual unsigned int getBinarySessionHeaderVersion() const { return 0; }
+
 	virtual void initiate(bool blocking = true) = 0;
 
 	virtual void requestOOBW() { /* Do nothing */ }
 
+	/**
+	 * Tells the pool that the application failed to handle this session
+	 * properly, e.g. because it responded with a 5xx status code. Used
+	 * for outlier ejection.
+	 */
+	virtual void reportAppError() { /* Do nothing */ }
+
+	/**
+	 * Tells the pool that the application has begun sending its response.
+	 * Outlier ejection measures latency up to this point, so that long-lived
+	 * sessions such as WebSockets and streaming responses aren't counted as
+	 * slow.
+	 */
+	virtual void reportResponseBegin() { /* Do nothing */ }
+
 	/**
 	 * This Session object becomes fully unsable after closing.
 	 */
@@ -30,11 +30,15 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/make_shared.hpp>
 #include <oxt/tracable_exception.hpp>
+#include <oxt/macros.hpp>
+#include <Exceptions.h>
 #include <ResourceLocator.h>
 #include <RandomGenerator.h>
 #include <StaticString.h>
 #include <MemoryKit/palloc.h>
+#include <SystemTools/SystemTime.h>
 #include <DataStructures/StringKeyTable.h>
 #include <Core/ApplicationPool/Options.h>
 #include <Core/ApplicationPool/Context.h>
@@ -186,13 +190,58 @@ struct GetCallback {
 struct GetWaiter {
 	Options options;
 	GetCallback callback;
+	/** When the request was first queued, in microseconds. Used for
+	 * measuring queueing delays. See QueueDelayMonitor.
+	 */
+	unsigned long long queuedAt;
 
 	GetWaiter(const Options &o, const GetCallback &cb)
 		: options(o),
-		  callback(cb)
+		  callback(cb),
+		  queuedAt(o.currentTime != 0 ? o.currentTime : SystemTime::getUsec())
 	{
 		options.persist(o);
 	}
+
+	/**
+	 * Returns the time (in microseconds) at which this waiter exceeds
+	 * its maximum queueing time, or 0 if it may be queued indefinitely.
+	 */
+	unsigned long long deadline() const {
+		if (options.maxRequestQueueTime == 0) {
+			return 0;
+		} else {
+			return queuedAt + options.maxRequestQueueTime * 1000ull;
+		}
+	}
+
+	bool cancelled() const {
+		return options.cancelled != NULL
+			&& options.cancelled->load(boost::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns whether this waiter should be removed from the getWaitlist
+	 * without being served, either because the caller cancelled it or
+	 * because it exceeded its maximum queueing time. This is O(1), so
+	 * getWaitlist walkers can check it for every waiter they encounter.
+	 */
+	bool abandoned(unsigned long long now) const {
+		return OXT_UNLIKELY(cancelled())
+			|| OXT_UNLIKELY(options.maxRequestQueueTime != 0 && now >= deadline());
+	}
+
+	/** The exception that the callback of an abandoned() waiter is called with. */
+	ExceptionPtr abandonmentException(unsigned long long now) const {
+		if (cancelled()) {
+			return boost::make_shared<GetAbortedException>(
+				"The request was cancelled while it was queued");
+		} else {
+			return boost::make_shared<RequestQueueTimeoutException>(
+				(now > queuedAt) ? now - queuedAt : 0,
+				options.maxRequestQueueTime);
+		}
+	}
 };
 
 struct Ticket {
@@ -54,6 +54,8 @@
 #include <Core/ApplicationPool/BasicGroupInfo.h>
 #include <Core/ApplicationPool/Process.h>
 #include <Core/ApplicationPool/Options.h>
+#include <Core/ApplicationPool/QueueDelayMonitor.h>
+#include <Core/ApplicationPool/SpawnTimings.h>
 #include <Core/SpawningKit/Factory.h>
 #include <Core/SpawningKit/Result.h>
 #include <Core/SpawningKit/UserSwitchingRules.h>
@@ -79,6 +81,7 @@ public:
 	struct GetAction {
 		GetCallback callback;
 		SessionPtr session;
+		ExceptionPtr exception;
 	};
 
 	struct DisableWaiter {
@@ -175,6 +178,12 @@ public:
 	 *    if m_restarting: processesBeingSpawned == 0
 	 */
 	bool m_restarting: 1;
+	/** Whether a rolling restart is in progress (i.e. whether
+	 * rollingRestartThreadMain() is at work). While it is in progress, the
+	 * group keeps serving requests with its old processes, and the
+	 * rolling restart thread replaces them one by one.
+	 */
+	bool m_rollingRestarting: 1;
 	bool alwaysRestartFileExists: 1;
 
 	/** Contains the spawn loop thread and the restarter thread. */
@@ -189,6 +198,19 @@ public:
 	 */
 	bool detachedProcessesCheckerActive;
 	boost::condition_variable detachedProcessesCheckerCond;
+	/** The earliest time (in microseconds) at which an enabled process that was
+	 * ejected because of outlier ejection may be probed again, or 0 if no enabled
+	 * processes are ejected. See maybeReadmitOutliers().
+	 */
+	unsigned long long nextOutlierReadmissionTime;
+	/** Whether a process's out-of-band work was deferred because this Group
+	 * was too busy. See initiateDeferredOobwRequests().
+	 */
+	bool hasDeferredOobw;
+	/** The number of processes for which recycleThreadMain() is spawning
+	 * a replacement. Bounded by `options.maxConcurrentRecycles`.
+	 */
+	unsigned int recyclesInProgress;
 	Callback shutdownCallback;
 	GroupPtr selfPointer;
 
@@ -204,11 +226,15 @@ public:
 	/****** Session management ******/
 
 	RouteResult route(const Options &options) const;
+	RouteResult routeToLeastBusyEnabledProcess(Process *process) const;
 	SessionPtr newSession(Process *process, unsigned long long now = 0);
 	static void _onSessionInitiateFailure(Session *session);
 	static void _onSessionClose(Session *session);
 	OXT_FORCE_INLINE void onSessionInitiateFailure(Process *process, Session *session);
 	OXT_FORCE_INLINE void onSessionClose(Process *process, Session *session);
+	bool updateProcessHealth(Process *process, Session *session);
+	void scheduleOutlierReadmission(unsigned long long time);
+	void maybeReadmitOutliers(unsigned long long now);
 
 	/****** Spawning and restarting ******/
 
@@ -216,9 +242,22 @@ public:
 		unsigned int restartsInitiated);
 	void spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner, const Options &options,
 		unsigned int restartsInitiated);
+	static void forceTriggerShutdownAndCleanupAll(const vector<ProcessPtr> *processes);
 	void finalizeRestart(GroupPtr self, Options oldOptions, Options newOptions,
 		RestartMethod method, SpawningKit::FactoryPtr spawningKitFactory,
 		unsigned int restartsInitiated, boost::container::vector<Callback> postLockActions);
+	void rollingRestart(const Options &options);
+	void rollingRestartThreadMain(GroupPtr self, SpawningKit::SpawnerPtr oldSpawner,
+		SpawningKit::SpawnerPtr newSpawner, Options options, ProcessList oldProcesses,
+		unsigned int restartsInitiated);
+	void replaceProcess(const ProcessPtr &oldProcess, const ProcessPtr &newProcess,
+		boost::container::vector<Callback> &postLockActions);
+	bool recycleInBackground(Process *process);
+	void recycleThreadMain(GroupPtr self, SpawningKit::SpawnerPtr spawner, Options options,
+		ProcessPtr oldProcess, unsigned int restartsInitiated);
+	void sendWarmupRequests(const ProcessPtr &process, const Options &options);
+	void sendWarmupRequest(int fd, const StaticString &protocol, const Options &options,
+		unsigned long long *timeout);
 
 	/****** Process list management ******/
 
@@ -226,7 +265,12 @@ public:
 	Process *findProcessWithStickySessionIdOrLowestBusyness(unsigned int id) const;
 	Process *findProcessWithLowestBusyness(const ProcessList &processes) const;
 	Process *findEnabledProcessWithLowestBusyness() const;
+	Process *findEjectedProcessWithLowestBusyness() const;
+	Process *findProcessWithRoutingHash(unsigned int hash) const;
+	unsigned long jitteredLimit(const Process *process, unsigned long limit) const;
 
+	void attachIrrespectiveOfLimits(const ProcessPtr &process,
+		boost::container::vector<Callback> &postLockActions);
 	void addProcessToList(const ProcessPtr &process, ProcessList &destination);
 	void removeProcessFromList(const ProcessPtr &process, ProcessList &source);
 	void removeFromDisableWaitlist(const ProcessPtr &p, DisableResult result,
@@ -242,11 +286,14 @@ public:
 
 	bool oobwAllowed() const;
 	bool shouldInitiateOobw(Process *process) const;
+	bool shouldDeferOobw() const;
 	void maybeInitiateOobw(Process *process);
 	void lockAndMaybeInitiateOobw(const ProcessPtr &process, DisableResult result, GroupPtr self);
 	void initiateOobw(const ProcessPtr &process);
 	void spawnThreadOOBWRequest(GroupPtr self, ProcessPtr process);
 	void initiateNextOobwRequest();
+	void initiateDeferredOobwRequests();
+	unsigned long long requestPeriodicOobw(unsigned long long now);
 
 	/****** Internal utilities ******/
 
@@ -272,6 +319,9 @@ public:
 	Group *findOtherGroupWaitingForCapacity() const;
 	bool pushGetWaiter(const Options &newOptions, const GetCallback &callback,
 		boost::container::vector<Callback> &postLockActions);
+	bool shouldShedGetWaiter(const GetWaiter &waiter, unsigned long long now);
+	unsigned long long shedOverloadedGetWaiters(unsigned long long now,
+		boost::container::vector<Callback> &postLockActions);
 	template<typename Lock> void assignSessionsToGetWaitersQuickly(Lock &lock);
 	void assignSessionsToGetWaiters(boost::container::vector<Callback> &postLockActions);
 	bool testOverflowRequestQueue() const;
@@ -401,6 +451,23 @@ public:
 	 *       !enabledProcesses.empty() || m_spawning || restarting() || poolAtFullCapacity()
 	 */
 	deque<GetWaiter> getWaitlist;
+	/** Measures the queueing delay of getWaitlist and decides when to shed waiters. */
+	QueueDelayMonitor getWaitlistDelayMonitor;
+	/** The number of processes in this group that were shut down in order to
+	 * make room for other groups in the pool.
+	 */
+	unsigned int processesEvicted;
+	/** The last time (in microseconds) that a session was requested from
+	 * this Group, or 0 if never. Used for selecting warm spare groups.
+	 */
+	unsigned long long lastUsed;
+	/** The number of out-of-band work requests that were deferred because
+	 * this Group was too busy, and the number that were performed.
+	 */
+	unsigned int oobwsDeferred;
+	unsigned int oobwsPerformed;
+	/** Step duration histograms of the processes spawned for this Group. */
+	SpawnTimings spawnTimings;
 	/**
 	 * Disable() commands that couldn't finish immediately will put their callbacks
 	 * in this queue. Note that there may be multiple DisableWaiters pointing to the
@@ -450,11 +517,13 @@ public:
 
 	void restart(const Options &options, RestartMethod method = RM_DEFAULT);
 	bool restarting() const;
+	bool rollingRestarting() const;
 	bool needsRestart(const Options &options);
 
 	SpawnResult spawn();
 	bool spawning() const;
 	bool shouldSpawn() const;
+	unsigned int spawnBatchSize() const;
 	bool shouldSpawnForGetAction() const;
 	bool allowSpawn() const;
 
@@ -478,12 +547,16 @@ public:
 	bool allEnabledProcessesAreTotallyBusy() const;
 
 	unsigned int capacityUsed() const;
+	unsigned int capacityWeight() const;
+	unsigned int fairShare() const;
+	unsigned int fairShare(unsigned int totalCapacityWeight) const;
 	bool isWaitingForCapacity() const;
 	bool garbageCollectable(unsigned long long now = 0) const;
 
 	void inspectXml(std::ostream &stream, bool includeSecrets = true) const;
 	void inspectPropertiesInAdminPanelFormat(Json::Value &result) const;
 	void inspectConfigInAdminPanelFormat(Json::Value &result) const;
+	void inspectSpawnTimingsAsJson(Json::Value &result) const;
 
 	/****** Out-of-band work ******/
 
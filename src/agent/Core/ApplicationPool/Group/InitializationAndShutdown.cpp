@@ -114,6 +114,14 @@ Group::Group(Pool *_pool, const Options &_options)
 	processesBeingSpawned = 0;
 	m_spawning     = false;
 	m_restarting   = false;
+	m_rollingRestarting = false;
+	nextOutlierReadmissionTime = 0;
+	processesEvicted = 0;
+	lastUsed = 0;
+	hasDeferredOobw = false;
+	recyclesInProgress = 0;
+	oobwsDeferred = 0;
+	oobwsPerformed = 0;
 	lifeStatus.store(ALIVE, boost::memory_order_relaxed);
 	lastRestartFileMtime = 0;
 	lastRestartFileCheckTime = 0;
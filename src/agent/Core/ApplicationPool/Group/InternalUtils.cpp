@@ -88,6 +88,28 @@ Group::mergeOptions(const Options &other) {
 	options.minProcesses     = other.minProcesses;
 	options.statThrottleRate = other.statThrottleRate;
 	options.maxPreloaderIdleTime = other.maxPreloaderIdleTime;
+	options.memoryLimit      = other.memoryLimit;
+	options.recycleLimitJitter = other.recycleLimitJitter;
+	options.maxConcurrentRecycles = other.maxConcurrentRecycles;
+	options.outlierEjectionErrors = other.outlierEjectionErrors;
+	options.outlierLatencyThreshold = other.outlierLatencyThreshold;
+	options.outlierEjectionTime = other.outlierEjectionTime;
+	options.outlierRestartThreshold = other.outlierRestartThreshold;
+	options.capacityWeight   = other.capacityWeight;
+	options.guaranteedCapacity = other.guaranteedCapacity;
+	options.routingLoadFactor = other.routingLoadFactor;
+	options.oobwMaxUtilization = other.oobwMaxUtilization;
+	options.oobwInterval     = other.oobwInterval;
+	options.rollingRestart   = other.rollingRestart;
+	options.warmupRequests   = other.warmupRequests;
+	if (options.warmupRequestPath != other.warmupRequestPath) {
+		// `other`'s strings are only valid during the get() request, so
+		// store the new path in our own storage area. `newOptions` keeps
+		// the old storage area alive while it's being copied.
+		Options newOptions = options;
+		newOptions.warmupRequestPath = other.warmupRequestPath;
+		options.persist(newOptions);
+	}
 }
 
 /* Given a hook name like "queue_full_error", we return HookScriptOptions filled in with this name and a spec
@@ -208,6 +230,8 @@ Group::createProcessObject(const SpawningKit::Spawner &spawner,
 		}
 	};
 
+	spawnTimings.record(spawnResult);
+
 	Json::Value args;
 	args["spawner_creation_time"] = (Json::UInt64) spawner.creationTime;
 
@@ -264,6 +288,15 @@ bool
 Group::pushGetWaiter(const Options &newOptions, const GetCallback &callback,
 	boost::container::vector<Callback> &postLockActions)
 {
+	if (newOptions.maxRequestQueueSize != 0
+	 && getWaitlist.size() >= newOptions.maxRequestQueueSize)
+	{
+		// Make room by dropping waiters whose clients have gone away
+		// or that have been queued for too long.
+		Pool::removeAbandonedGetWaiters(getWaitlist,
+			SystemTime::getUsec(), postLockActions);
+	}
+
 	if (OXT_LIKELY(!testOverflowRequestQueue()
 		&& (newOptions.maxRequestQueueSize == 0
 		    || getWaitlist.size() < newOptions.maxRequestQueueSize)))
@@ -271,6 +304,16 @@ Group::pushGetWaiter(const Options &newOptions, const GetCallback &callback,
 		getWaitlist.push_back(GetWaiter(
 			newOptions.copyAndPersist(),
 			callback));
+		if (newOptions.maxRequestQueueTime != 0) {
+			// Make sure the waiter is dropped in time even if no
+			// process becomes available.
+			getPool()->scheduleGarbageCollection(getWaitlist.back().deadline());
+		}
+		unsigned long long nextCheckTime = shedOverloadedGetWaiters(
+			SystemTime::getUsec(), postLockActions);
+		if (nextCheckTime != 0) {
+			getPool()->scheduleGarbageCollection(nextCheckTime);
+		}
 		return true;
 	} else {
 		postLockActions.push_back(boost::bind(GetCallback::call,
@@ -286,6 +329,64 @@ Group::pushGetWaiter(const Options &newOptions, const GetCallback &callback,
 	}
 }
 
+/**
+ * Must be called when the given waiter is about to be removed from the
+ * getWaitlist. Records its queueing delay, and returns whether it should
+ * be shed instead of being served.
+ */
+bool
+Group::shouldShedGetWaiter(const GetWaiter &waiter, unsigned long long now) {
+	unsigned long long delay = (now > waiter.queuedAt) ? now - waiter.queuedAt : 0;
+	if (OXT_LIKELY(!getWaitlistDelayMonitor.dequeue(delay, now,
+		waiter.options.requestQueueTargetDelay)))
+	{
+		return false;
+	}
+
+	P_DEBUG("Shedding request that was queued for " << delay / 1000 <<
+		" msec in group " << info.name << ": request queue is overloaded");
+	return true;
+}
+
+/**
+ * Sheds the waiters at the head of the getWaitlist that should be shed
+ * according to getWaitlistDelayMonitor, without waiting for a process to
+ * become available to them. Called when a waiter is enqueued and by the
+ * garbage collector, so that clients get a fast error even if all processes
+ * are stuck.
+ *
+ * Returns the time at which this should be called again, or 0 if there is
+ * no need to.
+ */
+unsigned long long
+Group::shedOverloadedGetWaiters(unsigned long long now,
+	boost::container::vector<Callback> &postLockActions)
+{
+	unsigned long long nextCheckTime = 0;
+
+	while (!getWaitlist.empty()) {
+		const GetWaiter &waiter = getWaitlist.front();
+		unsigned long long delay = (now > waiter.queuedAt) ? now - waiter.queuedAt : 0;
+		if (OXT_LIKELY(!getWaitlistDelayMonitor.checkHead(delay, now,
+			waiter.options.requestQueueTargetDelay, nextCheckTime)))
+		{
+			break;
+		}
+
+		P_DEBUG("Shedding request that has been queued for " << delay / 1000 <<
+			" msec in group " << info.name << ": request queue is overloaded");
+		postLockActions.push_back(boost::bind(
+			GetCallback::call,
+			waiter.callback,
+			SessionPtr(),
+			boost::make_shared<RequestQueueOverloadedException>(
+				delay, waiter.options.requestQueueTargetDelay)));
+		getWaitlist.erase(getWaitlist.begin());
+	}
+
+	return nextCheckTime;
+}
+
 template<typename Lock>
 void
 Group::assignSessionsToGetWaitersQuickly(Lock &lock) {
@@ -296,6 +397,7 @@ Group::assignSessionsToGetWaitersQuickly(Lock &lock) {
 	}
 
 	boost::container::small_vector<GetAction, 8> actions;
+	unsigned long long now = SystemTime::getUsec();
 	unsigned int i = 0;
 	bool done = false;
 
@@ -303,11 +405,25 @@ Group::assignSessionsToGetWaitersQuickly(Lock &lock) {
 
 	while (!done && i < getWaitlist.size()) {
 		const GetWaiter &waiter = getWaitlist[i];
+		if (OXT_UNLIKELY(waiter.abandoned(now))) {
+			GetAction action;
+			action.callback = waiter.callback;
+			action.exception = waiter.abandonmentException(now);
+			getWaitlist.erase(getWaitlist.begin() + i);
+			actions.push_back(action);
+			continue;
+		}
+
 		RouteResult result = route(waiter.options);
 		if (result.process != NULL) {
 			GetAction action;
 			action.callback = waiter.callback;
-			action.session  = newSession(result.process);
+			if (OXT_UNLIKELY(shouldShedGetWaiter(waiter, now))) {
+				action.exception = boost::make_shared<RequestQueueOverloadedException>(
+					now - waiter.queuedAt, waiter.options.requestQueueTargetDelay);
+			} else {
+				action.session = newSession(result.process);
+			}
 			getWaitlist.erase(getWaitlist.begin() + i);
 			actions.push_back(action);
 		} else {
@@ -322,19 +438,38 @@ Group::assignSessionsToGetWaitersQuickly(Lock &lock) {
 	lock.unlock();
 	boost::container::small_vector<GetAction, 50>::const_iterator it, end = actions.end();
 	for (it = actions.begin(); it != end; it++) {
-		it->callback(it->session, ExceptionPtr());
+		it->callback(it->session, it->exception);
 	}
 }
 
 void
 Group::assignSessionsToGetWaiters(boost::container::vector<Callback> &postLockActions) {
+	unsigned long long now = SystemTime::getUsec();
 	unsigned int i = 0;
 	bool done = false;
 
 	while (!done && i < getWaitlist.size()) {
 		const GetWaiter &waiter = getWaitlist[i];
+		if (OXT_UNLIKELY(waiter.abandoned(now))) {
+			postLockActions.push_back(boost::bind(
+				GetCallback::call,
+				waiter.callback,
+				SessionPtr(),
+				waiter.abandonmentException(now)));
+			getWaitlist.erase(getWaitlist.begin() + i);
+			continue;
+		}
+
 		RouteResult result = route(waiter.options);
-		if (result.process != NULL) {
+		if (result.process != NULL && OXT_UNLIKELY(shouldShedGetWaiter(waiter, now))) {
+			postLockActions.push_back(boost::bind(
+				GetCallback::call,
+				waiter.callback,
+				SessionPtr(),
+				boost::make_shared<RequestQueueOverloadedException>(
+					now - waiter.queuedAt, waiter.options.requestQueueTargetDelay)));
+			getWaitlist.erase(getWaitlist.begin() + i);
+		} else if (result.process != NULL) {
 			postLockActions.push_back(boost::bind(
 				GetCallback::call,
 				waiter.callback,
@@ -72,9 +72,46 @@ Group::shouldInitiateOobw(Process *process) const {
 		&& oobwAllowed();
 }
 
+/**
+ * Returns whether out-of-band work should be postponed because this group
+ * is too busy to take a process out of rotation: requests are queued, or
+ * the share of enabled processes that are handling requests exceeds
+ * `options.oobwMaxUtilization`.
+ */
+bool
+Group::shouldDeferOobw() const {
+	if (!getWaitlist.empty()) {
+		return true;
+	}
+	if (options.oobwMaxUtilization == 0 || enabledCount == 0) {
+		return false;
+	}
+
+	unsigned int busyCount = 0;
+	foreach (const ProcessPtr &process, enabledProcesses) {
+		if (process->sessions > 0) {
+			busyCount++;
+		}
+	}
+	return busyCount * 100 > options.oobwMaxUtilization * (unsigned int) enabledCount;
+}
+
 void
 Group::maybeInitiateOobw(Process *process) {
 	if (shouldInitiateOobw(process)) {
+		if (process->enabled == Process::ENABLED && shouldDeferOobw()) {
+			// The process stays in the OOBW_REQUESTED state and keeps handling
+			// requests. initiateDeferredOobwRequests() will try again later.
+			if (!process->oobwDeferred) {
+				P_DEBUG("Deferring out-of-band work for process " << process->inspect() <<
+					" because the group is busy");
+				process->oobwDeferred = true;
+				oobwsDeferred++;
+			}
+			hasDeferredOobw = true;
+			return;
+		}
+
 		// We keep an extra reference to prevent premature destruction.
 		ProcessPtr p = process->shared_from_this();
 		initiateOobw(p);
@@ -128,6 +165,7 @@ Group::initiateOobw(const ProcessPtr &process) {
 	assert(process->oobwStatus == Process::OOBW_REQUESTED);
 
 	process->oobwStatus = Process::OOBW_IN_PROGRESS;
+	process->oobwDeferred = false;
 
 	if (process->enabled == Process::ENABLED
 	 || process->enabled == Process::DISABLING)
@@ -266,6 +304,8 @@ Group::spawnThreadOOBWRequest(GroupPtr self, ProcessPtr process) {
 		}
 
 		process->oobwStatus = Process::OOBW_NOT_ACTIVE;
+		process->lastOobwTime = SystemTime::getUsec();
+		oobwsPerformed++;
 		if (process->enabled == Process::DISABLED) {
 			enable(process, actions);
 			assignSessionsToGetWaiters(actions);
@@ -288,18 +328,76 @@ Group::spawnThreadOOBWRequest(GroupPtr self, ProcessPtr process) {
 
 void
 Group::initiateNextOobwRequest() {
+	hasDeferredOobw = false;
 	ProcessList::const_iterator it, end = enabledProcesses.end();
 	for (it = enabledProcesses.begin(); it != end; it++) {
 		const ProcessPtr &process = *it;
 		if (shouldInitiateOobw(process.get())) {
 			// We keep an extra reference to processes to prevent premature destruction.
 			ProcessPtr p = process;
-			initiateOobw(p);
+			maybeInitiateOobw(p.get());
 			return;
 		}
 	}
 }
 
+/**
+ * Called when the load on this group may have dropped. Initiates out-of-band
+ * work that was previously deferred, if the group is no longer too busy.
+ */
+void
+Group::initiateDeferredOobwRequests() {
+	if (hasDeferredOobw && !shouldDeferOobw()) {
+		initiateNextOobwRequest();
+	}
+}
+
+/**
+ * Requests out-of-band work for idle processes that haven't performed any
+ * for `options.oobwInterval` seconds. Called periodically by the garbage
+ * collector. Busy processes are skipped until they become idle, so that the
+ * out-of-band work takes place during quiet periods.
+ *
+ * Returns the time (in microseconds) at which this method should be called
+ * again, or 0 if there is nothing to wait for.
+ */
+unsigned long long
+Group::requestPeriodicOobw(unsigned long long now) {
+	unsigned long long interval = (unsigned long long) options.oobwInterval * 1000000;
+	unsigned long long nextCheckTime = 0;
+	bool requested = false;
+
+	foreach (const ProcessPtr &process, enabledProcesses) {
+		if (process->oobwStatus != Process::OOBW_NOT_ACTIVE) {
+			continue;
+		}
+
+		unsigned long long dueTime = std::max(process->lastOobwTime,
+			process->getSpawnEndTime()) + interval;
+		if (now < dueTime) {
+			if (nextCheckTime == 0 || dueTime < nextCheckTime) {
+				nextCheckTime = dueTime;
+			}
+		} else if (process->sessions == 0) {
+			P_DEBUG("Requesting periodic out-of-band work for process " <<
+				process->inspect());
+			process->oobwStatus = Process::OOBW_REQUESTED;
+			requested = true;
+		} else {
+			// Check again soon to see whether the process has become idle.
+			dueTime = now + 5 * 1000000;
+			if (nextCheckTime == 0 || dueTime < nextCheckTime) {
+				nextCheckTime = dueTime;
+			}
+		}
+	}
+
+	if (requested) {
+		initiateNextOobwRequest();
+	}
+	return nextCheckTime;
+}
+
 
 /****************************
  *
@@ -125,6 +125,102 @@ Group::findEnabledProcessWithLowestBusyness() const {
 	return enabledProcesses[leastBusyProcessIndex].get();
 }
 
+/**
+ * Returns the least busy enabled process that has been ejected because of
+ * outlier ejection and that can still be routed to, or NULL if there is none.
+ */
+Process *
+Group::findEjectedProcessWithLowestBusyness() const {
+	int lowestBusyness = -1;
+	Process *leastBusyProcess = NULL;
+	ProcessList::const_iterator it;
+	ProcessList::const_iterator end = enabledProcesses.end();
+	for (it = enabledProcesses.begin(); it != end; it++) {
+		Process *process = (*it).get();
+		if (OXT_UNLIKELY(process->health.isEjected()) && process->canBeRoutedTo()) {
+			int busyness = process->busyness();
+			if (lowestBusyness == -1 || lowestBusyness > busyness) {
+				lowestBusyness = busyness;
+				leastBusyProcess = process;
+			}
+		}
+	}
+	return leastBusyProcess;
+}
+
+/**
+ * Consistent hash routing with bounded loads. Each enabled process gets a
+ * score for the given hash, and the request goes to the process with the
+ * highest score (rendezvous hashing). A process's score only depends on its
+ * sticky session ID, so when processes come and go, only the keys of those
+ * processes move elsewhere.
+ *
+ * Processes that have more sessions than `routingLoadFactor` percent of the
+ * average (counting the new session) are skipped, and so are processes that
+ * cannot be routed to at all. If all processes are skipped then this falls
+ * back to the least busy process.
+ */
+Process *
+Group::findProcessWithRoutingHash(unsigned int hash) const {
+	unsigned int i, size = enabledProcessBusynessLevels.size();
+	const int *enabledProcessBusynessLevels = &this->enabledProcessBusynessLevels[0];
+	unsigned long long totalSessions = 1;
+
+	for (i = 0; i < size; i++) {
+		totalSessions += enabledProcesses[i]->sessions;
+	}
+	unsigned long long loadFactor = std::max(options.routingLoadFactor, 100u);
+	unsigned long long maxSessions = (totalSessions * loadFactor + size * 100 - 1)
+		/ (size * 100);
+
+	Process *bestProcess = NULL;
+	boost::uint32_t bestScore = 0;
+	for (i = 0; i < size; i++) {
+		Process *process = enabledProcesses[i].get();
+		if (enabledProcessBusynessLevels[i] == INT_MAX
+		 || (unsigned long long) process->sessions >= maxSessions)
+		{
+			continue;
+		}
+
+		// MurmurHash3 finalizer over the request hash and the process ID.
+		boost::uint32_t score = hash ^ (process->getStickySessionId() * 0x9e3779b9u);
+		score ^= score >> 16;
+		score *= 0x85ebca6bu;
+		score ^= score >> 13;
+		score *= 0xc2b2ae35u;
+		score ^= score >> 16;
+		if (bestProcess == NULL || score > bestScore) {
+			bestProcess = process;
+			bestScore = score;
+		}
+	}
+
+	if (bestProcess == NULL) {
+		return findEnabledProcessWithLowestBusyness();
+	} else {
+		return bestProcess;
+	}
+}
+
+/**
+ * Returns the given recycling limit (a number of requests or an amount of
+ * memory) for the given process, lowered by up to `options.recycleLimitJitter`
+ * percent. Because the amount depends on the process's random `recycleJitter`,
+ * processes that were spawned at the same time reach their limits at
+ * different times.
+ */
+unsigned long
+Group::jitteredLimit(const Process *process, unsigned long limit) const {
+	if (options.recycleLimitJitter == 0) {
+		return limit;
+	}
+
+	unsigned int percentage = std::min(options.recycleLimitJitter, 99u);
+	double maxJitter = (double) limit * percentage / 100;
+	return limit - (unsigned long) (maxJitter * process->recycleJitter);
+}
+
 /**
  * Adds a process to the given list (enabledProcess, disablingProcesses, disabledProcesses)
  * and sets the process->enabled flag accordingly.
@@ -138,10 +234,13 @@ Group::addProcessToList(const ProcessPtr &process, ProcessList &destination) {
 	if (&destination == &enabledProcesses) {
 		process->enabled = Process::ENABLED;
 		enabledCount++;
-		enabledProcessBusynessLevels.push_back(process->busyness());
+		enabledProcessBusynessLevels.push_back(process->routingBusyness());
 		if (process->isTotallyBusy()) {
 			nEnabledProcessesTotallyBusy++;
 		}
+		if (OXT_UNLIKELY(process->health.isEjected())) {
+			scheduleOutlierReadmission(process->health.getEjectedUntil());
+		}
 	} else if (&destination == &disablingProcesses) {
 		process->enabled = Process::DISABLING;
 		disablingCount++;
@@ -212,7 +311,7 @@ Group::removeProcessFromList(const ProcessPtr &process, ProcessList &source) {
 		enabledProcessBusynessLevels.clear();
 		for (it = source.begin(); it != end; it++, i++) {
 			const ProcessPtr &process = *it;
-			enabledProcessBusynessLevels.push_back(process->busyness());
+			enabledProcessBusynessLevels.push_back(process->routingBusyness());
 		}
 		enabledProcessBusynessLevels.shrink_to_fit();
 	}
@@ -387,21 +486,14 @@ Group::detachedProcessesCheckerMain(GroupPtr self) {
 	}
 }
 
-
-/****************************
- *
- * Public methods
- *
- ****************************/
-
-
 /**
- * Attaches the given process to this Group and mark it as enabled. This
- * function doesn't touch `getWaitlist` so be sure to fix its invariants
- * afterwards if necessary, e.g. by calling `assignSessionsToGetWaiters()`.
+ * Attaches the given process to this Group without checking the group and
+ * pool process limits. This is only used in exceptional situations, such
+ * as rolling restarts, which temporarily run one process more than the
+ * limits allow so that capacity doesn't drop while replacing processes.
  */
-AttachResult
-Group::attach(const ProcessPtr &process,
+void
+Group::attachIrrespectiveOfLimits(const ProcessPtr &process,
 	boost::container::vector<Callback> &postLockActions)
 {
 	TRACE_POINT();
@@ -409,21 +501,18 @@ Group::attach(const ProcessPtr &process,
 	assert(process->isAlive());
 	assert(isAlive());
 
-	if (processUpperLimitsReached()) {
-		return AR_GROUP_UPPER_LIMITS_REACHED;
-	} else if (poolAtFullCapacity()) {
-		return AR_POOL_AT_FULL_CAPACITY;
-	} else if (!isWaitingForCapacity() && anotherGroupIsWaitingForCapacity()) {
-		return AR_ANOTHER_GROUP_IS_WAITING_FOR_CAPACITY;
-	}
-
 	process->initializeStickySessionId(generateStickySessionId());
+	process->recycleJitter = pool->getRandomGenerator()->generateUint() / 4294967296.0;
 	if (options.forceMaxConcurrentRequestsPerProcess != -1) {
 		process->forceMaxConcurrency(options.forceMaxConcurrentRequestsPerProcess);
 	}
 
 	P_DEBUG("Attaching process " << process->inspect());
 	addProcessToList(process, enabledProcesses);
+	if (options.oobwInterval > 0) {
+		getPool()->scheduleGarbageCollection(process->getSpawnEndTime()
+			+ (unsigned long long) options.oobwInterval * 1000000);
+	}
 
 	/* Now that there are enough resources, relevant processes in
 	 * 'disableWaitlist' can be disabled.
@@ -457,7 +546,39 @@ Group::attach(const ProcessPtr &process,
 	wakeUpGarbageCollector();
 
 	postLockActions.push_back(boost::bind(&Group::runAttachHooks, this, process));
+}
+
+
+/****************************
+ *
+ * Public methods
+ *
+ ****************************/
+
+
+/**
+ * Attaches the given process to this Group and mark it as enabled. This
+ * function doesn't touch `getWaitlist` so be sure to fix its invariants
+ * afterwards if necessary, e.g. by calling `assignSessionsToGetWaiters()`.
+ */
+AttachResult
+Group::attach(const ProcessPtr &process,
+	boost::container::vector<Callback> &postLockActions)
+{
+	TRACE_POINT();
+	assert(process->getGroup() == NULL || process->getGroup() == this);
+	assert(process->isAlive());
+	assert(isAlive());
+
+	if (processUpperLimitsReached()) {
+		return AR_GROUP_UPPER_LIMITS_REACHED;
+	} else if (poolAtFullCapacity()) {
+		return AR_POOL_AT_FULL_CAPACITY;
+	} else if (!isWaitingForCapacity() && anotherGroupIsWaitingForCapacity()) {
+		return AR_ANOTHER_GROUP_IS_WAITING_FOR_CAPACITY;
+	}
 
+	attachIrrespectiveOfLimits(process, postLockActions);
 	return AR_OK;
 }
 
@@ -58,16 +58,16 @@ Group::RouteResult
 Group::route(const Options &options) const {
 	if (OXT_LIKELY(enabledCount > 0)) {
 		if (options.stickySessionId == 0) {
-			Process *process = findEnabledProcessWithLowestBusyness();
-			if (process->canBeRoutedTo()) {
-				return RouteResult(process);
-			} else {
-				return RouteResult(NULL, true);
-			}
+			Process *process = OXT_LIKELY(options.routingHash == 0)
+				? findEnabledProcessWithLowestBusyness()
+				: findProcessWithRoutingHash(options.routingHash);
+			return routeToLeastBusyEnabledProcess(process);
 		} else {
 			Process *process = findProcessWithStickySessionIdOrLowestBusyness(
 				options.stickySessionId);
-			if (process != NULL) {
+			if (process != NULL && process->getStickySessionId() != options.stickySessionId) {
+				return routeToLeastBusyEnabledProcess(process);
+			} else if (process != NULL) {
 				if (process->canBeRoutedTo()) {
 					return RouteResult(process);
 				} else {
@@ -87,14 +87,41 @@ Group::route(const Options &options) const {
 	}
 }
 
+/* Helper for route(). `process` is the enabled process that the routing
+ * algorithm picked. Because routing-restricted processes (see
+ * `Process::isRoutingRestricted()`) sort last, it is only restricted or
+ * totally busy if all unrestricted processes are totally busy.
+ *
+ * In that case the request goes to an ejected process if one can take it.
+ * Queueing the request while an ejected process sits idle would leave an idle
+ * enabled process next to a non-empty getWaitlist, which other code (e.g.
+ * `Pool::forceFreeCapacity()`) assumes never happens.
+ */
+Group::RouteResult
+Group::routeToLeastBusyEnabledProcess(Process *process) const {
+	if (OXT_LIKELY(!process->isRoutingRestricted()) && process->canBeRoutedTo()) {
+		return RouteResult(process);
+	}
+
+	process = findEjectedProcessWithLowestBusyness();
+	if (process != NULL) {
+		return RouteResult(process);
+	} else {
+		return RouteResult(NULL, true);
+	}
+}
+
 SessionPtr
 Group::newSession(Process *process, unsigned long long now) {
 	bool wasTotallyBusy = process->isTotallyBusy();
 	SessionPtr session = process->newSession(now);
 	session->onInitiateFailure = _onSessionInitiateFailure;
 	session->onClose   = _onSessionClose;
+	// `now` may have been taken well before the session was checked out,
+	// e.g. when the request was queued.
+	session->checkoutTime = SystemTime::getUsec();
 	if (process->enabled == Process::ENABLED) {
-		enabledProcessBusynessLevels[process->getIndex()] = process->busyness();
+		enabledProcessBusynessLevels[process->getIndex()] = process->routingBusyness();
 		if (!wasTotallyBusy && process->isTotallyBusy()) {
 			nEnabledProcessesTotallyBusy++;
 		}
@@ -154,12 +181,14 @@ Group::onSessionClose(Process *process, Session *session) {
 	/* Update statistics. */
 	bool wasTotallyBusy = process->isTotallyBusy();
 	process->sessionClosed(session);
+	bool detachingBecauseUnhealthy = options.outlierEjectionErrors != 0
+		&& updateProcessHealth(process, session);
 	assert(process->getLifeStatus() == Process::ALIVE);
 	assert(process->enabled == Process::ENABLED
 		|| process->enabled == Process::DISABLING
 		|| process->enabled == Process::DETACHED);
 	if (process->enabled == Process::ENABLED) {
-		enabledProcessBusynessLevels[process->getIndex()] = process->busyness();
+		enabledProcessBusynessLevels[process->getIndex()] = process->routingBusyness();
 		if (wasTotallyBusy) {
 			assert(nEnabledProcessesTotallyBusy >= 1);
 			nEnabledProcessesTotallyBusy--;
@@ -173,18 +202,25 @@ Group::onSessionClose(Process *process, Session *session) {
 
 	bool detachingBecauseOfMaxRequests = false;
 	bool detachingBecauseCapacityNeeded = false;
-	bool shouldDetach =
+	bool shouldDetach = detachingBecauseUnhealthy ||
 		( detachingBecauseOfMaxRequests = (
 			options.maxRequests > 0
-			&& process->processed >= options.maxRequests
+			&& process->processed >= jitteredLimit(process, options.maxRequests)
+			&& !recycleInBackground(process)
 		)) || (
 			detachingBecauseCapacityNeeded = (
 				process->sessions == 0
-				&& getWaitlist.empty()
+				&& capacityUsed() > options.guaranteedCapacity
 				&& (
 					!pool->getWaitlist.empty()
 					|| anotherGroupIsWaitingForCapacity()
 				)
+				&& (
+					getWaitlist.empty()
+					// Even if this group is busy, it should not starve
+					// other groups of capacity.
+					|| (enabledCount > 1 && capacityUsed() > fairShare())
+				)
 			)
 		);
 	bool shouldDisable =
@@ -197,7 +233,14 @@ Group::onSessionClose(Process *process, Session *session) {
 		boost::container::vector<Callback> actions;
 
 		if (shouldDetach) {
-			if (detachingBecauseCapacityNeeded) {
+			if (detachingBecauseUnhealthy) {
+				/* This process keeps failing requests, even after having been
+				 * ejected several times, so we replace it.
+				 */
+				P_WARN("Process " << process->inspect() << " has been ejected " <<
+					process->health.getConsecutiveEjections() << " times in a row "
+					"because of failing requests; replacing it");
+			} else if (detachingBecauseCapacityNeeded) {
 				/* Someone might be trying to get() a session for a different
 				 * group that couldn't be spawned because of lack of pool capacity.
 				 * If this group isn't under sufficiently load (as apparent by the
@@ -206,6 +249,7 @@ Group::onSessionClose(Process *process, Session *session) {
 				 */
 				P_DEBUG("Process " << process->inspect() << " is no longer totally "
 					"busy; detaching it in order to make room in the pool");
+				processesEvicted++;
 			} else {
 				/* This process has processed its maximum number of requests,
 				 * so we detach it.
@@ -215,6 +259,9 @@ Group::onSessionClose(Process *process, Session *session) {
 					options.maxRequests << "); detaching it");
 			}
 			pool->detachProcessUnlocked(process->shared_from_this(), actions);
+			if (detachingBecauseUnhealthy && isAlive() && shouldSpawn()) {
+				spawn();
+			}
 		} else {
 			ProcessPtr processPtr = process->shared_from_this();
 			removeProcessFromList(processPtr, disablingProcesses);
@@ -232,6 +279,9 @@ Group::onSessionClose(Process *process, Session *session) {
 
 		// This could change process->enabled.
 		maybeInitiateOobw(process);
+		if (OXT_UNLIKELY(hasDeferredOobw)) {
+			initiateDeferredOobwRequests();
+		}
 
 		if (!getWaitlist.empty() && process->enabled == Process::ENABLED) {
 			/* If there are clients on this group waiting for a process to
@@ -244,6 +294,73 @@ Group::onSessionClose(Process *process, Session *session) {
 	}
 }
 
+/**
+ * Reports the outcome of a session to the process's ProcessHealthMonitor,
+ * and ejects the process if it turns out to be an outlier. Ejected processes
+ * are excluded from routing through `Process::routingBusyness()`.
+ *
+ * Returns whether the process has been ejected too many times in a row
+ * and should be replaced.
+ */
+bool
+Group::updateProcessHealth(Process *process, Session *session) {
+	unsigned long long now = SystemTime::getUsec();
+	// Measure up to the start of the response, so that long-lived sessions
+	// (WebSockets, streaming responses) aren't counted as slow. If the app
+	// never responded then the session lasted as long as it waited.
+	unsigned long long end = (session->responseBeginTime != 0)
+		? session->responseBeginTime
+		: now;
+	unsigned long long latency = (end > session->checkoutTime)
+		? end - session->checkoutTime
+		: 0;
+
+	if (!process->health.report(session->hasAppError(), latency, now,
+		options.outlierEjectionErrors, options.outlierLatencyThreshold,
+		options.outlierEjectionTime))
+	{
+		return false;
+	}
+
+	P_WARN("Process " << process->inspect() << " is failing requests; "
+		"not routing new requests to it for " <<
+		(process->health.getEjectedUntil() - now) / 1000000 << " seconds");
+	scheduleOutlierReadmission(process->health.getEjectedUntil());
+	return options.outlierRestartThreshold != 0
+		&& process->health.getConsecutiveEjections() >= options.outlierRestartThreshold;
+}
+
+void
+Group::scheduleOutlierReadmission(unsigned long long time) {
+	if (nextOutlierReadmissionTime == 0 || time < nextOutlierReadmissionTime) {
+		nextOutlierReadmissionTime = time;
+	}
+}
+
+/**
+ * Starts probing enabled processes whose ejection time has passed, so that
+ * they receive a trickle of traffic again. Called from get() so that this
+ * doesn't need a timer.
+ */
+void
+Group::maybeReadmitOutliers(unsigned long long now) {
+	if (now < nextOutlierReadmissionTime) {
+		return;
+	}
+
+	nextOutlierReadmissionTime = 0;
+	for (unsigned int i = 0; i < enabledProcesses.size(); i++) {
+		Process *process = enabledProcesses[i].get();
+		if (process->health.maybeStartProbing(now)) {
+			P_INFO("Probing whether process " << process->inspect() <<
+				" has recovered from failing requests");
+			enabledProcessBusynessLevels[i] = process->routingBusyness();
+		} else if (process->health.isEjected()) {
+			scheduleOutlierReadmission(process->health.getEjectedUntil());
+		}
+	}
+}
+
 
 /****************************
  *
@@ -258,6 +375,12 @@ Group::get(const Options &newOptions, const GetCallback &callback,
 {
 	assert(isAlive());
 
+	if (!newOptions.noop) {
+		lastUsed = (newOptions.currentTime != 0)
+			? newOptions.currentTime
+			: SystemTime::getUsec();
+	}
+
 	if (OXT_LIKELY(!restarting())) {
 		if (OXT_UNLIKELY(needsRestart(newOptions))) {
 			restart(newOptions);
@@ -316,6 +439,11 @@ Group::get(const Options &newOptions, const GetCallback &callback,
 		}
 		return SessionPtr();
 	} else {
+		if (OXT_UNLIKELY(nextOutlierReadmissionTime != 0)) {
+			maybeReadmitOutliers(newOptions.currentTime != 0
+				? newOptions.currentTime : SystemTime::getUsec());
+		}
+
 		RouteResult result = route(newOptions);
 		if (result.process == NULL) {
 			/* Looks like all processes are totally busy.
@@ -328,6 +456,11 @@ Group::get(const Options &newOptions, const GetCallback &callback,
 			return SessionPtr();
 		} else {
 			P_DEBUG("Session checked out from process " << result.process->inspect());
+			if (newOptions.requestQueueTargetDelay != 0) {
+				getWaitlistDelayMonitor.bypass(newOptions.currentTime != 0
+					? newOptions.currentTime : SystemTime::getUsec(),
+					newOptions.requestQueueTargetDelay);
+			}
 			return newSession(result.process, newOptions.currentTime);
 		}
 	}
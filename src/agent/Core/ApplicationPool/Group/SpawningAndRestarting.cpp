@@ -53,6 +53,14 @@ Group::spawnThreadMain(GroupPtr self, SpawningKit::SpawnerPtr spawner,
 	spawnThreadRealMain(spawner, options, restartsInitiated);
 }
 
+void
+Group::forceTriggerShutdownAndCleanupAll(const vector<ProcessPtr> *processes) {
+	vector<ProcessPtr>::const_iterator it, end = processes->end();
+	for (it = processes->begin(); it != end; it++) {
+		Process::forceTriggerShutdownAndCleanup(*it);
+	}
+}
+
 void
 Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 	const Options &options, unsigned int restartsInitiated)
@@ -67,6 +75,12 @@ Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 	bool done = false;
 	while (!done) {
 		bool shouldFail = false;
+		unsigned int batchSize;
+		{
+			LockGuard l(pool->syncher);
+			batchSize = processesBeingSpawned;
+		}
+
 		if (debug != NULL && debug->spawning) {
 			UPDATE_TRACE_POINT();
 			boost::this_thread::restore_interruption ri(di);
@@ -89,7 +103,7 @@ Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 			shouldFail = message->name == "Fail spawn loop iteration " + iteration;
 		}
 
-		ProcessPtr process;
+		vector<ProcessPtr> processes;
 		ExceptionPtr exception;
 		try {
 			UPDATE_TRACE_POINT();
@@ -103,8 +117,14 @@ Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 					journey, &config);
 				e.setSummary("Simulated failure");
 				throw e.finalize();
+			} else if (batchSize > 1) {
+				vector<SpawningKit::Result> results = spawner->spawnBatch(options, batchSize);
+				vector<SpawningKit::Result>::const_iterator it, end = results.end();
+				for (it = results.begin(); it != end; it++) {
+					processes.push_back(createProcessObject(*spawner, *it));
+				}
 			} else {
-				process = createProcessObject(*spawner, spawner->spawn(options));
+				processes.push_back(createProcessObject(*spawner, spawner->spawn(options)));
 			}
 		} catch (const boost::thread_interrupted &) {
 			break;
@@ -118,13 +138,14 @@ Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 		}
 
 		UPDATE_TRACE_POINT();
-		ScopeGuard guard(boost::bind(Process::forceTriggerShutdownAndCleanup, process));
+		ScopeGuard guard(boost::bind(forceTriggerShutdownAndCleanupAll, &processes));
 		boost::unique_lock<boost::mutex> lock(pool->syncher);
 
 		if (!isAlive()) {
-			if (process != NULL) {
-				P_DEBUG("Group is being shut down so dropping process " <<
-					process->inspect() << " which we just spawned and exiting spawn loop");
+			if (!processes.empty()) {
+				P_DEBUG("Group is being shut down so dropping " << processes.size() <<
+					" process(es), starting with " << processes[0]->inspect() <<
+					", which we just spawned and exiting spawn loop");
 			} else {
 				P_DEBUG("The group is being shut down. A process failed "
 					"to be spawned anyway, so ignoring this error and exiting "
@@ -134,9 +155,11 @@ Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 			// may have been violated.
 			break;
 		} else if (restartsInitiated != this->restartsInitiated) {
-			if (process != NULL) {
-				P_DEBUG("A restart was issued for the group, so dropping process " <<
-					process->inspect() << " which we just spawned and exiting spawn loop");
+			if (!processes.empty()) {
+				P_DEBUG("A restart was issued for the group, so dropping " <<
+					processes.size() << " process(es), starting with " <<
+					processes[0]->inspect() << ", which we just spawned and"
+					" exiting spawn loop");
 			} else {
 				P_DEBUG("A restart was issued for the group. A process failed "
 					"to be spawned anyway, so ignoring this error and exiting "
@@ -151,15 +174,30 @@ Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 		assert(m_spawning);
 		assert(processesBeingSpawned > 0);
 
-		processesBeingSpawned--;
+		processesBeingSpawned -= batchSize;
 		assert(processesBeingSpawned == 0);
 
 		UPDATE_TRACE_POINT();
 		boost::container::vector<Callback> actions;
-		if (process != NULL) {
-			AttachResult result = attach(process, actions);
-			if (result == AR_OK) {
-				guard.clear();
+		if (!processes.empty()) {
+			bool attachedAny = false;
+			vector<ProcessPtr>::iterator it, end = processes.end();
+			for (it = processes.begin(); it != end; it++) {
+				AttachResult result = attach(*it, actions);
+				if (result == AR_OK) {
+					attachedAny = true;
+					// Prevent the guard from cleaning up this process.
+					it->reset();
+				} else {
+					done = true;
+					P_DEBUG("Unable to attach spawned process " << (*it)->inspect());
+					if (result == AR_ANOTHER_GROUP_IS_WAITING_FOR_CAPACITY) {
+						pool->possiblySpawnMoreProcessesForExistingGroups();
+					}
+					break;
+				}
+			}
+			if (attachedAny) {
 				if (getWaitlist.empty()) {
 					pool->assignSessionsToGetWaiters(actions);
 				} else {
@@ -167,12 +205,6 @@ Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 				}
 				P_DEBUG("New process count = " << enabledCount <<
 					", remaining get waiters = " << getWaitlist.size());
-			} else {
-				done = true;
-				P_DEBUG("Unable to attach spawned process " << process->inspect());
-				if (result == AR_ANOTHER_GROUP_IS_WAITING_FOR_CAPACITY) {
-					pool->possiblySpawnMoreProcessesForExistingGroups();
-				}
 			}
 		} else {
 			// TODO: sure this is the best thing? if there are
@@ -193,7 +225,7 @@ Group::spawnThreadRealMain(const SpawningKit::SpawnerPtr &spawner,
 		if (done) {
 			P_DEBUG("Spawn loop done");
 		} else {
-			processesBeingSpawned++;
+			processesBeingSpawned += spawnBatchSize();
 			P_DEBUG("Continue spawning");
 		}
 
@@ -294,6 +326,418 @@ Group::finalizeRestart(GroupPtr self,
 	}
 }
 
+/**
+ * Restarts this group by replacing its processes one by one, so that the
+ * group keeps serving requests throughout the restart. The new spawner is
+ * swapped in right away so that any process spawned from now on runs the
+ * new version; rollingRestartThreadMain() takes care of the old processes.
+ */
+void
+Group::rollingRestart(const Options &options) {
+	P_DEBUG("Rolling restarting group " << getName());
+
+	// If there is currently a restarter thread or a spawner thread active,
+	// the following tells them to abort their current work as soon as possible.
+	restartsInitiated++;
+
+	processesBeingSpawned = 0;
+	m_spawning = false;
+	m_rollingRestarting = true;
+	recyclesInProgress = 0;
+	uuid = generateUuid(pool);
+	this->options.groupUuid = uuid;
+
+	// `options` may refer to `this->options`, so make a copy first.
+	Options newOptions = options.copyAndPersist().clearPerRequestFields();
+	resetOptions(newOptions);
+	SpawningKit::SpawnerPtr oldSpawner = spawner;
+	spawner = getContext()->spawningKitFactory->create(this->options);
+
+	ProcessList oldProcesses;
+	oldProcesses.reserve(getProcessCount());
+	oldProcesses.insert(oldProcesses.end(), enabledProcesses.begin(), enabledProcesses.end());
+	oldProcesses.insert(oldProcesses.end(), disablingProcesses.begin(), disablingProcesses.end());
+	oldProcesses.insert(oldProcesses.end(), disabledProcesses.begin(), disabledProcesses.end());
+
+	interruptableThreads.create_thread(
+		boost::bind(&Group::rollingRestartThreadMain, this, shared_from_this(),
+			oldSpawner, spawner,
+			this->options.copyAndPersist().clearPerRequestFields(),
+			oldProcesses, restartsInitiated),
+		"Group rolling restarter: " + getName(),
+		POOL_HELPER_THREAD_STACK_SIZE
+	);
+}
+
+// The 'self' parameter is for keeping the current Group object alive while this thread is running.
+void
+Group::rollingRestartThreadMain(GroupPtr self, SpawningKit::SpawnerPtr oldSpawner,
+	SpawningKit::SpawnerPtr newSpawner, Options options, ProcessList oldProcesses,
+	unsigned int restartsInitiated)
+{
+	TRACE_POINT();
+	boost::this_thread::disable_interruption di;
+	boost::this_thread::disable_syscall_interruption dsi;
+
+	Pool *pool = getPool();
+	oldSpawner.reset();
+
+	ProcessList::const_iterator it, end = oldProcesses.end();
+	for (it = oldProcesses.begin(); it != end; it++) {
+		const ProcessPtr &oldProcess = *it;
+
+		{
+			boost::unique_lock<boost::mutex> lock(pool->syncher);
+			if (!isAlive() || restartsInitiated != this->restartsInitiated) {
+				P_DEBUG("Rolling restart of group " << getName() << " aborted");
+				return;
+			} else if (!oldProcess->isAlive() || oldProcess->enabled == Process::DETACHED) {
+				// The process was already detached for another reason,
+				// e.g. because it was idle for too long.
+				continue;
+			}
+		}
+
+		UPDATE_TRACE_POINT();
+		ProcessPtr process;
+		try {
+			boost::this_thread::restore_interruption ri(di);
+			boost::this_thread::restore_syscall_interruption rsi(dsi);
+			process = createProcessObject(*newSpawner, newSpawner->spawn(options));
+		} catch (const boost::thread_interrupted &) {
+			return;
+		} catch (SpawningKit::SpawnException &e) {
+			processAndLogNewSpawnException(e, options, pool->getContext());
+		} catch (const tracable_exception &e) {
+			P_ERROR("Cannot spawn a process for group " << getName() << ": " <<
+				e.what() << "\n" << e.backtrace());
+		}
+
+		if (process == NULL) {
+			// Keep the remaining old processes around: serving requests with
+			// the old version is better than not serving them at all.
+			P_ERROR("Rolling restart of group " << getName() << " aborted "
+				"because a new process could not be spawned");
+			break;
+		}
+
+		UPDATE_TRACE_POINT();
+		ScopeGuard guard(boost::bind(Process::forceTriggerShutdownAndCleanup, process));
+		if (options.warmupRequests > 0) {
+			try {
+				boost::this_thread::restore_interruption ri(di);
+				boost::this_thread::restore_syscall_interruption rsi(dsi);
+				sendWarmupRequests(process, options);
+			} catch (const boost::thread_interrupted &) {
+				return;
+			}
+		}
+
+		UPDATE_TRACE_POINT();
+		boost::container::vector<Callback> actions;
+		boost::unique_lock<boost::mutex> lock(pool->syncher);
+		if (!isAlive() || restartsInitiated != this->restartsInitiated) {
+			P_DEBUG("Rolling restart of group " << getName() << " aborted, so "
+				"dropping process " << process->inspect() << " which we just spawned");
+			return;
+		}
+
+		guard.clear();
+		replaceProcess(oldProcess, process, actions);
+		pool->fullVerifyInvariants();
+		lock.unlock();
+		UPDATE_TRACE_POINT();
+		runAllActions(actions);
+	}
+
+	boost::unique_lock<boost::mutex> lock(pool->syncher);
+	if (isAlive() && restartsInitiated == this->restartsInitiated) {
+		m_rollingRestarting = false;
+		if (shouldSpawn()) {
+			spawn();
+		}
+		P_DEBUG("Rolling restart of group " << getName() << " done");
+	}
+}
+
+/**
+ * Puts a freshly spawned process into service in place of an old one, as
+ * part of a rolling restart or of recycling. The new process is attached before the old one
+ * is disabled, so the number of enabled processes never drops. To make that
+ * possible, the group temporarily has one process more than the limits
+ * allow. The old process finishes its current requests before it is
+ * detached.
+ */
+void
+Group::replaceProcess(const ProcessPtr &oldProcess, const ProcessPtr &newProcess,
+	boost::container::vector<Callback> &postLockActions)
+{
+	P_DEBUG("Replacing process " << oldProcess->inspect() <<
+		" with " << newProcess->inspect());
+	attachIrrespectiveOfLimits(newProcess, postLockActions);
+
+	if (oldProcess->isAlive() && oldProcess->enabled != Process::DETACHED) {
+		DisableResult result = disable(oldProcess,
+			boost::bind(&Pool::lockAndDetachDisabledProcess, pool,
+				boost::placeholders::_1, boost::placeholders::_2));
+		switch (result) {
+		case DR_SUCCESS:
+		case DR_NOOP:
+			pool->detachProcessUnlocked(oldProcess, postLockActions);
+			break;
+		case DR_DEFERRED:
+			// Pool::lockAndDetachDisabledProcess() will eventually be called.
+			break;
+		default:
+			P_WARN("Process " << oldProcess->inspect() <<
+				" could not be disabled; leaving it running");
+			break;
+		}
+	}
+
+	if (getWaitlist.empty()) {
+		pool->assignSessionsToGetWaiters(postLockActions);
+	} else {
+		assignSessionsToGetWaiters(postLockActions);
+	}
+}
+
+/**
+ * Called when a process has reached its maximum number of requests. If
+ * `options.maxConcurrentRecycles` is set, then instead of detaching the
+ * process right away (which lowers the group's capacity until a new process
+ * has been spawned), a replacement is spawned in the background while the
+ * process keeps serving requests. If too many processes are already being
+ * replaced, the process simply keeps serving requests until it's its turn.
+ *
+ * Returns whether the process is taken care of this way, in which case the
+ * caller must not detach it.
+ */
+bool
+Group::recycleInBackground(Process *process) {
+	if (options.maxConcurrentRecycles == 0
+	 || process->enabled != Process::ENABLED
+	 || m_restarting)
+	{
+		return false;
+	} else if (process->recycling) {
+		return true;
+	} else if (recyclesInProgress >= options.maxConcurrentRecycles) {
+		P_DEBUG("Process " << process->inspect() << " has reached its maximum "
+			"number of requests, but " << recyclesInProgress << " other processes "
+			"are already being replaced; replacing it later");
+		return true;
+	}
+
+	P_DEBUG("Process " << process->inspect() << " has reached its maximum "
+		"number of requests (" << options.maxRequests << "); spawning a replacement");
+	process->recycling = true;
+	recyclesInProgress++;
+	interruptableThreads.create_thread(
+		boost::bind(&Group::recycleThreadMain, this, shared_from_this(),
+			spawner, options.copyAndPersist().clearPerRequestFields(),
+			process->shared_from_this(), restartsInitiated),
+		"Process recycler: " + process->inspect(),
+		POOL_HELPER_THREAD_STACK_SIZE
+	);
+	return true;
+}
+
+// The 'self' parameter is for keeping the current Group object alive while this thread is running.
+void
+Group::recycleThreadMain(GroupPtr self, SpawningKit::SpawnerPtr spawner, Options options,
+	ProcessPtr oldProcess, unsigned int restartsInitiated)
+{
+	TRACE_POINT();
+	boost::this_thread::disable_interruption di;
+	boost::this_thread::disable_syscall_interruption dsi;
+
+	Pool *pool = getPool();
+	ProcessPtr process;
+	try {
+		boost::this_thread::restore_interruption ri(di);
+		boost::this_thread::restore_syscall_interruption rsi(dsi);
+		process = createProcessObject(*spawner, spawner->spawn(options));
+	} catch (const boost::thread_interrupted &) {
+		return;
+	} catch (SpawningKit::SpawnException &e) {
+		processAndLogNewSpawnException(e, options, pool->getContext());
+	} catch (const tracable_exception &e) {
+		P_ERROR("Cannot spawn a process for group " << getName() << ": " <<
+			e.what() << "\n" << e.backtrace());
+	}
+
+	if (process != NULL && options.warmupRequests > 0) {
+		// sendWarmupRequests() gives up after a timeout, so this always
+		// returns and the recycle state below always gets cleaned up.
+		try {
+			boost::this_thread::restore_interruption ri(di);
+			boost::this_thread::restore_syscall_interruption rsi(dsi);
+			sendWarmupRequests(process, options);
+		} catch (const boost::thread_interrupted &) {
+			Process::forceTriggerShutdownAndCleanup(process);
+			return;
+		} catch (const tracable_exception &e) {
+			P_WARN("Warm-up requests to process " << process->inspect() <<
+				" failed: " << e.what());
+		}
+	}
+
+	UPDATE_TRACE_POINT();
+	boost::container::vector<Callback> actions;
+	boost::unique_lock<boost::mutex> lock(pool->syncher);
+	if (!isAlive() || restartsInitiated != this->restartsInitiated) {
+		// The group was restarted in the mean time, so the old process is
+		// gone already.
+		if (process != NULL) {
+			lock.unlock();
+			Process::forceTriggerShutdownAndCleanup(process);
+		}
+		return;
+	}
+
+	assert(recyclesInProgress > 0);
+	recyclesInProgress--;
+	oldProcess->recycling = false;
+	if (process != NULL) {
+		replaceProcess(oldProcess, process, actions);
+	} else if (oldProcess->isAlive() && oldProcess->enabled != Process::DETACHED) {
+		P_WARN("Could not spawn a replacement for process " << oldProcess->inspect() <<
+			", which has reached its maximum number of requests; detaching it anyway");
+		pool->detachProcessUnlocked(oldProcess, actions);
+	}
+	pool->fullVerifyInvariants();
+	lock.unlock();
+	UPDATE_TRACE_POINT();
+	runAllActions(actions);
+}
+
+/**
+ * Sends `options.warmupRequests` GET requests to a freshly spawned process
+ * before it receives real traffic, so that it can fill its caches and load
+ * lazily loaded code. Errors are logged but otherwise ignored: the process
+ * already passed the spawn handshake, so it is ready to be used anyway.
+ */
+void
+Group::sendWarmupRequests(const ProcessPtr &process, const Options &options) {
+	TRACE_POINT();
+	Socket *socket = process->findSocketsAcceptingHttpRequestsAndWithLowestBusyness();
+	if (socket == NULL) {
+		return;
+	}
+
+	P_DEBUG("Sending " << options.warmupRequests << " warm-up requests to process " <<
+		process->inspect());
+	for (unsigned int i = 0; i < options.warmupRequests; i++) {
+		// Warming up is part of starting the process, so every warm-up
+		// request may take as long as the spawn itself is allowed to.
+		unsigned long long timeout = (unsigned long long) options.startTimeout * 1000;
+		try {
+			// The connection is marked as fail because we half-close it,
+			// so it can't be reused.
+			Connection connection = socket->checkoutConnection();
+			connection.fail = true;
+			ScopeGuard guard(boost::bind(&Socket::checkinConnection, socket, connection));
+			sendWarmupRequest(connection.fd, socket->protocol, options, &timeout);
+		} catch (const SystemException &e) {
+			P_WARN("Warm-up request to process " << process->inspect() <<
+				" failed: " << e.what());
+			return;
+		} catch (const TimeoutException &e) {
+			P_WARN("Warm-up request to process " << process->inspect() <<
+				" timed out");
+			return;
+		}
+	}
+}
+
+void
+Group::sendWarmupRequest(int fd, const StaticString &protocol, const Options &options,
+	unsigned long long *timeout)
+{
+	StaticString requestUri = options.warmupRequestPath;
+	StaticString pathInfo = requestUri;
+	StaticString queryString;
+	string::size_type pos = requestUri.find('?');
+	if (pos != string::npos) {
+		pathInfo = requestUri.substr(0, pos);
+		queryString = requestUri.substr(pos + 1);
+	}
+
+	if (protocol == "session") {
+		// This is modeled after Core::Controller when it is sending data
+		// using the "session" protocol.
+		char sizeField[sizeof(boost::uint32_t)];
+		boost::container::small_vector<StaticString, 32> data;
+
+		data.push_back(StaticString(sizeField, sizeof(boost::uint32_t)));
+		data.push_back(P_STATIC_STRING_WITH_NULL("REQUEST_METHOD"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("GET"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("REQUEST_URI"));
+		data.push_back(requestUri);
+		data.push_back(StaticString("", 1));
+		data.push_back(P_STATIC_STRING_WITH_NULL("PATH_INFO"));
+		data.push_back(pathInfo);
+		data.push_back(StaticString("", 1));
+		data.push_back(P_STATIC_STRING_WITH_NULL("SCRIPT_NAME"));
+		data.push_back(StaticString("", 1));
+		data.push_back(P_STATIC_STRING_WITH_NULL("QUERY_STRING"));
+		data.push_back(queryString);
+		data.push_back(StaticString("", 1));
+		data.push_back(P_STATIC_STRING_WITH_NULL("SERVER_NAME"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("localhost"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("SERVER_PORT"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("80"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("SERVER_PROTOCOL"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("HTTP/1.1"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("REMOTE_ADDR"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("127.0.0.1"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("HTTP_HOST"));
+		data.push_back(P_STATIC_STRING_WITH_NULL("localhost"));
+
+		data.push_back(P_STATIC_STRING_WITH_NULL("PASSENGER_CONNECT_PASSWORD"));
+		data.push_back(getApiKey().toStaticString());
+		data.push_back(StaticString("", 1));
+
+		boost::uint32_t dataSize = 0;
+		for (unsigned int i = 1; i < data.size(); i++) {
+			dataSize += (boost::uint32_t) data[i].size();
+		}
+		Uint32Message::generate(sizeField, dataSize);
+
+		gatheredWrite(fd, &data[0], data.size(), timeout);
+	} else {
+		writeExact(fd, "GET " + requestUri + " HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Connection: close\r\n\r\n",
+			timeout);
+	}
+
+	// Apps that support keep-alive connections don't close the
+	// connection after sending the response, but they do close it when
+	// they see that there won't be a next request.
+	if (syscalls::shutdown(fd, SHUT_WR) == -1) {
+		int e = errno;
+		throw SystemException("Cannot shut down the writer side of the "
+			"warm-up connection", e);
+	}
+
+	// We do not care what the actual response is ... just read it until
+	// the application closes the connection.
+	char buf[1024 * 4];
+	ssize_t ret;
+	do {
+		if (!waitUntilReadable(fd, timeout)) {
+			throw TimeoutException("Cannot read warm-up response within the timeout");
+		}
+		ret = syscalls::read(fd, buf, sizeof(buf));
+		if (ret == -1) {
+			int e = errno;
+			throw SystemException("Cannot read warm-up response", e);
+		}
+	} while (ret > 0);
+}
+
 
 /****************************
  *
@@ -307,6 +751,13 @@ Group::restart(const Options &options, RestartMethod method) {
 	boost::container::vector<Callback> actions;
 
 	assert(isAlive());
+	if ((method == RM_ROLLING || (method == RM_DEFAULT && options.rollingRestart))
+	 && enabledCount > 0)
+	{
+		rollingRestart(options);
+		return;
+	}
+
 	P_DEBUG("Restarting group " << getName());
 
 	// If there is currently a restarter thread or a spawner thread active,
@@ -316,6 +767,8 @@ Group::restart(const Options &options, RestartMethod method) {
 	processesBeingSpawned = 0;
 	m_spawning   = false;
 	m_restarting = true;
+	m_rollingRestarting = false;
+	recyclesInProgress = 0;
 	uuid         = generateUuid(pool);
 	this->options.groupUuid = uuid;
 	detachAll(actions);
@@ -335,9 +788,14 @@ Group::restarting() const {
 	return m_restarting;
 }
 
+bool
+Group::rollingRestarting() const {
+	return m_rollingRestarting;
+}
+
 bool
 Group::needsRestart(const Options &options) {
-	if (m_restarting) {
+	if (m_restarting || m_rollingRestarting) {
 		return false;
 	} else {
 		time_t now;
@@ -441,8 +899,8 @@ Group::spawn() {
 				restartsInitiated),
 			"Group process spawner: " + info.name,
 			POOL_HELPER_THREAD_STACK_SIZE);
+		processesBeingSpawned += spawnBatchSize();
 		m_spawning = true;
-		processesBeingSpawned++;
 		return SR_OK;
 	}
 }
@@ -471,6 +929,36 @@ Group::shouldSpawnForGetAction() const {
 	return enabledCount == 0 || shouldSpawn();
 }
 
+/**
+ * The number of processes that the spawn loop should spawn in its next
+ * iteration. This is more than 1 only if the spawner supports batch
+ * spawning, and the group is more than one process away from `minProcesses`
+ * (e.g. right after a restart). The result respects the same resource
+ * limits as `spawn()` does.
+ */
+unsigned int
+Group::spawnBatchSize() const {
+	const Pool *pool = getPool();
+	unsigned int used = capacityUsed();
+	unsigned int poolUsed = pool->capacityUsedUnlocked();
+	unsigned int result;
+
+	if (pool->spawnBatchSize <= 1
+	 || used + 1 >= options.minProcesses
+	 || poolUsed + 1 >= pool->max
+	 || !spawner->supportsBatchSpawning())
+	{
+		return 1;
+	}
+
+	result = std::min(options.minProcesses - used, pool->spawnBatchSize);
+	result = std::min(result, pool->max - poolUsed);
+	if (options.maxProcesses != 0 && used < options.maxProcesses) {
+		result = std::min(result, options.maxProcesses - used);
+	}
+	return std::max(result, 1u);
+}
+
 /**
  * Whether a new process is allowed to be spawned for this group,
  * i.e. whether the upper processes limits have not been reached.
@@ -94,6 +94,35 @@ Group::capacityUsed() const {
 	return enabledCount + disablingCount + disabledCount + processesBeingSpawned;
 }
 
+unsigned int
+Group::capacityWeight() const {
+	return (options.capacityWeight == 0) ? 1 : options.capacityWeight;
+}
+
+/**
+ * Returns the number of processes that this group is entitled to when the
+ * pool is at full capacity: the pool's capacity divided over all groups
+ * in proportion to their weights, but at least `guaranteedCapacity` and
+ * at least 1.
+ */
+unsigned int
+Group::fairShare() const {
+	return fairShare(getPool()->totalCapacityWeightUnlocked());
+}
+
+/**
+ * Like fairShare(), but with the sum of all groups' weights already
+ * calculated. Use this when calculating the fair share of multiple groups.
+ */
+unsigned int
+Group::fairShare(unsigned int totalCapacityWeight) const {
+	unsigned int max = getPool()->max;
+	unsigned int share = (unsigned int) ((unsigned long long) max * capacityWeight()
+		/ std::max(totalCapacityWeight, 1u));
+	share = std::max(share, std::min(options.guaranteedCapacity, max));
+	return std::max(share, 1u);
+}
+
 /**
  * Checks whether this group is waiting for capacity on the pool to
  * become available before it can continue processing requests.
@@ -134,7 +163,17 @@ Group::inspectXml(std::ostream &stream, bool includeSecrets) const {
 	stream << "<disabling_process_count>" << disablingCount << "</disabling_process_count>";
 	stream << "<disabled_process_count>" << disabledCount << "</disabled_process_count>";
 	stream << "<capacity_used>" << capacityUsed() << "</capacity_used>";
+	stream << "<capacity_weight>" << capacityWeight() << "</capacity_weight>";
+	stream << "<guaranteed_capacity>" << options.guaranteedCapacity << "</guaranteed_capacity>";
+	stream << "<fair_share>" << fairShare() << "</fair_share>";
+	stream << "<processes_evicted>" << processesEvicted << "</processes_evicted>";
+	stream << "<oobws_deferred>" << oobwsDeferred << "</oobws_deferred>";
+	stream << "<oobws_performed>" << oobwsPerformed << "</oobws_performed>";
+	stream << "<recycles_in_progress>" << recyclesInProgress << "</recycles_in_progress>";
 	stream << "<get_wait_list_size>" << getWaitlist.size() << "</get_wait_list_size>";
+	stream << "<get_wait_list_delay>";
+	getWaitlistDelayMonitor.inspectXml(stream);
+	stream << "</get_wait_list_delay>";
 	stream << "<disable_wait_list_size>" << disableWaitlist.size() << "</disable_wait_list_size>";
 	stream << "<processes_being_spawned>" << processesBeingSpawned << "</processes_being_spawned>";
 	if (m_spawning) {
@@ -143,6 +182,9 @@ Group::inspectXml(std::ostream &stream, bool includeSecrets) const {
 	if (restarting()) {
 		stream << "<restarting/>";
 	}
+	if (rollingRestarting()) {
+		stream << "<rolling_restarting/>";
+	}
 	if (includeSecrets) {
 		stream << "<secret>" << escapeForXml(getApiKey().toStaticString()) << "</secret>";
 		stream << "<api_key>" << escapeForXml(getApiKey().toStaticString()) << "</api_key>";
@@ -255,8 +297,26 @@ Group::inspectConfigInAdminPanelFormat(Json::Value &result) const {
 	result["user_switching"] = VAL(options.userSwitching); // TODO: default value depends on integration mode and euid
 	result["file_descriptor_ulimit"] = VAL(options.fileDescriptorUlimit, 0u);
 	result["load_shell_envvars"] = VAL(options.loadShellEnvvars); // TODO: default value depends on integration mode
+	result["python_preloading"] = VAL(options.pythonPreloading, false);
 	result["max_request_queue_size"] = VAL(options.maxRequestQueueSize,
 		(Json::UInt) DEFAULT_MAX_REQUEST_QUEUE_SIZE);
+	result["request_queue_target_delay"] = VAL(options.requestQueueTargetDelay, 0u);
+	result["memory_limit"] = VAL(options.memoryLimit, 0u);
+	result["recycle_limit_jitter"] = VAL(options.recycleLimitJitter, 0u);
+	result["max_concurrent_recycles"] = VAL(options.maxConcurrentRecycles, 0u);
+	result["outlier_ejection_errors"] = VAL(options.outlierEjectionErrors, 0u);
+	result["outlier_latency_threshold"] = VAL(options.outlierLatencyThreshold, 0u);
+	result["outlier_ejection_time"] = VAL(options.outlierEjectionTime, 30u);
+	result["outlier_restart_threshold"] = VAL(options.outlierRestartThreshold, 0u);
+	result["capacity_weight"] = VAL(options.capacityWeight, 1u);
+	result["guaranteed_capacity"] = VAL(options.guaranteedCapacity, 0u);
+	result["routing_key"] = SVAL(options.routingKey, P_STATIC_STRING(""));
+	result["routing_load_factor"] = VAL(options.routingLoadFactor, 125u);
+	result["oobw_max_utilization"] = VAL(options.oobwMaxUtilization, 0u);
+	result["oobw_interval"] = VAL(options.oobwInterval, 0u);
+	result["rolling_restarts"] = VAL(options.rollingRestart, false);
+	result["warmup_requests"] = VAL(options.warmupRequests, 0u);
+	result["warmup_request_path"] = SVAL(options.warmupRequestPath, P_STATIC_STRING("/"));
 	result["max_requests"] = VAL((Json::UInt) options.maxRequests, 0u);
 	result["abort_websockets_on_process_shutdown"] = VAL(options.abortWebsocketsOnProcessShutdown);
 	result["force_max_concurrent_requests_per_process"] = VAL(options.forceMaxConcurrentRequestsPerProcess, -1);
@@ -299,6 +359,12 @@ Group::inspectConfigInAdminPanelFormat(Json::Value &result) const {
 	#undef NON_EMPTY_SVAL
 }
 
+void
+Group::inspectSpawnTimingsAsJson(Json::Value &result) const {
+	result["spawns"] = (Json::UInt64) spawnTimings.getSpawnCount();
+	result["steps"] = spawnTimings.inspectAsJson();
+}
+
 
 } // namespace ApplicationPool2
 } // namespace Passenger
@@ -30,6 +30,7 @@
 #include <vector>
 #include <utility>
 #include <boost/shared_array.hpp>
+#include <boost/atomic.hpp>
 #include <WrapperRegistry/Registry.h>
 #include <DataStructures/HashedStaticString.h>
 #include <Constants.h>
@@ -117,6 +118,8 @@ private:
 		result.push_back(&options.uri);
 
 		result.push_back(&options.stickySessionsCookieAttributes);
+		result.push_back(&options.warmupRequestPath);
+		result.push_back(&options.routingKey);
 
 		return result;
 	}
@@ -312,6 +315,14 @@ public:
 	 */
 	bool loadShellEnvvars;
 
+	/**
+	 * Whether Python apps should be started through wsgi-preloader.py
+	 * when the spawn method is "smart". Off by default because preloading
+	 * breaks apps that start threads or open connections while being
+	 * imported.
+	 */
+	bool pythonPreloading;
+
 	bool userSwitching;
 
 	/**
@@ -350,12 +361,143 @@ public:
 	 */
 	unsigned int maxOutOfBandWorkInstances;
 
+	/**
+	 * Out-of-band work is deferred while requests are queued for this group,
+	 * or while more than this percentage of the group's enabled processes are
+	 * handling requests. A value of 0 means that only queued requests defer
+	 * out-of-band work.
+	 */
+	unsigned int oobwMaxUtilization;
+
+	/**
+	 * If nonzero, the core itself requests out-of-band work for processes
+	 * that have not performed any for this many seconds, once they are idle.
+	 * The app must support out-of-band work, as the Ruby loader does (where
+	 * it runs the garbage collector).
+	 */
+	unsigned int oobwInterval;
+
 	/**
 	 * The maximum number of requests that may live in the Group.getWaitlist queue.
 	 * A value of 0 means unlimited.
 	 */
 	unsigned int maxRequestQueueSize;
 
+	/**
+	 * The queueing delay (in milliseconds) that the Group.getWaitlist is
+	 * allowed to have persistently. If the delay stays above this target,
+	 * requests that have been queued for too long are shed with a
+	 * RequestQueueOverloadedException. See QueueDelayMonitor.
+	 * A value of 0 means that requests are never shed.
+	 */
+	unsigned int requestQueueTargetDelay;
+
+	/**
+	 * The maximum amount of private memory (in MB) that a process may use.
+	 * Processes that exceed this limit are gracefully replaced. See
+	 * Pool::recycleProcessesExceedingMemoryLimit().
+	 * A value of 0 means unlimited.
+	 */
+	unsigned int memoryLimit;
+
+	/**
+	 * Lowers `maxRequests` and `memoryLimit` for each process by a random
+	 * amount of up to this percentage, so that processes that were spawned
+	 * together don't all reach their limits, and get recycled, at the same
+	 * time. The amount is chosen once per process. See Group::jitteredLimit().
+	 */
+	unsigned int recycleLimitJitter;
+
+	/**
+	 * If nonzero, a process that reaches `maxRequests` keeps serving requests
+	 * until a replacement process has been spawned, and at most this many
+	 * processes in the group are being replaced at the same time. If zero,
+	 * such a process is detached right away.
+	 */
+	unsigned int maxConcurrentRecycles;
+
+	/**
+	 * Outlier ejection: the number of consecutive failed requests after
+	 * which a process temporarily stops receiving requests. A request fails
+	 * if the application responds with a 5xx status code or with a broken
+	 * response, or if it takes longer than `outlierLatencyThreshold`.
+	 * See ProcessHealthMonitor. A value of 0 disables outlier ejection.
+	 */
+	unsigned int outlierEjectionErrors;
+
+	/**
+	 * Requests for which the application takes longer than this many
+	 * milliseconds to begin responding count as failed for the purpose of
+	 * outlier ejection. A value of 0 means no threshold.
+	 */
+	unsigned int outlierLatencyThreshold;
+
+	/**
+	 * The number of seconds that an ejected process stops receiving requests.
+	 * This doubles every time the process is ejected again right after
+	 * being readmitted.
+	 */
+	unsigned int outlierEjectionTime;
+
+	/**
+	 * A process that is ejected this many times in a row is replaced.
+	 * A value of 0 means that ejected processes are never replaced.
+	 */
+	unsigned int outlierRestartThreshold;
+
+	/**
+	 * The relative share of the pool's capacity that this group is entitled
+	 * to when the pool is at full capacity. A group with weight 2 is entitled
+	 * to twice as many processes as a group with weight 1. See
+	 * Group::fairShare().
+	 */
+	unsigned int capacityWeight;
+
+	/**
+	 * The number of processes that this group keeps even when other groups
+	 * need capacity: these are never shut down to make room for other groups,
+	 * and a group below this number gets priority when capacity becomes free.
+	 */
+	unsigned int guaranteedCapacity;
+
+	/**
+	 * If not empty, requests are routed by consistent hashing on this key
+	 * instead of to the least busy process, so that requests with the same
+	 * key tend to end up at the same process. One of:
+	 *
+	 *  - "header:NAME": the value of the given request header.
+	 *  - "cookie:NAME": the value of the given cookie.
+	 *  - "path:N": the first N segments of the request path.
+	 *
+	 * The Controller hashes the key into `routingHash`. See
+	 * Group::findProcessWithRoutingHash().
+	 */
+	StaticString routingKey;
+
+	/**
+	 * The load bound for consistent hash routing, as a percentage of the
+	 * average number of sessions per process. A request goes to the process
+	 * that its key hashes to, unless that process already has more sessions
+	 * than this bound allows. Values below 100 are treated as 100.
+	 */
+	unsigned int routingLoadFactor;
+
+	/**
+	 * Whether restarts should be rolling by default. A rolling restart
+	 * replaces the old processes one by one, so that the group keeps
+	 * serving requests in the meantime. See RestartMethod.
+	 */
+	bool rollingRestart;
+
+	/**
+	 * The number of warm-up requests that a rolling restart sends to each
+	 * new process before it starts receiving real traffic.
+	 */
+	unsigned int warmupRequests;
+
+	/** The path that warm-up requests are sent to. */
+	StaticString warmupRequestPath;
+
 	/**
 	 * Whether websocket connections should be aborted on process shutdown
 	 * or restart.
@@ -388,6 +530,12 @@ public:
 	 */
 	unsigned int stickySessionId;
 
+	/**
+	 * The hash of the request's routing key (see `routingKey`), or 0 if
+	 * the request should be routed to the least busy process.
+	 */
+	unsigned int routingHash;
+
 	/**
 	 * A throttling rate for file stats. When set to a non-zero value N,
 	 * restart.txt and other files which are usually stat()ted on every
@@ -401,6 +549,14 @@ public:
 	 */
 	unsigned long maxRequests;
 
+	/**
+	 * The maximum amount of time (in milliseconds) that this request may
+	 * wait in a getWaitlist. Once exceeded, the request is removed from the
+	 * queue and the get callback is called with a RequestQueueTimeoutException.
+	 * A value of 0 means unlimited.
+	 */
+	unsigned int maxRequestQueueTime;
+
 	/** If the current time (in microseconds) has already been queried, set it
 	 * here. Pool will use this timestamp instead of querying it again.
 	 */
@@ -417,6 +573,16 @@ public:
 	 */
 	bool noop;
 
+	/**
+	 * Allows the caller of Pool::asyncGet() to cancel the request while it's
+	 * waiting in a getWaitlist, e.g. because the client has disconnected.
+	 * Once the pointed-to flag is set, the request is dropped from the
+	 * queue without checking out a session, and the get callback is called
+	 * with a GetAbortedException. The flag must stay valid until the
+	 * callback has been called. May be NULL.
+	 */
+	const boost::atomic<bool> *cancelled;
+
 	/*-----------------*/
 	/*-----------------*/
 
@@ -460,6 +626,7 @@ public:
 		  forceMaxConcurrentRequestsPerProcess(-1),
 		  debugger(false),
 		  loadShellEnvvars(true),
+		  pythonPreloading(false),
 		  userSwitching(true),
 		  raiseInternalError(false),
 
@@ -467,15 +634,34 @@ public:
 		  maxProcesses(0),
 		  maxPreloaderIdleTime(-1),
 		  maxOutOfBandWorkInstances(1),
+		  oobwMaxUtilization(0),
+		  oobwInterval(0),
 		  maxRequestQueueSize(DEFAULT_MAX_REQUEST_QUEUE_SIZE),
+		  requestQueueTargetDelay(0),
+		  memoryLimit(0),
+		  recycleLimitJitter(0),
+		  maxConcurrentRecycles(0),
+		  outlierEjectionErrors(0),
+		  outlierLatencyThreshold(0),
+		  outlierEjectionTime(30),
+		  outlierRestartThreshold(0),
+		  capacityWeight(1),
+		  guaranteedCapacity(0),
+		  routingLoadFactor(125),
+		  rollingRestart(false),
+		  warmupRequests(0),
+		  warmupRequestPath("/", 1),
 		  abortWebsocketsOnProcessShutdown(true),
 		  stickySessionsCookieAttributes(DEFAULT_STICKY_SESSIONS_COOKIE_ATTRIBUTES, sizeof(DEFAULT_STICKY_SESSIONS_COOKIE_ATTRIBUTES) - 1),
 
 		  stickySessionId(0),
+		  routingHash(0),
 		  statThrottleRate(DEFAULT_STAT_THROTTLE_RATE),
 		  maxRequests(0),
+		  maxRequestQueueTime(0),
 		  currentTime(0),
-		  noop(false)
+		  noop(false),
+		  cancelled(NULL)
 		  /*********************************/
 	{
 		/*********************************/
@@ -545,8 +731,10 @@ public:
 		hostName = StaticString();
 		uri      = StaticString();
 		stickySessionId = 0;
+		routingHash     = 0;
 		currentTime     = 0;
 		noop     = false;
+		cancelled = NULL;
 		return *this;
 	}
 
@@ -28,6 +28,7 @@
 
 #include <string>
 #include <vector>
+#include <set>
 #include <algorithm>
 #include <utility>
 #include <sstream>
@@ -65,6 +66,7 @@
 #include <Core/ApplicationPool/Group.h>
 #include <Core/ApplicationPool/Session.h>
 #include <Core/ApplicationPool/Options.h>
+#include <Core/ApplicationPool/QueueDelayMonitor.h>
 #include <Core/SpawningKit/Factory.h>
 #include <Shared/ApplicationPoolApiKey.h>
 
@@ -208,6 +210,21 @@ public:
 	mutable boost::mutex syncher;
 	unsigned int max;
 	unsigned long long maxIdleTime;
+	/**
+	 * The number of most recently used groups that are kept warm: they keep
+	 * at least one process and their preloader, even when idle, and one
+	 * process is spawned for them in advance if they have none. This way the
+	 * first request after a quiet period doesn't have to wait for a spawn.
+	 * See Pool::selectWarmSpareGroups().
+	 */
+	unsigned int warmSpares;
+	/**
+	 * The maximum number of processes that a group may spawn at once, if its
+	 * spawner supports that (see Spawner::spawnBatch()). Batches are only
+	 * used to bring a group up to its `minProcesses`, e.g. after a restart.
+	 * See Group::spawnBatchSize().
+	 */
+	unsigned int spawnBatchSize;
 	bool selfchecking;
 
 	Context *context;
@@ -271,6 +288,8 @@ public:
 	 *       getWaitlist is empty.
 	 */
 	vector<GetWaiter> getWaitlist;
+	/** Measures the queueing delay of getWaitlist and decides when to shed waiters. */
+	QueueDelayMonitor getWaitlistDelayMonitor;
 
 // Actually private, but marked public so that unit tests can access the fields.
 public:
@@ -330,9 +349,14 @@ public:
 		unsigned long long now;
 		unsigned long long nextGcRunTime;
 		boost::container::vector<Callback> actions;
+		vector<Group *> warmSpareGroups;
+		/** Number of idle processes detached during this run. */
+		unsigned int processesGarbageCollected;
 	};
 
 	boost::condition_variable garbageCollectionCond;
+	/** When the garbage collector will run next (microseconds), or 0 if unknown. */
+	unsigned long long nextGarbageCollectionTime;
 
 	void initializeGarbageCollection();
 	static void garbageCollect(PoolPtr self);
@@ -342,8 +366,15 @@ public:
 	void garbageCollectProcessesInGroup(GarbageCollectorState &state,
 		const GroupPtr &group);
 	void maybeCleanPreloader(GarbageCollectorState &state, const GroupPtr &group);
+	void selectWarmSpareGroups(vector<Group *> &result) const;
+	static bool isWarmSpareGroup(const GarbageCollectorState &state, const GroupPtr &group);
+	void maybeSpawnWarmSpare(Group *group);
 	unsigned long long realGarbageCollect();
 	void wakeupGarbageCollector();
+	void scheduleGarbageCollection(unsigned long long time);
+	void recycleProcessesExceedingMemoryLimit(boost::container::vector<Callback> &postLockActions);
+	bool maybeRecycleProcessExceedingMemoryLimit(const GroupPtr &group,
+		boost::container::vector<Callback> &postLockActions);
 
 
 	/****** General utilities ******/
@@ -361,6 +392,9 @@ public:
 	template<typename Queue> static void assignExceptionToGetWaiters(Queue &getWaitlist,
 		const ExceptionPtr &exception,
 		boost::container::vector<Callback> &postLockActions);
+	template<typename Queue> static unsigned long long removeAbandonedGetWaiters(
+		Queue &getWaitlist, unsigned long long now,
+		boost::container::vector<Callback> &postLockActions);
 	static void syncGetCallback(const AbstractSessionPtr &session, const ExceptionPtr &e,
 		void *userData);
 
@@ -403,7 +437,7 @@ public:
 		}
 	};
 
-	ProcessPtr findOldestIdleProcess(const Group *exclude = NULL) const;
+	ProcessPtr findIdleProcessToFree(const Group *exclude = NULL) const;
 	ProcessPtr findBestProcessToTrash() const;
 	ProcessPtr forceFreeCapacity(const Group *exclude,
 		boost::container::vector<Callback> &postLockActions);
@@ -411,6 +445,8 @@ public:
 		boost::container::vector<Callback> &postLockActions);
 	static void syncDisableProcessCallback(const ProcessPtr &process, DisableResult result,
 		boost::shared_ptr<DisableWaitTicket> ticket);
+	void lockAndDetachDisabledProcess(const ProcessPtr &process, DisableResult result);
+	static bool hasHigherCapacityPriority(const Group *a, const Group *b);
 	void possiblySpawnMoreProcessesForExistingGroups();
 
 
@@ -423,6 +459,7 @@ public:
 		const StaticString &defaultValue);
 	static Json::Value makeSingleNonEmptyStrValueJsonConfigFormat(const StaticString &val);
 	unsigned int capacityUsedUnlocked() const;
+	unsigned int totalCapacityWeightUnlocked() const;
 	bool atFullCapacityUnlocked() const;
 	void inspectProcessList(const InspectOptions &options, stringstream &result,
 		const Group *group, const ProcessList &processes) const;
@@ -486,6 +523,7 @@ public:
 		bool lock = true) const;
 	Json::Value inspectPropertiesInAdminPanelFormat(const ToJsonOptions &options = ToJsonOptions::makeAuthorized()) const;
 	Json::Value inspectConfigInAdminPanelFormat(const ToJsonOptions &options = ToJsonOptions::makeAuthorized()) const;
+	Json::Value inspectSpawnTimingsAsJson(const ToJsonOptions &options = ToJsonOptions::makeAuthorized()) const;
 
 
 	/****** Miscellaneous ******/
@@ -494,6 +532,8 @@ public:
 	SessionPtr get(const Options &options, Ticket *ticket);
 	void setMax(unsigned int max);
 	void setMaxIdleTime(unsigned long long value);
+	void setWarmSpares(unsigned int value);
+	void setSpawnBatchSize(unsigned int value);
 	void enableSelfChecking(bool enabled);
 	bool isSpawning(bool lock = true) const;
 	bool authorizeByApiKey(const ApiKey &key, bool lock = true) const;
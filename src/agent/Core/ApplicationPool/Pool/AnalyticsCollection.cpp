@@ -178,6 +178,9 @@ Pool::realCollectAnalytics() {
 		UPDATE_TRACE_POINT();
 		processesToDetach.clear();
 
+		UPDATE_TRACE_POINT();
+		recycleProcessesExceedingMemoryLimit(actions);
+
 		l.unlock();
 
 		UPDATE_TRACE_POINT();
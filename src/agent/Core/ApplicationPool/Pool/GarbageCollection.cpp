@@ -52,6 +52,7 @@ Pool::garbageCollect(PoolPtr self) {
 	TRACE_POINT();
 	{
 		ScopedLock lock(self->syncher);
+		self->nextGarbageCollectionTime = SystemTime::getUsec() + 5 * 1000000;
 		self->garbageCollectionCond.timed_wait(lock,
 			posix_time::seconds(5));
 	}
@@ -61,6 +62,7 @@ Pool::garbageCollect(PoolPtr self) {
 			unsigned long long sleepTime = self->realGarbageCollect();
 			UPDATE_TRACE_POINT();
 			ScopedLock lock(self->syncher);
+			self->nextGarbageCollectionTime = SystemTime::getUsec() + sleepTime;
 			self->garbageCollectionCond.timed_wait(lock,
 				posix_time::microseconds(sleepTime));
 		} catch (const thread_interrupted &) {
@@ -110,22 +112,32 @@ Pool::garbageCollectProcessesInGroup(GarbageCollectorState &state,
 			processesToGc);
 	}
 
+	// Warm spare groups keep at least one process.
+	unsigned long minProcesses = group->options.minProcesses;
+	if (minProcesses == 0 && isWarmSpareGroup(state, group)) {
+		minProcesses = 1;
+	}
+
 	p_it  = processesToGc.begin();
 	p_end = processesToGc.end();
 	while (p_it != p_end
-	 && (unsigned long) group->getProcessCount() > group->options.minProcesses)
+	 && (unsigned long) group->getProcessCount() > minProcesses)
 	{
 		ProcessPtr process = *p_it;
 		P_DEBUG("Garbage collect idle process: " << process->inspect() <<
 			", group=" << group->getName());
 		group->detach(process, state.actions);
+		state.processesGarbageCollected++;
 		p_it++;
 	}
 }
 
 void
 Pool::maybeCleanPreloader(GarbageCollectorState &state, const GroupPtr &group) {
-	if (group->spawner->cleanable() && group->options.getMaxPreloaderIdleTime() != 0) {
+	if (group->spawner->cleanable()
+	 && group->options.getMaxPreloaderIdleTime() != 0
+	 && !isWarmSpareGroup(state, group))
+	{
 		unsigned long long spawnerGcTime =
 			group->spawner->lastUsed() +
 			group->options.getMaxPreloaderIdleTime() * 1000000;
@@ -138,6 +150,59 @@ Pool::maybeCleanPreloader(GarbageCollectorState &state, const GroupPtr &group) {
 	}
 }
 
+static bool
+groupWasUsedMoreRecently(const Group *a, const Group *b) {
+	return a->lastUsed > b->lastUsed;
+}
+
+/**
+ * Selects the `warmSpares` most recently used groups. Groups that haven't
+ * been used yet, e.g. because they were only prestarted, are not selected.
+ */
+void
+Pool::selectWarmSpareGroups(vector<Group *> &result) const {
+	GroupMap::ConstIterator g_it(groups);
+	while (*g_it != NULL) {
+		Group *group = g_it.getValue().get();
+		if (group->lastUsed != 0) {
+			result.push_back(group);
+		}
+		g_it.next();
+	}
+
+	if (result.size() > warmSpares) {
+		std::partial_sort(result.begin(), result.begin() + warmSpares, result.end(),
+			groupWasUsedMoreRecently);
+		result.resize(warmSpares);
+	}
+}
+
+bool
+Pool::isWarmSpareGroup(const GarbageCollectorState &state, const GroupPtr &group) {
+	return std::find(state.warmSpareGroups.begin(), state.warmSpareGroups.end(),
+		group.get()) != state.warmSpareGroups.end();
+}
+
+/**
+ * Spawns a process for the given warm spare group if it has none, e.g.
+ * because its processes were shut down to make room for other groups, as
+ * long as that doesn't take capacity away from anyone.
+ */
+void
+Pool::maybeSpawnWarmSpare(Group *group) {
+	if (group->getProcessCount() == 0
+	 && group->isAlive()
+	 && !group->spawning()
+	 && !group->restarting()
+	 && group->getWaitlist.empty()
+	 && getWaitlist.empty()
+	 && !atFullCapacityUnlocked())
+	{
+		P_DEBUG("Spawning a warm spare process for group " << group->getName());
+		group->spawn();
+	}
+}
+
 unsigned long long
 Pool::realGarbageCollect() {
 	TRACE_POINT();
@@ -146,9 +211,13 @@ Pool::realGarbageCollect() {
 	GarbageCollectorState state;
 	state.now = SystemTime::getUsec();
 	state.nextGcRunTime = 0;
+	state.processesGarbageCollected = 0;
 
 	P_DEBUG("Garbage collection time...");
 	verifyInvariants();
+	if (warmSpares > 0) {
+		selectWarmSpareGroups(state.warmSpareGroups);
+	}
 
 	// For all groups...
 	while (*g_it != NULL) {
@@ -159,14 +228,58 @@ Pool::realGarbageCollect() {
 			garbageCollectProcessesInGroup(state, group);
 		}
 
+		// ...drop queued requests that were cancelled or that have been
+		// queued for longer than their maximum queueing time.
+		unsigned long long deadline = removeAbandonedGetWaiters(
+			group->getWaitlist, state.now, state.actions);
+		if (deadline != 0) {
+			maybeUpdateNextGcRuntime(state, deadline);
+		}
+
+		// ...shed queued requests if the request queue is overloaded,
+		// even if no process becomes available to them.
+		deadline = group->shedOverloadedGetWaiters(state.now, state.actions);
+		if (deadline != 0) {
+			maybeUpdateNextGcRuntime(state, deadline);
+		}
+
 		group->verifyInvariants();
 
 		// ...cleanup the spawner if it's been idle for more than preloaderIdleTime.
 		maybeCleanPreloader(state, group);
 
+		// ...start out-of-band work that is due or that was deferred.
+		if (group->options.oobwInterval > 0) {
+			deadline = group->requestPeriodicOobw(state.now);
+			if (deadline != 0) {
+				maybeUpdateNextGcRuntime(state, deadline);
+			}
+		}
+		group->initiateDeferredOobwRequests();
+
 		g_it.next();
 	}
 
+	unsigned long long deadline = removeAbandonedGetWaiters(getWaitlist,
+		state.now, state.actions);
+	if (deadline != 0) {
+		maybeUpdateNextGcRuntime(state, deadline);
+	}
+
+	// Spawn a process in advance for recently used groups that have none.
+	// Not in a run that has just shut down idle processes though: the pool is
+	// shrinking, and spawning now would make it alternate between killing
+	// and spawning processes on every run. The next run takes care of it.
+	if (state.processesGarbageCollected == 0) {
+		vector<Group *>::const_iterator it, end = state.warmSpareGroups.end();
+		for (it = state.warmSpareGroups.begin(); it != end; it++) {
+			maybeSpawnWarmSpare(*it);
+		}
+	} else if (!state.warmSpareGroups.empty()) {
+		P_DEBUG("Not spawning warm spare processes during a garbage collection"
+			" run that shut down idle processes");
+	}
+
 	verifyInvariants();
 	lock.unlock();
 
@@ -196,6 +309,115 @@ Pool::wakeupGarbageCollector() {
 	garbageCollectionCond.notify_all();
 }
 
+/**
+ * Gracefully replaces processes that use more private memory than their
+ * group's `memoryLimit`. Process memory usage is measured by
+ * `collectAnalytics()`, which calls this method right after updating
+ * the metrics. Must be called with the lock held.
+ */
+void
+Pool::recycleProcessesExceedingMemoryLimit(boost::container::vector<Callback> &postLockActions) {
+	GroupMap::ConstIterator g_it(groups);
+	while (*g_it != NULL) {
+		const GroupPtr group = g_it.getValue();
+		if (group->options.memoryLimit != 0) {
+			maybeRecycleProcessExceedingMemoryLimit(group, postLockActions);
+		}
+		g_it.next();
+	}
+}
+
+/**
+ * Picks the enabled process in the given group that exceeds the memory
+ * limit the most, disables it so that it stops receiving new requests,
+ * and detaches it once its current requests are done.
+ *
+ * To protect latency, a group recycles at most one process at a time,
+ * and only when it has spare capacity: either the pool has room to spawn
+ * a replacement right away, or the group's other enabled processes can
+ * absorb the traffic in the meantime. Returns whether a process is
+ * being recycled.
+ */
+bool
+Pool::maybeRecycleProcessExceedingMemoryLimit(const GroupPtr &group,
+	boost::container::vector<Callback> &postLockActions)
+{
+	if (!group->isAlive()
+	 || group->restarting()
+	 || group->spawning()
+	 || group->disablingCount > 0
+	 || !group->getWaitlist.empty())
+	{
+		return false;
+	}
+
+	ProcessPtr process;
+	foreach (const ProcessPtr &p, group->enabledProcesses) {
+		size_t limit = (size_t) group->jitteredLimit(p.get(),
+			group->options.memoryLimit) * 1024;
+		if (p->metrics.isValid()
+		 && p->metrics.realMemory() > limit
+		 && p->oobwStatus == Process::OOBW_NOT_ACTIVE
+		 && !p->recycling
+		 && (process == NULL || p->metrics.realMemory() > process->metrics.realMemory()))
+		{
+			process = p;
+		}
+	}
+	if (process == NULL) {
+		return false;
+	}
+
+	bool canSpawnReplacement = group->allowSpawn();
+	if (!canSpawnReplacement
+	 && (group->enabledCount <= 1 || group->allEnabledProcessesAreTotallyBusy()))
+	{
+		P_DEBUG("Process " << process->inspect() << " exceeds the memory limit, "
+			"but there is no spare capacity to replace it yet");
+		return false;
+	}
+
+	P_NOTICE("Process " << process->inspect() << " is using " <<
+		process->metrics.realMemory() / 1024 << " MB of memory, which exceeds "
+		"the limit of " << group->jitteredLimit(process.get(), group->options.memoryLimit) <<
+		" MB; replacing it");
+
+	DisableResult result = group->disable(process,
+		boost::bind(&Pool::lockAndDetachDisabledProcess, this,
+			boost::placeholders::_1, boost::placeholders::_2));
+	switch (result) {
+	case DR_SUCCESS:
+		detachProcessUnlocked(process, postLockActions);
+		break;
+	case DR_DEFERRED:
+		// lockAndDetachDisabledProcess() will eventually be called.
+		break;
+	default:
+		P_DEBUG("Process " << process->inspect() << " could not be disabled; "
+			"not replacing it");
+		return false;
+	}
+
+	if (group->isAlive() && group->allowSpawn()
+	 && (canSpawnReplacement || group->shouldSpawn()))
+	{
+		group->spawn();
+	}
+	return true;
+}
+
+/**
+ * Ensures that the garbage collector runs no later than the given time
+ * (in microseconds). Must be called with the lock held.
+ */
+void
+Pool::scheduleGarbageCollection(unsigned long long time) {
+	if (nextGarbageCollectionTime == 0 || time < nextGarbageCollectionTime) {
+		nextGarbageCollectionTime = time;
+		garbageCollectionCond.notify_all();
+	}
+}
+
 
 } // namespace ApplicationPool2
 } // namespace Passenger
@@ -152,14 +152,34 @@ Pool::fullVerifyInvariants() const {
 void
 Pool::assignSessionsToGetWaiters(boost::container::vector<Callback> &postLockActions) {
 	bool done = false;
+	unsigned long long now = SystemTime::getUsec();
 	vector<GetWaiter>::iterator it, end = getWaitlist.end();
 	vector<GetWaiter> newWaitlist;
 
 	for (it = getWaitlist.begin(); it != end && !done; it++) {
 		GetWaiter &waiter = *it;
 
+		if (OXT_UNLIKELY(waiter.abandoned(now))) {
+			postLockActions.push_back(boost::bind(GetCallback::call,
+				waiter.callback, SessionPtr(),
+				waiter.abandonmentException(now)));
+			continue;
+		}
+
 		Group *group = findMatchingGroup(waiter.options);
-		if (group != NULL) {
+		if ((group != NULL || !atFullCapacityUnlocked())
+		 && OXT_UNLIKELY(getWaitlistDelayMonitor.dequeue(
+			(now > waiter.queuedAt) ? now - waiter.queuedAt : 0, now,
+			waiter.options.requestQueueTargetDelay)))
+		{
+			P_DEBUG("Shedding request that was queued for " <<
+				(now - waiter.queuedAt) / 1000 << " msec in the top-level "
+				"queue: request queue is overloaded");
+			postLockActions.push_back(boost::bind(GetCallback::call,
+				waiter.callback, SessionPtr(),
+				boost::make_shared<RequestQueueOverloadedException>(
+					now - waiter.queuedAt, waiter.options.requestQueueTargetDelay)));
+		} else if (group != NULL) {
 			SessionPtr session = group->get(waiter.options, waiter.callback,
 				postLockActions);
 			if (session != NULL) {
@@ -197,6 +217,46 @@ Pool::assignExceptionToGetWaiters(Queue &getWaitlist,
 	}
 }
 
+/**
+ * Removes all waiters from the given getWaitlist that were cancelled or
+ * that exceeded their maximum queueing time, preserving the order of the
+ * remaining waiters. Their callbacks are called with the appropriate
+ * exception. Returns the earliest deadline among the remaining waiters,
+ * or 0 if none of them has one.
+ */
+template<typename Queue>
+unsigned long long
+Pool::removeAbandonedGetWaiters(Queue &getWaitlist, unsigned long long now,
+	boost::container::vector<Callback> &postLockActions)
+{
+	typename Queue::iterator it, end = getWaitlist.end();
+	typename Queue::iterator dest = getWaitlist.begin();
+	unsigned long long nextDeadline = 0;
+
+	for (it = getWaitlist.begin(); it != end; it++) {
+		if (it->abandoned(now)) {
+			P_DEBUG("Removing request that was " <<
+				(it->cancelled() ? "cancelled" : "queued for too long") <<
+				" from the request queue");
+			postLockActions.push_back(boost::bind(GetCallback::call,
+				it->callback, SessionPtr(),
+				it->abandonmentException(now)));
+		} else {
+			unsigned long long deadline = it->deadline();
+			if (deadline != 0 && (nextDeadline == 0 || deadline < nextDeadline)) {
+				nextDeadline = deadline;
+			}
+			if (dest != it) {
+				*dest = *it;
+			}
+			dest++;
+		}
+	}
+
+	getWaitlist.erase(dest, end);
+	return nextDeadline;
+}
+
 void
 Pool::syncGetCallback(const AbstractSessionPtr &session, const ExceptionPtr &e,
 	void *userData)
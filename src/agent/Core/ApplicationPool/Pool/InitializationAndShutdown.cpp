@@ -51,6 +51,9 @@ Pool::Pool(Context *_context)
 	lifeStatus   = ALIVE;
 	max          = 6;
 	maxIdleTime  = 60 * 1000000;
+	warmSpares   = 0;
+	spawnBatchSize = 1;
+	nextGarbageCollectionTime = 0;
 	selfchecking = true;
 	palloc       = psg_create_pool(PSG_DEFAULT_POOL_SIZE);
 
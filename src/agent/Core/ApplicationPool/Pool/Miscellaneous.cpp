@@ -95,6 +95,9 @@ Pool::asyncGet(const Options &options, const GetCallback &callback, bool lockNow
 			getWaitlist.push_back(GetWaiter(
 				options.copyAndPersist(),
 				callback));
+			if (options.maxRequestQueueTime != 0) {
+				scheduleGarbageCollection(getWaitlist.back().deadline());
+			}
 		} else {
 			/* Now that a process has been trashed we can create
 			 * the missing Group.
@@ -201,6 +204,19 @@ Pool::setMaxIdleTime(unsigned long long value) {
 	wakeupGarbageCollector();
 }
 
+void
+Pool::setWarmSpares(unsigned int value) {
+	LockGuard l(syncher);
+	warmSpares = value;
+	wakeupGarbageCollector();
+}
+
+void
+Pool::setSpawnBatchSize(unsigned int value) {
+	LockGuard l(syncher);
+	spawnBatchSize = std::max(value, 1u);
+}
+
 void
 Pool::enableSelfChecking(bool enabled) {
 	LockGuard l(syncher);
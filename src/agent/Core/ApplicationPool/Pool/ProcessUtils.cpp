@@ -45,32 +45,50 @@ using namespace boost;
  ****************************/
 
 
+/**
+ * Finds an idle process that can be shut down to make room for another group.
+ * Processes are taken from the group that exceeds its fair share of the pool
+ * (see Group::fairShare()) by the most, so that a single busy group cannot
+ * starve the others. Groups never lose processes below their guaranteed
+ * capacity. Among equally eligible processes, the least recently used
+ * one is picked.
+ */
 ProcessPtr
-Pool::findOldestIdleProcess(const Group *exclude) const {
-	ProcessPtr oldestIdleProcess;
+Pool::findIdleProcessToFree(const Group *exclude) const {
+	ProcessPtr bestProcess;
+	int bestProcessOverage = 0;
+	unsigned int totalCapacityWeight = totalCapacityWeightUnlocked();
 
 	GroupMap::ConstIterator g_it(groups);
 	while (*g_it != NULL) {
 		const GroupPtr &group = g_it.getValue();
-		if (group.get() == exclude) {
+		if (group.get() == exclude
+		 || group->capacityUsed() <= group->options.guaranteedCapacity)
+		{
 			g_it.next();
 			continue;
 		}
+
+		int overage = (int) group->capacityUsed()
+			- (int) group->fairShare(totalCapacityWeight);
 		const ProcessList &processes = group->enabledProcesses;
 		ProcessList::const_iterator p_it, p_end = processes.end();
 		for (p_it = processes.begin(); p_it != p_end; p_it++) {
 			const ProcessPtr process = *p_it;
 			if (process->busyness() == 0
-			     && (oldestIdleProcess == NULL
-			         || process->lastUsed < oldestIdleProcess->lastUsed)
+			     && (bestProcess == NULL
+			         || overage > bestProcessOverage
+			         || (overage == bestProcessOverage
+			             && process->lastUsed < bestProcess->lastUsed))
 			) {
-				oldestIdleProcess = process;
+				bestProcess = process;
+				bestProcessOverage = overage;
 			}
 		}
 		g_it.next();
 	}
 
-	return oldestIdleProcess;
+	return bestProcess;
 }
 
 ProcessPtr
@@ -103,7 +121,7 @@ ProcessPtr
 Pool::forceFreeCapacity(const Group *exclude,
 	boost::container::vector<Callback> &postLockActions)
 {
-	ProcessPtr process = findOldestIdleProcess(exclude);
+	ProcessPtr process = findIdleProcessToFree(exclude);
 	if (process != NULL) {
 		P_DEBUG("Forcefully detaching process " << process->inspect() <<
 			" in order to free capacity in the pool");
@@ -112,6 +130,7 @@ Pool::forceFreeCapacity(const Group *exclude,
 		assert(group != NULL);
 		assert(group->getWaitlist.empty());
 
+		group->processesEvicted++;
 		group->detach(process, postLockActions);
 	}
 	return process;
@@ -150,8 +169,61 @@ Pool::syncDisableProcessCallback(const ProcessPtr &process, DisableResult result
 	ticket->cond.notify_one();
 }
 
+/**
+ * A Group::disable() callback for processes that are being replaced: once
+ * the process is done disabling, it is detached, and a new process is
+ * spawned if the group needs one.
+ */
+void
+Pool::lockAndDetachDisabledProcess(const ProcessPtr &process, DisableResult result) {
+	TRACE_POINT();
+	boost::container::vector<Callback> actions;
+	ScopedLock lock(syncher);
+
+	if (OXT_UNLIKELY(!process->isAlive())) {
+		return;
+	}
+
+	if (result == DR_SUCCESS && process->enabled == Process::DISABLED) {
+		P_DEBUG("Process " << process->inspect() << " disabled; detaching it");
+		Group *group = process->getGroup();
+		detachProcessUnlocked(process, actions);
+		if (group->isAlive() && group->shouldSpawn()) {
+			group->spawn();
+		}
+	} else {
+		// We do not re-enable the process because it's likely that the
+		// administrator has explicitly changed the state.
+		P_DEBUG("Detaching process " << process->inspect() << " aborted "
+			"because it could not be disabled");
+	}
+
+	lock.unlock();
+	runAllActions(actions);
+}
+
+/**
+ * Whether group `a` should get free pool capacity before group `b`: groups
+ * below their guaranteed capacity go first, followed by the group that
+ * uses the least capacity relative to its weight.
+ */
+bool
+Pool::hasHigherCapacityPriority(const Group *a, const Group *b) {
+	bool aBelowGuarantee = a->capacityUsed() < a->options.guaranteedCapacity;
+	bool bBelowGuarantee = b->capacityUsed() < b->options.guaranteedCapacity;
+	if (aBelowGuarantee != bBelowGuarantee) {
+		return aBelowGuarantee;
+	} else {
+		return (unsigned long long) a->capacityUsed() * b->capacityWeight()
+			< (unsigned long long) b->capacityUsed() * a->capacityWeight();
+	}
+}
+
 void
 Pool::possiblySpawnMoreProcessesForExistingGroups() {
+	vector<Group *> candidates;
+	vector<Group *>::const_iterator it;
+
 	/* Looks for Groups that are waiting for capacity to become available,
 	 * and spawn processes in those groups.
 	 */
@@ -159,29 +231,41 @@ Pool::possiblySpawnMoreProcessesForExistingGroups() {
 	while (*g_it != NULL) {
 		const GroupPtr &group = g_it.getValue();
 		if (group->isWaitingForCapacity()) {
-			P_DEBUG("Group " << group->getName() << " is waiting for capacity");
-			group->spawn();
-			if (atFullCapacityUnlocked()) {
-				return;
-			}
+			candidates.push_back(group.get());
 		}
 		g_it.next();
 	}
+	std::stable_sort(candidates.begin(), candidates.end(), hasHigherCapacityPriority);
+	for (it = candidates.begin(); it != candidates.end(); it++) {
+		Group *group = *it;
+		P_DEBUG("Group " << group->getName() << " is waiting for capacity");
+		group->spawn();
+		if (atFullCapacityUnlocked()) {
+			return;
+		}
+	}
+
 	/* Now look for Groups that haven't maximized their allowed capacity
 	 * yet, and spawn processes in those groups.
 	 */
+	candidates.clear();
 	g_it = GroupMap::ConstIterator(groups);
 	while (*g_it != NULL) {
 		const GroupPtr &group = g_it.getValue();
 		if (group->shouldSpawn()) {
-			P_DEBUG("Group " << group->getName() << " requests more processes to be spawned");
-			group->spawn();
-			if (atFullCapacityUnlocked()) {
-				return;
-			}
+			candidates.push_back(group.get());
 		}
 		g_it.next();
 	}
+	std::stable_sort(candidates.begin(), candidates.end(), hasHigherCapacityPriority);
+	for (it = candidates.begin(); it != candidates.end(); it++) {
+		Group *group = *it;
+		P_DEBUG("Group " << group->getName() << " requests more processes to be spawned");
+		group->spawn();
+		if (atFullCapacityUnlocked()) {
+			return;
+		}
+	}
 }
 
 
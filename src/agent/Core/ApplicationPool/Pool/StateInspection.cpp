@@ -63,11 +63,46 @@ Pool::capacityUsedUnlocked() const {
 	}
 }
 
+/**
+ * Returns the sum of the capacity weights of all groups, including groups
+ * that are waiting in the top-level getWaitlist to be created.
+ */
+unsigned int
+Pool::totalCapacityWeightUnlocked() const {
+	GroupMap::ConstIterator g_it(groups);
+	unsigned int result = 0;
+	while (*g_it != NULL) {
+		result += g_it.getValue()->capacityWeight();
+		g_it.next();
+	}
+
+	if (!getWaitlist.empty()) {
+		set<string> waitingGroupNames;
+		vector<GetWaiter>::const_iterator it, end = getWaitlist.end();
+		for (it = getWaitlist.begin(); it != end; it++) {
+			if (waitingGroupNames.insert(it->options.getAppGroupName().toString()).second) {
+				result += std::max(it->options.capacityWeight, 1u);
+			}
+		}
+	}
+
+	return result;
+}
+
 bool
 Pool::atFullCapacityUnlocked() const {
 	return capacityUsedUnlocked() >= max;
 }
 
+static void
+formatKilobytesAsMegabytes(char *buf, size_t size, ssize_t kb) {
+	if (kb == -1) {
+		snprintf(buf, size, "?");
+	} else {
+		snprintf(buf, size, "%ldM", (long) (kb / 1024));
+	}
+}
+
 void
 Pool::inspectProcessList(const InspectOptions &options, stringstream &result,
 	const Group *group, const ProcessList &processes) const
@@ -99,6 +134,21 @@ Pool::inspectProcessList(const InspectOptions &options, stringstream &result,
 			distanceOfTimeInWords(process->lastUsed / 1000000).c_str());
 		result << buf << endl;
 
+		if (process->metrics.isValid() && process->metrics.pss != -1) {
+			// Reporting PSS next to RSS shows how much of each worker's
+			// memory is still shared with the preloader through copy-on-write.
+			char rssbuf[16];
+			char pssbuf[16];
+			char privbuf[16];
+			formatKilobytesAsMegabytes(rssbuf, sizeof(rssbuf), process->metrics.rss);
+			formatKilobytesAsMegabytes(pssbuf, sizeof(pssbuf), process->metrics.pss);
+			formatKilobytesAsMegabytes(privbuf, sizeof(privbuf), process->metrics.privateDirty);
+			snprintf(buf, sizeof(buf),
+				"    RSS: %s   PSS: %s   Private dirty: %s",
+				rssbuf, pssbuf, privbuf);
+			result << buf << endl;
+		}
+
 		if (process->enabled == Process::DISABLING) {
 			result << "    Disabling..." << endl;
 		} else if (process->enabled == Process::DISABLED) {
@@ -167,6 +217,8 @@ Pool::inspect(const InspectOptions &options, bool lock) const {
 		result << "  App root: " << group->options.appRoot << endl;
 		if (group->restarting()) {
 			result << "  (restarting...)" << endl;
+		} else if (group->rollingRestarting()) {
+			result << "  (rolling restarting...)" << endl;
 		}
 		if (group->spawning()) {
 			if (group->processesBeingSpawned == 0) {
@@ -178,6 +230,23 @@ Pool::inspect(const InspectOptions &options, bool lock) const {
 			}
 		}
 		result << "  Requests in queue: " << group->getWaitlist.size() << endl;
+		if (groups.size() > 1) {
+			result << "  Capacity: " << group->capacityUsed() << " used, " <<
+				group->fairShare() << " fair share, " <<
+				group->processesEvicted << " evicted" << endl;
+		}
+		if (group->oobwsPerformed > 0 || group->oobwsDeferred > 0) {
+			result << "  Out-of-band work: " << group->oobwsPerformed << " performed, " <<
+				group->oobwsDeferred << " deferred" << endl;
+		}
+		if (group->getWaitlistDelayMonitor.getAverageDelay() >= 0) {
+			const QueueDelayMonitor &monitor = group->getWaitlistDelayMonitor;
+			result << "  Queue delay: " <<
+				(unsigned long long) (monitor.getAverageDelay() / 1000) << " ms avg, " <<
+				monitor.getPeakDelay() / 1000 << " ms peak, " <<
+				monitor.getShedCount() << " shed" <<
+				(monitor.isOverloaded() ? " (overloaded)" : "") << endl;
+		}
 		inspectProcessList(options, result, group.get(), group->enabledProcesses);
 		inspectProcessList(options, result, group.get(), group->disablingProcesses);
 		inspectProcessList(options, result, group.get(), group->disabledProcesses);
@@ -211,6 +280,9 @@ Pool::toXml(const ToXmlOptions &options, bool lock) const {
 	result << "<max>" << max << "</max>";
 	result << "<capacity_used>" << capacityUsedUnlocked() << "</capacity_used>";
 	result << "<get_wait_list_size>" << getWaitlist.size() << "</get_wait_list_size>";
+	result << "<get_wait_list_delay>";
+	getWaitlistDelayMonitor.inspectXml(result);
+	result << "</get_wait_list_delay>";
 
 	if (options.secrets) {
 		vector<GetWaiter>::const_iterator w_it, w_end = getWaitlist.end();
@@ -340,6 +412,46 @@ Pool::inspectConfigInAdminPanelFormat(const ToJsonOptions &options) const {
 	return result;
 }
 
+Json::Value
+Pool::inspectSpawnTimingsAsJson(const ToJsonOptions &options) const {
+	ScopedLock l(syncher);
+	Json::Value result(Json::objectValue);
+	GroupMap::ConstIterator g_it(groups);
+
+	if (!authorizeByUid(options.uid, false)
+	 && !authorizeByApiKey(options.apiKey, false))
+	{
+		throw SecurityException("Operation unauthorized");
+	}
+
+	while (*g_it != NULL) {
+		const GroupPtr &group = g_it.getValue();
+
+		if (options.hasApplicationIdsFilter) {
+			const bool *tmp;
+			if (!options.applicationIdsFilter.lookup(group->info.name, &tmp)) {
+				g_it.next();
+				continue;
+			}
+		}
+
+		if (!group->authorizeByUid(options.uid)
+		 && !group->authorizeByApiKey(options.apiKey))
+		{
+			g_it.next();
+			continue;
+		}
+
+		Json::Value groupDoc(Json::objectValue);
+		group->inspectSpawnTimingsAsJson(groupDoc);
+		result[group->info.name] = groupDoc;
+
+		g_it.next();
+	}
+
+	return result;
+}
+
 
 Json::Value
 Pool::makeSingleValueJsonConfigFormat(const Json::Value &val, const Json::Value &defaultValue) {
@@ -50,6 +50,7 @@
 #include <Core/ApplicationPool/Common.h>
 #include <Core/ApplicationPool/Socket.h>
 #include <Core/ApplicationPool/Session.h>
+#include <Core/ApplicationPool/ProcessHealthMonitor.h>
 #include <Core/SpawningKit/PipeWatcher.h>
 #include <Core/SpawningKit/Result.h>
 #include <Shared/ApplicationPoolApiKey.h>
@@ -285,7 +286,9 @@ private:
 				StaticString(base + log.socketStringOffsets[i].description.offset,
 					log.socketStringOffsets[i].description.size),
 				getJsonIntField(socket, "concurrency"),
-				getJsonBoolField(socket, "accept_http_requests")
+				getJsonBoolField(socket, "accept_http_requests"),
+				getJsonBoolField(socket, "framed_request_bodies", false),
+				getJsonUintField(socket, "binary_session_header_version", 0u)
 			);
 		}
 
@@ -384,6 +387,12 @@ public:
 
 	/** Last time when a session was opened for this Process. */
 	unsigned long long lastUsed;
+	/** Last time when this Process finished out-of-band work, or 0 if never. */
+	unsigned long long lastOobwTime;
+	/** A random number in [0, 1), chosen when the Process is attached.
+	 * Determines how much its recycling limits are lowered. See
+	 * Group::jitteredLimit(). */
+	double recycleJitter;
 	/** Number of sessions currently open.
 	 * @invariant session >= 0
 	 */
@@ -441,10 +450,18 @@ public:
 	/** Caches whether or not the OS process still exists. */
 	mutable bool m_osProcessExists: 1;
 	bool longRunningConnectionsAborted: 1;
+	/** Whether the requested out-of-band work was deferred because the
+	 * Group was too busy. Used for statistics. */
+	bool oobwDeferred: 1;
+	/** Whether Group::recycleThreadMain() is spawning a replacement for
+	 * this process because it reached its maximum number of requests. */
+	bool recycling: 1;
 	/** Time at which shutdown began. */
 	time_t shutdownStartTime;
 	/** Collected by Pool::collectAnalytics(). */
 	ProcessMetrics metrics;
+	/** Updated by Group::onSessionClose(). Used for outlier ejection. */
+	ProcessHealthMonitor health;
 
 
 	Process(const BasicGroupInfo *groupInfo, const Json::Value &args)
@@ -458,6 +475,8 @@ public:
 		  refcount(1),
 		  index(-1),
 		  lastUsed(spawnEndTime),
+		  lastOobwTime(0),
+		  recycleJitter(0),
 		  sessions(0),
 		  processed(0),
 		  lifeStatus(ALIVE),
@@ -465,6 +484,8 @@ public:
 		  oobwStatus(OOBW_NOT_ACTIVE),
 		  m_osProcessExists(true),
 		  longRunningConnectionsAborted(false),
+		  oobwDeferred(false),
+		  recycling(false),
 		  shutdownStartTime(0)
 	{
 		initializeSocketsAndStringFields(args);
@@ -483,6 +504,8 @@ public:
 		  refcount(1),
 		  index(-1),
 		  lastUsed(spawnEndTime),
+		  lastOobwTime(0),
+		  recycleJitter(0),
 		  sessions(0),
 		  processed(0),
 		  lifeStatus(ALIVE),
@@ -490,6 +513,8 @@ public:
 		  oobwStatus(OOBW_NOT_ACTIVE),
 		  m_osProcessExists(true),
 		  longRunningConnectionsAborted(false),
+		  oobwDeferred(false),
+		  recycling(false),
 		  shutdownStartTime(0)
 	{
 		initializeSocketsAndStringFields(skResult);
@@ -673,6 +698,10 @@ public:
 		return spawnerCreationTime;
 	}
 
+	unsigned long long getSpawnEndTime() const {
+		return spawnEndTime;
+	}
+
 	bool isDummy() const {
 		return type == SpawningKit::Result::DUMMY;
 	}
@@ -763,6 +792,29 @@ public:
 		}
 	}
 
+	/**
+	 * Whether outlier ejection keeps the Group from routing requests to this
+	 * process: it has been ejected, or it's being probed and is already
+	 * handling a request.
+	 */
+	bool isRoutingRestricted() const {
+		return health.isEjected() || (health.isProbing() && sessions > 0);
+	}
+
+	/**
+	 * The busyness value that the Group uses for routing. This is the same as
+	 * `busyness()`, except that processes for which `isRoutingRestricted()`
+	 * holds sort last, so that they're only picked if all other processes
+	 * are totally busy as well. `Group::route()` handles that case explicitly.
+	 */
+	int routingBusyness() const {
+		if (OXT_UNLIKELY(isRoutingRestricted())) {
+			return INT_MAX;
+		} else {
+			return busyness();
+		}
+	}
+
 	/**
 	 * Whether we've reached the maximum number of concurrent sessions for this
 	 * process.
@@ -873,6 +925,9 @@ public:
 		stream << "<sessions>" << sessions << "</sessions>";
 		stream << "<busyness>" << busyness() << "</busyness>";
 		stream << "<processed>" << processed << "</processed>";
+		if (lastOobwTime != 0) {
+			stream << "<last_oobw_time>" << lastOobwTime << "</last_oobw_time>";
+		}
 		stream << "<spawner_creation_time>" << spawnerCreationTime << "</spawner_creation_time>";
 		stream << "<spawn_start_time>" << spawnStartTime << "</spawn_start_time>";
 		stream << "<spawn_end_time>" << spawnEndTime << "</spawn_end_time>";
@@ -911,6 +966,9 @@ public:
 		default:
 			P_BUG("Unknown 'enabled' state " << (int) enabled);
 		}
+		stream << "<health>";
+		health.inspectXml(stream);
+		stream << "</health>";
 		if (metrics.isValid()) {
 			stream << "<has_metrics>true</has_metrics>";
 			stream << "<cpu>" << (int) metrics.cpu << "</cpu>";
@@ -0,0 +1,234 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef _PASSENGER_APPLICATION_POOL_PROCESS_HEALTH_MONITOR_H_
+#define _PASSENGER_APPLICATION_POOL_PROCESS_HEALTH_MONITOR_H_
+
+#include <algorithm>
+#include <oxt/macros.hpp>
+#include <Algorithms/MovingAverage.h>
+
+namespace Passenger {
+namespace ApplicationPool2 {
+
+
+/**
+ * Scores the health of a single process based on the outcome and latency of
+ * its recent requests, and decides when the process is an outlier that should
+ * temporarily stop receiving traffic (outlier ejection):
+ *
+ *  - A request is bad if it failed (see Session::reportAppError()) or if it
+ *    took longer than the latency threshold.
+ *  - A healthy process is ejected after `maxConsecutiveErrors` bad requests
+ *    in a row, or when at least half of its recent requests were bad.
+ *  - Once the ejection time has passed, the process is probed: it receives
+ *    one request at a time. If the probe succeeds then the process is
+ *    healthy again, otherwise it's ejected again for twice as long.
+ *
+ * This class is not thread-safe; it is protected by the Pool lock.
+ */
+class ProcessHealthMonitor {
+public:
+	enum State {
+		HEALTHY,
+		EJECTED,
+		PROBING
+	};
+
+	/** The error rate is only trusted after this many requests. */
+	static const unsigned int MIN_REQUESTS_FOR_ERROR_RATE = 20;
+	/** The ejection time doubles with each consecutive ejection, up to
+	 * 2^MAX_BACKOFF_SHIFT times the configured ejection time.
+	 */
+	static const unsigned int MAX_BACKOFF_SHIFT = 5;
+
+private:
+	State state;
+	unsigned int consecutiveErrors;
+	unsigned int consecutiveEjections;
+	unsigned int requests;
+	double errorRate;
+	double averageLatency;
+	unsigned long long ejectedUntil;
+	unsigned long long ejections;
+
+	void eject(unsigned long long now, unsigned int ejectionTime) {
+		unsigned int shift = consecutiveEjections;
+		if (shift > MAX_BACKOFF_SHIFT) {
+			shift = MAX_BACKOFF_SHIFT;
+		}
+		state = EJECTED;
+		consecutiveEjections++;
+		ejections++;
+		ejectedUntil = now + ((ejectionTime * 1000000ull) << shift);
+		consecutiveErrors = 0;
+		requests = 0;
+		errorRate = -1;
+	}
+
+public:
+	ProcessHealthMonitor()
+		: state(HEALTHY),
+		  consecutiveErrors(0),
+		  consecutiveEjections(0),
+		  requests(0),
+		  errorRate(-1),
+		  averageLatency(-1),
+		  ejectedUntil(0),
+		  ejections(0)
+		{ }
+
+	/**
+	 * Must be called when a request to the process has finished. `latency`
+	 * is the time (in microseconds) that the request took, `latencyThreshold`
+	 * is in milliseconds (0 means no threshold) and `ejectionTime` is in
+	 * seconds. If `maxConsecutiveErrors` is 0 then only statistics are
+	 * collected.
+	 *
+	 * Returns whether the process should be ejected now.
+	 */
+	bool report(bool failed, unsigned long long latency, unsigned long long now,
+		unsigned int maxConsecutiveErrors, unsigned int latencyThreshold,
+		unsigned int ejectionTime)
+	{
+		bool bad = failed || (latencyThreshold != 0 && latency > latencyThreshold * 1000ull);
+
+		averageLatency = expMovingAverage(averageLatency, latency, 0.1);
+		errorRate = expMovingAverage(errorRate, bad ? 1 : 0, 0.1);
+		if (requests < MIN_REQUESTS_FOR_ERROR_RATE) {
+			requests++;
+		}
+		if (bad) {
+			consecutiveErrors++;
+		} else {
+			consecutiveErrors = 0;
+		}
+
+		if (maxConsecutiveErrors == 0) {
+			return false;
+		}
+
+		switch (state) {
+		case HEALTHY:
+			if (consecutiveErrors >= maxConsecutiveErrors
+			 || (requests >= MIN_REQUESTS_FOR_ERROR_RATE && errorRate >= 0.5))
+			{
+				eject(now, ejectionTime);
+				return true;
+			} else {
+				return false;
+			}
+		case PROBING:
+			if (bad) {
+				eject(now, ejectionTime);
+				return true;
+			} else {
+				state = HEALTHY;
+				consecutiveEjections = 0;
+				return false;
+			}
+		default:
+			// A request that was already in progress when the process
+			// was ejected. It doesn't tell us anything new.
+			return false;
+		}
+	}
+
+	/**
+	 * Moves an ejected process to the probing state if its ejection time
+	 * has passed. Returns whether that happened.
+	 */
+	bool maybeStartProbing(unsigned long long now) {
+		if (state == EJECTED && now >= ejectedUntil) {
+			state = PROBING;
+			return true;
+		} else {
+			return false;
+		}
+	}
+
+	State getState() const {
+		return state;
+	}
+
+	bool isEjected() const {
+		return state == EJECTED;
+	}
+
+	bool isProbing() const {
+		return state == PROBING;
+	}
+
+	/** The time until which the process is ejected, in microseconds. */
+	unsigned long long getEjectedUntil() const {
+		return ejectedUntil;
+	}
+
+	/** The number of times that the process was ejected without
+	 * passing a probe in between.
+	 */
+	unsigned int getConsecutiveEjections() const {
+		return consecutiveEjections;
+	}
+
+	/** The exponential moving average of the fraction of bad requests,
+	 * or -1 if there is no data yet.
+	 */
+	double getErrorRate() const {
+		return errorRate;
+	}
+
+	/** The exponential moving average of the request latency in
+	 * microseconds, or -1 if there is no data yet.
+	 */
+	double getAverageLatency() const {
+		return averageLatency;
+	}
+
+	template<typename Stream>
+	void inspectXml(Stream &stream) const {
+		switch (state) {
+		case HEALTHY:
+			stream << "<state>HEALTHY</state>";
+			break;
+		case EJECTED:
+			stream << "<state>EJECTED</state>";
+			stream << "<ejected_until>" << ejectedUntil << "</ejected_until>";
+			break;
+		case PROBING:
+			stream << "<state>PROBING</state>";
+			break;
+		}
+		stream << "<error_rate>" << std::max(errorRate, 0.0) << "</error_rate>";
+		stream << "<average_latency>" << (unsigned long long) std::max(averageLatency, 0.0) << "</average_latency>";
+		stream << "<ejections>" << ejections << "</ejections>";
+	}
+};
+
+
+} // namespace ApplicationPool2
+} // namespace Passenger
+
+#endif /* _PASSENGER_APPLICATION_POOL_PROCESS_HEALTH_MONITOR_H_ */
@@ -0,0 +1,212 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef _PASSENGER_APPLICATION_POOL_QUEUE_DELAY_MONITOR_H_
+#define _PASSENGER_APPLICATION_POOL_QUEUE_DELAY_MONITOR_H_
+
+#include <ostream>
+#include <algorithm>
+#include <oxt/macros.hpp>
+#include <Algorithms/MovingAverage.h>
+
+namespace Passenger {
+namespace ApplicationPool2 {
+
+
+/**
+ * Keeps track of how long get waiters sit in a getWaitlist (their sojourn
+ * time) and decides when to shed them, using CoDel as applied to server
+ * request queues:
+ *
+ *  - Time is divided into intervals of INTERVAL_FACTOR times the target delay.
+ *  - If the minimum sojourn time during an interval was above the target,
+ *    then the queue isn't draining and is considered overloaded during the
+ *    next interval.
+ *  - While overloaded, waiters that have been queued for longer than twice
+ *    the target are shed with a fast error instead of being served. Their
+ *    clients have most likely given up already.
+ *
+ * Short bursts drain within an interval and are therefore never shed.
+ *
+ * Waiters are normally only checked when a process becomes available to
+ * them. If no process becomes available, e.g. because all of them are stuck,
+ * then the waiter at the head of the queue is checked through `checkHead()`
+ * instead, so that it gets a fast error in that case too.
+ *
+ * This class is not thread-safe; it is protected by the Pool lock.
+ */
+class QueueDelayMonitor {
+public:
+	static const unsigned int INTERVAL_FACTOR = 20;
+
+private:
+	unsigned long long intervalEnd;
+	unsigned long long minDelay;
+	bool overloaded;
+
+	unsigned long long lastDelay;
+	unsigned long long peakDelay;
+	double averageDelay;
+	unsigned long long dequeued;
+	unsigned long long shed;
+
+	void recordDelay(unsigned long long delay) {
+		lastDelay = delay;
+		if (delay > peakDelay) {
+			peakDelay = delay;
+		}
+		averageDelay = expMovingAverage(averageDelay, delay, 0.1);
+		dequeued++;
+	}
+
+	void updateInterval(unsigned long long delay, unsigned long long now,
+		unsigned long long targetDelay)
+	{
+		if (now >= intervalEnd) {
+			overloaded = minDelay > targetDelay;
+			minDelay = delay;
+			intervalEnd = now + INTERVAL_FACTOR * targetDelay;
+		} else if (delay < minDelay) {
+			minDelay = delay;
+		}
+	}
+
+public:
+	QueueDelayMonitor()
+		: intervalEnd(0),
+		  minDelay(0),
+		  overloaded(false),
+		  lastDelay(0),
+		  peakDelay(0),
+		  averageDelay(-1),
+		  dequeued(0),
+		  shed(0)
+		{ }
+
+	/**
+	 * Must be called when a waiter is about to leave the queue. `delay` is
+	 * the time (in microseconds) that it has spent in the queue, and
+	 * `targetDelay` is the configured target delay in milliseconds. If
+	 * `targetDelay` is 0 then only statistics are collected.
+	 *
+	 * Returns whether the waiter should be shed.
+	 */
+	bool dequeue(unsigned long long delay, unsigned long long now,
+		unsigned int targetDelay)
+	{
+		bool result = false;
+
+		recordDelay(delay);
+		if (targetDelay != 0) {
+			unsigned long long target = targetDelay * 1000ull;
+			updateInterval(delay, now, target);
+			result = overloaded && delay > 2 * target;
+			if (OXT_UNLIKELY(result)) {
+				shed++;
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * Must be called with the time (in microseconds) that the waiter at the
+	 * head of the queue has spent in it so far, while it is still waiting.
+	 * Since it will have spent at least that long in the queue when it
+	 * leaves, this detects a standing queue even if nothing is dequeued.
+	 *
+	 * Returns whether the waiter should be shed now, in which case it counts
+	 * as dequeued and must be removed from the queue. Otherwise,
+	 * `nextCheckTime` is set to the time at which checking the head again may
+	 * give a different result, or to 0 if `targetDelay` is 0.
+	 */
+	bool checkHead(unsigned long long delay, unsigned long long now,
+		unsigned int targetDelay, unsigned long long &nextCheckTime)
+	{
+		if (targetDelay == 0) {
+			nextCheckTime = 0;
+			return false;
+		}
+
+		unsigned long long target = targetDelay * 1000ull;
+		updateInterval(delay, now, target);
+		if (overloaded && delay > 2 * target) {
+			recordDelay(delay);
+			shed++;
+			return true;
+		}
+
+		nextCheckTime = intervalEnd;
+		if (overloaded) {
+			nextCheckTime = std::min(nextCheckTime, now + 2 * target - delay + 1);
+		}
+		return false;
+	}
+
+	/**
+	 * Must be called when a request is served without being queued at all,
+	 * which proves that there is no standing queue.
+	 */
+	void bypass(unsigned long long now, unsigned int targetDelay) {
+		if (targetDelay != 0) {
+			updateInterval(0, now, targetDelay * 1000ull);
+		}
+	}
+
+	bool isOverloaded() const {
+		return overloaded;
+	}
+
+	unsigned long long getShedCount() const {
+		return shed;
+	}
+
+	/** The exponential moving average of the sojourn time in microseconds,
+	 * or -1 if nothing has been dequeued yet.
+	 */
+	double getAverageDelay() const {
+		return averageDelay;
+	}
+
+	unsigned long long getPeakDelay() const {
+		return peakDelay;
+	}
+
+	void inspectXml(std::ostream &stream) const {
+		stream << "<last>" << lastDelay << "</last>";
+		stream << "<average>" << (unsigned long long) std::max(averageDelay, 0.0) << "</average>";
+		stream << "<peak>" << peakDelay << "</peak>";
+		stream << "<dequeued>" << dequeued << "</dequeued>";
+		stream << "<shed>" << shed << "</shed>";
+		if (overloaded) {
+			stream << "<overloaded/>";
+		}
+	}
+};
+
+
+} // namespace ApplicationPool2
+} // namespace Passenger
+
+#endif /* _PASSENGER_APPLICATION_POOL_QUEUE_DELAY_MONITOR_H_ */
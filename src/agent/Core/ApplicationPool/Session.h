@@ -33,6 +33,7 @@
 #include <oxt/backtrace.hpp>
 #include <Utils/ScopeGuard.h>
 #include <Utils/Lock.h>
+#include <SystemTools/SystemTime.h>
 #include <Core/ApplicationPool/Context.h>
 #include <Core/ApplicationPool/BasicProcessInfo.h>
 #include <Core/ApplicationPool/BasicGroupInfo.h>
@@ -87,6 +88,7 @@ private:
 	Connection connection;
 	mutable boost::atomic<int> refcount;
 	bool closed;
+	bool appError;
 
 	void deinitiate(bool success, bool wantKeepAlive) {
 		connection.fail = !success;
@@ -117,6 +119,13 @@ private:
 public:
 	Callback onInitiateFailure;
 	Callback onClose;
+	/** The time at which this session was checked out, in microseconds. */
+	unsigned long long checkoutTime;
+	/**
+	 * The time at which the application began sending its response, in
+	 * microseconds, or 0 if it hasn't yet.
+	 */
+	unsigned long long responseBeginTime;
 
 	Session(Context *_context, const BasicProcessInfo *_processInfo, Socket *_socket)
 		: context(_context),
@@ -124,8 +133,11 @@ public:
 		  socket(_socket),
 		  refcount(1),
 		  closed(false),
+		  appError(false),
 		  onInitiateFailure(NULL),
-		  onClose(NULL)
+		  onClose(NULL),
+		  checkoutTime(0),
+		  responseBeginTime(0)
 		{ }
 
 	~Session() {
@@ -180,6 +192,14 @@ public:
 		return getSocket()->protocol;
 	}
 
+	virtual bool hasFramedRequestBodies() const {
+		return getSocket()->framedRequestBodies;
+	}
+
+	virtual unsigned int getBinarySessionHeaderVersion() const {
+		return getSocket()->binarySessionHeaderVersion;
+	}
+
 
 	virtual void initiate(bool blocking = true) {
 		assert(!closed);
@@ -225,6 +245,24 @@ public:
 
 	virtual void requestOOBW();
 
+	virtual void reportAppError() {
+		appError = true;
+	}
+
+	virtual void reportResponseBegin() {
+		if (responseBeginTime == 0) {
+			responseBeginTime = SystemTime::getUsec();
+		}
+	}
+
+	/**
+	 * Whether reportAppError() has been called. Unlike the `success` argument
+	 * of close(), this is not affected by clients that disconnect early.
+	 */
+	bool hasAppError() const {
+		return appError;
+	}
+
 
 	virtual void ref() const {
 		refcount.fetch_add(1, boost::memory_order_relaxed);
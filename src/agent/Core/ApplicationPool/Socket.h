@@ -109,6 +109,16 @@ public:
 	 */
 	int concurrency;
 	bool acceptHttpRequests;
+	/**
+	 * Whether the app reads "session" protocol request bodies up to
+	 * CONTENT_LENGTH instead of until EOF. See SpawningKit::Result::Socket.
+	 */
+	bool framedRequestBodies;
+	/**
+	 * The highest binary "session" protocol header encoding version that
+	 * the app supports, or 0. See SpawningKit::Result::Socket.
+	 */
+	unsigned int binarySessionHeaderVersion;
 
 	// Private. In public section as alignment optimization.
 	int totalConnections;
@@ -120,17 +130,22 @@ public:
 	Socket()
 		: pid(-1),
 		  concurrency(-1),
-		  acceptHttpRequests(0)
+		  acceptHttpRequests(0),
+		  framedRequestBodies(0),
+		  binarySessionHeaderVersion(0)
 		{ }
 
 	Socket(pid_t _pid, const StaticString &_address, const StaticString &_protocol,
-		const StaticString &_description, int _concurrency, bool _acceptHttpRequests)
+		const StaticString &_description, int _concurrency, bool _acceptHttpRequests,
+		bool _framedRequestBodies = false, unsigned int _binarySessionHeaderVersion = 0)
 		: address(_address),
 		  protocol(_protocol),
 		  description(_description),
 		  pid(_pid),
 		  concurrency(_concurrency),
 		  acceptHttpRequests(_acceptHttpRequests),
+		  framedRequestBodies(_framedRequestBodies),
+		  binarySessionHeaderVersion(_binarySessionHeaderVersion),
 		  totalConnections(0),
 		  totalIdleConnections(0),
 		  sessions(0)
@@ -144,6 +159,8 @@ public:
 		  pid(other.pid),
 		  concurrency(other.concurrency),
 		  acceptHttpRequests(other.acceptHttpRequests),
+		  framedRequestBodies(other.framedRequestBodies),
+		  binarySessionHeaderVersion(other.binarySessionHeaderVersion),
 		  totalConnections(other.totalConnections),
 		  totalIdleConnections(other.totalIdleConnections),
 		  sessions(other.sessions)
@@ -159,6 +176,8 @@ public:
 		pid = other.pid;
 		concurrency = other.concurrency;
 		acceptHttpRequests = other.acceptHttpRequests;
+		framedRequestBodies = other.framedRequestBodies;
+		binarySessionHeaderVersion = other.binarySessionHeaderVersion;
 		sessions = other.sessions;
 		return *this;
 	}
@@ -266,10 +285,11 @@ public:
 class SocketList: public boost::container::small_vector<Socket, 1> {
 public:
 	void add(pid_t pid, const StaticString &address, const StaticString &protocol,
-		const StaticString &description, int concurrency, bool acceptHttpRequests)
+		const StaticString &description, int concurrency, bool acceptHttpRequests,
+		bool framedRequestBodies = false, unsigned int binarySessionHeaderVersion = 0)
 	{
 		push_back(Socket(pid, address, protocol, description, concurrency,
-			acceptHttpRequests));
+			acceptHttpRequests, framedRequestBodies, binarySessionHeaderVersion));
 	}
 
 	const Socket *findFirstSocketWithProtocol(const StaticString &protocol) const {
@@ -0,0 +1,169 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef _PASSENGER_APPLICATION_POOL_SPAWN_TIMINGS_H_
+#define _PASSENGER_APPLICATION_POOL_SPAWN_TIMINGS_H_
+
+#include <boost/thread.hpp>
+#include <map>
+#include <jsoncpp/json.h>
+#include <Core/SpawningKit/Journey.h>
+#include <Core/SpawningKit/Result.h>
+
+namespace Passenger {
+namespace ApplicationPool2 {
+
+using namespace std;
+
+
+/**
+ * Per-step duration histograms of the successful spawns in a Group, built
+ * from the journey step durations in their SpawningKit::Result, plus one
+ * for the total spawn duration. This makes regressions in app boot time
+ * (or in any other step, e.g. the OS shell or the preloader fork) visible
+ * without a spawn having to fail first.
+ *
+ * This class is thread-safe because it is fed from spawner threads.
+ */
+class SpawnTimings {
+public:
+	static const unsigned int BUCKET_COUNT = 16;
+
+	struct Histogram {
+		unsigned long long count;
+		unsigned long long sum;
+		unsigned long long max;
+		/** buckets[i] counts the durations that fall in
+		 * (BUCKET_BOUNDS[i - 1], BUCKET_BOUNDS[i]]. The last bucket
+		 * counts everything above the last bound.
+		 */
+		unsigned long long buckets[BUCKET_COUNT];
+
+		Histogram()
+			: count(0),
+			  sum(0),
+			  max(0)
+		{
+			for (unsigned int i = 0; i < BUCKET_COUNT; i++) {
+				buckets[i] = 0;
+			}
+		}
+
+		void record(unsigned long long usec) {
+			unsigned int i = 0;
+			while (i < BUCKET_COUNT - 1 && usec > bucketBound(i)) {
+				i++;
+			}
+			buckets[i]++;
+			count++;
+			sum += usec;
+			if (usec > max) {
+				max = usec;
+			}
+		}
+
+		Json::Value inspectAsJson() const {
+			Json::Value doc, bucketsDoc(Json::arrayValue);
+			unsigned long long cumulative = 0;
+
+			for (unsigned int i = 0; i < BUCKET_COUNT; i++) {
+				Json::Value bucket;
+				cumulative += buckets[i];
+				if (i == BUCKET_COUNT - 1) {
+					bucket["le"] = "+Inf";
+				} else {
+					bucket["le"] = bucketBound(i) / 1000000.0;
+				}
+				bucket["count"] = (Json::UInt64) cumulative;
+				bucketsDoc.append(bucket);
+			}
+
+			doc["count"] = (Json::UInt64) count;
+			doc["sum"] = sum / 1000000.0;
+			doc["max"] = max / 1000000.0;
+			doc["buckets"] = bucketsDoc;
+			return doc;
+		}
+	};
+
+	/** The upper bound of bucket `i`, in microseconds. */
+	static unsigned long long bucketBound(unsigned int i) {
+		static const unsigned int bounds[BUCKET_COUNT - 1] = {
+			1, 2, 5, 10, 20, 50, 100, 200, 500,
+			1000, 2000, 5000, 10000, 20000, 60000
+		};
+		return bounds[i] * 1000ull;
+	}
+
+private:
+	typedef map<SpawningKit::JourneyStep, Histogram> StepMap;
+
+	mutable boost::mutex syncher;
+	StepMap steps;
+	Histogram total;
+
+public:
+	void record(const SpawningKit::Result &result) {
+		vector< pair<SpawningKit::JourneyStep, unsigned long long> >::const_iterator it,
+			end = result.stepDurations.end();
+		boost::lock_guard<boost::mutex> l(syncher);
+
+		for (it = result.stepDurations.begin(); it != end; it++) {
+			steps[it->first].record(it->second);
+		}
+		if (result.spawnEndTimeMonotonic >= result.spawnStartTimeMonotonic) {
+			total.record(result.spawnEndTimeMonotonic - result.spawnStartTimeMonotonic);
+		}
+	}
+
+	unsigned long long getSpawnCount() const {
+		boost::lock_guard<boost::mutex> l(syncher);
+		return total.count;
+	}
+
+	/**
+	 * Returns an object with a histogram for each step (keyed by the step
+	 * name in lower case) and one for the total spawn duration (keyed
+	 * "total"). Durations are in seconds. Buckets are cumulative.
+	 */
+	Json::Value inspectAsJson() const {
+		Json::Value doc(Json::objectValue);
+		StepMap::const_iterator it, end = steps.end();
+		boost::lock_guard<boost::mutex> l(syncher);
+
+		for (it = steps.begin(); it != end; it++) {
+			doc[SpawningKit::journeyStepToStringLowerCase(it->first)] =
+				it->second.inspectAsJson();
+		}
+		doc["total"] = total.inspectAsJson();
+		return doc;
+	}
+};
+
+
+} // namespace ApplicationPool2
+} // namespace Passenger
+
+#endif /* _PASSENGER_APPLICATION_POOL_SPAWN_TIMINGS_H_ */
@@ -54,6 +54,8 @@ private:
 	SocketPair connection;
 	BufferedIO peerBufferedIO;
 	unsigned int stickySessionId;
+	bool framedRequestBodies;
+	unsigned int binarySessionHeaderVersion;
 	mutable bool closed;
 	mutable bool success;
 	mutable bool wantKeepAlive;
@@ -65,6 +67,8 @@ public:
 		  gupid("gupid-123"),
 		  protocol("session"),
 		  stickySessionId(0),
+		  framedRequestBodies(false),
+		  binarySessionHeaderVersion(0),
 		  closed(false),
 		  success(false),
 		  wantKeepAlive(false)
@@ -119,6 +123,26 @@ public:
 		protocol = v;
 	}
 
+	virtual bool hasFramedRequestBodies() const {
+		boost::lock_guard<boost::mutex> l(syncher);
+		return framedRequestBodies;
+	}
+
+	void setFramedRequestBodies(bool v) {
+		boost::lock_guard<boost::mutex> l(syncher);
+		framedRequestBodies = v;
+	}
+
+	virtual unsigned int getBinarySessionHeaderVersion() const {
+		boost::lock_guard<boost::mutex> l(syncher);
+		return binarySessionHeaderVersion;
+	}
+
+	void setBinarySessionHeaderVersion(unsigned int v) {
+		boost::lock_guard<boost::mutex> l(syncher);
+		binarySessionHeaderVersion = v;
+	}
+
 	virtual unsigned int getStickySessionId() const {
 		boost::lock_guard<boost::mutex> l(syncher);
 		return stickySessionId;
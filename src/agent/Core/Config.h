@@ -48,6 +48,7 @@
 #include <Core/ApiServer.h>
 #include <Core/AdminPanelConnector.h>
 #include <Shared/ApiAccountUtils.h>
+#include <SystemTools/CpuTopology.h>
 #include <Constants.h>
 #include <Utils.h>
 #include <IOTools/IOUtils.h>
@@ -63,6 +64,7 @@ using namespace std;
  * (do not edit: following text is automatically generated
  * by 'rake configkit_schemas_inline_comments')
  *
+ *   adaptive_request_body_buffering                                 boolean            -          default(false)
  *   admin_panel_auth_type                                           string             -          default("basic")
  *   admin_panel_close_timeout                                       float              -          default(10.0)
  *   admin_panel_connect_timeout                                     float              -          default(30.0)
@@ -91,8 +93,13 @@ using namespace std;
  *   api_server_file_buffered_channel_max_disk_chunk_read_size       unsigned integer   -          default(0)
  *   api_server_file_buffered_channel_threshold                      unsigned integer   -          default(131072)
  *   api_server_mbuf_block_chunk_size                                unsigned integer   -          default(4096),read_only
+ *   api_server_mbuf_large_block_chunk_size                          unsigned integer   -          default(65536),read_only
+ *   api_server_mbuf_small_block_chunk_size                          unsigned integer   -          default(512),read_only
  *   api_server_min_spare_clients                                    unsigned integer   -          default(0)
  *   api_server_request_freelist_limit                               unsigned integer   -          default(1024)
+ *   api_server_slab_allocator                                       boolean            -          default(false),read_only
+ *   api_server_slab_allocator_hugepages                             string             -          default("madvise"),read_only
+ *   api_server_slab_allocator_max_idle_slabs                        unsigned integer   -          default(1),read_only
  *   api_server_start_reading_after_accept                           boolean            -          default(true)
  *   app_output_log_level                                            string             -          default("notice")
  *   benchmark_mode                                                  string             -          -
@@ -101,6 +108,7 @@ using namespace std;
  *   controller_addresses                                            array of strings   -          default(["tcp://127.0.0.1:3000"]),read_only
  *   controller_client_freelist_limit                                unsigned integer   -          default(0)
  *   controller_cpu_affine                                           boolean            -          default(false),read_only
+ *   controller_cpu_affine_excluded_cpus                             string             -          default(""),read_only
  *   controller_file_buffered_channel_auto_start_mover               boolean            -          default(true)
  *   controller_file_buffered_channel_auto_truncate_file             boolean            -          default(true)
  *   controller_file_buffered_channel_buffer_dir                     string             -          default
@@ -108,27 +116,49 @@ using namespace std;
  *   controller_file_buffered_channel_max_disk_chunk_read_size       unsigned integer   -          default(0)
  *   controller_file_buffered_channel_threshold                      unsigned integer   -          default(131072)
  *   controller_mbuf_block_chunk_size                                unsigned integer   -          default(4096),read_only
+ *   controller_mbuf_large_block_chunk_size                          unsigned integer   -          default(65536),read_only
+ *   controller_mbuf_small_block_chunk_size                          unsigned integer   -          default(512),read_only
  *   controller_min_spare_clients                                    unsigned integer   -          default(0)
  *   controller_request_freelist_limit                               unsigned integer   -          default(1024)
  *   controller_secure_headers_password                              any                -          secret
+ *   controller_slab_allocator                                       boolean            -          default(false),read_only
+ *   controller_slab_allocator_hugepages                             string             -          default("madvise"),read_only
+ *   controller_slab_allocator_max_idle_slabs                        unsigned integer   -          default(1),read_only
  *   controller_socket_backlog                                       unsigned integer   -          default(2048),read_only
  *   controller_start_reading_after_accept                           boolean            -          default(true)
  *   controller_threads                                              unsigned integer   -          default,read_only
  *   default_abort_websockets_on_process_shutdown                    boolean            -          default(true)
  *   default_app_file_descriptor_ulimit                              unsigned integer   -          -
  *   default_bind_address                                            string             -          default("127.0.0.1")
+ *   default_capacity_weight                                         unsigned integer   -          default(1)
  *   default_environment                                             string             -          default("production")
  *   default_force_max_concurrent_requests_per_process               integer            -          default(-1)
  *   default_friendly_error_pages                                    string             -          default("auto")
  *   default_group                                                   string             -          default
+ *   default_guaranteed_capacity                                     unsigned integer   -          default(0)
  *   default_load_shell_envvars                                      boolean            -          default(false)
+ *   default_max_concurrent_recycles                                 unsigned integer   -          default(0)
  *   default_max_preloader_idle_time                                 unsigned integer   -          default(300)
  *   default_max_request_queue_size                                  unsigned integer   -          default(100)
+ *   default_max_request_queue_time                                  unsigned integer   -          default(0)
  *   default_max_requests                                            unsigned integer   -          default(0)
+ *   default_memory_limit                                            unsigned integer   -          default(0)
  *   default_meteor_app_settings                                     string             -          -
  *   default_min_instances                                           unsigned integer   -          default(1)
  *   default_nodejs                                                  string             -          default("node")
+ *   default_oobw_interval                                           unsigned integer   -          default(0)
+ *   default_oobw_max_utilization                                    unsigned integer   -          default(0)
+ *   default_outlier_ejection_errors                                 unsigned integer   -          default(0)
+ *   default_outlier_ejection_time                                   unsigned integer   -          default(30)
+ *   default_outlier_latency_threshold                               unsigned integer   -          default(0)
+ *   default_outlier_restart_threshold                               unsigned integer   -          default(0)
  *   default_python                                                  string             -          default("python")
+ *   default_python_preloading                                       boolean            -          default(false)
+ *   default_recycle_limit_jitter                                    unsigned integer   -          default(0)
+ *   default_request_queue_target_delay                              unsigned integer   -          default(0)
+ *   default_rolling_restarts                                        boolean            -          default(false)
+ *   default_routing_key                                             string             -          default("")
+ *   default_routing_load_factor                                     unsigned integer   -          default(125)
  *   default_ruby                                                    string             -          default("ruby")
  *   default_server_name                                             string             -          default
  *   default_server_port                                             unsigned integer   -          default
@@ -137,6 +167,8 @@ using namespace std;
  *   default_sticky_sessions_cookie_attributes                       string             -          default("SameSite=Lax; Secure;")
  *   default_sticky_sessions_cookie_name                             string             -          default("_passenger_route")
  *   default_user                                                    string             -          default("nobody")
+ *   default_warmup_request_path                                     string             -          default("/")
+ *   default_warmup_requests                                         unsigned integer   -          default(0)
  *   disable_log_prefix                                              boolean            -          default(false)
  *   file_descriptor_log_target                                      any                -          -
  *   file_descriptor_ulimit                                          unsigned integer   -          default(0),read_only
@@ -157,7 +189,12 @@ using namespace std;
  *   pid_file                                                        string             -          read_only
  *   pool_idle_time                                                  unsigned integer   -          default(300)
  *   pool_selfchecks                                                 boolean            -          default(false)
+ *   pool_spawn_batch_size                                           unsigned integer   -          default(4)
+ *   pool_warm_spares                                                unsigned integer   -          default(0)
  *   prestart_urls                                                   array of strings   -          default([]),read_only
+ *   request_body_buffering_memory_threshold                         unsigned integer   -          default(65536)
+ *   request_body_buffering_min_upload_speed                         unsigned integer   -          default(262144)
+ *   request_body_buffering_probe_time                               unsigned integer   -          default(200)
  *   response_buffer_high_watermark                                  unsigned integer   -          default(134217728)
  *   security_update_checker_certificate_path                        string             -          -
  *   security_update_checker_disabled                                boolean            -          default(false)
@@ -165,6 +202,7 @@ using namespace std;
  *   security_update_checker_proxy_url                               string             -          -
  *   security_update_checker_url                                     string             -          default("https://securitycheck.phusionpassenger.com/v1/check.json")
  *   server_software                                                 string             -          default("Phusion_Passenger/6.0.10")
+ *   shell_envvars_cache_ttl                                         unsigned integer   -          default(0)
  *   show_version_in_header                                          boolean            -          default(true)
  *   single_app_mode_app_root                                        string             -          default,read_only
  *   single_app_mode_app_start_command                               string             -          read_only
@@ -321,6 +359,15 @@ private:
 		if (config["controller_threads"].asUInt() < 1) {
 			errors.push_back(Error("'{{controller_threads}}' must be at least 1"));
 		}
+
+		vector<unsigned int> excludedCpus;
+		try {
+			parseCpuList(config["controller_cpu_affine_excluded_cpus"].asString(),
+				excludedCpus);
+		} catch (const ArgumentException &) {
+			errors.push_back(Error("'{{controller_cpu_affine_excluded_cpus}}' must be"
+				" a CPU list such as '0-3,8'"));
+		}
 	}
 
 	static void validateAddresses(const ConfigKit::Store &config, vector<ConfigKit::Error> &errors) {
@@ -492,12 +539,16 @@ public:
 		add("max_pool_size", UINT_TYPE, OPTIONAL, DEFAULT_MAX_POOL_SIZE);
 		add("pool_idle_time", UINT_TYPE, OPTIONAL, Json::UInt(DEFAULT_POOL_IDLE_TIME));
 		add("pool_selfchecks", BOOL_TYPE, OPTIONAL, false);
+		add("pool_spawn_batch_size", UINT_TYPE, OPTIONAL, 4);
+		add("pool_warm_spares", UINT_TYPE, OPTIONAL, 0);
 		add("prestart_urls", STRING_ARRAY_TYPE, OPTIONAL | READ_ONLY, Json::arrayValue);
+		add("shell_envvars_cache_ttl", UINT_TYPE, OPTIONAL, 0);
 		add("controller_secure_headers_password", ANY_TYPE, OPTIONAL | SECRET);
 		add("controller_socket_backlog", UINT_TYPE, OPTIONAL | READ_ONLY, DEFAULT_SOCKET_BACKLOG);
 		add("controller_addresses", STRING_ARRAY_TYPE, OPTIONAL | READ_ONLY, getDefaultControllerAddresses());
 		add("api_server_addresses", STRING_ARRAY_TYPE, OPTIONAL | READ_ONLY, Json::arrayValue);
 		add("controller_cpu_affine", BOOL_TYPE, OPTIONAL | READ_ONLY, false);
+		add("controller_cpu_affine_excluded_cpus", STRING_TYPE, OPTIONAL | READ_ONLY, "");
 		add("file_descriptor_ulimit", UINT_TYPE, OPTIONAL | READ_ONLY, 0);
 
 		add("hook_attached_process", STRING_TYPE, OPTIONAL | READ_ONLY);
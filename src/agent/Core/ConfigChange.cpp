@@ -302,7 +302,11 @@ asyncCommitConfigChange(ConfigChangeRequest *req, const CommitConfigChangeCallba
 
 	wo->appPool->setMax(coreConfig->get("max_pool_size").asInt());
 	wo->appPool->setMaxIdleTime(coreConfig->get("pool_idle_time").asInt() * 1000000ULL);
+	wo->appPool->setWarmSpares(coreConfig->get("pool_warm_spares").asUInt());
+	wo->appPool->setSpawnBatchSize(coreConfig->get("pool_spawn_batch_size").asUInt());
 	wo->appPool->enableSelfChecking(coreConfig->get("pool_selfchecks").asBool());
+	wo->spawningKitContext->shellEnvvarsCache.setTtl(
+		coreConfig->get("shell_envvars_cache_ttl").asUInt());
 	{
 		LockGuard l(wo->appPoolContext->agentConfigSyncher);
 		wo->appPoolContext->agentConfig = coreConfig->inspectEffectiveValues();
@@ -112,6 +112,9 @@ private:
 	// If you change this value, make sure that Request::sessionCheckoutTry
 	// has enough bits.
 	static const unsigned int MAX_SESSION_CHECKOUT_TRY = 10;
+	// The highest binary session protocol header encoding version that
+	// we can generate. See constructHeaderForSessionProtocol().
+	static const unsigned int MAX_BINARY_SESSION_HEADER_VERSION = 1;
 
 	ControllerMainConfig mainConfig;
 	ControllerRequestConfigPtr requestConfig;
@@ -145,6 +148,12 @@ private:
 	TurboCaching<Request> turboCaching;
 	ConfigKit::Store *singleAppModeConfig;
 
+	// Statistics about the decisions made by decideRequestBodyBuffering()
+	// and probeRequestBodyUploadSpeed().
+	unsigned long long smallRequestBodiesBuffered;
+	unsigned long long fastRequestBodiesStreamed;
+	unsigned long long slowRequestBodiesBuffered;
+
 	#ifdef DEBUG_CC_EVENT_LOOP_BLOCKING
 		struct ev_prepare prepareWatcher;
 		ev_tstamp timeBeforeBlocking;
@@ -182,12 +191,15 @@ private:
 	void createNewPoolOptions(Client *client, Request *req,
 		const HashedStaticString &appGroupName);
 	void setStickySessionId(Client *client, Request *req);
+	void setRoutingHash(Client *client, Request *req);
 	const LString *getStickySessionCookieName(Request *req);
 
 
 	/****** Stage: buffering body ******/
 
+	void decideRequestBodyBuffering(Client *client, Request *req);
 	void beginBufferingBody(Client *client, Request *req);
+	void probeRequestBodyUploadSpeed(Client *client, Request *req);
 	Channel::Result whenBufferingBody_onRequestBody(Client *client, Request *req,
 		const MemoryKit::mbuf &buffer, int errcode);
 	static void _bodyBufferFlushed(FileBufferedChannel *_channel);
@@ -389,6 +401,9 @@ public:
 
 		  turboCaching(),
 		  singleAppModeConfig(NULL),
+		  smallRequestBodiesBuffered(0),
+		  fastRequestBodiesStreamed(0),
+		  slowRequestBodiesBuffered(0),
 		  resourceLocator(NULL)
 		  /**************************/
 	{
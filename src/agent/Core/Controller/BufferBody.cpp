@@ -46,6 +46,36 @@ using namespace boost;
  ****************************/
 
 
+/**
+ * Called when adaptive request body buffering is enabled, instead of
+ * relying solely on the 'B' flag. Small bodies are buffered (in memory,
+ * as long as they fit within the bodyBuffer threshold). Large bodies are
+ * buffered too, but only until we've measured the client's upload speed:
+ * if the client turns out to be fast enough then probeRequestBodyUploadSpeed()
+ * checks out a session early and the rest of the body is streamed through.
+ *
+ * Bodies of unknown size are left alone: buffering them is the only way
+ * to tell the app the body size upfront, so we can't switch halfway.
+ */
+void
+Controller::decideRequestBodyBuffering(Client *client, Request *req) {
+	if (req->bodyType != Request::RBT_CONTENT_LENGTH) {
+		return;
+	}
+
+	req->requestBodyBuffering = true;
+	if (req->aux.bodyInfo.contentLength <= req->config->requestBodyBufferingMemoryThreshold) {
+		SKC_TRACE(client, 2, "Request body is small (" <<
+			req->aux.bodyInfo.contentLength << " bytes); buffering it");
+		smallRequestBodiesBuffered++;
+	} else {
+		SKC_TRACE(client, 2, "Request body is large (" <<
+			req->aux.bodyInfo.contentLength << " bytes); measuring the"
+			" client's upload speed before deciding whether to buffer it");
+		req->probingBodyUploadSpeed = true;
+	}
+}
+
 void
 Controller::beginBufferingBody(Client *client, Request *req) {
 	TRACE_POINT();
@@ -53,6 +83,49 @@ Controller::beginBufferingBody(Client *client, Request *req) {
 	req->bodyChannel.start();
 	req->bodyBuffer.reinitialize();
 	req->bodyBuffer.stop();
+	if (req->probingBodyUploadSpeed) {
+		req->bodyUploadProbeStartTime = SystemTime::getUsec();
+		req->bodyUploadSpeedMeter = SpeedMeter<double, 8, 25000, 10000000>();
+		req->bodyUploadSpeedMeter.addSample(0, req->bodyUploadProbeStartTime);
+	}
+}
+
+/**
+ * Called for every chunk of body data while probing. Once the probe time
+ * has passed and the upload speed is known, decides whether to keep
+ * buffering until the end of the body (slow clients, so that they don't
+ * occupy an application process), or to check out a session right away
+ * while the bodyBuffer passes the rest of the body through (fast clients).
+ */
+void
+Controller::probeRequestBodyUploadSpeed(Client *client, Request *req) {
+	unsigned long long now = SystemTime::getUsec();
+
+	req->bodyUploadSpeedMeter.addSample(req->bodyBytesBuffered, now);
+	if (now - req->bodyUploadProbeStartTime
+		< (unsigned long long) req->config->requestBodyBufferingProbeTime * 1000)
+	{
+		return;
+	}
+
+	double speed = req->bodyUploadSpeedMeter.currentSpeed();
+	if (speed == req->bodyUploadSpeedMeter.unknownSpeed()) {
+		return;
+	}
+
+	req->probingBodyUploadSpeed = false;
+	if (speed >= req->config->requestBodyBufferingMinUploadSpeed) {
+		SKC_DEBUG(client, "Client uploads request body at " <<
+			(unsigned long long) speed << " bytes/sec; streaming the rest"
+			" of the body to the application");
+		fastRequestBodiesStreamed++;
+		checkoutSession(client, req);
+	} else {
+		SKC_DEBUG(client, "Client uploads request body at " <<
+			(unsigned long long) speed << " bytes/sec; buffering the"
+			" entire body before checking out a session");
+		slowRequestBodiesBuffered++;
+	}
 }
 
 /**
@@ -95,6 +168,13 @@ Controller::whenBufferingBody_onRequestBody(Client *client, Request *req,
 			req->bodyBuffer.setBuffersFlushedCallback(_bodyBufferFlushed);
 		}
 
+		if (req->probingBodyUploadSpeed) {
+			probeRequestBodyUploadSpeed(client, req);
+			if (req->ended()) {
+				return Channel::Result(0, true);
+			}
+		}
+
 		return Channel::Result(buffer.size(), false);
 	} else if (errcode == 0 || errcode == ECONNRESET) {
 		// EOF
@@ -127,7 +207,12 @@ Controller::whenBufferingBody_onRequestBody(Client *client, Request *req,
 			req->headers.erase(HTTP_TRANSFER_ENCODING);
 			req->headers.insert(&header, req->pool);
 		}
-		checkoutSession(client, req);
+		if (req->state == Request::BUFFERING_REQUEST_BODY) {
+			// If we were still probing then the body ended before we
+			// could measure anything useful, so it's fully buffered anyway.
+			req->probingBodyUploadSpeed = false;
+			checkoutSession(client, req);
+		}
 		return Channel::Result(0, true);
 	} else {
 		const unsigned int BUFSIZE = 1024;
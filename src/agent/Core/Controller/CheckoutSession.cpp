@@ -66,6 +66,7 @@ Controller::checkoutSession(Client *client, Request *req) {
 	callback.userData = req;
 
 	options.currentTime = SystemTime::getUsec();
+	options.cancelled = &req->sessionCheckoutCancelled;
 
 	refRequest(req, __FILE__, __LINE__);
 	#ifdef DEBUG_CC_EVENT_LOOP_BLOCKING
@@ -39,6 +39,7 @@
 #include <MemoryKit/palloc.h>
 #include <ServerKit/HttpServer.h>
 #include <SystemTools/UserDatabase.h>
+#include <StrIntTools/StrIntUtils.h>
 #include <WrapperRegistry/Registry.h>
 #include <Constants.h>
 #include <Exceptions.h>
@@ -77,29 +78,72 @@ parseControllerBenchmarkMode(const StaticString &mode) {
 	}
 }
 
+/**
+ * Whether `key` is a valid value for Options::routingKey: empty, or one
+ * of "header:NAME", "cookie:NAME" or "path:N".
+ */
+inline bool
+isValidRoutingKey(const StaticString &key) {
+	if (key.empty()) {
+		return true;
+	}
+
+	string::size_type sep = key.find(':');
+	if (sep == string::npos || sep == key.size() - 1) {
+		return false;
+	}
+	StaticString type = key.substr(0, sep);
+	StaticString arg = key.substr(sep + 1);
+	if (type == "header" || type == "cookie") {
+		return true;
+	} else if (type == "path") {
+		return looksLikePositiveNumber(arg);
+	} else {
+		return false;
+	}
+}
+
 /*
  * BEGIN ConfigKit schema: Passenger::Core::ControllerSchema
  * (do not edit: following text is automatically generated
  * by 'rake configkit_schemas_inline_comments')
  *
  *   accept_burst_count                                  unsigned integer   -          default(32)
+ *   adaptive_request_body_buffering                     boolean            -          default(false)
  *   benchmark_mode                                      string             -          -
  *   client_freelist_limit                               unsigned integer   -          default(0)
  *   default_abort_websockets_on_process_shutdown        boolean            -          default(true)
  *   default_app_file_descriptor_ulimit                  unsigned integer   -          -
  *   default_bind_address                                string             -          default("127.0.0.1")
+ *   default_capacity_weight                             unsigned integer   -          default(1)
  *   default_environment                                 string             -          default("production")
  *   default_force_max_concurrent_requests_per_process   integer            -          default(-1)
  *   default_friendly_error_pages                        string             -          default("auto")
  *   default_group                                       string             -          default
+ *   default_guaranteed_capacity                         unsigned integer   -          default(0)
  *   default_load_shell_envvars                          boolean            -          default(false)
+ *   default_max_concurrent_recycles                     unsigned integer   -          default(0)
  *   default_max_preloader_idle_time                     unsigned integer   -          default(300)
  *   default_max_request_queue_size                      unsigned integer   -          default(100)
+ *   default_max_request_queue_time                      unsigned integer   -          default(0)
  *   default_max_requests                                unsigned integer   -          default(0)
+ *   default_memory_limit                                unsigned integer   -          default(0)
  *   default_meteor_app_settings                         string             -          -
  *   default_min_instances                               unsigned integer   -          default(1)
  *   default_nodejs                                      string             -          default("node")
+ *   default_oobw_interval                               unsigned integer   -          default(0)
+ *   default_oobw_max_utilization                        unsigned integer   -          default(0)
+ *   default_outlier_ejection_errors                     unsigned integer   -          default(0)
+ *   default_outlier_ejection_time                       unsigned integer   -          default(30)
+ *   default_outlier_latency_threshold                   unsigned integer   -          default(0)
+ *   default_outlier_restart_threshold                   unsigned integer   -          default(0)
  *   default_python                                      string             -          default("python")
+ *   default_python_preloading                           boolean            -          default(false)
+ *   default_recycle_limit_jitter                        unsigned integer   -          default(0)
+ *   default_request_queue_target_delay                  unsigned integer   -          default(0)
+ *   default_rolling_restarts                            boolean            -          default(false)
+ *   default_routing_key                                 string             -          default("")
+ *   default_routing_load_factor                         unsigned integer   -          default(125)
  *   default_ruby                                        string             -          default("ruby")
  *   default_server_name                                 string             required   -
  *   default_server_port                                 unsigned integer   required   -
@@ -108,11 +152,16 @@ parseControllerBenchmarkMode(const StaticString &mode) {
  *   default_sticky_sessions_cookie_attributes           string             -          default("SameSite=Lax; Secure;")
  *   default_sticky_sessions_cookie_name                 string             -          default("_passenger_route")
  *   default_user                                        string             -          default("nobody")
+ *   default_warmup_request_path                         string             -          default("/")
+ *   default_warmup_requests                             unsigned integer   -          default(0)
  *   graceful_exit                                       boolean            -          default(true)
  *   integration_mode                                    string             -          default("standalone"),read_only
  *   max_instances_per_app                               unsigned integer   -          read_only
  *   min_spare_clients                                   unsigned integer   -          default(0)
  *   multi_app                                           boolean            -          default(true),read_only
+ *   request_body_buffering_memory_threshold             unsigned integer   -          default(65536)
+ *   request_body_buffering_min_upload_speed             unsigned integer   -          default(262144)
+ *   request_body_buffering_probe_time                   unsigned integer   -          default(200)
  *   request_freelist_limit                              unsigned integer   -          default(1024)
  *   response_buffer_high_watermark                      unsigned integer   -          default(134217728)
  *   server_software                                     string             -          default("Phusion_Passenger/6.0.10")
@@ -165,14 +214,37 @@ private:
 		add("default_spawn_method", STRING_TYPE, OPTIONAL, DEFAULT_SPAWN_METHOD);
 		add("default_bind_address", STRING_TYPE, OPTIONAL, DEFAULT_BIND_ADDRESS);
 		add("default_load_shell_envvars", BOOL_TYPE, OPTIONAL, false);
+		add("default_python_preloading", BOOL_TYPE, OPTIONAL, false);
 		add("default_meteor_app_settings", STRING_TYPE, OPTIONAL);
 		add("default_app_file_descriptor_ulimit", UINT_TYPE, OPTIONAL);
 		add("default_min_instances", UINT_TYPE, OPTIONAL, 1);
 		add("default_max_preloader_idle_time", UINT_TYPE, OPTIONAL, DEFAULT_MAX_PRELOADER_IDLE_TIME);
 		add("default_max_request_queue_size", UINT_TYPE, OPTIONAL, DEFAULT_MAX_REQUEST_QUEUE_SIZE);
+		add("default_request_queue_target_delay", UINT_TYPE, OPTIONAL, 0);
+		add("default_max_request_queue_time", UINT_TYPE, OPTIONAL, 0);
+		add("default_memory_limit", UINT_TYPE, OPTIONAL, 0);
+		add("default_recycle_limit_jitter", UINT_TYPE, OPTIONAL, 0);
+		add("default_max_concurrent_recycles", UINT_TYPE, OPTIONAL, 0);
+		add("default_outlier_ejection_errors", UINT_TYPE, OPTIONAL, 0);
+		add("default_outlier_latency_threshold", UINT_TYPE, OPTIONAL, 0);
+		add("default_outlier_ejection_time", UINT_TYPE, OPTIONAL, 30);
+		add("default_outlier_restart_threshold", UINT_TYPE, OPTIONAL, 0);
+		add("default_capacity_weight", UINT_TYPE, OPTIONAL, 1);
+		add("default_guaranteed_capacity", UINT_TYPE, OPTIONAL, 0);
+		add("default_routing_key", STRING_TYPE, OPTIONAL, "");
+		add("default_routing_load_factor", UINT_TYPE, OPTIONAL, 125);
+		add("default_oobw_max_utilization", UINT_TYPE, OPTIONAL, 0);
+		add("default_oobw_interval", UINT_TYPE, OPTIONAL, 0);
+		add("default_rolling_restarts", BOOL_TYPE, OPTIONAL, false);
+		add("default_warmup_requests", UINT_TYPE, OPTIONAL, 0);
+		add("default_warmup_request_path", STRING_TYPE, OPTIONAL, "/");
 		add("default_force_max_concurrent_requests_per_process", INT_TYPE, OPTIONAL, -1);
 		add("default_abort_websockets_on_process_shutdown", BOOL_TYPE, OPTIONAL, true);
 		add("default_max_requests", UINT_TYPE, OPTIONAL, 0);
+		add("adaptive_request_body_buffering", BOOL_TYPE, OPTIONAL, false);
+		add("request_body_buffering_memory_threshold", UINT_TYPE, OPTIONAL, 64 * 1024);
+		add("request_body_buffering_min_upload_speed", UINT_TYPE, OPTIONAL, 256 * 1024);
+		add("request_body_buffering_probe_time", UINT_TYPE, OPTIONAL, 200);
 
 
 		/*******************/
@@ -204,6 +276,11 @@ private:
 			errors.push_back(Error("'{{benchmark_mode}}' is not set to a valid value"));
 		}
 
+		if (!isValidRoutingKey(config["default_routing_key"].asString())) {
+			errors.push_back(Error("'{{default_routing_key}}' must be one of"
+				" 'header:NAME', 'cookie:NAME' or 'path:N'"));
+		}
+
 		/*******************/
 	}
 
@@ -431,15 +508,38 @@ public:
 	StaticString defaultSpawnMethod;
 	StaticString defaultBindAddress;
 	StaticString defaultMeteorAppSettings;
+	StaticString defaultWarmupRequestPath;
+	StaticString defaultRoutingKey;
 	unsigned int defaultAppFileDescriptorUlimit;
 	unsigned int defaultMinInstances;
 	unsigned int defaultMaxPreloaderIdleTime;
 	unsigned int defaultMaxRequestQueueSize;
+	unsigned int defaultRequestQueueTargetDelay;
+	unsigned int defaultMaxRequestQueueTime;
+	unsigned int defaultMemoryLimit;
+	unsigned int defaultRecycleLimitJitter;
+	unsigned int defaultMaxConcurrentRecycles;
+	unsigned int defaultOutlierEjectionErrors;
+	unsigned int defaultOutlierLatencyThreshold;
+	unsigned int defaultOutlierEjectionTime;
+	unsigned int defaultOutlierRestartThreshold;
+	unsigned int defaultCapacityWeight;
+	unsigned int defaultGuaranteedCapacity;
+	unsigned int defaultRoutingLoadFactor;
+	unsigned int defaultOobwMaxUtilization;
+	unsigned int defaultOobwInterval;
+	unsigned int defaultWarmupRequests;
 	unsigned int defaultMaxRequests;
+	unsigned int requestBodyBufferingMemoryThreshold;
+	unsigned int requestBodyBufferingMinUploadSpeed;
+	unsigned int requestBodyBufferingProbeTime;
 	int defaultForceMaxConcurrentRequestsPerProcess;
 	bool showVersionInHeader: 1;
+	bool adaptiveRequestBodyBuffering: 1;
 	bool defaultAbortWebsocketsOnProcessShutdown;
+	bool defaultRollingRestarts;
 	bool defaultLoadShellEnvvars;
+	bool defaultPythonPreloading;
 
 	/*******************/
 	/*******************/
@@ -465,15 +565,38 @@ public:
 		  defaultSpawnMethod(psg_pstrdup(pool, config["default_spawn_method"].asString())),
 		  defaultBindAddress(psg_pstrdup(pool, config["default_bind_address"].asString())),
 		  defaultMeteorAppSettings(psg_pstrdup(pool, config["default_meteor_app_settings"].asString())),
+		  defaultWarmupRequestPath(psg_pstrdup(pool, config["default_warmup_request_path"].asString())),
+		  defaultRoutingKey(psg_pstrdup(pool, config["default_routing_key"].asString())),
 		  defaultAppFileDescriptorUlimit(config["default_app_file_descriptor_ulimit"].asUInt()),
 		  defaultMinInstances(config["default_min_instances"].asUInt()),
 		  defaultMaxPreloaderIdleTime(config["default_max_preloader_idle_time"].asUInt()),
 		  defaultMaxRequestQueueSize(config["default_max_request_queue_size"].asUInt()),
+		  defaultRequestQueueTargetDelay(config["default_request_queue_target_delay"].asUInt()),
+		  defaultMaxRequestQueueTime(config["default_max_request_queue_time"].asUInt()),
+		  defaultMemoryLimit(config["default_memory_limit"].asUInt()),
+		  defaultRecycleLimitJitter(config["default_recycle_limit_jitter"].asUInt()),
+		  defaultMaxConcurrentRecycles(config["default_max_concurrent_recycles"].asUInt()),
+		  defaultOutlierEjectionErrors(config["default_outlier_ejection_errors"].asUInt()),
+		  defaultOutlierLatencyThreshold(config["default_outlier_latency_threshold"].asUInt()),
+		  defaultOutlierEjectionTime(config["default_outlier_ejection_time"].asUInt()),
+		  defaultOutlierRestartThreshold(config["default_outlier_restart_threshold"].asUInt()),
+		  defaultCapacityWeight(config["default_capacity_weight"].asUInt()),
+		  defaultGuaranteedCapacity(config["default_guaranteed_capacity"].asUInt()),
+		  defaultRoutingLoadFactor(config["default_routing_load_factor"].asUInt()),
+		  defaultOobwMaxUtilization(config["default_oobw_max_utilization"].asUInt()),
+		  defaultOobwInterval(config["default_oobw_interval"].asUInt()),
+		  defaultWarmupRequests(config["default_warmup_requests"].asUInt()),
 		  defaultMaxRequests(config["default_max_requests"].asUInt()),
+		  requestBodyBufferingMemoryThreshold(config["request_body_buffering_memory_threshold"].asUInt()),
+		  requestBodyBufferingMinUploadSpeed(config["request_body_buffering_min_upload_speed"].asUInt()),
+		  requestBodyBufferingProbeTime(config["request_body_buffering_probe_time"].asUInt()),
 		  defaultForceMaxConcurrentRequestsPerProcess(config["default_force_max_concurrent_requests_per_process"].asInt()),
 		  showVersionInHeader(config["show_version_in_header"].asBool()),
+		  adaptiveRequestBodyBuffering(config["adaptive_request_body_buffering"].asBool()),
 		  defaultAbortWebsocketsOnProcessShutdown(config["default_abort_websockets_on_process_shutdown"].asBool()),
-		  defaultLoadShellEnvvars(config["default_load_shell_envvars"].asBool())
+		  defaultRollingRestarts(config["default_rolling_restarts"].asBool()),
+		  defaultLoadShellEnvvars(config["default_load_shell_envvars"].asBool()),
+		  defaultPythonPreloading(config["default_python_preloading"].asBool())
 
 		  /*******************/
 		{ }
@@ -95,6 +95,10 @@ Controller::onAppSourceData(Client *client, Request *req, const MemoryKit::mbuf
 				return Channel::Result(ret, false);
 			case AppResponse::PARSING_BODY_WITH_LENGTH:
 				SKC_TRACE(client, 2, "Expecting an app response body with fixed length");
+				if (resp->aux.bodyInfo.contentLength > buffer.size() - ret) {
+					req->appSource.setReadSizeHint(resp->aux.bodyInfo.contentLength
+						- (buffer.size() - ret));
+				}
 				onAppResponseBegin(client, req);
 				return Channel::Result(ret, false);
 			case AppResponse::PARSING_BODY_UNTIL_EOF:
@@ -374,6 +378,13 @@ Controller::onAppResponseBegin(Client *client, Request *req) {
 
 	prepareAppResponseCaching(client, req);
 
+	if (req->session != NULL) {
+		req->session->reportResponseBegin();
+		if (OXT_UNLIKELY(resp->statusCode >= 500)) {
+			req->session->reportAppError();
+		}
+	}
+
 	if (OXT_UNLIKELY(oobw)) {
 		SKC_TRACE(client, 2, "Response with OOBW detected");
 		if (req->session != NULL) {
@@ -1081,6 +1092,14 @@ Controller::keepAliveAppConnection(Client *client, Request *req) {
 		SKC_TRACE(client, 2, "Not keep-aliving application session connection"
 			" because it had been half-closed before");
 		req->session->close(true, false);
+	} else if (req->hasBody()
+		&& (req->state != Request::WAITING_FOR_APP_OUTPUT || !req->appSink.acceptingInput()))
+	{
+		// The app responded before we were done sending it the request body.
+		// The leftover body data would be mistaken for the next request.
+		SKC_TRACE(client, 2, "Not keep-aliving application session connection"
+			" because the request body has not been fully sent to the application");
+		req->session->close(true, false);
 	} else {
 		// halfClosePolicy is initialized in sendHeaderToApp(). That method is
 		// called immediately after checking out a session, before any events
@@ -134,9 +134,12 @@ Controller::reinitializeRequest(Client *client, Request *req) {
 	req->appResponseInitialized = false;
 	req->strip100ContinueHeader = false;
 	req->hasPragmaHeader = false;
+	req->probingBodyUploadSpeed = false;
+	req->sessionCheckoutCancelled.store(false, boost::memory_order_relaxed);
 	req->host = NULL;
 	req->config = requestConfig;
 	req->bodyBytesBuffered = 0;
+	req->bodyUploadProbeStartTime = 0;
 	req->cacheKey = HashedStaticString();
 	req->cacheControl = NULL;
 	req->varyCookie = NULL;
@@ -154,6 +157,11 @@ Controller::reinitializeRequest(Client *client, Request *req) {
 
 void
 Controller::deinitializeRequest(Client *client, Request *req) {
+	if (req->state == Request::CHECKING_OUT_SESSION) {
+		// The request is still queued in the pool. Let the pool drop it
+		// instead of checking out a session that we would discard anyway.
+		req->sessionCheckoutCancelled.store(true, boost::memory_order_relaxed);
+	}
 	req->session.reset();
 	req->config.reset();
 
@@ -243,9 +251,14 @@ ServerKit::Channel::Result
 Controller::onRequestBody(Client *client, Request *req, const MemoryKit::mbuf &buffer,
 	int errcode)
 {
-	switch (req->state) {
-	case Request::BUFFERING_REQUEST_BODY:
+	if (req->requestBodyBuffering) {
+		// The session may already have been checked out while we're
+		// still buffering (see probeRequestBodyUploadSpeed()). The
+		// rest of the body still goes through bodyBuffer.
 		return whenBufferingBody_onRequestBody(client, req, buffer, errcode);
+	}
+
+	switch (req->state) {
 	case Request::FORWARDING_BODY_TO_APP:
 		return whenSendingRequest_onRequestBody(client, req, buffer, errcode);
 	default:
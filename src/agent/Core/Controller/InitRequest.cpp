@@ -175,6 +175,7 @@ Controller::initializePoolOptions(Client *client, Request *req, RequestAnalysis
 
 		// Allow certain options to be overridden on a per-request basis
 		fillPoolOption(req, req->options.maxRequests, PASSENGER_MAX_REQUESTS);
+		fillPoolOption(req, req->options.maxRequestQueueTime, "!~PASSENGER_MAX_REQUEST_QUEUE_TIME");
 	}
 }
 
@@ -196,12 +197,31 @@ Controller::fillPoolOptionsFromConfigCaches(Options &options,
 	options.minProcesses = requestConfig->defaultMinInstances;
 	options.maxPreloaderIdleTime = requestConfig->defaultMaxPreloaderIdleTime;
 	options.maxRequestQueueSize = requestConfig->defaultMaxRequestQueueSize;
+	options.requestQueueTargetDelay = requestConfig->defaultRequestQueueTargetDelay;
+	options.maxRequestQueueTime = requestConfig->defaultMaxRequestQueueTime;
+	options.memoryLimit = requestConfig->defaultMemoryLimit;
+	options.recycleLimitJitter = requestConfig->defaultRecycleLimitJitter;
+	options.maxConcurrentRecycles = requestConfig->defaultMaxConcurrentRecycles;
+	options.outlierEjectionErrors = requestConfig->defaultOutlierEjectionErrors;
+	options.outlierLatencyThreshold = requestConfig->defaultOutlierLatencyThreshold;
+	options.outlierEjectionTime = requestConfig->defaultOutlierEjectionTime;
+	options.outlierRestartThreshold = requestConfig->defaultOutlierRestartThreshold;
+	options.capacityWeight = requestConfig->defaultCapacityWeight;
+	options.guaranteedCapacity = requestConfig->defaultGuaranteedCapacity;
+	options.routingKey = requestConfig->defaultRoutingKey;
+	options.routingLoadFactor = requestConfig->defaultRoutingLoadFactor;
+	options.oobwMaxUtilization = requestConfig->defaultOobwMaxUtilization;
+	options.oobwInterval = requestConfig->defaultOobwInterval;
+	options.rollingRestart = requestConfig->defaultRollingRestarts;
+	options.warmupRequests = requestConfig->defaultWarmupRequests;
+	options.warmupRequestPath = requestConfig->defaultWarmupRequestPath;
 	options.abortWebsocketsOnProcessShutdown = requestConfig->defaultAbortWebsocketsOnProcessShutdown;
 	options.forceMaxConcurrentRequestsPerProcess = requestConfig->defaultForceMaxConcurrentRequestsPerProcess;
 	options.environment = requestConfig->defaultEnvironment;
 	options.spawnMethod = requestConfig->defaultSpawnMethod;
 	options.bindAddress = requestConfig->defaultBindAddress;
 	options.loadShellEnvvars = requestConfig->defaultLoadShellEnvvars;
+	options.pythonPreloading = requestConfig->defaultPythonPreloading;
 	options.statThrottleRate = mainConfig.statThrottleRate;
 	options.maxRequests = requestConfig->defaultMaxRequests;
 	options.stickySessionsCookieAttributes = requestConfig->defaultStickySessionsCookieAttributes;
@@ -373,11 +393,29 @@ Controller::createNewPoolOptions(Client *client, Request *req,
 	fillPoolOptionSecToMsec(req, options.startTimeout, "!~PASSENGER_START_TIMEOUT");
 	fillPoolOption(req, options.maxPreloaderIdleTime, "!~PASSENGER_MAX_PRELOADER_IDLE_TIME");
 	fillPoolOption(req, options.maxRequestQueueSize, "!~PASSENGER_MAX_REQUEST_QUEUE_SIZE");
+	fillPoolOption(req, options.requestQueueTargetDelay, "!~PASSENGER_REQUEST_QUEUE_TARGET_DELAY");
+	fillPoolOption(req, options.memoryLimit, "!~PASSENGER_MEMORY_LIMIT");
+	fillPoolOption(req, options.recycleLimitJitter, "!~PASSENGER_RECYCLE_LIMIT_JITTER");
+	fillPoolOption(req, options.maxConcurrentRecycles, "!~PASSENGER_MAX_CONCURRENT_RECYCLES");
+	fillPoolOption(req, options.outlierEjectionErrors, "!~PASSENGER_OUTLIER_EJECTION_ERRORS");
+	fillPoolOption(req, options.outlierLatencyThreshold, "!~PASSENGER_OUTLIER_LATENCY_THRESHOLD");
+	fillPoolOption(req, options.outlierEjectionTime, "!~PASSENGER_OUTLIER_EJECTION_TIME");
+	fillPoolOption(req, options.outlierRestartThreshold, "!~PASSENGER_OUTLIER_RESTART_THRESHOLD");
+	fillPoolOption(req, options.capacityWeight, "!~PASSENGER_CAPACITY_WEIGHT");
+	fillPoolOption(req, options.guaranteedCapacity, "!~PASSENGER_GUARANTEED_CAPACITY");
+	fillPoolOption(req, options.routingKey, "!~PASSENGER_ROUTING_KEY");
+	fillPoolOption(req, options.routingLoadFactor, "!~PASSENGER_ROUTING_LOAD_FACTOR");
+	fillPoolOption(req, options.oobwMaxUtilization, "!~PASSENGER_OOBW_MAX_UTILIZATION");
+	fillPoolOption(req, options.oobwInterval, "!~PASSENGER_OOBW_INTERVAL");
+	fillPoolOption(req, options.rollingRestart, "!~PASSENGER_ROLLING_RESTARTS");
+	fillPoolOption(req, options.warmupRequests, "!~PASSENGER_WARMUP_REQUESTS");
+	fillPoolOption(req, options.warmupRequestPath, "!~PASSENGER_WARMUP_REQUEST_PATH");
 	fillPoolOption(req, options.abortWebsocketsOnProcessShutdown, "!~PASSENGER_ABORT_WEBSOCKETS_ON_PROCESS_SHUTDOWN");
 	fillPoolOption(req, options.forceMaxConcurrentRequestsPerProcess, "!~PASSENGER_FORCE_MAX_CONCURRENT_REQUESTS_PER_PROCESS");
 	fillPoolOption(req, options.restartDir, "!~PASSENGER_RESTART_DIR");
 	fillPoolOption(req, options.startupFile, "!~PASSENGER_STARTUP_FILE");
 	fillPoolOption(req, options.loadShellEnvvars, "!~PASSENGER_LOAD_SHELL_ENVVARS");
+	fillPoolOption(req, options.pythonPreloading, "!~PASSENGER_PYTHON_PRELOADING");
 	fillPoolOption(req, options.fileDescriptorUlimit, "!~PASSENGER_APP_FILE_DESCRIPTOR_ULIMIT");
 	fillPoolOption(req, options.raiseInternalError, "!~PASSENGER_RAISE_INTERNAL_ERROR");
 	fillPoolOption(req, options.lveMinUid, "!~PASSENGER_LVE_MIN_UID");
@@ -420,6 +458,76 @@ Controller::setStickySessionId(Client *client, Request *req) {
 	}
 }
 
+/**
+ * Hashes the value of the configured routing key (see Options::routingKey)
+ * into `req->options.routingHash`, so that the pool can route requests with
+ * the same key to the same process. Requests without a value for the key
+ * are routed to the least busy process as usual.
+ */
+void
+Controller::setRoutingHash(Client *client, Request *req) {
+	StaticString routingKey = req->options.routingKey;
+	if (OXT_LIKELY(routingKey.empty()) || req->options.stickySessionId != 0) {
+		return;
+	}
+
+	string::size_type sep = routingKey.find(':');
+	if (sep == string::npos) {
+		return;
+	}
+	StaticString type = routingKey.substr(0, sep);
+	StaticString arg = routingKey.substr(sep + 1);
+	StaticString value;
+
+	if (type == P_STATIC_STRING("header")) {
+		char *name = (char *) psg_pnalloc(req->pool, arg.size());
+		convertLowerCase((const unsigned char *) arg.data(),
+			(unsigned char *) name, arg.size());
+		const LString *header = req->headers.lookup(
+			HashedStaticString(name, arg.size()));
+		if (header != NULL && header->size > 0) {
+			header = psg_lstr_make_contiguous(header, req->pool);
+			value = StaticString(header->start->data, header->size);
+		}
+	} else if (type == P_STATIC_STRING("cookie")) {
+		const LString *cookieHeader = req->headers.lookup(HTTP_COOKIE);
+		if (cookieHeader != NULL && cookieHeader->size > 0) {
+			vector< pair<StaticString, StaticString> > cookies;
+			pair<StaticString, StaticString> cookie;
+
+			parseCookieHeader(req->pool, cookieHeader, cookies);
+			foreach (cookie, cookies) {
+				if (cookie.first == arg) {
+					value = cookie.second;
+					break;
+				}
+			}
+		}
+	} else if (type == P_STATIC_STRING("path")) {
+		// Use the path up to (but not including) the slash that
+		// starts segment N+1.
+		StaticString path = req->getPathWithoutQueryString();
+		unsigned int segments = stringToUint(arg);
+		string::size_type end = 0;
+		while (segments > 0 && end < path.size()) {
+			end = path.find('/', end + 1);
+			if (end == string::npos) {
+				end = path.size();
+			}
+			segments--;
+		}
+		value = path.substr(0, end);
+	}
+
+	if (!value.empty()) {
+		Hasher hasher;
+		hasher.update(value.data(), value.size());
+		unsigned int hash = hasher.finalize();
+		req->options.routingHash = (hash == 0) ? 1 : hash;
+		SKC_TRACE(client, 3, "Routing hash: " << req->options.routingHash);
+	}
+}
+
 const LString *
 Controller::getStickySessionCookieName(Request *req) {
 	const LString *value = req->headers.lookup(PASSENGER_STICKY_SESSIONS_COOKIE_NAME);
@@ -476,6 +584,11 @@ Controller::onRequestBegin(Client *client, Request *req) {
 			return;
 		}
 		setStickySessionId(client, req);
+		setRoutingHash(client, req);
+	}
+
+	if (req->hasBody() && req->config->adaptiveRequestBodyBuffering) {
+		decideRequestBodyBuffering(client, req);
 	}
 
 	if (!req->hasBody() || !req->requestBodyBuffering) {
@@ -94,6 +94,9 @@ Controller::endRequestWithAppSocketIncompleteResponse(Client **client, Request *
 				" (likely because client half-closed)");
 		} else {
 			SKC_WARN(*client, "Sending 502 response: application did not send a complete response");
+			if ((*req)->session != NULL) {
+				(*req)->session->reportAppError();
+			}
 		}
 		endRequestWithSimpleResponse(client, req,
 			"<h2>Incomplete response received from application</h2>", 502);
@@ -105,6 +108,9 @@ Controller::endRequestWithAppSocketIncompleteResponse(Client **client, Request *
 void
 Controller::endRequestWithAppSocketReadError(Client **client, Request **req, int e) {
 	Client *c = *client;
+	if ((*req)->session != NULL) {
+		(*req)->session->reportAppError();
+	}
 	if (!(*req)->responseBegun) {
 		SKC_WARN(*client, "Sending 502 response: application socket read error");
 		endRequestWithSimpleResponse(client, req, "<h2>Application socket read error</h2>", 502);
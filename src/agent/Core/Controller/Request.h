@@ -27,6 +27,7 @@
 #define _PASSENGER_REQUEST_HANDLER_REQUEST_H_
 
 #include <ev++.h>
+#include <boost/atomic.hpp>
 #include <string>
 #include <cstring>
 
@@ -34,6 +35,7 @@
 #include <ServerKit/FdSinkChannel.h>
 #include <ServerKit/FdSourceChannel.h>
 #include <LoggingKit/LoggingKit.h>
+#include <Utils/SpeedMeter.h>
 #include <Core/ApplicationPool/Pool.h>
 #include <Core/Controller/Config.h>
 #include <Core/Controller/AppResponse.h>
@@ -78,8 +80,15 @@ public:
 	bool appResponseInitialized: 1;
 	bool strip100ContinueHeader: 1;
 	bool hasPragmaHeader: 1;
+	// Whether we're still measuring the client's upload speed in order to
+	// decide whether to keep buffering the body. See
+	// Controller::probeRequestBodyUploadSpeed().
+	bool probingBodyUploadSpeed: 1;
 
 	Options options;
+	// Set when the request ends while it's still waiting for a session, so
+	// that the pool drops it from the getWaitlist. See Options::cancelled.
+	boost::atomic<bool> sessionCheckoutCancelled;
 	AbstractSessionPtr session;
 	const LString *host;
 	ControllerRequestConfigPtr config;
@@ -90,6 +99,8 @@ public:
 
 	ServerKit::FileBufferedChannel bodyBuffer;
 	boost::uint64_t bodyBytesBuffered; // After dechunking
+	unsigned long long bodyUploadProbeStartTime;
+	SpeedMeter<double, 8, 25000, 10000000> bodyUploadSpeedMeter;
 
 	HashedStaticString cacheKey;
 	LString *cacheControl;
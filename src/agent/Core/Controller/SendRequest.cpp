@@ -62,10 +62,12 @@ struct Controller::SessionProtocolWorkingState {
 	const LString *contentLength;
 	char *environmentVariablesData;
 	size_t environmentVariablesSize;
+	unsigned int binaryHeaderVersion;
 	bool hasBaseURI;
 
 	SessionProtocolWorkingState()
-		: environmentVariablesData(NULL)
+		: environmentVariablesData(NULL),
+		  binaryHeaderVersion(0)
 		{ }
 
 	~SessionProtocolWorkingState() {
@@ -91,9 +93,13 @@ Controller::sendHeaderToApp(Client *client, Request *req) {
 
 	if (req->session->getProtocol() == "session") {
 		UPDATE_TRACE_POINT();
-		if (req->bodyType == Request::RBT_NO_BODY) {
-			// When there is no request body we will try to keep-alive the
-			// application connection, so half-close the application
+		if (req->bodyType == Request::RBT_NO_BODY
+		 || (req->bodyType == Request::RBT_CONTENT_LENGTH
+		     && req->session->hasFramedRequestBodies()))
+		{
+			// When there is no request body, or when the app reads the
+			// body up to CONTENT_LENGTH, we will try to keep-alive the
+			// application connection. So half-close the application
 			// connection upon encountering the next request's early error
 			// in order not to break the keep-alive.
 			req->halfClosePolicy = Request::HALF_CLOSE_UPON_NEXT_REQUEST_EARLY_READ_ERROR;
@@ -156,6 +162,11 @@ Controller::sendHeaderToAppWithSessionProtocol(Client *client, Request *req) {
 	TRACE_POINT();
 	SessionProtocolWorkingState state;
 
+	state.binaryHeaderVersion = req->session->getBinarySessionHeaderVersion();
+	if (state.binaryHeaderVersion > MAX_BINARY_SESSION_HEADER_VERSION) {
+		state.binaryHeaderVersion = MAX_BINARY_SESSION_HEADER_VERSION;
+	}
+
 	// Workaround for Ruby < 2.1 support.
 	std::string deltaMonotonic;
 	unsigned long long now = SystemTime::getUsec();
@@ -316,6 +327,216 @@ httpHeaderToScgiUpperCase(unsigned char *data, unsigned int size) {
 	}
 }
 
+/*
+ * Binary session protocol header encoding, used instead of the NUL-separated
+ * encoding for apps that advertise a `binary_session_header_version` on their
+ * socket. Version 1 looks like this:
+ *
+ *   uint32  size of the rest of the header, big endian
+ *   uint8   0 (a NUL-separated header never starts with a NUL byte)
+ *   uint8   encoding version
+ *   zero or more entries until the end of the header:
+ *     uint8   index into the key table below, or 0xFF for a literal key
+ *     uint16  key size, big endian (literal keys only)
+ *     ...     key data (literal keys only)
+ *     uint32  value size, big endian
+ *     ...     value data
+ *
+ * The key table is also defined in passenger_native_support.c,
+ * utils/native_support_utils.rb and wsgi-loader.py. Changing it requires
+ * a new encoding version.
+ */
+enum SessionHeaderKey {
+	SHK_REQUEST_URI,
+	SHK_PATH_INFO,
+	SHK_SCRIPT_NAME,
+	SHK_QUERY_STRING,
+	SHK_REQUEST_METHOD,
+	SHK_SERVER_NAME,
+	SHK_SERVER_PORT,
+	SHK_SERVER_SOFTWARE,
+	SHK_SERVER_PROTOCOL,
+	SHK_REMOTE_ADDR,
+	SHK_REMOTE_PORT,
+	SHK_REMOTE_USER,
+	SHK_CONTENT_TYPE,
+	SHK_CONTENT_LENGTH,
+	SHK_PASSENGER_CONNECT_PASSWORD,
+	SHK_HTTPS,
+	SHK_HTTP_CONNECTION,
+	SHK_HTTP_HOST,
+	SHK_HTTP_USER_AGENT,
+	SHK_HTTP_ACCEPT,
+	SHK_HTTP_ACCEPT_ENCODING,
+	SHK_HTTP_ACCEPT_LANGUAGE,
+	SHK_HTTP_COOKIE,
+	SHK_HTTP_REFERER,
+	SHK_HTTP_CACHE_CONTROL,
+	SHK_HTTP_IF_MODIFIED_SINCE,
+	SHK_HTTP_IF_NONE_MATCH,
+	SHK_HTTP_AUTHORIZATION,
+	SHK_HTTP_ORIGIN,
+	SHK_HTTP_X_FORWARDED_FOR,
+	SHK_HTTP_X_FORWARDED_PROTO,
+	SHK_HTTP_X_REQUESTED_WITH,
+	SHK_HTTP_UPGRADE,
+
+	SHK_LITERAL = 0xFF
+};
+
+struct InternedHttpHeader {
+	HashedStaticString name;
+	SessionHeaderKey key;
+};
+
+static const InternedHttpHeader internedHttpHeaders[] = {
+	{ "host", SHK_HTTP_HOST },
+	{ "user-agent", SHK_HTTP_USER_AGENT },
+	{ "accept", SHK_HTTP_ACCEPT },
+	{ "accept-encoding", SHK_HTTP_ACCEPT_ENCODING },
+	{ "accept-language", SHK_HTTP_ACCEPT_LANGUAGE },
+	{ "cookie", SHK_HTTP_COOKIE },
+	{ "referer", SHK_HTTP_REFERER },
+	{ "cache-control", SHK_HTTP_CACHE_CONTROL },
+	{ "if-modified-since", SHK_HTTP_IF_MODIFIED_SINCE },
+	{ "if-none-match", SHK_HTTP_IF_NONE_MATCH },
+	{ "authorization", SHK_HTTP_AUTHORIZATION },
+	{ "origin", SHK_HTTP_ORIGIN },
+	{ "x-forwarded-for", SHK_HTTP_X_FORWARDED_FOR },
+	{ "x-forwarded-proto", SHK_HTTP_X_FORWARDED_PROTO },
+	{ "x-requested-with", SHK_HTTP_X_REQUESTED_WITH },
+	{ "upgrade", SHK_HTTP_UPGRADE }
+};
+
+static SessionHeaderKey
+lookupInternedHttpHeader(const ServerKit::Header *header) {
+	const unsigned int count = sizeof(internedHttpHeaders) / sizeof(InternedHttpHeader);
+	for (unsigned int i = 0; i < count; i++) {
+		if (header->hash == internedHttpHeaders[i].name.hash()
+		 && psg_lstr_cmp(&header->key, internedHttpHeaders[i].name))
+		{
+			return internedHttpHeaders[i].key;
+		}
+	}
+	return SHK_LITERAL;
+}
+
+/**
+ * Appends a key that is in the binary encoding's key table. In the
+ * NUL-separated encoding, `name` is appended instead.
+ */
+static char *
+appendSessionHeaderKey(char *pos, const char *end, bool binary, SessionHeaderKey key,
+	const StaticString &name)
+{
+	if (binary) {
+		const char ch = (char) key;
+		return appendData(pos, end, &ch, 1);
+	} else {
+		pos = appendData(pos, end, name);
+		return appendData(pos, end, "", 1);
+	}
+}
+
+/**
+ * Literal keys in the binary encoding have a 16-bit size. Returns whether
+ * all keys of the NUL-separated key-value pairs in `data` fit.
+ */
+static bool
+sessionHeaderPairKeysFitBinaryEncoding(const char *data, size_t size) {
+	const char *dataEnd = data + size;
+
+	while (data < dataEnd) {
+		const char *keyEnd = (const char *) memchr(data, '\0', dataEnd - data);
+		if (keyEnd == NULL) {
+			break;
+		}
+		if (size_t(keyEnd - data) > 0xFFFF) {
+			return false;
+		}
+		const char *valueEnd = (const char *) memchr(keyEnd + 1, '\0',
+			dataEnd - keyEnd - 1);
+		if (valueEnd == NULL) {
+			break;
+		}
+		data = valueEnd + 1;
+	}
+
+	return true;
+}
+
+static char *
+appendSessionHeaderLiteralKeyPrefix(char *pos, const char *end, size_t keySize) {
+	assert(keySize <= 0xFFFF);
+	char buf[1 + sizeof(boost::uint16_t)];
+	buf[0] = (char) SHK_LITERAL;
+	Uint16Message::generate(buf + 1, keySize);
+	return appendData(pos, end, buf, sizeof(buf));
+}
+
+static char *
+appendSessionHeaderValuePrefix(char *pos, const char *end, bool binary, size_t valueSize) {
+	if (binary) {
+		char buf[sizeof(boost::uint32_t)];
+		Uint32Message::generate(buf, valueSize);
+		return appendData(pos, end, buf, sizeof(buf));
+	} else {
+		return pos;
+	}
+}
+
+static char *
+appendSessionHeaderValueSuffix(char *pos, const char *end, bool binary) {
+	if (binary) {
+		return pos;
+	} else {
+		return appendData(pos, end, "", 1);
+	}
+}
+
+static char *
+appendSessionHeaderValue(char *pos, const char *end, bool binary, const StaticString &value) {
+	pos = appendSessionHeaderValuePrefix(pos, end, binary, value.size());
+	pos = appendData(pos, end, value);
+	return appendSessionHeaderValueSuffix(pos, end, binary);
+}
+
+static char *
+appendSessionHeaderValue(char *pos, const char *end, bool binary, const LString *value) {
+	pos = appendSessionHeaderValuePrefix(pos, end, binary, value->size);
+	pos = appendData(pos, end, value);
+	return appendSessionHeaderValueSuffix(pos, end, binary);
+}
+
+/**
+ * Converts the NUL-separated key-value pairs in `data` to literal
+ * binary header entries.
+ */
+static char *
+appendBinarySessionHeaderPairs(char *pos, const char *end, const char *data, size_t size) {
+	const char *dataEnd = data + size;
+
+	while (data < dataEnd) {
+		const char *keyEnd = (const char *) memchr(data, '\0', dataEnd - data);
+		if (keyEnd == NULL) {
+			break;
+		}
+		const char *valueEnd = (const char *) memchr(keyEnd + 1, '\0',
+			dataEnd - keyEnd - 1);
+		if (valueEnd == NULL) {
+			break;
+		}
+
+		pos = appendSessionHeaderLiteralKeyPrefix(pos, end, keyEnd - data);
+		pos = appendData(pos, end, data, keyEnd - data);
+		pos = appendSessionHeaderValue(pos, end, true,
+			StaticString(keyEnd + 1, valueEnd - keyEnd - 1));
+		data = valueEnd + 1;
+	}
+
+	return pos;
+}
+
 unsigned int
 Controller::determineMaxHeaderSizeForSessionProtocol(Request *req,
 	SessionProtocolWorkingState &state, string delta_monotonic)
@@ -455,11 +676,35 @@ Controller::determineMaxHeaderSizeForSessionProtocol(Request *req,
 	while (*it != NULL) {
 		dataSize += sizeof("HTTP_") - 1 + it->header->key.size + 1;
 		dataSize += it->header->val.size + 1;
+		if (sizeof("HTTP_") - 1 + it->header->key.size > 0xFFFF) {
+			// Too long for a literal key in the binary encoding. The
+			// encoding is chosen per request, so send this one with
+			// the NUL-separated encoding.
+			state.binaryHeaderVersion = 0;
+		}
 		it.next();
 	}
 
 	if (state.environmentVariablesData != NULL) {
 		dataSize += state.environmentVariablesSize;
+		if (state.binaryHeaderVersion > 0
+		 && !sessionHeaderPairKeysFitBinaryEncoding(state.environmentVariablesData,
+			state.environmentVariablesSize))
+		{
+			state.binaryHeaderVersion = 0;
+		}
+	}
+
+	if (state.binaryHeaderVersion > 0) {
+		// Marker and version bytes. Entries for interned keys are never
+		// larger than in the NUL-separated encoding, but literal keys need
+		// 5 more bytes: a key marker and key size instead of a NUL
+		// terminator, and a 4-byte value size instead of a NUL terminator.
+		size_t literalEntries = req->headers.size();
+		if (state.environmentVariablesData != NULL) {
+			literalEntries += state.environmentVariablesSize / 2 + 1;
+		}
+		dataSize += 2 + 5 * literalEntries;
 	}
 
 	return dataSize + 1;
@@ -471,94 +716,104 @@ Controller::constructHeaderForSessionProtocol(Request *req, char * restrict buff
 {
 	char *pos = buffer;
 	const char *end = buffer + size;
+	const bool binary = state.binaryHeaderVersion > 0;
 
 	pos += sizeof(boost::uint32_t);
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("REQUEST_URI"));
-	pos = appendData(pos, end, req->path.start->data, req->path.size);
-	pos = appendData(pos, end, "", 1);
+	if (binary) {
+		const char header[2] = { '\0', (char) state.binaryHeaderVersion };
+		pos = appendData(pos, end, header, sizeof(header));
+	}
+
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_REQUEST_URI,
+		P_STATIC_STRING("REQUEST_URI"));
+	pos = appendSessionHeaderValue(pos, end, binary, &req->path);
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("PATH_INFO"));
-	pos = appendData(pos, end, state.path.data(), state.path.size());
-	pos = appendData(pos, end, "", 1);
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_PATH_INFO,
+		P_STATIC_STRING("PATH_INFO"));
+	pos = appendSessionHeaderValue(pos, end, binary, state.path);
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("SCRIPT_NAME"));
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_SCRIPT_NAME,
+		P_STATIC_STRING("SCRIPT_NAME"));
 	if (state.hasBaseURI) {
-		pos = appendData(pos, end, req->options.baseURI);
-		pos = appendData(pos, end, "", 1);
+		pos = appendSessionHeaderValue(pos, end, binary, req->options.baseURI);
 	} else {
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL(""));
+		pos = appendSessionHeaderValue(pos, end, binary, P_STATIC_STRING(""));
 	}
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("QUERY_STRING"));
-	pos = appendData(pos, end, state.queryString.data(), state.queryString.size());
-	pos = appendData(pos, end, "", 1);
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_QUERY_STRING,
+		P_STATIC_STRING("QUERY_STRING"));
+	pos = appendSessionHeaderValue(pos, end, binary, state.queryString);
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("REQUEST_METHOD"));
-	pos = appendData(pos, end, state.methodStr);
-	pos = appendData(pos, end, "", 1);
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_REQUEST_METHOD,
+		P_STATIC_STRING("REQUEST_METHOD"));
+	pos = appendSessionHeaderValue(pos, end, binary, state.methodStr);
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("SERVER_NAME"));
-	pos = appendData(pos, end, state.serverName);
-	pos = appendData(pos, end, "", 1);
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_SERVER_NAME,
+		P_STATIC_STRING("SERVER_NAME"));
+	pos = appendSessionHeaderValue(pos, end, binary, state.serverName);
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("SERVER_PORT"));
-	pos = appendData(pos, end, state.serverPort);
-	pos = appendData(pos, end, "", 1);
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_SERVER_PORT,
+		P_STATIC_STRING("SERVER_PORT"));
+	pos = appendSessionHeaderValue(pos, end, binary, state.serverPort);
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("SERVER_SOFTWARE"));
-	pos = appendData(pos, end, req->config->serverSoftware);
-	pos = appendData(pos, end, "", 1);
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_SERVER_SOFTWARE,
+		P_STATIC_STRING("SERVER_SOFTWARE"));
+	pos = appendSessionHeaderValue(pos, end, binary, req->config->serverSoftware);
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("SERVER_PROTOCOL"));
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("HTTP/1.1"));
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_SERVER_PROTOCOL,
+		P_STATIC_STRING("SERVER_PROTOCOL"));
+	pos = appendSessionHeaderValue(pos, end, binary, P_STATIC_STRING("HTTP/1.1"));
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("REMOTE_ADDR"));
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_REMOTE_ADDR,
+		P_STATIC_STRING("REMOTE_ADDR"));
 	if (state.remoteAddr != NULL) {
-		pos = appendData(pos, end, state.remoteAddr);
-		pos = appendData(pos, end, "", 1);
+		pos = appendSessionHeaderValue(pos, end, binary, state.remoteAddr);
 	} else {
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("127.0.0.1"));
+		pos = appendSessionHeaderValue(pos, end, binary, P_STATIC_STRING("127.0.0.1"));
 	}
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("REMOTE_PORT"));
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_REMOTE_PORT,
+		P_STATIC_STRING("REMOTE_PORT"));
 	if (state.remotePort != NULL) {
-		pos = appendData(pos, end, state.remotePort);
-		pos = appendData(pos, end, "", 1);
+		pos = appendSessionHeaderValue(pos, end, binary, state.remotePort);
 	} else {
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("0"));
+		pos = appendSessionHeaderValue(pos, end, binary, P_STATIC_STRING("0"));
 	}
 
 	if (state.remoteUser != NULL) {
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("REMOTE_USER"));
-		pos = appendData(pos, end, state.remoteUser);
-		pos = appendData(pos, end, "", 1);
+		pos = appendSessionHeaderKey(pos, end, binary, SHK_REMOTE_USER,
+			P_STATIC_STRING("REMOTE_USER"));
+		pos = appendSessionHeaderValue(pos, end, binary, state.remoteUser);
 	}
 
 	if (state.contentType != NULL) {
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("CONTENT_TYPE"));
-		pos = appendData(pos, end, state.contentType);
-		pos = appendData(pos, end, "", 1);
+		pos = appendSessionHeaderKey(pos, end, binary, SHK_CONTENT_TYPE,
+			P_STATIC_STRING("CONTENT_TYPE"));
+		pos = appendSessionHeaderValue(pos, end, binary, state.contentType);
 	}
 
 	if (state.contentLength != NULL) {
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("CONTENT_LENGTH"));
-		pos = appendData(pos, end, state.contentLength);
-		pos = appendData(pos, end, "", 1);
+		pos = appendSessionHeaderKey(pos, end, binary, SHK_CONTENT_LENGTH,
+			P_STATIC_STRING("CONTENT_LENGTH"));
+		pos = appendSessionHeaderValue(pos, end, binary, state.contentLength);
 	}
 
-	pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("PASSENGER_CONNECT_PASSWORD"));
-	pos = appendData(pos, end, req->session->getApiKey().toStaticString());
-	pos = appendData(pos, end, "", 1);
+	pos = appendSessionHeaderKey(pos, end, binary, SHK_PASSENGER_CONNECT_PASSWORD,
+		P_STATIC_STRING("PASSENGER_CONNECT_PASSWORD"));
+	pos = appendSessionHeaderValue(pos, end, binary,
+		req->session->getApiKey().toStaticString());
 
 	if (req->https) {
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("HTTPS"));
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("on"));
+		pos = appendSessionHeaderKey(pos, end, binary, SHK_HTTPS,
+			P_STATIC_STRING("HTTPS"));
+		pos = appendSessionHeaderValue(pos, end, binary, P_STATIC_STRING("on"));
 	}
 
 	if (req->upgraded()) {
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("HTTP_CONNECTION"));
-		pos = appendData(pos, end, P_STATIC_STRING_WITH_NULL("upgrade"));
+		pos = appendSessionHeaderKey(pos, end, binary, SHK_HTTP_CONNECTION,
+			P_STATIC_STRING("HTTP_CONNECTION"));
+		pos = appendSessionHeaderValue(pos, end, binary, P_STATIC_STRING("upgrade"));
 	}
 
 	ServerKit::HeaderTable::Iterator it(req->headers);
@@ -580,28 +835,41 @@ Controller::constructHeaderForSessionProtocol(Request *req, char * restrict buff
 			continue;
 		}
 
-		pos = appendData(pos, end, P_STATIC_STRING("HTTP_"));
-		const LString::Part *part = it->header->key.start;
-		while (part != NULL) {
-			char *start = pos;
-			pos = appendData(pos, end, part->data, part->size);
-			httpHeaderToScgiUpperCase((unsigned char *) start, pos - start);
-			part = part->next;
+		SessionHeaderKey key = binary
+			? lookupInternedHttpHeader(it->header)
+			: SHK_LITERAL;
+		if (key != SHK_LITERAL) {
+			pos = appendSessionHeaderKey(pos, end, binary, key, StaticString());
+		} else {
+			if (binary) {
+				pos = appendSessionHeaderLiteralKeyPrefix(pos, end,
+					sizeof("HTTP_") - 1 + it->header->key.size);
+			}
+			pos = appendData(pos, end, P_STATIC_STRING("HTTP_"));
+			const LString::Part *part = it->header->key.start;
+			while (part != NULL) {
+				char *start = pos;
+				pos = appendData(pos, end, part->data, part->size);
+				httpHeaderToScgiUpperCase((unsigned char *) start, pos - start);
+				part = part->next;
+			}
+			if (!binary) {
+				pos = appendData(pos, end, "", 1);
+			}
 		}
-		pos = appendData(pos, end, "", 1);
 
-		part = it->header->val.start;
-		while (part != NULL) {
-			pos = appendData(pos, end, part->data, part->size);
-			part = part->next;
-		}
-		pos = appendData(pos, end, "", 1);
+		pos = appendSessionHeaderValue(pos, end, binary, &it->header->val);
 
 		it.next();
 	}
 
 	if (state.environmentVariablesData != NULL) {
-		pos = appendData(pos, end, state.environmentVariablesData, state.environmentVariablesSize);
+		if (binary) {
+			pos = appendBinarySessionHeaderPairs(pos, end, state.environmentVariablesData,
+				state.environmentVariablesSize);
+		} else {
+			pos = appendData(pos, end, state.environmentVariablesData, state.environmentVariablesSize);
+		}
 	}
 
 	Uint32Message::generate(buffer, pos - buffer - sizeof(boost::uint32_t));
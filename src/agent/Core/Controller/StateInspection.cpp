@@ -64,6 +64,13 @@ Controller::inspectStateAsJson() const {
 		subdoc["store_success_ratio"] = turboCaching.responseCache.getStoreSuccessRatio();
 		doc["turbocaching"] = subdoc;
 	}
+	if (requestConfig->adaptiveRequestBodyBuffering) {
+		Json::Value subdoc;
+		subdoc["small_bodies_buffered"] = (Json::UInt64) smallRequestBodiesBuffered;
+		subdoc["fast_bodies_streamed"] = (Json::UInt64) fastRequestBodiesStreamed;
+		subdoc["slow_bodies_buffered"] = (Json::UInt64) slowRequestBodiesBuffered;
+		doc["adaptive_request_body_buffering"] = subdoc;
+	}
 	return doc;
 }
 
@@ -88,6 +95,9 @@ Controller::inspectRequestStateAsJson(const Request *req) const {
 		doc["sticky_session_id"] = req->options.stickySessionId;
 	}
 	doc["sticky_session"] = req->stickySession;
+	if (req->options.routingHash != 0) {
+		doc["routing_hash"] = req->options.routingHash;
+	}
 	doc["session_checkout_try"] = req->sessionCheckoutTry;
 
 	flags["dechunk_response"] = req->dechunkResponse;
@@ -97,6 +107,11 @@ Controller::inspectRequestStateAsJson(const Request *req) const {
 
 	if (req->requestBodyBuffering) {
 		doc["body_bytes_buffered"] = byteSizeToJson(req->bodyBytesBuffered);
+		if (req->probingBodyUploadSpeed) {
+			doc["body_upload_speed"] = byteSpeedToJson(
+				req->bodyUploadSpeedMeter.currentSpeed(),
+				req->bodyUploadSpeedMeter.unknownSpeed(), "second");
+		}
 	}
 
 	if (req->session != NULL) {
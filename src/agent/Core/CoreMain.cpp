@@ -91,6 +91,7 @@
 #include <Exceptions.h>
 #include <Utils.h>
 #include <Utils/Timer.h>
+#include <SystemTools/CpuTopology.h>
 #include <IOTools/MessageIO.h>
 #include <Core/OptionParser.h>
 #include <Core/Controller.h>
@@ -719,6 +720,8 @@ initializeNonPrivilegedWorkingObjects() {
 		wo->spawningKitContext->instanceDir = absolutizePath(
 			wo->spawningKitContext->instanceDir);
 	}
+	wo->spawningKitContext->shellEnvvarsCache.setTtl(
+		coreConfig->get("shell_envvars_cache_ttl").asUInt());
 	wo->spawningKitContext->finalize();
 
 	UPDATE_TRACE_POINT();
@@ -731,6 +734,8 @@ initializeNonPrivilegedWorkingObjects() {
 	wo->appPool->initialize();
 	wo->appPool->setMax(coreConfig->get("max_pool_size").asInt());
 	wo->appPool->setMaxIdleTime(coreConfig->get("pool_idle_time").asInt() * 1000000ULL);
+	wo->appPool->setWarmSpares(coreConfig->get("pool_warm_spares").asUInt());
+	wo->appPool->setSpawnBatchSize(coreConfig->get("pool_spawn_batch_size").asUInt());
 	wo->appPool->enableSelfChecking(coreConfig->get("pool_selfchecks").asBool());
 	wo->appPool->abortLongRunningConnectionsCallback = abortLongRunningConnections;
 
@@ -1092,34 +1097,92 @@ uninstallAbortHandlerCustomDiagnostics() {
 	Agent::Fundamentals::abortHandlerConfigChanged();
 }
 
+#ifdef SUPPORTS_PER_THREAD_CPU_AFFINITY
+	/**
+	 * Returns the CPUs that controller threads may be pinned to: the CPUs
+	 * that we are allowed to run on, minus the ones that the administrator
+	 * reserved for application processes. The result is ordered so that
+	 * consecutive threads land on different NUMA nodes.
+	 */
+	static vector<unsigned int>
+	getControllerThreadCpus() {
+		cpu_set_t allowed;
+		vector<unsigned int> excluded, result;
+
+		CPU_ZERO(&allowed);
+		if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+			int e = errno;
+			P_WARN("Cannot query CPU affinity: " << strerror(e) << " (errno=" << e << ")");
+			return result;
+		}
+
+		parseCpuList(coreConfig->get("controller_cpu_affine_excluded_cpus").asString(),
+			excluded);
+		for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &allowed)
+			 && std::find(excluded.begin(), excluded.end(), cpu) == excluded.end())
+			{
+				result.push_back(cpu);
+			}
+		}
+
+		return interleaveCpusByNumaNode(result, getCpuToNumaNodeMap());
+	}
+
+	/**
+	 * Runs inside the controller thread's event loop. Pins the thread to
+	 * the given CPU, then recreates the thread's spare mbuf blocks and client
+	 * objects from within this thread. Linux places pages on the NUMA node of
+	 * the CPU that first touches them, so this makes the freelists local to
+	 * the node that the thread runs on.
+	 */
+	static void
+	pinControllerThread(ThreadWorkingObjects *two, unsigned int threadNumber,
+		unsigned int cpu)
+	{
+		cpu_set_t cpus;
+		int result;
+
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		P_DEBUG("Setting CPU affinity of core thread " << threadNumber
+			<< " to CPU " << cpu);
+		result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (result != 0) {
+			P_WARN("Cannot set CPU affinity on core thread " << threadNumber
+				<< ": " << strerror(result) << " (errno=" << result << ")");
+			return;
+		}
+
+		two->serverKitContext->compactMbufPools();
+		two->controller->compact(LoggingKit::DEBUG);
+		two->controller->createSpareClients();
+	}
+#endif
+
 static void
 mainLoop() {
 	TRACE_POINT();
 	WorkingObjects *wo = workingObjects;
 	#ifdef SUPPORTS_PER_THREAD_CPU_AFFINITY
-		unsigned int maxCpus = boost::thread::hardware_concurrency();
-		bool cpuAffine = coreConfig->get("controller_cpu_affine").asBool()
-			&& maxCpus <= CPU_SETSIZE;
+		vector<unsigned int> cpus;
+		if (coreConfig->get("controller_cpu_affine").asBool()) {
+			cpus = getControllerThreadCpus();
+			if (cpus.empty()) {
+				P_WARN("No CPUs available for controller threads after excluding '"
+					<< coreConfig->get("controller_cpu_affine_excluded_cpus").asString()
+					<< "'; not setting CPU affinity");
+			}
+		}
 	#endif
 
 	for (unsigned int i = 0; i < wo->threadWorkingObjects.size(); i++) {
 		ThreadWorkingObjects *two = &wo->threadWorkingObjects[i];
 		two->bgloop->start("Main event loop: thread " + toString(i + 1), 0);
 		#ifdef SUPPORTS_PER_THREAD_CPU_AFFINITY
-			if (cpuAffine) {
-				cpu_set_t cpus;
-				int result;
-
-				CPU_ZERO(&cpus);
-				CPU_SET(i % maxCpus, &cpus);
-				P_DEBUG("Setting CPU affinity of core thread " << (i + 1)
-					<< " to CPU " << (i % maxCpus + 1));
-				result = pthread_setaffinity_np(two->bgloop->getNativeHandle(),
-					maxCpus, &cpus);
-				if (result != 0) {
-					P_WARN("Cannot set CPU affinity on core thread " << (i + 1)
-						<< ": " << strerror(result) << " (errno=" << result << ")");
-				}
+			if (!cpus.empty()) {
+				two->bgloop->safe->runSync(boost::bind(pinControllerThread,
+					two, i + 1, cpus[i % cpus.size()]));
 			}
 		#endif
 	}
@@ -115,6 +115,7 @@ coreUsage() {
 	printf("      --spawn-method NAME   Spawn method to use. Can either be 'smart' or\n");
 	printf("                            'direct'. Default: %s\n", DEFAULT_SPAWN_METHOD);
 	printf("      --load-shell-envvars  Load shell startup files before loading application\n");
+	printf("      --python-preloading   Preload Python apps when the spawn method is 'smart'\n");
 	printf("      --concurrency-model   The concurrency model to use for the app, either\n");
 	printf("                            'process' or 'thread' (Enterprise only).\n");
 	printf("                            Default: " DEFAULT_CONCURRENCY_MODEL "\n");
@@ -139,7 +140,11 @@ coreUsage() {
 	printf("                            Set custom file descriptor ulimit for the app\n");
 	printf("      --debugger            Enable Ruby debugger support (Enterprise only)\n");
 	printf("\n");
-	printf("      --rolling-restarts    Enable rolling restarts (Enterprise only)\n");
+	printf("      --rolling-restarts    Replace processes one by one when restarting\n");
+	printf("      --warmup-requests N   Number of warm-up requests to send to each new\n");
+	printf("                            process during a rolling restart. Default: 0\n");
+	printf("      --warmup-request-path PATH\n");
+	printf("                            Path to send warm-up requests to. Default: /\n");
 	printf("      --resist-deployment-errors\n");
 	printf("                            Enable deployment error resistance (Enterprise only)\n");
 	printf("\n");
@@ -149,6 +154,20 @@ coreUsage() {
 	printf("      --pool-idle-time SECS\n");
 	printf("                            Maximum number of seconds an application process\n");
 	printf("                            may be idle. Default: %d\n", DEFAULT_POOL_IDLE_TIME);
+	printf("      --pool-warm-spares N  Keep the N most recently used applications warm:\n");
+	printf("                            they keep one process and their preloader when\n");
+	printf("                            idle, so that they don't have to be spawned\n");
+	printf("                            from scratch on the next request. Default: 0\n");
+	printf("      --shell-envvars-cache-ttl SECS\n");
+	printf("                            How long the environment variables loaded by\n");
+	printf("                            the OS shell (see load_shell_envvars) may be\n");
+	printf("                            reused for later spawns, as long as the shell's\n");
+	printf("                            startup files don't change. 0 disables the\n");
+	printf("                            cache. Default: 0\n");
+	printf("      --pool-spawn-batch-size N\n");
+	printf("                            Maximum number of processes that an application\n");
+	printf("                            may spawn at once through its preloader, when it\n");
+	printf("                            needs several (e.g. after a restart). Default: 4\n");
 	printf("      --max-preloader-idle-time SECS\n");
 	printf("                            Maximum time that preloader processes may be\n");
 	printf("                            be idle. A value of 0 means that preloader\n");
@@ -158,8 +177,6 @@ coreUsage() {
 	printf("                            process can handle the given number of concurrent\n");
 	printf("                            requests per process\n");
 	printf("      --min-instances N     Minimum number of application processes. Default: 1\n");
-	printf("      --memory-limit MB     Restart application processes that go over the\n");
-	printf("                            given memory limit (Enterprise only)\n");
 	printf("\n");
 	printf("Request handling options (optional):\n");
 	printf("      --max-requests        Restart application processes that have handled\n");
@@ -169,6 +186,64 @@ coreUsage() {
 	printf("      --max-request-queue-size NUMBER\n");
 	printf("                            Specify request queue size. Default: %d\n",
 		DEFAULT_MAX_REQUEST_QUEUE_SIZE);
+	printf("      --request-queue-target-delay MSEC\n");
+	printf("                            Shed requests that waited too long in the queue\n");
+	printf("                            once the queueing delay stays above this target.\n");
+	printf("                            Default: 0 (disabled)\n");
+	printf("      --max-request-queue-time MSEC\n");
+	printf("                            Drop requests that waited in the queue for longer\n");
+	printf("                            than this. Default: 0 (unlimited)\n");
+	printf("      --memory-limit MB     Gracefully replace application processes whose\n");
+	printf("                            private memory usage exceeds this limit.\n");
+	printf("                            Default: 0 (unlimited)\n");
+	printf("      --recycle-limit-jitter PERCENT\n");
+	printf("                            Lower the max requests and memory limits of\n");
+	printf("                            each process by a random amount of up to\n");
+	printf("                            PERCENT, so that processes aren't all replaced\n");
+	printf("                            at the same time. Default: 0\n");
+	printf("      --max-concurrent-recycles N\n");
+	printf("                            Keep processes that reached the max requests\n");
+	printf("                            limit running until a replacement is spawned,\n");
+	printf("                            replacing at most N at a time. Default: 0\n");
+	printf("                            (detach such processes immediately)\n");
+	printf("      --outlier-ejection-errors N\n");
+	printf("                            Temporarily stop routing requests to a process\n");
+	printf("                            after N consecutive failed requests.\n");
+	printf("                            Default: 0 (disabled)\n");
+	printf("      --outlier-latency-threshold MSEC\n");
+	printf("                            Count requests that take longer than this to\n");
+	printf("                            begin responding as failed. Default: 0 (no\n");
+	printf("                            threshold)\n");
+	printf("      --outlier-ejection-time SECONDS\n");
+	printf("                            How long an outlier process is ejected for.\n");
+	printf("                            Default: 30\n");
+	printf("      --outlier-restart-threshold N\n");
+	printf("                            Replace a process after it has been ejected N\n");
+	printf("                            times in a row. Default: 0 (never)\n");
+	printf("      --capacity-weight N   This app's share of the pool's capacity,\n");
+	printf("                            relative to other apps. Default: 1\n");
+	printf("      --guaranteed-capacity N\n");
+	printf("                            Number of processes that this app keeps even\n");
+	printf("                            when other apps need capacity. Default: 0\n");
+	printf("      --routing-key KEY     Route requests with the same KEY to the same\n");
+	printf("                            process where possible. KEY is one of\n");
+	printf("                            header:NAME, cookie:NAME or path:SEGMENTS.\n");
+	printf("                            Default: route to the least busy process\n");
+	printf("      --routing-load-factor PERCENT\n");
+	printf("                            Maximum load of a process chosen by\n");
+	printf("                            --routing-key, relative to the average.\n");
+	printf("                            Default: 125\n");
+	printf("      --oobw-max-utilization PERCENT\n");
+	printf("                            Defer out-of-band work while more than this\n");
+	printf("                            percentage of an app's processes are busy.\n");
+	printf("                            It is always deferred while requests are\n");
+	printf("                            queued. Default: 0 (no limit)\n");
+	printf("      --oobw-interval SECONDS\n");
+	printf("                            Perform out-of-band work on idle processes\n");
+	printf("                            at this interval. Default: 0 (disabled)\n");
+	printf("      --adaptive-request-body-buffering\n");
+	printf("                            Decide whether to buffer request bodies based on\n");
+	printf("                            their size and the client's upload speed\n");
 	printf("      --sticky-sessions     Enable sticky sessions\n");
 	printf("      --sticky-sessions-cookie-name NAME\n");
 	printf("                            Cookie name to use for sticky sessions.\n");
@@ -209,6 +284,9 @@ coreUsage() {
 	printf("                            Default: number of CPU cores (%d)\n",
 		boost::thread::hardware_concurrency());
 	printf("      --cpu-affine          Enable per-thread CPU affinity (Linux only)\n");
+	printf("      --cpu-affine-exclude CPULIST\n");
+	printf("                            Do not pin threads to these CPUs, e.g. to reserve\n");
+	printf("                            them for app processes. Example: 0-1,8\n");
 	printf("      --core-file-descriptor-ulimit NUMBER\n");
 	printf("                            Set custom file descriptor ulimit for the core\n");
 	printf("      --admin-panel-url URL\n");
@@ -305,6 +383,15 @@ parseCoreOption(int argc, const char *argv[], int &i, Json::Value &updates) {
 	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--pool-idle-time")) {
 		updates["pool_idle_time"] = atoi(argv[i + 1]);
 		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--pool-spawn-batch-size")) {
+		updates["pool_spawn_batch_size"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--pool-warm-spares")) {
+		updates["pool_warm_spares"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--shell-envvars-cache-ttl")) {
+		updates["shell_envvars_cache_ttl"] = atoi(argv[i + 1]);
+		i += 2;
 	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--max-preloader-idle-time")) {
 		updates["default_max_preloader_idle_time"] = atoi(argv[i + 1]);
 		i += 2;
@@ -332,6 +419,9 @@ parseCoreOption(int argc, const char *argv[], int &i, Json::Value &updates) {
 	} else if (p.isFlag(argv[i], '\0', "--load-shell-envvars")) {
 		updates["default_load_shell_envvars"] = true;
 		i++;
+	} else if (p.isFlag(argv[i], '\0', "--python-preloading")) {
+		updates["default_python_preloading"] = true;
+		i++;
 	} else if (p.isFlag(argv[i], '\0', "--multi-app")) {
 		updates["multi_app"] = true;
 		i++;
@@ -347,6 +437,63 @@ parseCoreOption(int argc, const char *argv[], int &i, Json::Value &updates) {
 	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--max-request-queue-size")) {
 		updates["default_max_request_queue_size"] = atoi(argv[i + 1]);
 		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--request-queue-target-delay")) {
+		updates["default_request_queue_target_delay"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--max-request-queue-time")) {
+		updates["default_max_request_queue_time"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--memory-limit")) {
+		updates["default_memory_limit"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--recycle-limit-jitter")) {
+		updates["default_recycle_limit_jitter"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--max-concurrent-recycles")) {
+		updates["default_max_concurrent_recycles"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isFlag(argv[i], '\0', "--rolling-restarts")) {
+		updates["default_rolling_restarts"] = true;
+		i++;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--warmup-requests")) {
+		updates["default_warmup_requests"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--warmup-request-path")) {
+		updates["default_warmup_request_path"] = argv[i + 1];
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--outlier-ejection-errors")) {
+		updates["default_outlier_ejection_errors"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--outlier-latency-threshold")) {
+		updates["default_outlier_latency_threshold"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--outlier-ejection-time")) {
+		updates["default_outlier_ejection_time"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--outlier-restart-threshold")) {
+		updates["default_outlier_restart_threshold"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--capacity-weight")) {
+		updates["default_capacity_weight"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--guaranteed-capacity")) {
+		updates["default_guaranteed_capacity"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--routing-key")) {
+		updates["default_routing_key"] = argv[i + 1];
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--routing-load-factor")) {
+		updates["default_routing_load_factor"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--oobw-max-utilization")) {
+		updates["default_oobw_max_utilization"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--oobw-interval")) {
+		updates["default_oobw_interval"] = atoi(argv[i + 1]);
+		i += 2;
+	} else if (p.isFlag(argv[i], '\0', "--adaptive-request-body-buffering")) {
+		updates["adaptive_request_body_buffering"] = true;
+		i++;
 	} else if (p.isFlag(argv[i], '\0', "--sticky-sessions")) {
 		updates["default_sticky_sessions"] = true;
 		i++;
@@ -410,6 +557,9 @@ parseCoreOption(int argc, const char *argv[], int &i, Json::Value &updates) {
 	} else if (p.isFlag(argv[i], '\0', "--cpu-affine")) {
 		updates["controller_cpu_affine"] = true;
 		i++;
+	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--cpu-affine-exclude")) {
+		updates["controller_cpu_affine_excluded_cpus"] = argv[i + 1];
+		i += 2;
 	} else if (p.isValueFlag(argc, i, argv[i], '\0', "--core-file-descriptor-ulimit")) {
 		updates["file_descriptor_ulimit"] = atoi(argv[i + 1]);
 		i += 2;
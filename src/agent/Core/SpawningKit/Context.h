@@ -39,6 +39,7 @@
 #include <WrapperRegistry/Registry.h>
 #include <JsonTools/JsonUtils.h>
 #include <ConfigKit/Store.h>
+#include <Core/SpawningKit/ShellEnvvarsCache.h>
 
 namespace Passenger {
 	namespace ApplicationPool2 {
@@ -92,6 +93,7 @@ public:
 		unsigned int dummyConcurrency;
 		unsigned long long dummySpawnDelay;
 		unsigned long long spawnerCreationSleepTime;
+		string dummySocketAddress;
 
 		DebugSupport()
 			: dummyConcurrency(1),
@@ -143,6 +145,11 @@ public:
 	//UnionStation::ContextPtr unionStationContext;
 
 
+	/****** Shared caches ******/
+
+	ShellEnvvarsCache shellEnvvarsCache;
+
+
 	Context(const Schema &schema, const Json::Value &initialConfig = Json::Value())
 		: config(schema),
 
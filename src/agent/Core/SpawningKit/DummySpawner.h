@@ -54,23 +54,7 @@ private:
 		config->spawnMethod = P_STATIC_STRING("dummy");
 	}
 
-public:
-	unsigned int cleanCount;
-
-	DummySpawner(Context *context)
-		: Spawner(context),
-		  count(1),
-		  cleanCount(0)
-		{ }
-
-	virtual Result spawn(const AppPoolOptions &options) {
-		TRACE_POINT();
-		possiblyRaiseInternalError(options);
-
-		if (context->debugSupport != NULL) {
-			syscalls::usleep(context->debugSupport->dummySpawnDelay);
-		}
-
+	Result createResult(const AppPoolOptions &options) {
 		Config config;
 		Json::Value extraArgs;
 		setConfigFromAppPoolOptions(&config, extraArgs, options);
@@ -85,6 +69,9 @@ public:
 		socket.acceptHttpRequests = true;
 		if (context->debugSupport != NULL) {
 			socket.concurrency = context->debugSupport->dummyConcurrency;
+			if (!context->debugSupport->dummySocketAddress.empty()) {
+				socket.address = context->debugSupport->dummySocketAddress;
+			}
 		}
 
 		result.initialize(*context, &config);
@@ -94,6 +81,10 @@ public:
 		result.spawnEndTime = result.spawnStartTime;
 		result.spawnEndTimeMonotonic = result.spawnStartTimeMonotonic;
 		result.sockets.push_back(socket);
+		if (context->debugSupport != NULL) {
+			result.stepDurations.push_back(make_pair(SUBPROCESS_APP_LOAD_OR_EXEC,
+				(unsigned long long) context->debugSupport->dummySpawnDelay));
+		}
 
 		vector<StaticString> internalFieldErrors;
 		vector<StaticString> appSuppliedFieldErrors;
@@ -116,6 +107,49 @@ public:
 		return result;
 	}
 
+public:
+	unsigned int cleanCount;
+
+	DummySpawner(Context *context)
+		: Spawner(context),
+		  count(1),
+		  cleanCount(0)
+		{ }
+
+	virtual Result spawn(const AppPoolOptions &options) {
+		TRACE_POINT();
+		possiblyRaiseInternalError(options);
+
+		if (context->debugSupport != NULL) {
+			syscalls::usleep(context->debugSupport->dummySpawnDelay);
+		}
+
+		return createResult(options);
+	}
+
+	/**
+	 * Simulates a preloader batch fork: the spawn delay is incurred once
+	 * for the whole batch.
+	 */
+	virtual vector<Result> spawnBatch(const AppPoolOptions &options, unsigned int count) {
+		TRACE_POINT();
+		possiblyRaiseInternalError(options);
+
+		if (context->debugSupport != NULL) {
+			syscalls::usleep(context->debugSupport->dummySpawnDelay);
+		}
+
+		vector<Result> results;
+		for (unsigned int i = 0; i < std::max(count, 1u); i++) {
+			results.push_back(createResult(options));
+		}
+		return results;
+	}
+
+	virtual bool supportsBatchSpawning() const {
+		return true;
+	}
+
 	virtual bool cleanable() const {
 		return true;
 	}
@@ -51,11 +51,22 @@ private:
 		if (options.appType == "ruby" || options.appType == "rack") {
 			preloaderCommand.push_back(options.ruby);
 			preloaderCommand.push_back(dir + "/rack-preloader.rb");
+		} else if ((options.appType == "python" || options.appType == "wsgi")
+			&& options.pythonPreloading)
+		{
+			preloaderCommand.push_back(options.python);
+			preloaderCommand.push_back(dir + "/wsgi-preloader.py");
 		} else {
 			return SpawnerPtr();
 		}
-		return boost::make_shared<SmartSpawner>(context,
-			preloaderCommand, options);
+		boost::shared_ptr<SmartSpawner> spawner = boost::make_shared<SmartSpawner>(
+			context, preloaderCommand, options);
+		if (options.appType == "python" || options.appType == "wsgi") {
+			// Python preloading is opt-in and not every app survives being
+			// imported before forking, so don't let it take the app down.
+			spawner->setFallbackSpawner(boost::make_shared<DirectSpawner>(context));
+		}
+		return spawner;
 	}
 
 public:
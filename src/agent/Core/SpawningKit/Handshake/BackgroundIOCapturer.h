@@ -54,7 +54,8 @@ using namespace std;
  * Given a file descriptor, captures its output in a background thread
  * and also forwards it immediately to a target file descriptor.
  * Call stop() to stop the background thread and to obtain the captured
- * output so far.
+ * output so far. Alternatively, don't call start() but call captureOnce()
+ * whenever the file descriptor becomes readable.
  */
 class BackgroundIOCapturer {
 private:
@@ -69,45 +70,50 @@ private:
 	boost::function<void ()> endReachedCallback;
 	bool stopped;
 
-	void capture() {
+	/**
+	 * Reads from the file descriptor once, then stores and forwards whatever
+	 * was read. Returns false if the end of the stream has been reached, or
+	 * if an error occurred.
+	 */
+	bool readAndProcess() {
 		TRACE_POINT();
-		while (!boost::this_thread::interruption_requested()) {
-			char buf[1024 * 8];
-			ssize_t ret;
-
+		char buf[1024 * 8];
+		ssize_t ret;
+
+		ret = syscalls::read(fd, buf, sizeof(buf));
+		int e = errno;
+		boost::this_thread::disable_syscall_interruption dsi;
+		if (ret == 0) {
+			return false;
+		} else if (ret == -1) {
+			if (e != EAGAIN && e != EWOULDBLOCK) {
+				P_WARN("Background I/O capturer error: " <<
+					strerror(e) << " (errno=" << e << ")");
+				return false;
+			}
+		} else {
+			{
+				boost::lock_guard<boost::mutex> l(dataSyncher);
+				data.append(buf, ret);
+			}
 			UPDATE_TRACE_POINT();
-			ret = syscalls::read(fd, buf, sizeof(buf));
-			int e = errno;
-			boost::this_thread::disable_syscall_interruption dsi;
-			if (ret == 0) {
-				break;
-			} else if (ret == -1) {
-				if (e != EAGAIN && e != EWOULDBLOCK) {
-					P_WARN("Background I/O capturer error: " <<
-						strerror(e) << " (errno=" << e << ")");
-					break;
-				}
+			if (ret == 1 && buf[0] == '\n') {
+				LoggingKit::logAppOutput(appGroupName, pid, channelName, "", 0, appLogFile);
 			} else {
-				{
-					boost::lock_guard<boost::mutex> l(dataSyncher);
-					data.append(buf, ret);
+				vector<StaticString> lines;
+				if (ret > 0 && buf[ret - 1] == '\n') {
+					ret--;
 				}
-				UPDATE_TRACE_POINT();
-				if (ret == 1 && buf[0] == '\n') {
-					LoggingKit::logAppOutput(appGroupName, pid, channelName, "", 0, appLogFile);
-				} else {
-					vector<StaticString> lines;
-					if (ret > 0 && buf[ret - 1] == '\n') {
-						ret--;
-					}
-					split(StaticString(buf, ret), '\n', lines);
-					foreach (const StaticString line, lines) {
-						LoggingKit::logAppOutput(appGroupName, pid, channelName, line.data(), line.size(), appLogFile);
-					}
+				split(StaticString(buf, ret), '\n', lines);
+				foreach (const StaticString line, lines) {
+					LoggingKit::logAppOutput(appGroupName, pid, channelName, line.data(), line.size(), appLogFile);
 				}
 			}
 		}
+		return true;
+	}
 
+	void markStopped() {
 		{
 			boost::lock_guard<boost::mutex> l(dataSyncher);
 			stopped = true;
@@ -117,6 +123,16 @@ private:
 		}
 	}
 
+	void capture() {
+		TRACE_POINT();
+		while (!boost::this_thread::interruption_requested()) {
+			if (!readAndProcess()) {
+				break;
+			}
+		}
+		markStopped();
+	}
+
 public:
 	BackgroundIOCapturer(const FileDescriptor &_fd, pid_t _pid,
 		const string &_appGroupName,
@@ -165,6 +181,22 @@ public:
 		}
 	}
 
+	/**
+	 * Captures from the file descriptor once, for callers that watch the file
+	 * descriptor in their own event loop instead of calling start(). Only call
+	 * this when the file descriptor is readable. Returns false once the end of
+	 * the stream has been reached, after which isStopped() returns true.
+	 */
+	bool captureOnce() {
+		assert(thr == NULL);
+		if (readAndProcess()) {
+			return true;
+		} else {
+			markStopped();
+			return false;
+		}
+	}
+
 	void setEndReachedCallback(const boost::function<void ()> &callback) {
 		endReachedCallback = callback;
 	}
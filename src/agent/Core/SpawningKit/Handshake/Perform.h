@@ -34,14 +34,26 @@
 #include <oxt/backtrace.hpp>
 #include <string>
 #include <vector>
+#include <limits>
+#include <algorithm>
 #include <stdexcept>
 #include <cstddef>
 #include <cstdlib>
 #include <cerrno>
 #include <cassert>
 
+#include <boost/scoped_ptr.hpp>
+#include <climits>
+
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 #include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+	#include <sys/syscall.h>
+#endif
 
 #include <jsoncpp/json.h>
 
@@ -50,6 +62,7 @@
 #include <FileDescriptor.h>
 #include <FileTools/FileManip.h>
 #include <FileTools/PathManip.h>
+#include <IOTools/IOUtils.h>
 #include <Utils.h>
 #include <Utils/ScopeGuard.h>
 #include <SystemTools/SystemTime.h>
@@ -79,7 +92,7 @@ private:
 		FINISH_SUCCESS,
 		// The app has finished spawning with an error.
 		FINISH_ERROR,
-		// An internal error occurred in watchFinishSignal().
+		// An internal error occurred while watching the finish signal.
 		FINISH_INTERNAL_ERROR
 	};
 
@@ -95,121 +108,226 @@ private:
 	 * These objects captures the process's stdout and stderr while handshake is
 	 * in progress. If handshaking fails, then any output captured by these objects
 	 * will be stored into the resulting SpawnException's error page.
+	 *
+	 * Unlike elsewhere, this capturer does not run in a background thread:
+	 * its file descriptor is watched by the event loop in waitForEvents().
 	 */
 	BackgroundIOCapturerPtr stdoutAndErrCapturer;
 
-	boost::mutex syncher;
-	boost::condition_variable cond;
-
-	oxt::thread *processExitWatcher;
-	oxt::thread *finishSignalWatcher;
+	/**
+	 * All the things we watch while the handshake is in progress (process exit,
+	 * the finish signal, the stdout/stderr channel and socket pingability) are
+	 * multiplexed in a single poll() loop in the calling thread.
+	 */
+	FileDescriptor processExitFd;
+	bool checkProcessExitByPolling;
 	bool processExited;
+
+	FileDescriptor finishSignalFd;
 	FinishState finishState;
 	string finishSignalWatcherErrorMessage;
 	ErrorCategory finishSignalWatcherErrorCategory;
 
-	oxt::thread *socketPingabilityWatcher;
+	bool watchingSocketPingability;
+	boost::scoped_ptr<NTCP_State> pingabilityProbe;
+	MonotonicTimeUsec nextPingabilityProbeTime;
+	unsigned int pingabilityProbeInterval;
 	bool socketIsNowPingable;
 
+	/**
+	 * The indices of the things we watch in the pollfd array that was
+	 * last filled by addPollFds(), or -1 if they weren't added.
+	 */
+	int processExitPollIndex;
+	int finishSignalPollIndex;
+	int stdoutAndErrPollIndex;
+	int pingabilityProbePollIndex;
+
+	/** The maximum number of file descriptors that addPollFds() adds. */
+	static const unsigned int MAX_POLL_FDS = 4;
+
 
 	void initializeStdchannelsCapturing() {
 		if (stdoutAndErrFd != -1) {
 			stdoutAndErrCapturer = boost::make_shared<BackgroundIOCapturer>(
-				stdoutAndErrFd, pid, "output", alreadyReadStdoutAndErrData);
-			stdoutAndErrCapturer->setEndReachedCallback(boost::bind(
-				&HandshakePerform::wakeupEventLoop, this));
-			stdoutAndErrCapturer->start();
+				stdoutAndErrFd, pid, config->appGroupName, config->logFile,
+				P_STATIC_STRING("output"), alreadyReadStdoutAndErrData);
 		}
 	}
 
 	void startWatchingProcessExit() {
-		processExitWatcher = new oxt::thread(
-			boost::bind(&HandshakePerform::watchProcessExit, this),
-			"SpawningKit: process exit watcher", 64 * 1024);
+		#if defined(__linux__) && defined(SYS_pidfd_open)
+			int fd = syscall(SYS_pidfd_open, pid, 0);
+			if (fd != -1) {
+				processExitFd.assign(fd, __FILE__, __LINE__);
+				return;
+			} else if (errno == ESRCH) {
+				processExited = true;
+				return;
+			}
+		#endif
+		// No pidfd support: fall back to checking with waitpid() on
+		// every event loop iteration.
+		checkProcessExitByPolling = true;
 	}
 
-	void watchProcessExit() {
+	void checkProcessExit() {
 		TRACE_POINT();
-		int ret = syscalls::waitpid(pid, NULL, 0);
-		if (ret >= 0 || errno == EPERM) {
-			boost::lock_guard<boost::mutex> l(syncher);
+		int ret = syscalls::waitpid(pid, NULL, WNOHANG);
+		if (ret > 0 || (ret == -1 && errno == EPERM)) {
 			processExited = true;
-			wakeupEventLoop();
+			checkProcessExitByPolling = false;
+		} else if (ret == -1) {
+			// Not our child (e.g. it was forked by a preloader),
+			// so we can't check this way.
+			checkProcessExitByPolling = false;
 		}
 	}
 
-	void startWatchingFinishSignal() {
-		finishSignalWatcher = new oxt::thread(
-			boost::bind(&HandshakePerform::watchFinishSignal, this),
-			"SpawningKit: finish signal watcher", 64 * 1024);
+	void onProcessExitFdReadable() {
+		TRACE_POINT();
+		processExitFd.close();
+		processExited = true;
+		// Reap the process if it's our child.
+		syscalls::waitpid(pid, NULL, WNOHANG);
 	}
 
-	void watchFinishSignal() {
+	void startWatchingFinishSignal() {
 		TRACE_POINT();
 		try {
 			string path = session.responseDir + "/finish";
+			// Opening the FIFO in non-blocking mode succeeds even when
+			// there is no writer yet.
 			int fd = syscalls::openat(session.responseDirFd, "finish",
-				O_RDONLY | O_NOFOLLOW);
+				O_RDONLY | O_NOFOLLOW | O_NONBLOCK);
 			if (fd == -1) {
 				int e = errno;
 				throw FileSystemException("Error opening FIFO " + path,
 					e, path);
 			}
-			FdGuard guard(fd, __FILE__, __LINE__);
+			finishSignalFd.assign(fd, __FILE__, __LINE__);
+		} catch (const std::exception &e) {
+			setFinishSignalInternalError(e);
+		}
+	}
 
+	void onFinishSignalFdReadable() {
+		TRACE_POINT();
+		try {
+			string path = session.responseDir + "/finish";
 			char buf = '0';
-			ssize_t ret = syscalls::read(fd, &buf, 1);
+			ssize_t ret = syscalls::read(finishSignalFd, &buf, 1);
 			if (ret == -1) {
 				int e = errno;
+				if (e == EAGAIN || e == EWOULDBLOCK) {
+					return;
+				}
 				throw FileSystemException("Error reading from FIFO " + path,
 					e, path);
 			}
 
-			guard.runNow();
-
-			boost::lock_guard<boost::mutex> l(syncher);
+			finishSignalFd.close();
 			if (buf == '1') {
 				finishState = FINISH_SUCCESS;
 			} else {
 				finishState = FINISH_ERROR;
 			}
-			wakeupEventLoop();
 		} catch (const std::exception &e) {
-			boost::lock_guard<boost::mutex> l(syncher);
-			finishState = FINISH_INTERNAL_ERROR;
-			finishSignalWatcherErrorMessage = e.what();
-			finishSignalWatcherErrorCategory =
-				inferErrorCategoryFromAnotherException(e,
-					SPAWNING_KIT_HANDSHAKE_PERFORM);
-			wakeupEventLoop();
+			finishSignalFd.close(false);
+			setFinishSignalInternalError(e);
 		}
 	}
 
+	void setFinishSignalInternalError(const std::exception &e) {
+		finishState = FINISH_INTERNAL_ERROR;
+		finishSignalWatcherErrorMessage = e.what();
+		finishSignalWatcherErrorCategory =
+			inferErrorCategoryFromAnotherException(e,
+				SPAWNING_KIT_HANDSHAKE_PERFORM);
+	}
+
 	void startWatchingSocketPingability() {
-		socketPingabilityWatcher = new oxt::thread(
-			boost::bind(&HandshakePerform::watchSocketPingability, this),
-			"SpawningKit: socket pingability watcher", 64 * 1024);
+		watchingSocketPingability = true;
+		nextPingabilityProbeTime = 0;
+		pingabilityProbeInterval = 1000;
 	}
 
-	void watchSocketPingability() {
+	/**
+	 * Starts a non-blocking connect to the port that the app is expected to
+	 * listen on. If the result isn't immediately known then the event loop
+	 * waits for the socket to become writable.
+	 */
+	void startPingabilityProbe() {
 		TRACE_POINT();
-
-		while (true) {
-			unsigned long long timeout = 100000;
-
-			if (pingTcpServer("127.0.0.1", session.expectedStartPort, &timeout)) {
-				boost::lock_guard<boost::mutex> l(syncher);
-				socketIsNowPingable = true;
-				finishState = FINISH_SUCCESS;
-				wakeupEventLoop();
-				break;
+		pingabilityProbe.reset(new NTCP_State());
+		setupNonBlockingTcpSocket(*pingabilityProbe, "127.0.0.1",
+			session.expectedStartPort, __FILE__, __LINE__);
+		try {
+			if (connectToTcpServer(*pingabilityProbe)) {
+				onSocketPingable();
+			}
+		} catch (const SystemException &e) {
+			if (isNotPingableYetError(e.code())) {
+				schedulePingabilityProbe();
 			} else {
-				syscalls::usleep(50000);
+				throw;
 			}
 		}
 	}
 
-	void waitUntilSpawningFinished(boost::unique_lock<boost::mutex> &l) {
+	/**
+	 * Whether a connect error means that the app isn't listening yet (or is
+	 * in the middle of setting up its socket), as opposed to a problem that
+	 * retrying won't fix.
+	 */
+	static bool isNotPingableYetError(int e) {
+		return e == ECONNREFUSED
+			|| e == ECONNRESET
+			|| e == ECONNABORTED
+			|| e == ENOENT
+			|| e == ETIMEDOUT;
+	}
+
+	void onPingabilityProbeWritable() {
+		TRACE_POINT();
+		int error;
+		socklen_t len = sizeof(error);
+		if (getsockopt(pingabilityProbe->fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1) {
+			int e = errno;
+			throw SystemException("Error querying TCP socket 127.0.0.1:"
+				+ toString(session.expectedStartPort), e);
+		}
+		if (error == 0) {
+			onSocketPingable();
+		} else {
+			schedulePingabilityProbe();
+		}
+	}
+
+	/**
+	 * The port isn't connectable yet. Nothing tells us when the app starts
+	 * listening, so retry with exponential backoff: quickly at first so that
+	 * fast apps are detected quickly, but no more often than every 25 msec
+	 * after that.
+	 */
+	void schedulePingabilityProbe() {
+		pingabilityProbe.reset();
+		nextPingabilityProbeTime = SystemTime::getMonotonicUsec()
+			+ pingabilityProbeInterval;
+		pingabilityProbeInterval *= 2;
+		if (pingabilityProbeInterval > 25000) {
+			pingabilityProbeInterval = 25000;
+		}
+	}
+
+	void onSocketPingable() {
+		pingabilityProbe.reset();
+		watchingSocketPingability = false;
+		socketIsNowPingable = true;
+		finishState = FINISH_SUCCESS;
+	}
+
+	void waitUntilSpawningFinished() {
 		TRACE_POINT();
 		bool done;
 
@@ -218,17 +336,127 @@ private:
 			done = checkCurrentState();
 			if (!done) {
 				MonotonicTimeUsec begin = SystemTime::getMonotonicUsec();
-				cond.timed_wait(l, posix_time::microseconds(session.timeoutUsec));
-				MonotonicTimeUsec end = SystemTime::getMonotonicUsec();
-				if (end - begin > session.timeoutUsec) {
-					session.timeoutUsec = 0;
-				} else {
-					session.timeoutUsec -= end - begin;
-				}
+				waitForEvents(session.timeoutUsec);
+				subtractFromTimeout(SystemTime::getMonotonicUsec() - begin);
 			}
 		} while (!done);
 	}
 
+	void subtractFromTimeout(unsigned long long elapsedUsec) {
+		if (elapsedUsec > session.timeoutUsec) {
+			session.timeoutUsec = 0;
+		} else {
+			session.timeoutUsec -= elapsedUsec;
+		}
+	}
+
+	/**
+	 * Waits until something happens on any of the things we watch, or until
+	 * `timeoutUsec` has passed, and processes whatever happened.
+	 */
+	void waitForEvents(unsigned long long timeoutUsec) {
+		TRACE_POINT();
+		struct pollfd fds[MAX_POLL_FDS];
+		nfds_t nfds = addPollFds(fds, timeoutUsec);
+
+		int ret = syscalls::poll(fds, nfds, msecTimeout(timeoutUsec));
+		if (ret == -1) {
+			int e = errno;
+			throw SystemException("Error polling the file descriptors of process "
+				+ toString(pid), e);
+		}
+
+		processPollFds(fds);
+	}
+
+	/**
+	 * Adds the file descriptors of the things we watch to `fds`, which must
+	 * have room for MAX_POLL_FDS entries, and lowers `timeoutUsec` to the
+	 * time at which we need to check on things even if nothing happens.
+	 * Returns the number of entries that were added.
+	 */
+	nfds_t addPollFds(struct pollfd *fds, unsigned long long &timeoutUsec) {
+		nfds_t nfds = 0;
+
+		if (checkProcessExitByPolling && timeoutUsec > 50000) {
+			timeoutUsec = 50000;
+		}
+		if (watchingSocketPingability && pingabilityProbe == NULL) {
+			MonotonicTimeUsec now = SystemTime::getMonotonicUsec();
+			if (now >= nextPingabilityProbeTime) {
+				timeoutUsec = 0;
+			} else if (nextPingabilityProbeTime - now < timeoutUsec) {
+				timeoutUsec = nextPingabilityProbeTime - now;
+			}
+		}
+
+		processExitPollIndex = -1;
+		finishSignalPollIndex = -1;
+		stdoutAndErrPollIndex = -1;
+		pingabilityProbePollIndex = -1;
+		if (processExitFd != -1) {
+			processExitPollIndex = addPollFd(fds, nfds, processExitFd, POLLIN);
+		}
+		if (finishSignalFd != -1) {
+			finishSignalPollIndex = addPollFd(fds, nfds, finishSignalFd, POLLIN);
+		}
+		if (stdoutAndErrCapturer != NULL && !stdoutAndErrCapturer->isStopped()) {
+			stdoutAndErrPollIndex = addPollFd(fds, nfds,
+				stdoutAndErrCapturer->getFd(), POLLIN);
+		}
+		if (pingabilityProbe != NULL) {
+			pingabilityProbePollIndex = addPollFd(fds, nfds,
+				pingabilityProbe->fd, POLLOUT);
+		}
+		return nfds;
+	}
+
+	/**
+	 * Processes whatever happened according to the `fds` that were filled
+	 * by addPollFds() and then polled.
+	 */
+	void processPollFds(const struct pollfd *fds) {
+		TRACE_POINT();
+		if (stdoutAndErrPollIndex != -1 && fds[stdoutAndErrPollIndex].revents != 0) {
+			stdoutAndErrCapturer->captureOnce();
+		}
+		if (processExitPollIndex != -1 && fds[processExitPollIndex].revents != 0) {
+			onProcessExitFdReadable();
+		}
+		if (finishSignalPollIndex != -1 && fds[finishSignalPollIndex].revents != 0) {
+			onFinishSignalFdReadable();
+		}
+		if (pingabilityProbePollIndex != -1 && fds[pingabilityProbePollIndex].revents != 0) {
+			onPingabilityProbeWritable();
+		}
+
+		UPDATE_TRACE_POINT();
+		if (checkProcessExitByPolling) {
+			checkProcessExit();
+		}
+		if (watchingSocketPingability && pingabilityProbe == NULL
+		 && SystemTime::getMonotonicUsec() >= nextPingabilityProbeTime)
+		{
+			startPingabilityProbe();
+		}
+	}
+
+	static int addPollFd(struct pollfd *fds, nfds_t &nfds, int fd, short events) {
+		fds[nfds].fd = fd;
+		fds[nfds].events = events;
+		fds[nfds].revents = 0;
+		return nfds++;
+	}
+
+	static int msecTimeout(unsigned long long usec) {
+		unsigned long long msec = (usec + 999) / 1000;
+		if (msec > (unsigned long long) INT_MAX) {
+			return INT_MAX;
+		} else {
+			return (int) msec;
+		}
+	}
+
 	bool checkCurrentState() {
 		TRACE_POINT();
 
@@ -236,7 +464,7 @@ private:
 		 || processExited)
 		{
 			UPDATE_TRACE_POINT();
-			sleepShortlyToCaptureMoreStdoutStderr();
+			captureMoreStdoutStderr();
 			loadJourneyStateFromResponseDir();
 			if (session.journey.getFirstFailedStep() == UNKNOWN_JOURNEY_STEP) {
 				session.journey.setStepErrored(bestGuessSubprocessFailedStep(), true);
@@ -255,7 +483,7 @@ private:
 
 		if (session.timeoutUsec == 0) {
 			UPDATE_TRACE_POINT();
-			sleepShortlyToCaptureMoreStdoutStderr();
+			captureMoreStdoutStderr();
 
 			loadJourneyStateFromResponseDir();
 			session.journey.setStepErrored(SPAWNING_KIT_HANDSHAKE_PERFORM);
@@ -328,6 +556,7 @@ private:
 
 		UPDATE_TRACE_POINT();
 		if (result.validate(internalFieldErrors, appSuppliedFieldErrors)) {
+			storeShellEnvvarsInCache();
 			return result;
 		} else {
 			throwSpawnExceptionBecauseOfResultValidationErrors(internalFieldErrors,
@@ -336,9 +565,52 @@ private:
 		}
 	}
 
+	/**
+	 * If the SpawnEnvSetupper ran the OS shell, then it reports the
+	 * environment variable changes made by the shell. Store those in the
+	 * shell envvars cache so that the next spawn can skip the shell.
+	 * Problems here are not fatal to the spawn: at worst the next spawn
+	 * runs the shell again.
+	 */
+	void storeShellEnvvarsInCache() {
+		TRACE_POINT();
+		if (session.shellEnvvarsCacheKey.empty()
+		 || !fileExists(session.responseDir + "/shell_envvars.json"))
+		{
+			return;
+		}
+
+		try {
+			pair<string, bool> content = safeReadFile(session.responseDirFd,
+				"shell_envvars.json", SPAWNINGKIT_MAX_SUBPROCESS_ENVDUMP_SIZE);
+			Json::Reader reader;
+			Json::Value doc;
+
+			if (!content.second) {
+				P_WARN("[App " << pid << "] Not caching shell environment variables: "
+					<< session.responseDir << "/shell_envvars.json is too big");
+			} else if (!reader.parse(content.first, doc)
+				|| !doc.isObject()
+				|| !doc["shell"].isString()
+				|| !doc["input_envvars"].isObject()
+				|| !doc["set"].isObject()
+				|| !doc["unset"].isArray())
+			{
+				P_WARN("[App " << pid << "] Not caching shell environment variables: "
+					<< session.responseDir << "/shell_envvars.json is malformed");
+			} else {
+				session.context->shellEnvvarsCache.store(session.shellEnvvarsCacheKey,
+					doc, session.shellStartupFileStamps);
+			}
+		} catch (const SystemException &e) {
+			P_WARN("[App " << pid << "] Not caching shell environment variables: "
+				<< e.what());
+		}
+	}
+
 	void handleErrorResponse() {
 		TRACE_POINT();
-		sleepShortlyToCaptureMoreStdoutStderr();
+		captureMoreStdoutStderr();
 		loadJourneyStateFromResponseDir();
 		if (session.journey.getFirstFailedStep() == UNKNOWN_JOURNEY_STEP) {
 			session.journey.setStepErrored(bestGuessSubprocessFailedStep(), true);
@@ -357,7 +629,7 @@ private:
 
 	void handleInternalError() {
 		TRACE_POINT();
-		sleepShortlyToCaptureMoreStdoutStderr();
+		captureMoreStdoutStderr();
 
 		loadJourneyStateFromResponseDir();
 		session.journey.setStepErrored(SPAWNING_KIT_HANDSHAKE_PERFORM);
@@ -431,6 +703,13 @@ private:
 			if (socketDoc.isMember("accept_http_requests")) {
 				socket.acceptHttpRequests = socketDoc["accept_http_requests"].asBool();
 			}
+			if (socketDoc.isMember("framed_request_bodies")) {
+				socket.framedRequestBodies = socketDoc["framed_request_bodies"].asBool();
+			}
+			if (socketDoc.isMember("binary_session_header_version")) {
+				int version = socketDoc["binary_session_header_version"].asInt();
+				socket.binarySessionHeaderVersion = (version > 0) ? version : 0;
+			}
 			if (socketDoc.isMember("description")) {
 				socket.description = socketDoc["description"].asString();
 			}
@@ -482,6 +761,12 @@ private:
 			validateResultPropertiesFileSocketField(socketDoc,
 				"accept_http_requests", Json::booleanValue, it.index(),
 				false, false, errors);
+			validateResultPropertiesFileSocketField(socketDoc,
+				"framed_request_bodies", Json::booleanValue, it.index(),
+				false, false, errors);
+			validateResultPropertiesFileSocketField(socketDoc,
+				"binary_session_header_version", Json::intValue, it.index(),
+				false, false, errors);
 			validateResultPropertiesFileSocketAddress(socketDoc,
 				it.index(), errors);
 		}
@@ -629,10 +914,6 @@ private:
 		return false;
 	}
 
-	void wakeupEventLoop() {
-		cond.notify_all();
-	}
-
 	string getStdoutErrData() const {
 		return getStdoutErrData(stdoutAndErrCapturer);
 	}
@@ -645,15 +926,36 @@ private:
 		}
 	}
 
-	void sleepShortlyToCaptureMoreStdoutStderr() const {
-		syscalls::usleep(50000);
+	/**
+	 * Gives the process a short while to write more to stdout/stderr before
+	 * we report an error, so that the error report includes it. Returns early
+	 * if the output channel is closed, e.g. because the process has exited.
+	 */
+	void captureMoreStdoutStderr() {
+		TRACE_POINT();
+		if (stdoutAndErrCapturer == NULL) {
+			return;
+		}
+
+		MonotonicTimeUsec deadline = SystemTime::getMonotonicUsec() + 50000;
+		while (!stdoutAndErrCapturer->isStopped()) {
+			MonotonicTimeUsec now = SystemTime::getMonotonicUsec();
+			if (now >= deadline) {
+				break;
+			}
+			unsigned long long timeout = deadline - now;
+			if (!waitUntilReadable(stdoutAndErrCapturer->getFd(), &timeout)) {
+				break;
+			}
+			stdoutAndErrCapturer->captureOnce();
+		}
 	}
 
 	void throwSpawnExceptionBecauseAppDidNotProvidePreloaderProtocolSockets() {
 		TRACE_POINT();
 		assert(!config->genericApp);
 
-		sleepShortlyToCaptureMoreStdoutStderr();
+		captureMoreStdoutStderr();
 
 		if (!config->genericApp && config->startsUsingWrapper) {
 			UPDATE_TRACE_POINT();
@@ -752,7 +1054,7 @@ private:
 		TRACE_POINT();
 		assert(!config->genericApp);
 
-		sleepShortlyToCaptureMoreStdoutStderr();
+		captureMoreStdoutStderr();
 
 		if (!config->genericApp && config->startsUsingWrapper) {
 			UPDATE_TRACE_POINT();
@@ -876,7 +1178,7 @@ private:
 		string message;
 		typename vector<StringType>::const_iterator it, end;
 
-		sleepShortlyToCaptureMoreStdoutStderr();
+		captureMoreStdoutStderr();
 
 		if (!internalFieldErrors.empty()) {
 			UPDATE_TRACE_POINT();
@@ -1547,29 +1849,53 @@ private:
 		}
 	}
 
+	void startWatching() {
+		TRACE_POINT();
+		initializeStdchannelsCapturing();
+		startWatchingProcessExit();
+		if (config->genericApp || config->findFreePort) {
+			startWatchingSocketPingability();
+		}
+		if (!config->genericApp) {
+			startWatchingFinishSignal();
+		}
+	}
+
+	Result finish() {
+		TRACE_POINT();
+		Result result = handleResponse();
+		loadJourneyStateFromResponseDir();
+		return result;
+	}
+
+	SpawnException createSpawnExceptionFromInternalError(const std::exception &originalException) {
+		TRACE_POINT();
+		captureMoreStdoutStderr();
+
+		loadJourneyStateFromResponseDir();
+		session.journey.setStepErrored(SPAWNING_KIT_HANDSHAKE_PERFORM);
+
+		SpawnException e(originalException, session.journey, config);
+		e.setSubprocessPid(pid);
+		e.setStdoutAndErrData(getStdoutErrData());
+		return e.finalize();
+	}
+
+	static void cleanupAll(const vector<HandshakePerform *> &handshakes) {
+		vector<HandshakePerform *>::const_iterator it, end = handshakes.end();
+		for (it = handshakes.begin(); it != end; it++) {
+			(*it)->cleanup();
+		}
+	}
+
 	void cleanup() {
 		boost::this_thread::disable_interruption di;
 		boost::this_thread::disable_syscall_interruption dsi;
 		TRACE_POINT();
 
-		if (processExitWatcher != NULL) {
-			processExitWatcher->interrupt_and_join();
-			delete processExitWatcher;
-			processExitWatcher = NULL;
-		}
-		if (finishSignalWatcher != NULL) {
-			finishSignalWatcher->interrupt_and_join();
-			delete finishSignalWatcher;
-			finishSignalWatcher = NULL;
-		}
-		if (socketPingabilityWatcher != NULL) {
-			socketPingabilityWatcher->interrupt_and_join();
-			delete socketPingabilityWatcher;
-			socketPingabilityWatcher = NULL;
-		}
-		if (stdoutAndErrCapturer != NULL) {
-			stdoutAndErrCapturer->stop();
-		}
+		processExitFd.close(false);
+		finishSignalFd.close(false);
+		pingabilityProbe.reset();
 	}
 
 	JourneyStep bestGuessSubprocessFailedStep() const {
@@ -1705,12 +2031,17 @@ public:
 		  stdinFd(_stdinFd),
 		  stdoutAndErrFd(_stdoutAndErrFd),
 		  alreadyReadStdoutAndErrData(_alreadyReadStdoutAndErrData),
-		  processExitWatcher(NULL),
-		  finishSignalWatcher(NULL),
+		  checkProcessExitByPolling(false),
 		  processExited(false),
 		  finishState(NOT_FINISHED),
-		  socketPingabilityWatcher(NULL),
+		  watchingSocketPingability(false),
+		  nextPingabilityProbeTime(0),
+		  pingabilityProbeInterval(0),
 		  socketIsNowPingable(false),
+		  processExitPollIndex(-1),
+		  finishSignalPollIndex(-1),
+		  stdoutAndErrPollIndex(-1),
+		  pingabilityProbePollIndex(-1),
 		  debugSupport(NULL)
 	{
 		assert(_session.context != NULL);
@@ -1727,50 +2058,128 @@ public:
 		// it may want to perform additional preparation.
 
 		try {
-			initializeStdchannelsCapturing();
-			startWatchingProcessExit();
-			if (config->genericApp || config->findFreePort) {
-				startWatchingSocketPingability();
-			}
-			if (!config->genericApp) {
-				startWatchingFinishSignal();
-			}
+			startWatching();
 		} catch (const SpawnException &) {
 			throw;
 		} catch (const std::exception &originalException) {
-			sleepShortlyToCaptureMoreStdoutStderr();
-
-			loadJourneyStateFromResponseDir();
-			session.journey.setStepErrored(SPAWNING_KIT_HANDSHAKE_PERFORM);
-
-			SpawnException e(originalException, session.journey, config);
-			e.setStdoutAndErrData(getStdoutErrData());
-			e.setSubprocessPid(pid);
-			throw e.finalize();
+			throw createSpawnExceptionFromInternalError(originalException);
 		}
 
 		UPDATE_TRACE_POINT();
 		try {
-			boost::unique_lock<boost::mutex> l(syncher);
 			if (debugSupport != NULL) {
 				debugSupport->beginWaitUntilSpawningFinished();
 			}
-			waitUntilSpawningFinished(l);
-			Result result = handleResponse();
-			loadJourneyStateFromResponseDir();
-			return result;
+			waitUntilSpawningFinished();
+			return finish();
 		} catch (const SpawnException &) {
 			throw;
 		} catch (const std::exception &originalException) {
-			sleepShortlyToCaptureMoreStdoutStderr();
+			throw createSpawnExceptionFromInternalError(originalException);
+		}
+	}
 
-			loadJourneyStateFromResponseDir();
-			session.journey.setStepErrored(SPAWNING_KIT_HANDSHAKE_PERFORM);
+	/**
+	 * Performs the given handshakes concurrently in the calling thread, by
+	 * multiplexing the things that all of them watch in a single poll() loop.
+	 * This is used for batch spawning, where many processes initialize in
+	 * parallel.
+	 *
+	 * Unlike `execute()`, a failing handshake does not throw. Instead,
+	 * `errors[i]` is set to the SpawnException that describes why handshake
+	 * `i` failed. `results[i]` is only valid if `errors[i]` is NULL.
+	 */
+	static void executeConcurrently(const vector<HandshakePerform *> &handshakes,
+		vector<Result> &results, vector< boost::shared_ptr<SpawnException> > &errors)
+	{
+		TRACE_POINT();
+		ScopeGuard guard(boost::bind(&HandshakePerform::cleanupAll,
+			boost::cref(handshakes)));
+		unsigned int i, count = handshakes.size();
+		vector<struct pollfd> fds(count * MAX_POLL_FDS + 1);
+		vector<int> fdsOffsets(count, -1);
+		vector<bool> finished(count, false);
+		unsigned long long elapsedUsec = 0;
+
+		results.clear();
+		results.resize(count);
+		errors.clear();
+		errors.resize(count);
+
+		for (i = 0; i < count; i++) {
+			HandshakePerform *handshake = handshakes[i];
+			try {
+				handshake->startWatching();
+				if (handshake->debugSupport != NULL) {
+					handshake->debugSupport->beginWaitUntilSpawningFinished();
+				}
+			} catch (const SpawnException &e) {
+				errors[i] = boost::make_shared<SpawnException>(e);
+			} catch (const std::exception &originalException) {
+				errors[i] = boost::make_shared<SpawnException>(
+					handshake->createSpawnExceptionFromInternalError(originalException));
+			}
+			if (errors[i] != NULL) {
+				handshake->cleanup();
+				finished[i] = true;
+			}
+		}
 
-			SpawnException e(originalException, session.journey, config);
-			e.setSubprocessPid(pid);
-			e.setStdoutAndErrData(getStdoutErrData());
-			throw e.finalize();
+		while (true) {
+			boost::this_thread::interruption_point();
+			unsigned long long timeoutUsec = std::numeric_limits<unsigned long long>::max();
+			nfds_t nfds = 0;
+
+			UPDATE_TRACE_POINT();
+			for (i = 0; i < count; i++) {
+				if (finished[i]) {
+					continue;
+				}
+
+				HandshakePerform *handshake = handshakes[i];
+				try {
+					if (fdsOffsets[i] != -1) {
+						handshake->processPollFds(&fds[fdsOffsets[i]]);
+						handshake->subtractFromTimeout(elapsedUsec);
+						fdsOffsets[i] = -1;
+					}
+					if (handshake->checkCurrentState()) {
+						results[i] = handshake->finish();
+						finished[i] = true;
+					} else {
+						unsigned long long handshakeTimeoutUsec =
+							handshake->session.timeoutUsec;
+						fdsOffsets[i] = nfds;
+						nfds += handshake->addPollFds(&fds[nfds], handshakeTimeoutUsec);
+						timeoutUsec = std::min(timeoutUsec, handshakeTimeoutUsec);
+					}
+				} catch (const SpawnException &e) {
+					errors[i] = boost::make_shared<SpawnException>(e);
+					finished[i] = true;
+				} catch (const std::exception &originalException) {
+					errors[i] = boost::make_shared<SpawnException>(
+						handshake->createSpawnExceptionFromInternalError(originalException));
+					finished[i] = true;
+				}
+				if (finished[i]) {
+					handshake->cleanup();
+					fdsOffsets[i] = -1;
+				}
+			}
+
+			if (std::find(finished.begin(), finished.end(), false) == finished.end()) {
+				break;
+			}
+
+			UPDATE_TRACE_POINT();
+			MonotonicTimeUsec begin = SystemTime::getMonotonicUsec();
+			int ret = syscalls::poll(&fds[0], nfds, msecTimeout(timeoutUsec));
+			if (ret == -1) {
+				int e = errno;
+				throw SystemException("Error polling the file descriptors of"
+					" the processes being spawned", e);
+			}
+			elapsedUsec = SystemTime::getMonotonicUsec() - begin;
 		}
 	}
 
@@ -44,6 +44,7 @@
 #include <sys/socket.h>
 #include <pwd.h>
 #include <grp.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <limits.h>
 
@@ -124,42 +125,46 @@ private:
 	void createWorkDir() {
 		TRACE_POINT();
 		session.workDir.reset(new HandshakeWorkDir(context->spawnDir));
-
 		session.envDumpDir = session.workDir->getPath() + "/envdump";
-		makeDirTree(session.envDumpDir,
-			"u=rwx,g=,o=",
-			session.uid,
-			session.gid);
-		makeDirTree(session.envDumpDir + "/annotations",
-			"u=rwx,g=,o=",
-			session.uid,
-			session.gid);
-
 		session.responseDir = session.workDir->getPath() + "/response";
-		makeDirTree(session.responseDir,
-			"u=rwx,g=,o=",
-			session.uid,
-			session.gid);
-		createFifo(session.responseDir + "/finish");
-		makeDirTree(session.responseDir + "/error",
-			"u=rwx,g=,o=",
-			session.uid,
-			session.gid);
-		makeDirTree(session.responseDir + "/steps",
-			"u=rwx,g=,o=",
-			session.uid,
-			session.gid);
 
+		// Instead of creating every subdirectory through its full path
+		// (which makes the kernel resolve the spawn dir and the work dir
+		// over and over again, and costs a couple of extra stat() and
+		// chmod() calls per directory), we compute the skeleton upfront
+		// and create it relative to a file descriptor of the work dir.
+		session.workDirFd = openDirFd(session.workDir->getPath());
+
+		vector<string> skeleton;
+		getWorkDirSkeleton(skeleton);
+		vector<string>::const_iterator it, end = skeleton.end();
+		for (it = skeleton.begin(); it != end; it++) {
+			createWorkDirSubdir(*it);
+		}
+		createFifo("response/finish");
+	}
 
-		createJourneyStepDirs(getFirstSubprocessJourneyStep(),
+	/**
+	 * Populates `result` with the subdirectories (relative to the
+	 * work dir) that the work dir consists of, parents before children.
+	 */
+	void getWorkDirSkeleton(vector<string> &result) const {
+		result.push_back("envdump");
+		result.push_back("envdump/annotations");
+		result.push_back("response");
+		result.push_back("response/error");
+		result.push_back("response/steps");
+		addJourneyStepDirsToSkeleton(result, getFirstSubprocessJourneyStep(),
 			getLastSubprocessJourneyStep());
-		createJourneyStepDirs(getFirstPreloaderJourneyStep(),
+		addJourneyStepDirsToSkeleton(result, getFirstPreloaderJourneyStep(),
 			// Also create directory for PRELOADER_FINISH;
 			// the preloader will want to write there.
 			JourneyStep((int) getLastPreloaderJourneyStep() + 1));
 	}
 
-	void createJourneyStepDirs(JourneyStep firstStep, JourneyStep lastStep) {
+	void addJourneyStepDirsToSkeleton(vector<string> &result, JourneyStep firstStep,
+		JourneyStep lastStep) const
+	{
 		JourneyStep step;
 
 		for (step = firstStep; step < lastStep; step = JourneyStep((int) step + 1)) {
@@ -167,31 +172,59 @@ private:
 				continue;
 			}
 
-			string stepString = journeyStepToStringLowerCase(step);
-			string stepDir = session.responseDir + "/steps/" + stepString;
-			makeDirTree(stepDir, "u=rwx,g=,o=", session.uid, session.gid);
+			result.push_back("response/steps/" + journeyStepToStringLowerCase(step));
 		}
 	}
 
-	void createFifo(const string &path) {
+	void createWorkDirSubdir(const string &relativePath) {
 		int ret;
 
+		// The work dir is freshly created with mkdtemp() and is not
+		// accessible by anybody else, so we don't need to protect
+		// against existing entries. The umask can only take away
+		// permission bits, so the result is never more permissive
+		// than u=rwx,g=,o=.
 		do {
-			ret = mkfifo(path.c_str(), 0600);
+			ret = mkdirat(session.workDirFd, relativePath.c_str(), S_IRWXU);
 		} while (ret == -1 && errno == EINTR);
 		if (ret == -1) {
 			int e = errno;
+			string path = session.workDir->getPath() + "/" + relativePath;
+			throw FileSystemException("Cannot create directory " + path,
+				e, path);
+		}
+
+		chownWorkDirEntry(relativePath, "directory");
+	}
+
+	void createFifo(const string &relativePath) {
+		int ret;
+
+		do {
+			ret = mkfifoat(session.workDirFd, relativePath.c_str(), 0600);
+		} while (ret == -1 && errno == EINTR);
+		if (ret == -1) {
+			int e = errno;
+			string path = session.workDir->getPath() + "/" + relativePath;
 			throw FileSystemException("Cannot create FIFO file " + path,
 				e, path);
 		}
 
-		ret = syscalls::chown(path.c_str(),
-			session.uid,
-			session.gid);
+		chownWorkDirEntry(relativePath, "FIFO file");
+	}
+
+	void chownWorkDirEntry(const string &relativePath, const char *description) {
+		int ret;
+
+		do {
+			ret = fchownat(session.workDirFd, relativePath.c_str(),
+				session.uid, session.gid, AT_SYMLINK_NOFOLLOW);
+		} while (ret == -1 && errno == EINTR);
 		if (ret == -1) {
 			int e = errno;
+			string path = session.workDir->getPath() + "/" + relativePath;
 			throw FileSystemException(
-				"Cannot change ownership for FIFO file " + path,
+				"Cannot change ownership for " + string(description) + " " + path,
 				e, path);
 		}
 	}
@@ -199,11 +232,10 @@ private:
 	// Open various workdir subdirectories because we'll use these file descriptors later in
 	// safeReadFile() calls.
 	void openWorkDirSubdirFds() {
-		session.workDirFd = openDirFd(session.workDir->getPath());
-		session.responseDirFd = openDirFd(session.responseDir);
-		session.responseErrorDirFd = openDirFd(session.responseDir + "/error");
-		session.envDumpDirFd = openDirFd(session.envDumpDir);
-		session.envDumpAnnotationsDirFd = openDirFd(session.envDumpDir + "/annotations");
+		session.responseDirFd = openWorkDirSubdirFd("response");
+		session.responseErrorDirFd = openWorkDirSubdirFd("response/error");
+		session.envDumpDirFd = openWorkDirSubdirFd("envdump");
+		session.envDumpAnnotationsDirFd = openWorkDirSubdirFd("envdump/annotations");
 		openJourneyStepDirFds(getFirstSubprocessJourneyStep(),
 			getLastSubprocessJourneyStep());
 		openJourneyStepDirFds(getFirstPreloaderJourneyStep(),
@@ -219,8 +251,8 @@ private:
 			}
 
 			string stepString = journeyStepToStringLowerCase(step);
-			string stepDir = session.responseDir + "/steps/" + stepString;
-			session.stepDirFds.insert(make_pair(step, openDirFd(stepDir)));
+			session.stepDirFds.insert(make_pair(step,
+				openWorkDirSubdirFd("response/steps/" + stepString)));
 		}
 	}
 
@@ -233,6 +265,17 @@ private:
 		return fd;
 	}
 
+	int openWorkDirSubdirFd(const string &relativePath) {
+		int fd = syscalls::openat(session.workDirFd, relativePath.c_str(),
+			O_RDONLY | O_NOFOLLOW);
+		if (fd == -1) {
+			int e = errno;
+			string path = session.workDir->getPath() + "/" + relativePath;
+			throw FileSystemException("Cannot open " + path, e, path);
+		}
+		return fd;
+	}
+
 	void initializeResult() {
 		session.result.initialize(*context, config);
 	}
@@ -279,6 +322,27 @@ private:
 		}
 	}
 
+	void prepareShellEnvvarsCache() {
+		TRACE_POINT();
+		ShellEnvvarsCache &cache = context->shellEnvvarsCache;
+		if (!config->loadShellEnvvars || cache.getTtl() == 0) {
+			return;
+		}
+
+		session.shellEnvvarsCacheKey = ShellEnvvarsCache::makeKey(
+			config->user, args["app_root"].asString(), session.shell);
+		session.shellStartupFileStamps = ShellEnvvarsCache::stampStartupFiles(
+			session.shell, session.homedir);
+		args["shell_envvars_cache_enabled"] = true;
+
+		Json::Value doc;
+		if (cache.lookup(session.shellEnvvarsCacheKey, session.shellStartupFileStamps, doc)) {
+			P_DEBUG("[App " << config->appRoot << "] Passing cached shell environment"
+				" variables to the SpawnEnvSetupper");
+			args["shell_envvars_cache"] = doc;
+		}
+	}
+
 	void dumpArgsIntoWorkDir() {
 		TRACE_POINT();
 		P_DEBUG("[App spawn arg] " << args.toStyledString());
@@ -580,6 +644,7 @@ public:
 			preparePredefinedArgs();
 			prepareArgsFromAppConfig();
 			absolutizeKeyArgPaths();
+			prepareShellEnvvarsCache();
 			dumpArgsIntoWorkDir();
 
 			if (debugSupport != NULL) {
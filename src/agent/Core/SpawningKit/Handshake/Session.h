@@ -65,6 +65,14 @@ struct HandshakeSession {
 	string homedir;
 	string shell;
 
+	/**
+	 * Only set if the shell envvars cache is in use. The startup file stamps
+	 * are taken before the subprocess is started, and are stored along with
+	 * the shell envvars that the subprocess reports back.
+	 */
+	string shellEnvvarsCacheKey;
+	ShellEnvvarsCache::FileStamps shellStartupFileStamps;
+
 	unsigned long long timeoutUsec;
 
 	/**
@@ -27,6 +27,7 @@
 #define _PASSENGER_SPAWNING_KIT_HANDSHAKE_JOURNEY_H_
 
 #include <map>
+#include <vector>
 #include <utility>
 
 #include <oxt/macros.hpp>
@@ -408,6 +409,26 @@ public:
 		info.endTime = timestamp;
 	}
 
+	/**
+	 * Appends the durations (in microseconds) of all steps that have been
+	 * performed to `result`.
+	 */
+	void getPerformedStepDurations(vector< pair<JourneyStep, unsigned long long> > &result) const {
+		Map::const_iterator it, end = steps.end();
+		for (it = steps.begin(); it != end; it++) {
+			const JourneyStepInfo &info = it->second;
+			if (info.state != STEP_PERFORMED || info.beginTime == 0) {
+				continue;
+			}
+
+			const JourneyStepInfo *nextStepInfo = NULL;
+			if (info.nextStep != UNKNOWN_JOURNEY_STEP) {
+				nextStepInfo = &steps.find(info.nextStep)->second;
+			}
+			result.push_back(make_pair(it->first, info.usecDuration(nextStepInfo)));
+		}
+	}
+
 	void reset() {
 		Map::iterator it, end = steps.end();
 		for (it = steps.begin(); it != end; it++) {
@@ -28,6 +28,7 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 
 #include <sys/types.h>
 
@@ -37,6 +38,7 @@
 #include <ConfigKit/ConfigKit.h>
 #include <Core/SpawningKit/Context.h>
 #include <Core/SpawningKit/Config.h>
+#include <Core/SpawningKit/Journey.h>
 
 namespace Passenger {
 namespace SpawningKit {
@@ -61,6 +63,8 @@ public:
 				add("description", STRING_TYPE, OPTIONAL);
 				add("concurrency", INT_TYPE, OPTIONAL, -1);
 				add("accept_http_requests", BOOL_TYPE, OPTIONAL, false);
+				add("framed_request_bodies", BOOL_TYPE, OPTIONAL, false);
+				add("binary_session_header_version", UINT_TYPE, OPTIONAL, 0);
 
 				finalize();
 			}
@@ -76,10 +80,25 @@ public:
 		 */
 		int concurrency;
 		bool acceptHttpRequests;
+		/**
+		 * Only meaningful for the "session" protocol. Whether the app reads
+		 * request bodies up to CONTENT_LENGTH instead of until EOF, so that
+		 * Passenger does not have to half-close the connection to mark the
+		 * end of the body, and can keep the connection alive afterwards.
+		 */
+		bool framedRequestBodies;
+		/**
+		 * Only meaningful for the "session" protocol. The highest version of
+		 * the binary request header encoding that the app can parse, or 0 if
+		 * it only understands the NUL-separated encoding.
+		 */
+		unsigned int binarySessionHeaderVersion;
 
 		Socket()
 			: concurrency(-1),
-			  acceptHttpRequests(false)
+			  acceptHttpRequests(false),
+			  framedRequestBodies(false),
+			  binarySessionHeaderVersion(0)
 			{ }
 
 		Socket(const Schema &schema, const Json::Value &values) {
@@ -98,6 +117,8 @@ public:
 			}
 			concurrency = store["concurrency"].asInt();
 			acceptHttpRequests = store["accept_http_requests"].asBool();
+			framedRequestBodies = store["framed_request_bodies"].asBool();
+			binarySessionHeaderVersion = store["binary_session_header_version"].asUInt();
 		}
 
 		Json::Value inspectAsJson() const {
@@ -109,6 +130,8 @@ public:
 			}
 			doc["concurrency"] = concurrency;
 			doc["accept_http_requests"] = acceptHttpRequests;
+			doc["framed_request_bodies"] = framedRequestBodies;
+			doc["binary_session_header_version"] = binarySessionHeaderVersion;
 			return doc;
 		}
 	};
@@ -195,6 +218,15 @@ public:
 	vector<Socket> sockets;
 
 
+	/****** Fields supplied by the Spawner ******/
+
+	/**
+	 * Durations (in microseconds) of the journey steps that were performed
+	 * during a successful spawn. Used for spawn timing statistics.
+	 */
+	vector< pair<JourneyStep, unsigned long long> > stepDurations;
+
+
 	Result()
 		: pid(-1),
 		  type(UNKNOWN),
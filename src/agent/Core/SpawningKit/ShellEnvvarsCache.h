@@ -0,0 +1,291 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2011-2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef _PASSENGER_SPAWNING_KIT_SHELL_ENVVARS_CACHE_H_
+#define _PASSENGER_SPAWNING_KIT_SHELL_ENVVARS_CACHE_H_
+
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include <jsoncpp/json.h>
+
+#include <StaticString.h>
+#include <FileTools/PathManip.h>
+#include <SystemTools/SystemTime.h>
+
+namespace Passenger {
+namespace SpawningKit {
+
+using namespace std;
+
+
+/**
+ * Caches the environment variable changes that the OS shell makes when
+ * `loadShellEnvvars` is enabled, so that subsequent spawns of the same app
+ * don't have to start a login shell again. Starting a login shell can take
+ * a significant amount of time when the user's startup files do heavy work
+ * (e.g. initializing RVM, rbenv or nvm).
+ *
+ * The cache is populated by the SpawnEnvSetupper: it records the environment
+ * before and after the shell ran, and writes the difference to
+ * `response/shell_envvars.json` in the work directory. HandshakePerform stores
+ * that difference here. HandshakePrepare passes a cached entry to the
+ * SpawnEnvSetupper through the `shell_envvars_cache` argument.
+ *
+ * An entry is keyed on (user, app root, shell) and is invalidated when:
+ *
+ *  - its TTL expires;
+ *  - any of the shell's startup files (e.g. /etc/profile, ~/.bashrc) is
+ *    created, removed, or changes in modification time or size.
+ *
+ * The SpawnEnvSetupper additionally only applies an entry if the environment
+ * it would have passed to the shell is identical to the one that the entry
+ * was recorded with (see `input_envvars`). So if the app's configured
+ * environment variables change, the shell is started again.
+ *
+ * This class is thread-safe.
+ */
+class ShellEnvvarsCache {
+public:
+	struct FileStamp {
+		string path;
+		bool exists;
+		time_t mtime;
+		off_t size;
+
+		FileStamp()
+			: exists(false),
+			  mtime(0),
+			  size(0)
+			{ }
+
+		bool operator==(const FileStamp &other) const {
+			return path == other.path
+				&& exists == other.exists
+				&& mtime == other.mtime
+				&& size == other.size;
+		}
+
+		bool operator!=(const FileStamp &other) const {
+			return !operator==(other);
+		}
+	};
+
+	typedef vector<FileStamp> FileStamps;
+
+private:
+	struct Entry {
+		Json::Value doc;
+		FileStamps stamps;
+		unsigned long long storedAt;
+	};
+
+	mutable boost::mutex syncher;
+	map<string, Entry> entries;
+	unsigned int ttl;
+
+	static void addStamp(FileStamps &stamps, const string &path) {
+		struct stat buf;
+		FileStamp stamp;
+		int ret;
+
+		stamp.path = path;
+		do {
+			ret = stat(path.c_str(), &buf);
+		} while (ret == -1 && errno == EINTR);
+		if (ret == 0) {
+			stamp.exists = true;
+			stamp.mtime = buf.st_mtime;
+			stamp.size = buf.st_size;
+		}
+		stamps.push_back(stamp);
+	}
+
+	/**
+	 * Stamps a directory like /etc/profile.d, as well as every file in it.
+	 * The directory's own stamp catches files being added or removed.
+	 */
+	static void addDirStamps(FileStamps &stamps, const string &path) {
+		addStamp(stamps, path);
+		if (!stamps.back().exists) {
+			return;
+		}
+
+		DIR *dir = opendir(path.c_str());
+		if (dir == NULL) {
+			return;
+		}
+
+		vector<string> names;
+		struct dirent *ent;
+		while ((ent = readdir(dir)) != NULL) {
+			if (ent->d_name[0] != '.') {
+				names.push_back(ent->d_name);
+			}
+		}
+		closedir(dir);
+
+		std::sort(names.begin(), names.end());
+		vector<string>::const_iterator it, end = names.end();
+		for (it = names.begin(); it != end; it++) {
+			addStamp(stamps, path + "/" + *it);
+		}
+	}
+
+public:
+	ShellEnvvarsCache()
+		: ttl(0)
+		{ }
+
+	static string makeKey(const StaticString &user, const StaticString &appRoot,
+		const StaticString &shell)
+	{
+		string result;
+		result.reserve(user.size() + appRoot.size() + shell.size() + 2);
+		result.append(user.data(), user.size());
+		result.append(1, '\0');
+		result.append(appRoot.data(), appRoot.size());
+		result.append(1, '\0');
+		result.append(shell.data(), shell.size());
+		return result;
+	}
+
+	/**
+	 * Stats the startup files that the given shell reads when started as a
+	 * login shell, in the given home directory and in /etc.
+	 */
+	static FileStamps stampStartupFiles(const string &shell, const string &homedir) {
+		string shellName = extractBaseName(shell);
+		FileStamps stamps;
+
+		if (shellName == "bash") {
+			addStamp(stamps, "/etc/profile");
+			addDirStamps(stamps, "/etc/profile.d");
+			addStamp(stamps, "/etc/bash.bashrc");
+			addStamp(stamps, "/etc/bashrc");
+			addStamp(stamps, homedir + "/.bash_profile");
+			addStamp(stamps, homedir + "/.bash_login");
+			addStamp(stamps, homedir + "/.profile");
+			addStamp(stamps, homedir + "/.bashrc");
+		} else if (shellName == "zsh") {
+			const char *names[] = { "zshenv", "zprofile", "zshrc", "zlogin" };
+			for (unsigned int i = 0; i < sizeof(names) / sizeof(const char *); i++) {
+				addStamp(stamps, string("/etc/") + names[i]);
+				addStamp(stamps, string("/etc/zsh/") + names[i]);
+				addStamp(stamps, homedir + "/." + names[i]);
+			}
+			addStamp(stamps, "/etc/profile");
+			addDirStamps(stamps, "/etc/profile.d");
+		} else {
+			addStamp(stamps, "/etc/profile");
+			addDirStamps(stamps, "/etc/profile.d");
+			addStamp(stamps, homedir + "/.profile");
+		}
+
+		return stamps;
+	}
+
+	unsigned int getTtl() const {
+		boost::lock_guard<boost::mutex> l(syncher);
+		return ttl;
+	}
+
+	/**
+	 * Sets the maximum age of cache entries, in seconds. 0 disables the cache.
+	 */
+	void setTtl(unsigned int value) {
+		boost::lock_guard<boost::mutex> l(syncher);
+		ttl = value;
+		if (value == 0) {
+			entries.clear();
+		}
+	}
+
+	/**
+	 * Looks up the entry for the given key. Returns false if there is no
+	 * such entry, or if it has been invalidated, in which case it is removed.
+	 */
+	bool lookup(const string &key, const FileStamps &currentStamps, Json::Value &doc) {
+		boost::lock_guard<boost::mutex> l(syncher);
+		map<string, Entry>::iterator it = entries.find(key);
+		if (it == entries.end()) {
+			return false;
+		}
+
+		const Entry &entry = it->second;
+		unsigned long long now = SystemTime::getMonotonicUsec();
+		if (ttl == 0
+		 || now >= entry.storedAt + ttl * 1000000ull
+		 || entry.stamps != currentStamps)
+		{
+			entries.erase(it);
+			return false;
+		}
+
+		doc = entry.doc;
+		return true;
+	}
+
+	/**
+	 * Stores an entry. `stamps` must have been obtained through
+	 * `stampStartupFiles()` *before* the shell was started, so that changes
+	 * made to startup files while the shell ran invalidate the entry.
+	 */
+	void store(const string &key, const Json::Value &doc, const FileStamps &stamps) {
+		boost::lock_guard<boost::mutex> l(syncher);
+		if (ttl == 0) {
+			return;
+		}
+
+		Entry &entry = entries[key];
+		entry.doc = doc;
+		entry.stamps = stamps;
+		entry.storedAt = SystemTime::getMonotonicUsec();
+	}
+
+	void clear() {
+		boost::lock_guard<boost::mutex> l(syncher);
+		entries.clear();
+	}
+
+	unsigned int size() const {
+		boost::lock_guard<boost::mutex> l(syncher);
+		return entries.size();
+	}
+};
+
+
+} // namespace SpawningKit
+} // namespace Passenger
+
+#endif /* _PASSENGER_SPAWNING_KIT_SHELL_ENVVARS_CACHE_H_ */
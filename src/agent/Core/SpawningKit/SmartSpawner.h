@@ -30,6 +30,7 @@
 #include <oxt/system_calls.hpp>
 #include <boost/bind/bind.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <string>
 #include <vector>
 #include <map>
@@ -83,7 +84,7 @@ private:
 	StringKeyTable<string> preloaderAnnotations;
 	AppPoolOptions options;
 
-	// Protects m_lastUsed and pid.
+	// Protects m_lastUsed, pid, batchSpawningUnsupported and preloadingFailed.
 	mutable boost::mutex simpleFieldSyncher;
 	// Protects everything else.
 	mutable boost::mutex syncher;
@@ -93,6 +94,15 @@ private:
 	FileDescriptor preloaderStdin;
 	string socketAddress;
 	unsigned long long m_lastUsed;
+	// Set when the preloader rejected a `spawn_batch` command, e.g. because
+	// it's a third-party preloader that only supports `spawn`.
+	bool batchSpawningUnsupported;
+	// Spawner to use when the preloader cannot be started. See
+	// setFallbackSpawner().
+	SpawnerPtr fallbackSpawner;
+	// Set when the preloader failed to start and all spawns go through
+	// `fallbackSpawner` instead.
+	bool preloadingFailed;
 
 
 	/**
@@ -302,6 +312,39 @@ private:
 		state->stdoutAndErrOpenErrno = e;
 	}
 
+	/**
+	 * Starts the preloader if it isn't already running. Returns false if
+	 * spawning should go through `fallbackSpawner` instead, which is the
+	 * case once the preloader failed to start. Without a fallback spawner,
+	 * the SpawnException is propagated.
+	 */
+	bool startPreloaderOrFallBack() {
+		if (preloaderStarted()) {
+			return true;
+		} else if (fallbackSpawner != NULL) {
+			{
+				boost::lock_guard<boost::mutex> l(simpleFieldSyncher);
+				if (preloadingFailed) {
+					return false;
+				}
+			}
+			try {
+				startPreloader();
+			} catch (const SpawnException &e) {
+				P_WARN("Could not start the preloader for " << options.appRoot
+					<< ", spawning processes without preloading from now on: "
+					<< e.what());
+				boost::lock_guard<boost::mutex> l(simpleFieldSyncher);
+				preloadingFailed = true;
+				return false;
+			}
+			return true;
+		} else {
+			startPreloader();
+			return true;
+		}
+	}
+
 	bool preloaderStarted() const {
 		return pid != -1;
 	}
@@ -743,7 +786,9 @@ private:
 		}
 	}
 
-	Json::Value parseForkCommandResponse(HandshakeSession &session, const string &data) {
+	Json::Value parseForkCommandResponse(HandshakeSession &session, const string &data,
+		bool batch = false)
+	{
 		TRACE_POINT();
 		Json::Value doc;
 		Json::Reader reader;
@@ -772,7 +817,7 @@ private:
 		}
 
 		UPDATE_TRACE_POINT();
-		if (!validateForkCommandResponse(doc)) {
+		if (!validateForkCommandResponse(doc, batch)) {
 			session.journey.setStepErrored(SPAWNING_KIT_PARSE_RESPONSE_FROM_PRELOADER);
 
 			SpawnException e(INTERNAL_ERROR, session.journey, session.config);
@@ -799,14 +844,29 @@ private:
 		return doc;
 	}
 
-	bool validateForkCommandResponse(const Json::Value &doc) const {
+	bool validateForkCommandResponse(const Json::Value &doc, bool batch = false) const {
 		if (!doc.isObject()) {
 			return false;
 		}
 		if (!doc.isMember("result") || !doc["result"].isString()) {
 			return false;
 		}
-		if (doc["result"].asString() == "ok") {
+		if (doc["result"].asString() == "ok" && batch) {
+			// A `spawn_batch` response contains one `spawn`-style
+			// response per work directory.
+			if (!doc.isMember("results") || !doc["results"].isArray()
+				|| doc["results"].empty())
+			{
+				return false;
+			}
+			Json::Value::const_iterator it, end = doc["results"].end();
+			for (it = doc["results"].begin(); it != end; it++) {
+				if (!validateForkCommandResponse(*it)) {
+					return false;
+				}
+			}
+			return true;
+		} else if (doc["result"].asString() == "ok") {
 			if (!doc.isMember("pid") || !doc["pid"].isInt()) {
 				return false;
 			}
@@ -979,6 +1039,319 @@ private:
 		throw e.finalize();
 	}
 
+	/**
+	 * The state of a single process within a batch spawn.
+	 */
+	struct BatchItem {
+		boost::scoped_ptr<HandshakeSession> session;
+		StdChannelsAsyncOpenStatePtr stdChannelsAsyncOpenState;
+		ForkResult forkResult;
+		JourneyStep stepToMarkAsErrored;
+		boost::shared_ptr<SpawnException> error;
+
+		BatchItem()
+			: stepToMarkAsErrored(SPAWNING_KIT_PREPARATION)
+			{ }
+	};
+
+	typedef boost::shared_ptr<BatchItem> BatchItemPtr;
+
+	static void setBatchStepInProgress(const vector<BatchItemPtr> &items, JourneyStep step) {
+		vector<BatchItemPtr>::const_iterator it, end = items.end();
+		for (it = items.begin(); it != end; it++) {
+			(*it)->session->journey.setStepInProgress(step);
+			(*it)->stepToMarkAsErrored = step;
+		}
+	}
+
+	static void setBatchStepPerformed(const vector<BatchItemPtr> &items, JourneyStep step) {
+		vector<BatchItemPtr>::const_iterator it, end = items.end();
+		for (it = items.begin(); it != end; it++) {
+			(*it)->session->journey.setStepPerformed(step);
+		}
+	}
+
+	void setBatchItemError(BatchItem &item, SpawnException &e) {
+		addPreloaderEnvDumps(e);
+		item.error = boost::make_shared<SpawnException>(e);
+	}
+
+	void setBatchItemError(BatchItem &item, const std::exception &originalException) {
+		item.session->journey.setStepErrored(item.stepToMarkAsErrored, true);
+		SpawnException e(originalException, item.session->journey,
+			item.session->config);
+		addPreloaderEnvDumps(e);
+		item.error = boost::make_shared<SpawnException>(e.finalize());
+	}
+
+	void prepareBatchItem(BatchItem &item, Config &config, const Json::Value &extraArgs) {
+		TRACE_POINT();
+		item.session.reset(new HandshakeSession(*context, config, SPAWN_THROUGH_PRELOADER));
+		HandshakeSession &session = *item.session;
+		session.journey.setStepInProgress(SPAWNING_KIT_PREPARATION);
+
+		HandshakePrepare prepare(session, extraArgs);
+		prepare.execute();
+		createStdChannelFifos(session);
+		prepare.finalize();
+		session.journey.setStepPerformed(SPAWNING_KIT_PREPARATION, true);
+		item.stdChannelsAsyncOpenState = openStdChannelsFifosAsynchronously(session);
+	}
+
+	void sendBatchForkCommand(const vector<BatchItemPtr> &items, const FileDescriptor &fd) {
+		TRACE_POINT();
+		Json::Value doc;
+
+		doc["command"] = "spawn_batch";
+		doc["work_dirs"] = Json::Value(Json::arrayValue);
+		vector<BatchItemPtr>::const_iterator it, end = items.end();
+		for (it = items.begin(); it != end; it++) {
+			doc["work_dirs"].append((*it)->session->workDir->getPath());
+		}
+
+		writeExact(fd, Json::FastWriter().write(doc),
+			&items.front()->session->timeoutUsec);
+	}
+
+	/**
+	 * Asks the preloader to fork one process per batch item, using a single
+	 * `spawn_batch` command. Returns false if the preloader could not be
+	 * used for this, e.g. because it does not support that command or
+	 * because it crashed. The caller should then fall back to `spawn()`,
+	 * which knows how to deal with those situations.
+	 */
+	bool invokeBatchForkCommand(const vector<BatchItemPtr> &items) {
+		TRACE_POINT();
+		HandshakeSession &firstSession = *items.front()->session;
+		FileDescriptor fd;
+		string line;
+		Json::Value doc;
+
+		try {
+			setBatchStepInProgress(items, SPAWNING_KIT_CONNECT_TO_PRELOADER);
+			fd = connectToPreloader(firstSession);
+			setBatchStepPerformed(items, SPAWNING_KIT_CONNECT_TO_PRELOADER);
+
+			setBatchStepInProgress(items, SPAWNING_KIT_SEND_COMMAND_TO_PRELOADER);
+			sendBatchForkCommand(items, fd);
+			setBatchStepPerformed(items, SPAWNING_KIT_SEND_COMMAND_TO_PRELOADER);
+
+			setBatchStepInProgress(items, SPAWNING_KIT_READ_RESPONSE_FROM_PRELOADER);
+			line = readForkCommandResponse(firstSession, fd);
+			setBatchStepPerformed(items, SPAWNING_KIT_READ_RESPONSE_FROM_PRELOADER);
+		} catch (const SystemException &e) {
+			P_WARN("Error sending a batch spawn command to the preloader: "
+				<< e.what() << ". Spawning a single process instead");
+			return false;
+		} catch (const IOException &e) {
+			P_WARN("Error sending a batch spawn command to the preloader: "
+				<< e.what() << ". Spawning a single process instead");
+			return false;
+		}
+
+		UPDATE_TRACE_POINT();
+		setBatchStepInProgress(items, SPAWNING_KIT_PARSE_RESPONSE_FROM_PRELOADER);
+		doc = parseForkCommandResponse(firstSession, line, true);
+		setBatchStepPerformed(items, SPAWNING_KIT_PARSE_RESPONSE_FROM_PRELOADER);
+
+		// Preloaders that predate the `spawn_batch` command respond with
+		// "Unknown command ...". Any other error means that this batch
+		// failed to spawn, just like a failed `spawn` command.
+		if (doc["result"].asString() == "error"
+		 && startsWith(doc["message"].asString(), P_STATIC_STRING("Unknown command")))
+		{
+			P_INFO("The preloader for " << options.appRoot << " does not support"
+				" spawning processes in batches (" << doc["message"].asString()
+				<< "). Will spawn processes one by one");
+			boost::lock_guard<boost::mutex> l(simpleFieldSyncher);
+			batchSpawningUnsupported = true;
+			return false;
+		}
+
+		UPDATE_TRACE_POINT();
+		const Json::Value &results = doc["results"];
+		setBatchStepInProgress(items, SPAWNING_KIT_PROCESS_RESPONSE_FROM_PRELOADER);
+		if (doc["result"].asString() == "error") {
+			for (unsigned int i = 0; i < items.size(); i++) {
+				try {
+					handleForkCommandResponseError(*items[i]->session, doc);
+				} catch (SpawnException &e) {
+					setBatchItemError(*items[i], e);
+				}
+			}
+			return true;
+		}
+		for (unsigned int i = 0; i < items.size(); i++) {
+			BatchItem &item = *items[i];
+			try {
+				if (i >= results.size()) {
+					throw RuntimeException("The preloader did not fork a process"
+						" for work directory " + item.session->workDir->getPath());
+				}
+				item.forkResult = handleForkCommandResponse(*item.session,
+					item.stdChannelsAsyncOpenState, results[i]);
+			} catch (SpawnException &e) {
+				setBatchItemError(item, e);
+			} catch (const std::exception &e) {
+				setBatchItemError(item, e);
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * Performs the handshakes with all processes that were successfully
+	 * forked. The processes initialize in parallel, and their handshakes
+	 * are multiplexed in a single poll() loop in this thread.
+	 */
+	void performBatchHandshakes(const vector<BatchItemPtr> &items) {
+		TRACE_POINT();
+		vector<BatchItem *> forked;
+		vector< boost::shared_ptr<HandshakePerform> > performs;
+		vector<HandshakePerform *> handshakes;
+		vector<BatchItemPtr>::const_iterator it, end = items.end();
+
+		for (it = items.begin(); it != end; it++) {
+			BatchItem *item = it->get();
+			if (item->error != NULL) {
+				continue;
+			}
+
+			HandshakeSession &session = *item->session;
+			const ForkResult &forkResult = item->forkResult;
+			session.journey.setStepPerformed(SPAWNING_KIT_PROCESS_RESPONSE_FROM_PRELOADER);
+			session.journey.setStepInProgress(PRELOADER_PREPARATION);
+			session.journey.setStepInProgress(SPAWNING_KIT_HANDSHAKE_PERFORM);
+			item->stepToMarkAsErrored = SPAWNING_KIT_HANDSHAKE_PERFORM;
+
+			forked.push_back(item);
+			performs.push_back(boost::make_shared<HandshakePerform>(
+				boost::ref(session), forkResult.pid, forkResult.stdinFd,
+				forkResult.stdoutAndErrFd, forkResult.alreadyReadStdoutAndErrData));
+			handshakes.push_back(performs.back().get());
+		}
+		if (forked.empty()) {
+			return;
+		}
+
+		UPDATE_TRACE_POINT();
+		vector<Result> results;
+		vector< boost::shared_ptr<SpawnException> > errors;
+		HandshakePerform::executeConcurrently(handshakes, results, errors);
+
+		for (unsigned int i = 0; i < forked.size(); i++) {
+			HandshakeSession &session = *forked[i]->session;
+			if (errors[i] != NULL) {
+				setBatchItemError(*forked[i], *errors[i]);
+			} else {
+				session.journey.setStepPerformed(SPAWNING_KIT_HANDSHAKE_PERFORM);
+				session.journey.getPerformedStepDurations(session.result.stepDurations);
+			}
+		}
+	}
+
+	static void killBatchProcesses(const vector<BatchItemPtr> &items) {
+		vector<BatchItemPtr>::const_iterator it, end = items.end();
+		for (it = items.begin(); it != end; it++) {
+			if ((*it)->forkResult.pid != -1) {
+				nonInterruptableKillAndWaitpid((*it)->forkResult.pid);
+			}
+		}
+	}
+
+	/**
+	 * Returns false if the caller should fall back to `spawn()`.
+	 */
+	bool internalSpawnBatch(const AppPoolOptions &options, unsigned int count,
+		vector<Result> &results)
+	{
+		TRACE_POINT();
+		boost::lock_guard<boost::mutex> l(syncher);
+		if (!startPreloaderOrFallBack()) {
+			return false;
+		}
+
+		UPDATE_TRACE_POINT();
+		Config config;
+		Json::Value extraArgs;
+		vector<BatchItemPtr> items;
+		setConfigFromAppPoolOptionsOrThrow(&config, extraArgs, options);
+
+		// Preparation errors are reported by `spawn()`, and are likely
+		// to affect all processes in the batch.
+		for (unsigned int i = 0; i < count; i++) {
+			BatchItemPtr item = boost::make_shared<BatchItem>();
+			try {
+				prepareBatchItem(*item, config, extraArgs);
+			} catch (const std::exception &e) {
+				P_DEBUG("Error preparing a batch spawn: " << e.what());
+				break;
+			}
+			items.push_back(item);
+		}
+		if (items.empty()) {
+			return false;
+		}
+
+		UPDATE_TRACE_POINT();
+		try {
+			if (!invokeBatchForkCommand(items)) {
+				return false;
+			}
+			performBatchHandshakes(items);
+		} catch (...) {
+			killBatchProcesses(items);
+			throw;
+		}
+
+		UPDATE_TRACE_POINT();
+		SpawnException *firstError = NULL;
+		vector<BatchItemPtr>::const_iterator it, end = items.end();
+		for (it = items.begin(); it != end; it++) {
+			BatchItem &item = **it;
+			if (item.error == NULL) {
+				results.push_back(item.session->result);
+			} else {
+				if (item.forkResult.pid != -1) {
+					nonInterruptableKillAndWaitpid(item.forkResult.pid);
+				}
+				if (firstError == NULL) {
+					firstError = item.error.get();
+				}
+			}
+		}
+
+		if (results.empty()) {
+			throw *firstError;
+		}
+		for (it = items.begin(); it != end; it++) {
+			if ((*it)->error != NULL) {
+				P_WARN("Unable to spawn one of a batch of " << items.size()
+					<< " processes for " << options.appRoot << ": "
+					<< (*it)->error->what());
+			}
+		}
+		P_DEBUG("Batch spawning done: appRoot=" << options.appRoot
+			<< ", spawned " << results.size() << " of " << items.size()
+			<< " processes");
+		return true;
+	}
+
+	void setConfigFromAppPoolOptionsOrThrow(Config *config, Json::Value &extraArgs,
+		const AppPoolOptions &options)
+	{
+		try {
+			setConfigFromAppPoolOptions(config, extraArgs, options);
+		} catch (const std::exception &originalException) {
+			Journey journey(SPAWN_THROUGH_PRELOADER, true);
+			journey.setStepErrored(SPAWNING_KIT_PREPARATION, true);
+			SpawnException e(originalException, journey, config);
+			addPreloaderEnvDumps(e);
+			throw e.finalize();
+		}
+	}
+
 	void createStdChannelFifos(const HandshakeSession &session) {
 		const string &workDir = session.workDir->getPath();
 		createFifo(session, workDir + "/stdin");
@@ -1256,6 +1629,8 @@ public:
 		options    = _options.copyAndPersist();
 		pid        = -1;
 		m_lastUsed = SystemTime::getUsec();
+		batchSpawningUnsupported = false;
+		preloadingFailed = false;
 	}
 
 	virtual ~SmartSpawner() {
@@ -1277,23 +1652,15 @@ public:
 		}
 		UPDATE_TRACE_POINT();
 		boost::lock_guard<boost::mutex> l(syncher);
-		if (!preloaderStarted()) {
+		if (!startPreloaderOrFallBack()) {
 			UPDATE_TRACE_POINT();
-			startPreloader();
+			return fallbackSpawner->spawn(options);
 		}
 
 		UPDATE_TRACE_POINT();
 		Config config;
 		Json::Value extraArgs;
-		try {
-			setConfigFromAppPoolOptions(&config, extraArgs, options);
-		} catch (const std::exception &originalException) {
-			Journey journey(SPAWN_THROUGH_PRELOADER, true);
-			journey.setStepErrored(SPAWNING_KIT_PREPARATION, true);
-			SpawnException e(originalException, journey, &config);
-			addPreloaderEnvDumps(e);
-			throw e.finalize();
-		}
+		setConfigFromAppPoolOptionsOrThrow(&config, extraArgs, options);
 
 		UPDATE_TRACE_POINT();
 		HandshakeSession session(*context, config, SPAWN_THROUGH_PRELOADER);
@@ -1325,6 +1692,7 @@ public:
 				execute();
 			guard.clear();
 			session.journey.setStepPerformed(SPAWNING_KIT_HANDSHAKE_PERFORM);
+			session.journey.getPerformedStepDurations(session.result.stepDurations);
 			P_DEBUG("Process spawning done: appRoot=" << options.appRoot <<
 				", pid=" << forkResult.pid);
 			return session.result;
@@ -1340,6 +1708,36 @@ public:
 		}
 	}
 
+	virtual vector<Result> spawnBatch(const AppPoolOptions &options, unsigned int count) {
+		TRACE_POINT();
+		if (count <= 1 || !supportsBatchSpawning()) {
+			return Spawner::spawnBatch(options, count);
+		}
+
+		P_ASSERT_EQ(options.appType, this->options.appType);
+		P_ASSERT_EQ(options.appRoot, this->options.appRoot);
+
+		P_DEBUG("Spawning batch of " << count << " new processes: appRoot="
+			<< options.appRoot);
+		possiblyRaiseInternalError(options);
+
+		{
+			boost::lock_guard<boost::mutex> l(simpleFieldSyncher);
+			m_lastUsed = SystemTime::getUsec();
+		}
+
+		vector<Result> results;
+		if (!internalSpawnBatch(options, count, results)) {
+			results.push_back(spawn(options));
+		}
+		return results;
+	}
+
+	virtual bool supportsBatchSpawning() const {
+		boost::lock_guard<boost::mutex> l(simpleFieldSyncher);
+		return !batchSpawningUnsupported && !preloadingFailed;
+	}
+
 	virtual bool cleanable() const {
 		return true;
 	}
@@ -1359,6 +1757,21 @@ public:
 		return m_lastUsed;
 	}
 
+	/**
+	 * Sets a spawner to fall back to when the preloader fails to start,
+	 * instead of failing the spawn. Once that happens, all further spawns
+	 * go through the fallback spawner for as long as this SmartSpawner
+	 * lives. Must be called before the first spawn.
+	 */
+	void setFallbackSpawner(const SpawnerPtr &spawner) {
+		fallbackSpawner = spawner;
+	}
+
+	bool isPreloadingFailed() const {
+		boost::lock_guard<boost::mutex> lock(simpleFieldSyncher);
+		return preloadingFailed;
+	}
+
 	pid_t getPreloaderPid() const {
 		boost::lock_guard<boost::mutex> lock(simpleFieldSyncher);
 		return pid;
@@ -28,6 +28,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <oxt/system_calls.hpp>
+#include <vector>
 
 #include <modp_b64.h>
 
@@ -170,6 +171,32 @@ public:
 
 	virtual Result spawn(const AppPoolOptions &options) = 0;
 
+	/**
+	 * Spawns up to `count` processes at once. Spawners that can start
+	 * multiple processes more cheaply together than one by one (e.g.
+	 * SmartSpawner, which can ask its preloader to fork them all in a
+	 * single round-trip) override this.
+	 *
+	 * Returns at least one Result. If not a single process could be
+	 * spawned then this method throws, just like `spawn()`. Processes that
+	 * fail to spawn while others succeed are logged and left out of the
+	 * result; callers should spawn again if they still need more processes.
+	 *
+	 * The default implementation spawns exactly one process.
+	 */
+	virtual vector<Result> spawnBatch(const AppPoolOptions &options, unsigned int count) {
+		vector<Result> results;
+		results.push_back(spawn(options));
+		return results;
+	}
+
+	/**
+	 * Whether `spawnBatch()` can spawn more than one process at a time.
+	 */
+	virtual bool supportsBatchSpawning() const {
+		return false;
+	}
+
 	virtual bool cleanable() const {
 		return false;
 	}
@@ -48,6 +48,7 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <pwd.h>
 #include <grp.h>
@@ -65,6 +66,7 @@
 #include <SystemTools/UserDatabase.h>
 #include <Utils.h>
 #include <StrIntTools/StrIntUtils.h>
+#include <JsonTools/JsonUtils.h>
 #include <Core/SpawningKit/Handshake/WorkDir.h>
 #include <Core/SpawningKit/Exceptions.h>
 
@@ -376,20 +378,23 @@ lookupUserGroup(const Context &context, uid_t *uid, struct passwd **userInfo,
 
 static void
 chownNewWorkDirFiles(const Context &context, uid_t uid, gid_t gid) {
-	chown((context.workDir + "/response/steps/subprocess_before_first_exec/state").c_str(),
-		uid, gid);
-	chown((context.workDir + "/response/steps/subprocess_before_first_exec/duration").c_str(),
-		uid, gid);
-	chown((context.workDir + "/response/steps/subprocess_spawn_env_setupper_before_shell/state").c_str(),
-		uid, gid);
-	chown((context.workDir + "/response/steps/subprocess_spawn_env_setupper_before_shell/duration").c_str(),
-		uid, gid);
-	chown((context.workDir + "/envdump/envvars").c_str(),
-		uid, gid);
-	chown((context.workDir + "/envdump/user_info").c_str(),
-		uid, gid);
-	chown((context.workDir + "/envdump/ulimits").c_str(),
-		uid, gid);
+	static const char * const files[] = {
+		"response/steps/subprocess_before_first_exec/state",
+		"response/steps/subprocess_before_first_exec/duration",
+		"response/steps/subprocess_spawn_env_setupper_before_shell/state",
+		"response/steps/subprocess_spawn_env_setupper_before_shell/duration",
+		"envdump/envvars",
+		"envdump/user_info",
+		"envdump/ulimits"
+	};
+	int workDirFd = open(context.workDir.c_str(), O_RDONLY | O_NOFOLLOW);
+	if (workDirFd == -1) {
+		return;
+	}
+	for (unsigned int i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+		fchownat(workDirFd, files[i], uid, gid, AT_SYMLINK_NOFOLLOW);
+	}
+	close(workDirFd);
 }
 
 static void
@@ -747,6 +752,145 @@ shouldLoadShellEnvvars(const Json::Value &args, const string &shell) {
 	}
 }
 
+/**
+ * Environment variables whose values differ between spawns of the same
+ * application. They are ignored when caching the environment variable
+ * changes that the OS shell makes.
+ */
+static bool
+isSpawnSpecificEnvvar(const StaticString &name) {
+	return name == "PASSENGER_SPAWN_WORK_DIR" || name == "PORT";
+}
+
+static Json::Value
+snapshotEnvvars() {
+	Json::Value result(Json::objectValue);
+
+	for (char **p = environ; *p != NULL; p++) {
+		const char *sep = strchr(*p, '=');
+		if (sep == NULL) {
+			continue;
+		}
+		string name(*p, sep - *p);
+		if (!isSpawnSpecificEnvvar(name)) {
+			result[name] = sep + 1;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * If the Core passed us the environment variable changes that the OS shell
+ * made during an earlier spawn, and the environment that we would pass to
+ * the shell now is the same as back then, then apply those changes instead
+ * of running the shell.
+ */
+static bool
+applyCachedShellEnvvars(const Context &context, const string &shell,
+	const Json::Value &envvars)
+{
+	if (!context.args.isMember("shell_envvars_cache")) {
+		return false;
+	}
+
+	const Json::Value &cache = context.args["shell_envvars_cache"];
+	if (cache["shell"] != Json::Value(shell) || cache["input_envvars"] != envvars) {
+		P_DEBUG("Not using cached shell environment variables:"
+			" shell or environment changed");
+		return false;
+	}
+
+	const Json::Value &set = cache["set"];
+	Json::Value::const_iterator it, end = set.end();
+	for (it = set.begin(); it != end; it++) {
+		if (it->isString()) {
+			setenv(it.name().c_str(), it->asCString(), 1);
+		}
+	}
+
+	const Json::Value &unset = cache["unset"];
+	end = unset.end();
+	for (it = unset.begin(); it != end; it++) {
+		if (it->isString()) {
+			unsetenv(it->asCString());
+		}
+	}
+
+	P_DEBUG("Applied cached shell environment variables instead of"
+		" executing the OS shell");
+	return true;
+}
+
+/**
+ * Records the environment that we pass to the OS shell, so that
+ * `recordShellEnvvarChanges()` can later figure out what the shell changed.
+ */
+static void
+recordShellInput(const Context &context, const string &shell,
+	const Json::Value &envvars)
+{
+	Json::Value doc;
+	doc["shell"] = shell;
+	doc["envvars"] = envvars;
+	tryWriteFile(context.workDir + "/shell_envvars_input.json",
+		stringifyJson(doc));
+}
+
+/**
+ * Writes the environment variable changes made by the OS shell to
+ * response/shell_envvars.json, so that the Core can cache them. Failure
+ * to do so is not fatal: it only means that the next spawn runs the
+ * shell again.
+ */
+static void
+recordShellEnvvarChanges(const Context &context) {
+	string inputPath = context.workDir + "/shell_envvars_input.json";
+	Json::Reader reader;
+	Json::Value input;
+
+	try {
+		if (!fileExists(inputPath)) {
+			return;
+		}
+		if (!reader.parse(unsafeReadFile(inputPath), input)
+			|| !input["envvars"].isObject())
+		{
+			P_WARN("Cannot parse " << inputPath);
+			return;
+		}
+	} catch (const std::exception &e) {
+		P_WARN("Cannot read " << inputPath << ": " << e.what());
+		return;
+	}
+
+	const Json::Value &before = input["envvars"];
+	Json::Value after = snapshotEnvvars();
+	Json::Value doc;
+	Json::Value &set = doc["set"] = Json::Value(Json::objectValue);
+	Json::Value &unset = doc["unset"] = Json::Value(Json::arrayValue);
+	Json::Value::const_iterator it, end;
+
+	end = after.end();
+	for (it = after.begin(); it != end; it++) {
+		string name = it.name();
+		if (!before.isMember(name) || before[name] != *it) {
+			set[name] = *it;
+		}
+	}
+	end = before.end();
+	for (it = before.begin(); it != end; it++) {
+		if (!after.isMember(it.name())) {
+			unset.append(it.name());
+		}
+	}
+
+	doc["shell"] = input["shell"];
+	doc["input_envvars"] = before;
+	tryWriteFile(context.workDir + "/response/shell_envvars.json",
+		stringifyJson(doc));
+}
+
 static string
 commandArgsToString(const vector<const char *> &commandArgs) {
 	vector<const char *>::const_iterator it;
@@ -780,7 +924,9 @@ execNextCommand(const Context &context, const string &shell)
 	if (context.mode == BEFORE_MODE) {
 		// Note: `shell` could be empty:
 		// https://github.com/phusion/passenger/issues/2078
-		if (shouldLoadShellEnvvars(context.args, shell)) {
+		if (shouldLoadShellEnvvars(context.args, shell)
+			&& !applyCachedShellEnvvars(context, shell, snapshotEnvvars()))
+		{
 			nextJourneyStep = SpawningKit::SUBPROCESS_OS_SHELL;
 			commandArgs.push_back(shell.c_str());
 			if (LoggingKit::getLevel() >= LoggingKit::DEBUG3) {
@@ -794,6 +940,9 @@ execNextCommand(const Context &context, const string &shell)
 			// whether it should set the SUBPROCESS_OS_SHELL step to the
 			// PERFORMED state.
 			tryWriteFile(context.workDir + "/execute_through_os_shell", "");
+			if (context.args["shell_envvars_cache_enabled"].asBool()) {
+				recordShellInput(context, shell, snapshotEnvvars());
+			}
 		} else {
 			nextJourneyStep = SpawningKit::SUBPROCESS_SPAWN_ENV_SETUPPER_AFTER_SHELL;
 		}
@@ -917,6 +1066,7 @@ spawnEnvSetupperMain(int argc, char *argv[]) {
 		} else if (executedThroughShell(context)) {
 			recordJourneyStepEnd(context, SpawningKit::SUBPROCESS_OS_SHELL,
 				SpawningKit::STEP_PERFORMED);
+			recordShellEnvvarChanges(context);
 		} else {
 			recordJourneyStepEnd(context, SpawningKit::SUBPROCESS_OS_SHELL,
 				SpawningKit::STEP_NOT_STARTED);
@@ -46,6 +46,7 @@ using namespace std;
  * (do not edit: following text is automatically generated
  * by 'rake configkit_schemas_inline_comments')
  *
+ *   adaptive_request_body_buffering                                          boolean            -          default(false)
  *   admin_panel_auth_type                                                    string             -          default("basic")
  *   admin_panel_close_timeout                                                float              -          default(10.0)
  *   admin_panel_connect_timeout                                              float              -          default(30.0)
@@ -70,6 +71,7 @@ using namespace std;
  *   controller_addresses                                                     array of strings   -          default,read_only
  *   controller_client_freelist_limit                                         unsigned integer   -          default(0)
  *   controller_cpu_affine                                                    boolean            -          default(false),read_only
+ *   controller_cpu_affine_excluded_cpus                                      string             -          default(""),read_only
  *   controller_file_buffered_channel_auto_start_mover                        boolean            -          default(true)
  *   controller_file_buffered_channel_auto_truncate_file                      boolean            -          default(true)
  *   controller_file_buffered_channel_buffer_dir                              string             -          default
@@ -77,10 +79,15 @@ using namespace std;
  *   controller_file_buffered_channel_max_disk_chunk_read_size                unsigned integer   -          default(0)
  *   controller_file_buffered_channel_threshold                               unsigned integer   -          default(131072)
  *   controller_mbuf_block_chunk_size                                         unsigned integer   -          default(4096),read_only
+ *   controller_mbuf_large_block_chunk_size                                   unsigned integer   -          default(65536),read_only
+ *   controller_mbuf_small_block_chunk_size                                   unsigned integer   -          default(512),read_only
  *   controller_min_spare_clients                                             unsigned integer   -          default(0)
  *   controller_pid_file                                                      string             -          default,read_only
  *   controller_request_freelist_limit                                        unsigned integer   -          default(1024)
  *   controller_secure_headers_password                                       string             -          default,secret
+ *   controller_slab_allocator                                                boolean            -          default(false),read_only
+ *   controller_slab_allocator_hugepages                                      string             -          default("madvise"),read_only
+ *   controller_slab_allocator_max_idle_slabs                                 unsigned integer   -          default(1),read_only
  *   controller_socket_backlog                                                unsigned integer   -          default(2048),read_only
  *   controller_start_reading_after_accept                                    boolean            -          default(true)
  *   controller_threads                                                       unsigned integer   -          default,read_only
@@ -95,8 +102,13 @@ using namespace std;
  *   core_api_server_file_buffered_channel_max_disk_chunk_read_size           unsigned integer   -          default(0)
  *   core_api_server_file_buffered_channel_threshold                          unsigned integer   -          default(131072)
  *   core_api_server_mbuf_block_chunk_size                                    unsigned integer   -          default(4096),read_only
+ *   core_api_server_mbuf_large_block_chunk_size                              unsigned integer   -          default(65536),read_only
+ *   core_api_server_mbuf_small_block_chunk_size                              unsigned integer   -          default(512),read_only
  *   core_api_server_min_spare_clients                                        unsigned integer   -          default(0)
  *   core_api_server_request_freelist_limit                                   unsigned integer   -          default(1024)
+ *   core_api_server_slab_allocator                                           boolean            -          default(false),read_only
+ *   core_api_server_slab_allocator_hugepages                                 string             -          default("madvise"),read_only
+ *   core_api_server_slab_allocator_max_idle_slabs                            unsigned integer   -          default(1),read_only
  *   core_api_server_start_reading_after_accept                               boolean            -          default(true)
  *   core_file_descriptor_ulimit                                              unsigned integer   -          default(0),read_only
  *   core_pid_file                                                            string             -          read_only
@@ -104,18 +116,35 @@ using namespace std;
  *   default_abort_websockets_on_process_shutdown                             boolean            -          default(true)
  *   default_app_file_descriptor_ulimit                                       unsigned integer   -          -
  *   default_bind_address                                                     string             -          default("127.0.0.1")
+ *   default_capacity_weight                                                  unsigned integer   -          default(1)
  *   default_environment                                                      string             -          default("production")
  *   default_force_max_concurrent_requests_per_process                        integer            -          default(-1)
  *   default_friendly_error_pages                                             string             -          default("auto")
  *   default_group                                                            string             -          default
+ *   default_guaranteed_capacity                                              unsigned integer   -          default(0)
  *   default_load_shell_envvars                                               boolean            -          default(false)
+ *   default_max_concurrent_recycles                                          unsigned integer   -          default(0)
  *   default_max_preloader_idle_time                                          unsigned integer   -          default(300)
  *   default_max_request_queue_size                                           unsigned integer   -          default(100)
+ *   default_max_request_queue_time                                           unsigned integer   -          default(0)
  *   default_max_requests                                                     unsigned integer   -          default(0)
+ *   default_memory_limit                                                     unsigned integer   -          default(0)
  *   default_meteor_app_settings                                              string             -          -
  *   default_min_instances                                                    unsigned integer   -          default(1)
  *   default_nodejs                                                           string             -          default("node")
+ *   default_oobw_interval                                                    unsigned integer   -          default(0)
+ *   default_oobw_max_utilization                                             unsigned integer   -          default(0)
+ *   default_outlier_ejection_errors                                          unsigned integer   -          default(0)
+ *   default_outlier_ejection_time                                            unsigned integer   -          default(30)
+ *   default_outlier_latency_threshold                                        unsigned integer   -          default(0)
+ *   default_outlier_restart_threshold                                        unsigned integer   -          default(0)
  *   default_python                                                           string             -          default("python")
+ *   default_python_preloading                                                boolean            -          default(false)
+ *   default_recycle_limit_jitter                                             unsigned integer   -          default(0)
+ *   default_request_queue_target_delay                                       unsigned integer   -          default(0)
+ *   default_rolling_restarts                                                 boolean            -          default(false)
+ *   default_routing_key                                                      string             -          default("")
+ *   default_routing_load_factor                                              unsigned integer   -          default(125)
  *   default_ruby                                                             string             -          default("ruby")
  *   default_server_name                                                      string             -          default
  *   default_server_port                                                      unsigned integer   -          default
@@ -124,6 +153,8 @@ using namespace std;
  *   default_sticky_sessions_cookie_attributes                                string             -          default("SameSite=Lax; Secure;")
  *   default_sticky_sessions_cookie_name                                      string             -          default("_passenger_route")
  *   default_user                                                             string             -          default("nobody")
+ *   default_warmup_request_path                                              string             -          default("/")
+ *   default_warmup_requests                                                  unsigned integer   -          default(0)
  *   disable_log_prefix                                                       boolean            -          default(false)
  *   file_descriptor_log_target                                               any                -          -
  *   graceful_exit                                                            boolean            -          default(true)
@@ -146,7 +177,12 @@ using namespace std;
  *   pidfiles_to_delete_on_exit                                               array of strings   -          default([])
  *   pool_idle_time                                                           unsigned integer   -          default(300)
  *   pool_selfchecks                                                          boolean            -          default(false)
+ *   pool_spawn_batch_size                                                    unsigned integer   -          default(4)
+ *   pool_warm_spares                                                         unsigned integer   -          default(0)
  *   prestart_urls                                                            array of strings   -          default([]),read_only
+ *   request_body_buffering_memory_threshold                                  unsigned integer   -          default(65536)
+ *   request_body_buffering_min_upload_speed                                  unsigned integer   -          default(262144)
+ *   request_body_buffering_probe_time                                        unsigned integer   -          default(200)
  *   response_buffer_high_watermark                                           unsigned integer   -          default(134217728)
  *   security_update_checker_certificate_path                                 string             -          -
  *   security_update_checker_disabled                                         boolean            -          default(false)
@@ -155,6 +191,7 @@ using namespace std;
  *   security_update_checker_url                                              string             -          default("https://securitycheck.phusionpassenger.com/v1/check.json")
  *   server_software                                                          string             -          default("Phusion_Passenger/6.0.10")
  *   setsid                                                                   boolean            -          default(false)
+ *   shell_envvars_cache_ttl                                                  unsigned integer   -          default(0)
  *   show_version_in_header                                                   boolean            -          default(true)
  *   single_app_mode_app_root                                                 string             -          default,read_only
  *   single_app_mode_app_start_command                                        string             -          read_only
@@ -190,8 +227,13 @@ using namespace std;
  *   watchdog_api_server_file_buffered_channel_max_disk_chunk_read_size       unsigned integer   -          default(0)
  *   watchdog_api_server_file_buffered_channel_threshold                      unsigned integer   -          default(131072)
  *   watchdog_api_server_mbuf_block_chunk_size                                unsigned integer   -          default(4096),read_only
+ *   watchdog_api_server_mbuf_large_block_chunk_size                          unsigned integer   -          default(65536),read_only
+ *   watchdog_api_server_mbuf_small_block_chunk_size                          unsigned integer   -          default(512),read_only
  *   watchdog_api_server_min_spare_clients                                    unsigned integer   -          default(0)
  *   watchdog_api_server_request_freelist_limit                               unsigned integer   -          default(1024)
+ *   watchdog_api_server_slab_allocator                                       boolean            -          default(false),read_only
+ *   watchdog_api_server_slab_allocator_hugepages                             string             -          default("madvise"),read_only
+ *   watchdog_api_server_slab_allocator_max_idle_slabs                        unsigned integer   -          default(1),read_only
  *   watchdog_api_server_start_reading_after_accept                           boolean            -          default(true)
  *   watchdog_pid_file                                                        string             -          read_only
  *   watchdog_pid_file_autodelete                                             boolean            -          default(true)
@@ -255,7 +297,9 @@ private:
 	}
 
 	static Json::Value getDefaultSpawnDir(const ConfigKit::Store &store) {
-		return getSystemTempDir();
+		// Spawn work dirs consist of many tiny, short-lived files,
+		// so keep them off the disk if we can.
+		return getMemoryBackedTempDir();
 	}
 
 	static void validateAddresses(const ConfigKit::Store &config, vector<ConfigKit::Error> &errors) {
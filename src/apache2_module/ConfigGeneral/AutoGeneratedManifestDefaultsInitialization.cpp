@@ -131,7 +131,7 @@ ConfigManifestGenerator::autoGenerated_setGlobalConfigDefaults() {
 	addOptionsContainerDynamicDefault(
 		globalConfigContainer,
 		"PassengerSpawnDir",
-		P_STATIC_STRING("Either $TMPDIR or /tmp"));
+		P_STATIC_STRING("Either $TMPDIR, /dev/shm, or /tmp (see docs)"));
 
 	addOptionsContainerStaticDefaultInt(
 		globalConfigContainer,
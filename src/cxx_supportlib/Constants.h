@@ -53,6 +53,7 @@
 #define DEFAULT_FILE_BUFFERED_CHANNEL_THRESHOLD 131072
 #define DEFAULT_HTTP_SERVER_LISTEN_ADDRESS "tcp://127.0.0.1:3000"
 #define DEFAULT_INTEGRATION_MODE "standalone"
+#define DEFAULT_LARGE_MBUF_CHUNK_SIZE 65536
 #define DEFAULT_LOG_LEVEL 3
 #define DEFAULT_LOG_LEVEL_NAME "notice"
 #define DEFAULT_LVE_MIN_UID 500
@@ -65,6 +66,7 @@
 #define DEFAULT_PYTHON "python"
 #define DEFAULT_RESPONSE_BUFFER_HIGH_WATERMARK 134217728
 #define DEFAULT_RUBY "ruby"
+#define DEFAULT_SMALL_MBUF_CHUNK_SIZE 512
 #define DEFAULT_SOCKET_BACKLOG 2048
 #define DEFAULT_SPAWN_METHOD "smart"
 #define DEFAULT_START_TIMEOUT 90000
@@ -0,0 +1,149 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef _PASSENGER_DATA_STRUCTURES_MPSC_QUEUE_H_
+#define _PASSENGER_DATA_STRUCTURES_MPSC_QUEUE_H_
+
+#include <sched.h>
+#include <boost/atomic.hpp>
+#include <oxt/macros.hpp>
+
+namespace Passenger {
+
+using namespace std;
+
+
+/**
+ * An intrusive, lock-free, unbounded multi-producer single-consumer FIFO queue,
+ * based on Dmitry Vyukov's design:
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+ *
+ * Any number of threads may call push() concurrently. Only a single thread
+ * (the consumer) may call pop() and the other consumer methods at a time.
+ * The consumer role may be handed between threads with a mutex.
+ *
+ * Node must be default constructible and must contain a public field
+ * `boost::atomic<Node *> mpscNext`. The queue does not own the nodes:
+ * it never allocates or frees them.
+ *
+ * push() is wait-free. In the rare case that pop() observes a producer that
+ * has published a node but not yet linked it, pop() spins until the producer
+ * finishes (which takes a handful of instructions), so pop() never reports
+ * an empty queue while nodes are pending.
+ */
+template<typename Node>
+class MpscQueue {
+private:
+	// Written by producers.
+	boost::atomic<Node *> head;
+	char padding[64 - sizeof(boost::atomic<Node *>)];
+	// Only accessed by the consumer.
+	Node *tail;
+	Node stub;
+
+	static Node *waitForLink(Node *node) {
+		Node *next;
+		while ((next = node->mpscNext.load(boost::memory_order_acquire)) == NULL) {
+			sched_yield();
+		}
+		return next;
+	}
+
+public:
+	MpscQueue()
+		: head(&stub),
+		  tail(&stub)
+	{
+		stub.mpscNext.store(NULL, boost::memory_order_relaxed);
+	}
+
+	/** May be called from any thread. */
+	void push(Node *node) {
+		node->mpscNext.store(NULL, boost::memory_order_relaxed);
+		Node *prev = head.exchange(node, boost::memory_order_acq_rel);
+		prev->mpscNext.store(node, boost::memory_order_release);
+	}
+
+	/**
+	 * Removes the oldest node and returns it, or returns NULL if the queue
+	 * is empty. May only be called from the consumer thread.
+	 */
+	Node *pop() {
+		Node *tail = this->tail;
+		Node *next = tail->mpscNext.load(boost::memory_order_acquire);
+
+		if (tail == &stub) {
+			if (next == NULL) {
+				if (head.load(boost::memory_order_acquire) == &stub) {
+					return NULL;
+				}
+				next = waitForLink(tail);
+			}
+			this->tail = next;
+			tail = next;
+			next = tail->mpscNext.load(boost::memory_order_acquire);
+		}
+
+		if (next == NULL) {
+			if (head.load(boost::memory_order_acquire) == tail) {
+				// `tail` is the last node. We need a successor before we
+				// can hand it out, so put the stub back in.
+				push(&stub);
+			}
+			next = waitForLink(tail);
+		}
+
+		this->tail = next;
+		return tail;
+	}
+
+	/**
+	 * Calls `func(node)` on every node currently in the queue, oldest first,
+	 * without removing them. Nodes that are concurrently being pushed may or
+	 * may not be visited. May only be called from the consumer thread.
+	 */
+	template<typename Func>
+	void forEach(Func &func) {
+		Node *node = tail;
+		while (node != NULL) {
+			if (node != &stub) {
+				func(node);
+			}
+			node = node->mpscNext.load(boost::memory_order_acquire);
+		}
+	}
+
+	/** May only be called from the consumer thread. */
+	bool empty() const {
+		return tail == &stub
+			&& stub.mpscNext.load(boost::memory_order_acquire) == NULL
+			&& head.load(boost::memory_order_acquire) == &stub;
+	}
+};
+
+
+} // namespace Passenger
+
+#endif /* _PASSENGER_DATA_STRUCTURES_MPSC_QUEUE_H_ */
@@ -278,6 +278,12 @@ class RequestQueueFullException: public GetAbortedException {
 private:
 	string msg;
 
+protected:
+	RequestQueueFullException(const string &message)
+		: GetAbortedException(oxt::tracable_exception::no_backtrace()),
+		  msg(message)
+		{ }
+
 public:
 	RequestQueueFullException(unsigned int maxQueueSize)
 		: GetAbortedException(oxt::tracable_exception::no_backtrace())
@@ -294,6 +300,52 @@ public:
 	}
 };
 
+/**
+ * Indicates that a Pool::get() or Pool::asyncGet() request was shed from the
+ * getWaitlist queue because the queue has been persistently congested, and
+ * the request had already been waiting for too long.
+ */
+class RequestQueueOverloadedException: public RequestQueueFullException {
+private:
+	static string createMessage(unsigned long long queueTime, unsigned int targetDelay) {
+		stringstream str;
+		str << "Request queue overloaded (request was queued for " <<
+			queueTime / 1000 << " msec; configured target delay: " <<
+			targetDelay << " msec)";
+		return str.str();
+	}
+
+public:
+	RequestQueueOverloadedException(unsigned long long queueTime, unsigned int targetDelay)
+		: RequestQueueFullException(createMessage(queueTime, targetDelay))
+		{ }
+
+	virtual ~RequestQueueOverloadedException() throw() {}
+};
+
+/**
+ * Indicates that a Pool::get() or Pool::asyncGet() request was removed from
+ * the getWaitlist queue because it had been waiting for longer than its
+ * configured maximum queueing time.
+ */
+class RequestQueueTimeoutException: public RequestQueueFullException {
+private:
+	static string createMessage(unsigned long long queueTime, unsigned int maxQueueTime) {
+		stringstream str;
+		str << "Request queue timeout (request was queued for " <<
+			queueTime / 1000 << " msec; configured max. queue time: " <<
+			maxQueueTime << " msec)";
+		return str.str();
+	}
+
+public:
+	RequestQueueTimeoutException(unsigned long long queueTime, unsigned int maxQueueTime)
+		: RequestQueueFullException(createMessage(queueTime, maxQueueTime))
+		{ }
+
+	virtual ~RequestQueueTimeoutException() throw() {}
+};
+
 /**
  * Indicates that a specified argument is incorrect or violates a requirement.
  *
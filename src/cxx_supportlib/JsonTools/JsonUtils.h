@@ -122,6 +122,15 @@ getJsonUintField(const Json::Value &json, const Json::StaticString &key) {
 	}
 }
 
+inline unsigned int
+getJsonUintField(const Json::Value &json, const char *key, unsigned int defaultValue) {
+	if (json.isMember(key)) {
+		return json[key].asUInt();
+	} else {
+		return defaultValue;
+	}
+}
+
 inline unsigned int
 getJsonUintField(const Json::Value &json, const Json::StaticString &key, unsigned int defaultValue) {
 	if (json.isMember(key)) {
@@ -176,6 +185,15 @@ getJsonBoolField(const Json::Value &json, const char *key) {
 	}
 }
 
+inline bool
+getJsonBoolField(const Json::Value &json, const char *key, bool defaultValue) {
+	if (json.isMember(key)) {
+		return json[key].asBool();
+	} else {
+		return defaultValue;
+	}
+}
+
 
 inline StaticString
 getJsonStaticStringField(const Json::Value &json, const char *key) {
@@ -58,6 +58,9 @@ _mbuf_block_mark_as_active(struct mbuf_pool *pool, struct mbuf_block *mbuf_block
 	#endif
 	mbuf_block->refcount = 1;
 	pool->nactive_mbuf_blockq++;
+	if (pool->nactive_mbuf_blockq > pool->peak_active_mbuf_blockq) {
+		pool->peak_active_mbuf_blockq = pool->nactive_mbuf_blockq;
+	}
 }
 
 static struct mbuf_block *
@@ -138,7 +141,11 @@ _mbuf_block_get(struct mbuf_pool *pool)
 		return mbuf_block;
 	}
 
-	buf = (char *) malloc(pool->mbuf_block_chunk_size);
+	if (pool->slab_allocator != NULL) {
+		buf = (char *) slab_alloc(pool->slab_allocator);
+	} else {
+		buf = (char *) malloc(pool->mbuf_block_chunk_size);
+	}
 	if (OXT_UNLIKELY(buf == NULL)) {
 		return NULL;
 	}
@@ -223,10 +230,15 @@ mbuf_block_free(struct mbuf_block *mbuf_block)
 
 	if (mbuf_block->offset > 0) {
 		buf = (char *) mbuf_block - mbuf_block->offset;
+		free(buf);
 	} else {
 		buf = (char *) mbuf_block - mbuf_block->pool->mbuf_block_offset;
+		if (mbuf_block->pool->slab_allocator != NULL) {
+			slab_free(mbuf_block->pool->slab_allocator, buf);
+		} else {
+			free(buf);
+		}
 	}
-	free(buf);
 }
 
 void
@@ -273,6 +285,8 @@ mbuf_pool_init(struct mbuf_pool *pool)
 {
 	pool->nfree_mbuf_blockq = 0;
 	pool->nactive_mbuf_blockq = 0;
+	pool->peak_active_mbuf_blockq = 0;
+	pool->slab_allocator = NULL;
 	STAILQ_INIT(&pool->free_mbuf_blockq);
 
 	#ifdef MBUF_ENABLE_DEBUGGING
@@ -311,6 +325,10 @@ mbuf_pool_compact(struct mbuf_pool *pool)
 	}
 	assert(pool->nfree_mbuf_blockq == 0);
 
+	if (pool->slab_allocator != NULL) {
+		slab_allocator_release_idle(pool->slab_allocator);
+	}
+
 	return count;
 }
 
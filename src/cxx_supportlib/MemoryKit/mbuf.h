@@ -20,6 +20,7 @@
 #define _PSG_MBUF_BLOCK_H_
 
 #include <psg_sysqueue.h>
+#include <MemoryKit/slab.h>
 #include <algorithm>
 #include <cstddef>
 #include <cassert>
@@ -96,6 +97,7 @@ STAILQ_HEAD(mhdr, struct mbuf_block);
 struct mbuf_pool {
 	boost::uint32_t nfree_mbuf_blockq;   /* # free mbuf_block */
 	boost::uint32_t nactive_mbuf_blockq; /* # active (non-free) mbuf_block */
+	boost::uint32_t peak_active_mbuf_blockq; /* high-water mark of nactive_mbuf_blockq */
 	struct mhdr free_mbuf_blockq; /* free mbuf_block q */
 	#ifdef MBUF_ENABLE_DEBUGGING
 		struct active_mbuf_block_list active_mbuf_blockq; /* active mbuf_block q */
@@ -103,6 +105,12 @@ struct mbuf_pool {
 
 	size_t mbuf_block_chunk_size; /* mbuf_block chunk size - header + data (const) */
 	size_t mbuf_block_offset;     /* mbuf_block offset in chunk (const) */
+
+	/* If non-NULL, chunks are carved out of this allocator instead of being
+	 * malloc()ed. Standalone mbuf_blocks are always malloc()ed. Set to NULL
+	 * by mbuf_pool_init(); may be changed before the first mbuf_block is
+	 * allocated. The allocator's object size must be mbuf_block_chunk_size. */
+	struct slab_allocator *slab_allocator;
 };
 
 #define MBUF_BLOCK_MAGIC      0xdeadbeef
@@ -0,0 +1,344 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include <MemoryKit/slab.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <oxt/macros.hpp>
+#include <LoggingKit/LoggingKit.h>
+
+namespace Passenger {
+namespace MemoryKit {
+
+
+#define SLAB_HSIZE psg_slab_align(sizeof(struct slab), SLAB_ALIGNMENT)
+#define psg_slab_align(d, a) (((d) + ((a) - 1)) & ~((a) - 1))
+
+#define ASSERT_SLAB_PROPERTY(slab, expr) \
+	do { \
+		if (OXT_UNLIKELY(!(expr))) { \
+			P_BUG("Assertion failed: " #expr " (slab " << (void *) (slab) << ")"); \
+		} \
+	} while (false)
+
+
+static bool
+_slab_is_full(const struct slab *slab, size_t object_size)
+{
+	return slab->free_objects == NULL
+		&& (size_t) (slab->end - slab->unused) < object_size;
+}
+
+static void
+_slab_reset(struct slab *slab)
+{
+	slab->nused = 0;
+	slab->free_objects = NULL;
+	slab->unused = (char *) slab + SLAB_HSIZE;
+}
+
+/*
+ * Maps a region of `allocator->slab_size` bytes that is aligned on its own
+ * size, so that the slab header can be found by masking object addresses.
+ */
+static char *
+_slab_map(struct slab_allocator *allocator, bool *hugetlb)
+{
+	size_t size = allocator->slab_size;
+	char *mem, *start;
+	size_t head, tail;
+
+	#ifdef MAP_HUGETLB
+		if (allocator->hugepages == SLAB_HUGEPAGES_HUGETLB) {
+			mem = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (mem != (char *) MAP_FAILED) {
+				if (((uintptr_t) mem & (size - 1)) == 0) {
+					*hugetlb = true;
+					return mem;
+				}
+				munmap(mem, size);
+			}
+		}
+	#endif
+
+	*hugetlb = false;
+	mem = (char *) mmap(NULL, size * 2, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (OXT_UNLIKELY(mem == (char *) MAP_FAILED)) {
+		return NULL;
+	}
+
+	start = (char *) (((uintptr_t) mem + size - 1) & ~((uintptr_t) size - 1));
+	head = start - mem;
+	tail = size - head;
+	if (head > 0) {
+		munmap(mem, head);
+	}
+	if (tail > 0) {
+		munmap(start + size, tail);
+	}
+
+	#ifdef MADV_HUGEPAGE
+		if (allocator->hugepages != SLAB_HUGEPAGES_NONE) {
+			madvise(start, size, MADV_HUGEPAGE);
+		}
+	#endif
+
+	return start;
+}
+
+static struct slab *
+_slab_create(struct slab_allocator *allocator)
+{
+	struct slab *slab;
+	bool hugetlb;
+	char *mem;
+
+	mem = _slab_map(allocator, &hugetlb);
+	if (OXT_UNLIKELY(mem == NULL)) {
+		return NULL;
+	}
+
+	slab = (struct slab *) mem;
+	slab->magic = SLAB_MAGIC;
+	slab->allocator = allocator;
+	slab->end = mem + SLAB_HSIZE
+		+ slab_allocator_objects_per_slab(allocator) * allocator->object_size;
+	slab->hugetlb = hugetlb;
+	_slab_reset(slab);
+
+	allocator->nslabs++;
+	if (allocator->nslabs > allocator->peak_nslabs) {
+		allocator->peak_nslabs = allocator->nslabs;
+	}
+	if (hugetlb) {
+		allocator->nhugetlb_slabs++;
+	}
+	return slab;
+}
+
+static void
+_slab_destroy(struct slab_allocator *allocator, struct slab *slab)
+{
+	ASSERT_SLAB_PROPERTY(slab, slab->nused == 0);
+	allocator->nslabs--;
+	allocator->nreleased_slabs++;
+	if (slab->hugetlb) {
+		allocator->nhugetlb_slabs--;
+	}
+	slab->magic = 0;
+	munmap(slab, allocator->slab_size);
+}
+
+
+void
+slab_allocator_init(struct slab_allocator *allocator, size_t object_size,
+	enum slab_hugepages_mode hugepages, unsigned int max_idle_slabs)
+{
+	assert(object_size > 0);
+
+	allocator->object_size = psg_slab_align(std::max<size_t>(object_size, sizeof(void *)),
+		SLAB_ALIGNMENT);
+	allocator->slab_size = SLAB_DEFAULT_SIZE;
+	while ((allocator->slab_size - SLAB_HSIZE) / allocator->object_size < SLAB_MIN_OBJECTS) {
+		allocator->slab_size *= 2;
+	}
+	allocator->hugepages = hugepages;
+	allocator->max_idle_slabs = max_idle_slabs;
+
+	TAILQ_INIT(&allocator->partial_slabs);
+	TAILQ_INIT(&allocator->full_slabs);
+	TAILQ_INIT(&allocator->empty_slabs);
+
+	allocator->nslabs = 0;
+	allocator->nempty_slabs = 0;
+	allocator->peak_nslabs = 0;
+	allocator->nhugetlb_slabs = 0;
+	allocator->nused_objects = 0;
+	allocator->nreleased_slabs = 0;
+}
+
+/*
+ * Releases all empty slabs. Slabs that still contain objects are left mapped
+ * because those objects may still be in use: mbuf_pool_deinit(), for example,
+ * does not free active mbuf_blocks. Such slabs are released once their
+ * objects are freed and slab_allocator_deinit() is called again.
+ */
+void
+slab_allocator_deinit(struct slab_allocator *allocator)
+{
+	slab_allocator_release_idle(allocator, 0);
+	if (allocator->nused_objects > 0) {
+		P_WARN("Slab allocator deinitialized while " << allocator->nused_objects
+			<< " objects are still in use; leaving " << allocator->nslabs
+			<< " slabs mapped");
+	}
+}
+
+void *
+slab_alloc(struct slab_allocator *allocator)
+{
+	struct slab *slab;
+	void *object;
+
+	if (!TAILQ_EMPTY(&allocator->partial_slabs)) {
+		slab = TAILQ_FIRST(&allocator->partial_slabs);
+	} else if (!TAILQ_EMPTY(&allocator->empty_slabs)) {
+		slab = TAILQ_FIRST(&allocator->empty_slabs);
+		TAILQ_REMOVE(&allocator->empty_slabs, slab, next);
+		allocator->nempty_slabs--;
+		TAILQ_INSERT_HEAD(&allocator->partial_slabs, slab, next);
+	} else {
+		slab = _slab_create(allocator);
+		if (OXT_UNLIKELY(slab == NULL)) {
+			return NULL;
+		}
+		TAILQ_INSERT_HEAD(&allocator->partial_slabs, slab, next);
+	}
+
+	ASSERT_SLAB_PROPERTY(slab, slab->magic == SLAB_MAGIC);
+	if (slab->free_objects != NULL) {
+		object = slab->free_objects;
+		slab->free_objects = *(void **) object;
+	} else {
+		ASSERT_SLAB_PROPERTY(slab,
+			(size_t) (slab->end - slab->unused) >= allocator->object_size);
+		object = slab->unused;
+		slab->unused += allocator->object_size;
+	}
+	slab->nused++;
+	allocator->nused_objects++;
+
+	if (_slab_is_full(slab, allocator->object_size)) {
+		TAILQ_REMOVE(&allocator->partial_slabs, slab, next);
+		TAILQ_INSERT_HEAD(&allocator->full_slabs, slab, next);
+	}
+
+	return object;
+}
+
+void
+slab_free(struct slab_allocator *allocator, void *object)
+{
+	struct slab *slab = (struct slab *) ((uintptr_t) object
+		& ~((uintptr_t) allocator->slab_size - 1));
+	bool was_full;
+
+	ASSERT_SLAB_PROPERTY(slab, slab->magic == SLAB_MAGIC);
+	ASSERT_SLAB_PROPERTY(slab, slab->allocator == allocator);
+	ASSERT_SLAB_PROPERTY(slab, slab->nused > 0);
+
+	was_full = _slab_is_full(slab, allocator->object_size);
+	*(void **) object = slab->free_objects;
+	slab->free_objects = object;
+	slab->nused--;
+	allocator->nused_objects--;
+
+	if (slab->nused == 0) {
+		if (was_full) {
+			TAILQ_REMOVE(&allocator->full_slabs, slab, next);
+		} else {
+			TAILQ_REMOVE(&allocator->partial_slabs, slab, next);
+		}
+		if (allocator->nempty_slabs < allocator->max_idle_slabs) {
+			_slab_reset(slab);
+			TAILQ_INSERT_HEAD(&allocator->empty_slabs, slab, next);
+			allocator->nempty_slabs++;
+		} else {
+			_slab_destroy(allocator, slab);
+		}
+	} else if (was_full) {
+		// Prefer allocating from slabs that were already partially used,
+		// so that other slabs get a chance to become empty and released.
+		TAILQ_REMOVE(&allocator->full_slabs, slab, next);
+		TAILQ_INSERT_TAIL(&allocator->partial_slabs, slab, next);
+	}
+}
+
+unsigned int
+slab_allocator_release_idle(struct slab_allocator *allocator, unsigned int keep)
+{
+	unsigned int count = 0;
+
+	while (allocator->nempty_slabs > keep) {
+		struct slab *slab = TAILQ_LAST(&allocator->empty_slabs, slab_list);
+		TAILQ_REMOVE(&allocator->empty_slabs, slab, next);
+		allocator->nempty_slabs--;
+		_slab_destroy(allocator, slab);
+		count++;
+	}
+
+	return count;
+}
+
+size_t
+slab_allocator_reserved_size(const struct slab_allocator *allocator)
+{
+	return (size_t) allocator->nslabs * allocator->slab_size;
+}
+
+unsigned int
+slab_allocator_objects_per_slab(const struct slab_allocator *allocator)
+{
+	return (allocator->slab_size - SLAB_HSIZE) / allocator->object_size;
+}
+
+const char *
+slab_hugepages_mode_to_string(enum slab_hugepages_mode mode)
+{
+	switch (mode) {
+	case SLAB_HUGEPAGES_NONE:
+		return "none";
+	case SLAB_HUGEPAGES_MADVISE:
+		return "madvise";
+	case SLAB_HUGEPAGES_HUGETLB:
+		return "hugetlb";
+	default:
+		return "unknown";
+	}
+}
+
+bool
+parse_slab_hugepages_mode(const char *str, enum slab_hugepages_mode &result)
+{
+	if (strcmp(str, "none") == 0) {
+		result = SLAB_HUGEPAGES_NONE;
+	} else if (strcmp(str, "madvise") == 0) {
+		result = SLAB_HUGEPAGES_MADVISE;
+	} else if (strcmp(str, "hugetlb") == 0) {
+		result = SLAB_HUGEPAGES_HUGETLB;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+
+} // namespace MemoryKit
+} // namespace Passenger
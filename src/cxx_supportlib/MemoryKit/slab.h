@@ -0,0 +1,136 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef _PASSENGER_MEMORY_KIT_SLAB_H_
+#define _PASSENGER_MEMORY_KIT_SLAB_H_
+
+#include <psg_sysqueue.h>
+#include <cstddef>
+#include <boost/cstdint.hpp>
+
+/** A slab allocator for fixed-size objects, used for mbuf_blocks and
+ * ServerKit client objects.
+ *
+ * Instead of malloc()ing every object separately, memory is reserved from
+ * the kernel in large regions ("slabs", 2 MB by default) that are aligned on
+ * their own size, so that they can be backed by transparent huge pages
+ * (madvise(MADV_HUGEPAGE)) or explicitly reserved huge pages (MAP_HUGETLB).
+ * This reduces TLB pressure and heap fragmentation when there are many
+ * concurrent connections.
+ *
+ * Each slab starts with a header, followed by objects. Because slabs are
+ * aligned, the slab that an object belongs to is found by masking the
+ * object's address. Objects are handed out from a per-slab freelist, or by
+ * bumping a pointer into the never-used part of the slab so that untouched
+ * memory is not faulted in.
+ *
+ * Slabs that become completely unused are kept around for reuse, up to
+ * `max_idle_slabs`. Beyond that they are returned to the kernel with
+ * munmap(). slab_allocator_release_idle() can be used to release more.
+ *
+ * Like mbuf_pool, a slab_allocator is not thread-safe.
+ */
+
+namespace Passenger {
+namespace MemoryKit {
+
+
+struct slab_allocator;
+
+enum slab_hugepages_mode {
+	/* Use normal pages only. */
+	SLAB_HUGEPAGES_NONE,
+	/* Advise the kernel to back slabs with transparent huge pages. */
+	SLAB_HUGEPAGES_MADVISE,
+	/* Try to allocate slabs from the reserved huge page pool, falling
+	 * back to SLAB_HUGEPAGES_MADVISE if none are available. */
+	SLAB_HUGEPAGES_HUGETLB
+};
+
+struct slab {
+	boost::uint32_t magic;         /* slab magic (const) */
+	boost::uint32_t nused;         /* # objects handed out */
+	TAILQ_ENTRY(struct slab) next; /* entry in one of the allocator's lists */
+	struct slab_allocator *allocator; /* owning allocator (const) */
+	void *free_objects;            /* freelist of previously used objects */
+	char *unused;                  /* start of never-used space */
+	char *end;                     /* end of usable space (const) */
+	bool hugetlb;                  /* allocated with MAP_HUGETLB (const) */
+};
+
+TAILQ_HEAD(slab_list, struct slab);
+
+struct slab_allocator {
+	size_t object_size;            /* size of each object (const) */
+	size_t slab_size;              /* size of each slab, a power of 2 (const) */
+	enum slab_hugepages_mode hugepages; /* (const) */
+	unsigned int max_idle_slabs;   /* # empty slabs to keep for reuse */
+
+	struct slab_list partial_slabs; /* slabs with both used and free objects */
+	struct slab_list full_slabs;   /* slabs without free objects */
+	struct slab_list empty_slabs;  /* slabs without used objects */
+
+	boost::uint32_t nslabs;        /* # slabs currently mapped */
+	boost::uint32_t nempty_slabs;  /* # slabs in empty_slabs */
+	boost::uint32_t peak_nslabs;   /* high-water mark of nslabs */
+	boost::uint32_t nhugetlb_slabs; /* # slabs backed by MAP_HUGETLB */
+	boost::uint64_t nused_objects; /* # objects handed out */
+	boost::uint64_t nreleased_slabs; /* # slabs returned to the kernel so far */
+};
+
+#define SLAB_MAGIC          0x51ab51ab
+#define SLAB_DEFAULT_SIZE   (2 * 1024 * 1024)
+#define SLAB_ALIGNMENT      16
+/* Slabs are made large enough to hold at least this many objects. */
+#define SLAB_MIN_OBJECTS    8
+
+void slab_allocator_init(struct slab_allocator *allocator, size_t object_size,
+	enum slab_hugepages_mode hugepages = SLAB_HUGEPAGES_MADVISE,
+	unsigned int max_idle_slabs = 1);
+void slab_allocator_deinit(struct slab_allocator *allocator);
+
+/* Returns NULL if out of memory. */
+void *slab_alloc(struct slab_allocator *allocator);
+void slab_free(struct slab_allocator *allocator, void *object);
+
+/* Returns empty slabs to the kernel until at most `keep` remain.
+ * Returns the number of slabs released. */
+unsigned int slab_allocator_release_idle(struct slab_allocator *allocator,
+	unsigned int keep = 0);
+
+/* Number of bytes currently reserved from the kernel. */
+size_t slab_allocator_reserved_size(const struct slab_allocator *allocator);
+
+/* Number of objects that fit in a single slab. */
+unsigned int slab_allocator_objects_per_slab(const struct slab_allocator *allocator);
+
+const char *slab_hugepages_mode_to_string(enum slab_hugepages_mode mode);
+bool parse_slab_hugepages_mode(const char *str, enum slab_hugepages_mode &result);
+
+
+} // namespace MemoryKit
+} // namespace Passenger
+
+#endif /* _PASSENGER_MEMORY_KIT_SLAB_H_ */
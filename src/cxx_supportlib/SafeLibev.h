@@ -35,8 +35,11 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/bind/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
 #include <oxt/thread.hpp>
 #include <LoggingKit/LoggingKit.h>
+#include <DataStructures/MpscQueue.h>
 
 namespace Passenger {
 
@@ -46,35 +49,85 @@ using namespace boost;
 
 /**
  * Class for thread-safely using libev.
+ *
+ * Callbacks scheduled from other threads (runLater() and friends) are handed
+ * to the event loop thread through a lock-free multi-producer single-consumer
+ * queue of preallocated Command objects, so that scheduling a callback does
+ * not contend on a mutex with the event loop or with other producers. Wakeups
+ * are coalesced: a burst of runLater() calls costs a single ev_async_send().
  */
 class SafeLibev {
 private:
 	// 2^28-1. Command IDs are 28-bit so that we can pack DataSource's state and
 	// its planId in 32-bits total.
 	static const unsigned int MAX_COMMAND_ID = 268435455;
+	// Number of Command objects that are preallocated per event loop. If
+	// they're all in flight then we fall back to allocating from the heap.
+	static const unsigned int PREALLOCATED_COMMANDS = 1024;
+	static const boost::uint32_t NO_COMMAND = 0xffffffff;
 
 	typedef boost::function<void ()> Callback;
 
 	struct Command {
+		boost::atomic<Command *> mpscNext;
+		Command *nextInBatch;
 		Callback callback;
-		unsigned int id: 31;
+		boost::atomic<boost::uint32_t> nextFree;
+		unsigned int id: 28;
 		bool canceled: 1;
+		bool preallocated: 1;
+
+		Command()
+			: nextInBatch(NULL),
+			  nextFree(NO_COMMAND),
+			  id(0),
+			  canceled(false),
+			  preallocated(false)
+			{ }
+	};
+
+	struct CommandCanceler {
+		unsigned int id;
+		bool found;
 
-		Command(unsigned int _id, const Callback &_callback)
-			: callback(_callback),
-			  id(_id),
-			  canceled(false)
+		CommandCanceler(unsigned int _id)
+			: id(_id),
+			  found(false)
 			{ }
+
+		void operator()(Command *command) {
+			if (command->id == id) {
+				command->canceled = true;
+				found = true;
+			}
+		}
 	};
 
 	struct ev_loop *loop;
 	pthread_t loopThread;
 	ev_async async;
 
+	MpscQueue<Command> commandQueue;
+	boost::atomic<bool> wakeupPending;
+	boost::atomic<unsigned int> nextCommandId;
+	Command *preallocatedCommands;
+	// Lock-free stack of unused preallocated commands. The lower 32 bits are
+	// the index of the top entry, the upper 32 bits are a counter that is
+	// incremented on every change in order to avoid the ABA problem.
+	boost::atomic<boost::uint64_t> freeCommands;
+	// The commands that runCommands() took from the queue and has not run
+	// yet. Only accessed from the event loop thread.
+	Command *currentBatch;
+
+	// Held by the event loop while it takes commands from the queue, and by
+	// cancelCommand() while it looks for a command in the queue. This makes
+	// the holder the queue's consumer, so that other threads can cancel
+	// commands without waiting for the event loop.
+	boost::mutex commandQueueSyncher;
+
+	// Only used by the synchronous operations for waiting on the event loop.
 	boost::mutex syncher;
 	boost::condition_variable cond;
-	vector<Command> commands;
-	unsigned int nextCommandId;
 
 	static void asyncHandler(EV_P_ ev_async *w, int revents) {
 		SafeLibev *self = (SafeLibev *) w->data;
@@ -86,18 +139,110 @@ private:
 		(*callback)();
 	}
 
+	static boost::uint64_t makeFreeCommandsTop(boost::uint64_t oldTop, boost::uint32_t index) {
+		return (((oldTop >> 32) + 1) << 32) | index;
+	}
+
+	Command *allocateCommand() {
+		boost::uint64_t top = freeCommands.load(boost::memory_order_acquire);
+		while (true) {
+			boost::uint32_t index = (boost::uint32_t) top;
+			if (index == NO_COMMAND) {
+				return new Command();
+			}
+
+			Command *command = &preallocatedCommands[index];
+			boost::uint64_t newTop = makeFreeCommandsTop(top,
+				command->nextFree.load(boost::memory_order_relaxed));
+			if (freeCommands.compare_exchange_weak(top, newTop,
+				boost::memory_order_acquire, boost::memory_order_acquire))
+			{
+				return command;
+			}
+		}
+	}
+
+	void releaseCommand(Command *command) {
+		command->callback.clear();
+		if (!command->preallocated) {
+			delete command;
+			return;
+		}
+
+		boost::uint32_t index = command - preallocatedCommands;
+		boost::uint64_t top = freeCommands.load(boost::memory_order_relaxed);
+		do {
+			command->nextFree.store((boost::uint32_t) top, boost::memory_order_relaxed);
+		} while (!freeCommands.compare_exchange_weak(top, makeFreeCommandsTop(top, index),
+			boost::memory_order_release, boost::memory_order_relaxed));
+	}
+
+	unsigned int enqueueCommand(const Callback &callback) {
+		Command *command = allocateCommand();
+		unsigned int id = nextCommandId.fetch_add(1, boost::memory_order_relaxed)
+			% MAX_COMMAND_ID + 1;
+
+		command->callback = callback;
+		command->id = id;
+		command->canceled = false;
+		commandQueue.push(command);
+
+		// Only the first command after the event loop has started processing
+		// the queue needs to wake it up. This pairs with the store in runCommands().
+		if (!wakeupPending.exchange(true, boost::memory_order_seq_cst)) {
+			ev_async_send(loop, &async);
+		}
+		return id;
+	}
+
 	void runCommands() {
-		boost::unique_lock<boost::mutex> l(syncher);
-		vector<Command> commands = this->commands;
-		this->commands.clear();
-		l.unlock();
-
-		vector<Command>::const_iterator it, end = commands.end();
-		for (it = commands.begin(); it != end; it++) {
-			if (!it->canceled) {
-				it->callback();
+		Command *command, *last = NULL;
+
+		// Reset the flag before draining so that any command that we miss
+		// below triggers a new wakeup.
+		wakeupPending.store(false, boost::memory_order_seq_cst);
+
+		// Commands that are scheduled by the callbacks below are run in
+		// the next event loop iteration, not in this one.
+		assert(currentBatch == NULL);
+		{
+			boost::lock_guard<boost::mutex> l(commandQueueSyncher);
+			while ((command = commandQueue.pop()) != NULL) {
+				command->nextInBatch = NULL;
+				if (last == NULL) {
+					currentBatch = command;
+				} else {
+					last->nextInBatch = command;
+				}
+				last = command;
 			}
 		}
+
+		while (currentBatch != NULL) {
+			command = currentBatch;
+			currentBatch = command->nextInBatch;
+			if (!command->canceled) {
+				command->callback();
+			}
+			releaseCommand(command);
+		}
+	}
+
+	bool cancelCommandInBatch(unsigned int id) {
+		for (Command *command = currentBatch; command != NULL; command = command->nextInBatch) {
+			if (command->id == id) {
+				command->canceled = true;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool cancelCommandInQueue(unsigned int id) {
+		boost::lock_guard<boost::mutex> l(commandQueueSyncher);
+		CommandCanceler canceler(id);
+		commandQueue.forEach(canceler);
+		return canceler.found;
 	}
 
 	template<typename Watcher>
@@ -124,20 +269,24 @@ private:
 		cond.notify_all();
 	}
 
-	void incNextCommandId() {
-		if (nextCommandId == MAX_COMMAND_ID) {
-			nextCommandId = 1;
-		} else {
-			nextCommandId++;
-		}
-	}
-
 public:
 	/** SafeLibev takes over ownership of the loop object. */
-	SafeLibev(struct ev_loop *loop) {
+	SafeLibev(struct ev_loop *loop)
+		: wakeupPending(false),
+		  nextCommandId(0),
+		  currentBatch(NULL)
+	{
 		this->loop = loop;
 		loopThread = pthread_self();
-		nextCommandId = 1;
+
+		preallocatedCommands = new Command[PREALLOCATED_COMMANDS];
+		for (unsigned int i = 0; i < PREALLOCATED_COMMANDS; i++) {
+			preallocatedCommands[i].preallocated = true;
+			preallocatedCommands[i].nextFree.store(
+				(i + 1 < PREALLOCATED_COMMANDS) ? i + 1 : NO_COMMAND,
+				boost::memory_order_relaxed);
+		}
+		freeCommands.store(0, boost::memory_order_release);
 
 		ev_async_init(&async, asyncHandler);
 		ev_set_priority(&async, EV_MAXPRI);
@@ -146,11 +295,18 @@ public:
 	}
 
 	~SafeLibev() {
+		Command *command;
+
 		destroy();
 		P_LOG_FILE_DESCRIPTOR_CLOSE(ev_loop_get_pipe(loop, 0));
 		P_LOG_FILE_DESCRIPTOR_CLOSE(ev_loop_get_pipe(loop, 1));
 		P_LOG_FILE_DESCRIPTOR_CLOSE(ev_backend_fd(loop));
 		ev_loop_destroy(loop);
+
+		while ((command = commandQueue.pop()) != NULL) {
+			releaseCommand(command);
+		}
+		delete[] preallocatedCommands;
 	}
 
 	void destroy() {
@@ -194,11 +350,8 @@ public:
 		} else {
 			boost::unique_lock<boost::mutex> l(syncher);
 			bool done = false;
-			commands.push_back(Command(nextCommandId,
-				boost::bind(&SafeLibev::startWatcherAndNotify<Watcher>,
-					this, &watcher, &done)));
-			incNextCommandId();
-			ev_async_send(loop, &async);
+			enqueueCommand(boost::bind(&SafeLibev::startWatcherAndNotify<Watcher>,
+				this, &watcher, &done));
 			while (!done) {
 				cond.wait(l);
 			}
@@ -212,11 +365,8 @@ public:
 		} else {
 			boost::unique_lock<boost::mutex> l(syncher);
 			bool done = false;
-			commands.push_back(Command(nextCommandId,
-				boost::bind(&SafeLibev::stopWatcherAndNotify<Watcher>,
-					this, &watcher, &done)));
-			incNextCommandId();
-			ev_async_send(loop, &async);
+			enqueueCommand(boost::bind(&SafeLibev::stopWatcherAndNotify<Watcher>,
+				this, &watcher, &done));
 			while (!done) {
 				cond.wait(l);
 			}
@@ -236,11 +386,8 @@ public:
 		assert(callback);
 		boost::unique_lock<boost::mutex> l(syncher);
 		bool done = false;
-		commands.push_back(Command(nextCommandId,
-			boost::bind(&SafeLibev::runAndNotify, this,
-				&callback, &done)));
-		incNextCommandId();
-		ev_async_send(loop, &async);
+		enqueueCommand(boost::bind(&SafeLibev::runAndNotify, this,
+			&callback, &done));
 		while (!done) {
 			cond.wait(l);
 		}
@@ -264,15 +411,7 @@ public:
 
 	unsigned int runLater(const Callback &callback) {
 		assert(callback);
-		unsigned int result;
-		{
-			boost::unique_lock<boost::mutex> l(syncher);
-			commands.push_back(Command(nextCommandId, callback));
-			result = nextCommandId;
-			incNextCommandId();
-		}
-		ev_async_send(loop, &async);
-		return result;
+		return enqueueCommand(callback);
 	}
 
 	/**
@@ -281,23 +420,23 @@ public:
 	 * That is, a return value of true guarantees that the callback will not be called
 	 * in the future, while a return value of false means that the callback has already
 	 * been called or is currently being called.
+	 *
+	 * This never waits for the event loop, so it may be called from any thread,
+	 * even if the event loop is not running. When called from another thread
+	 * it only waits for the event loop to finish taking a batch of commands
+	 * from the queue; callbacks in a batch that has been taken but not run
+	 * yet can only be cancelled from the event loop thread.
 	 */
 	bool cancelCommand(unsigned int id) {
 		if (id == 0) {
 			return false;
 		}
 
-		boost::unique_lock<boost::mutex> l(syncher);
-		// TODO: we can do a binary search because the command ID
-		// is monotically increasing except on overflow.
-		vector<Command>::iterator it, end = commands.end();
-		for (it = commands.begin(); it != end; it++) {
-			if (it->id == id) {
-				it->canceled = true;
-				return true;
-			}
+		if (onEventLoopThread() && cancelCommandInBatch(id)) {
+			return true;
+		} else {
+			return cancelCommandInQueue(id);
 		}
-		return false;
 	}
 };
 
@@ -38,6 +38,9 @@
 
 #include <ConfigKit/ConfigKit.h>
 #include <FileTools/PathManip.h>
+#include <MemoryKit/mbuf.h>
+#include <MemoryKit/slab.h>
+#include <StrIntTools/StrIntUtils.h>
 #include <Constants.h>
 #include <Utils.h>
 
@@ -59,7 +62,12 @@ using namespace std;
  *   file_buffered_channel_max_disk_chunk_read_size       unsigned integer   -   default(0)
  *   file_buffered_channel_threshold                      unsigned integer   -   default(131072)
  *   mbuf_block_chunk_size                                unsigned integer   -   default(4096),read_only
+ *   mbuf_large_block_chunk_size                          unsigned integer   -   default(65536),read_only
+ *   mbuf_small_block_chunk_size                          unsigned integer   -   default(512),read_only
  *   secure_mode_password                                 string             -   secret
+ *   slab_allocator                                       boolean            -   default(false),read_only
+ *   slab_allocator_hugepages                             string             -   default("madvise"),read_only
+ *   slab_allocator_max_idle_slabs                        unsigned integer   -   default(1),read_only
  *
  * END
  */
@@ -78,6 +86,36 @@ private:
 		return updates;
 	}
 
+	static void validateMbufSizeClasses(const ConfigKit::Store &config, vector<ConfigKit::Error> &errors) {
+		typedef ConfigKit::Error Error;
+
+		unsigned int smallChunkSize = config["mbuf_small_block_chunk_size"].asUInt();
+		unsigned int largeChunkSize = config["mbuf_large_block_chunk_size"].asUInt();
+
+		// A size class that does not fit between the default chunk size and
+		// the other classes is simply not used, see Context::initialize().
+		if (smallChunkSize != 0 && smallChunkSize < MBUF_BLOCK_MIN_SIZE) {
+			errors.push_back(Error("'{{mbuf_small_block_chunk_size}}' must be 0 or at least "
+				+ toString(MBUF_BLOCK_MIN_SIZE)));
+		}
+		if (largeChunkSize > MBUF_BLOCK_MAX_SIZE) {
+			errors.push_back(Error("'{{mbuf_large_block_chunk_size}}' may not be larger than "
+				+ toString(MBUF_BLOCK_MAX_SIZE)));
+		}
+	}
+
+	static void validateSlabAllocator(const ConfigKit::Store &config, vector<ConfigKit::Error> &errors) {
+		typedef ConfigKit::Error Error;
+		MemoryKit::slab_hugepages_mode mode;
+
+		if (!MemoryKit::parse_slab_hugepages_mode(
+			config["slab_allocator_hugepages"].asCString(), mode))
+		{
+			errors.push_back(Error("'{{slab_allocator_hugepages}}' must be one of"
+				" 'none', 'madvise' or 'hugetlb'"));
+		}
+	}
+
 public:
 	Schema() {
 		using namespace ConfigKit;
@@ -94,8 +132,17 @@ public:
 
 		add("mbuf_block_chunk_size", UINT_TYPE, OPTIONAL | READ_ONLY,
 			DEFAULT_MBUF_CHUNK_SIZE);
+		add("mbuf_small_block_chunk_size", UINT_TYPE, OPTIONAL | READ_ONLY,
+			DEFAULT_SMALL_MBUF_CHUNK_SIZE);
+		add("mbuf_large_block_chunk_size", UINT_TYPE, OPTIONAL | READ_ONLY,
+			DEFAULT_LARGE_MBUF_CHUNK_SIZE);
 		add("secure_mode_password", STRING_TYPE, OPTIONAL | SECRET);
+		add("slab_allocator", BOOL_TYPE, OPTIONAL | READ_ONLY, false);
+		add("slab_allocator_hugepages", STRING_TYPE, OPTIONAL | READ_ONLY, "madvise");
+		add("slab_allocator_max_idle_slabs", UINT_TYPE, OPTIONAL | READ_ONLY, 1);
 
+		addValidator(validateMbufSizeClasses);
+		addValidator(validateSlabAllocator);
 		addNormalizer(normalize);
 
 		finalize();
@@ -32,6 +32,7 @@
 #include <ServerKit/Config.h>
 #include <ConfigKit/ConfigKit.h>
 #include <MemoryKit/mbuf.h>
+#include <MemoryKit/slab.h>
 #include <LoggingKit/Assert.h>
 #include <SafeLibev.h>
 #include <Exceptions.h>
@@ -62,16 +63,42 @@ public:
 	// Others
 	Config config;
 	struct MemoryKit::mbuf_pool mbuf_pool;
+	// Optional size classes next to the default mbuf_pool. A class is
+	// disabled if its mbuf_block_chunk_size is 0. See getMbufPoolForSize().
+	struct MemoryKit::mbuf_pool small_mbuf_pool;
+	struct MemoryKit::mbuf_pool large_mbuf_pool;
+	// If slab allocation is enabled, the blocks of each mbuf pool are carved
+	// out of the corresponding slab allocator. Servers use the same settings
+	// for their client objects.
+	bool slabAllocation;
+	MemoryKit::slab_hugepages_mode slabHugepages;
+	unsigned int slabMaxIdleSlabs;
+	struct MemoryKit::slab_allocator mbuf_slab_allocator;
+	struct MemoryKit::slab_allocator small_mbuf_slab_allocator;
+	struct MemoryKit::slab_allocator large_mbuf_slab_allocator;
 
 	Context(const Schema &schema, const Json::Value &initialConfig = Json::Value(),
 		const ConfigKit::Translator &translator = ConfigKit::DummyTranslator())
 		: configStore(schema, initialConfig, translator),
 		  libuv(NULL),
 		  config(configStore)
-		{ }
+	{
+		small_mbuf_pool.mbuf_block_chunk_size = 0;
+		large_mbuf_pool.mbuf_block_chunk_size = 0;
+		slabAllocation = configStore["slab_allocator"].asBool();
+		MemoryKit::parse_slab_hugepages_mode(
+			configStore["slab_allocator_hugepages"].asCString(), slabHugepages);
+		slabMaxIdleSlabs = configStore["slab_allocator_max_idle_slabs"].asUInt();
+	}
 
 	~Context() {
-		MemoryKit::mbuf_pool_deinit(&mbuf_pool);
+		deinitializeMbufPool(mbuf_pool);
+		if (small_mbuf_pool.mbuf_block_chunk_size != 0) {
+			deinitializeMbufPool(small_mbuf_pool);
+		}
+		if (large_mbuf_pool.mbuf_block_chunk_size != 0) {
+			deinitializeMbufPool(large_mbuf_pool);
+		}
 	}
 
 	void initialize() {
@@ -82,8 +109,75 @@ public:
 			throw RuntimeException("libuv must be non-NULL");
 		}
 
-		mbuf_pool.mbuf_block_chunk_size = configStore["mbuf_block_chunk_size"].asUInt();
-		MemoryKit::mbuf_pool_init(&mbuf_pool);
+		unsigned int smallChunkSize = configStore["mbuf_small_block_chunk_size"].asUInt();
+		unsigned int largeChunkSize = configStore["mbuf_large_block_chunk_size"].asUInt();
+
+		initializeMbufPool(mbuf_pool, mbuf_slab_allocator,
+			configStore["mbuf_block_chunk_size"].asUInt());
+		if (smallChunkSize != 0 && smallChunkSize < mbuf_pool.mbuf_block_chunk_size) {
+			initializeMbufPool(small_mbuf_pool, small_mbuf_slab_allocator,
+				smallChunkSize);
+		}
+		if (largeChunkSize > mbuf_pool.mbuf_block_chunk_size) {
+			initializeMbufPool(large_mbuf_pool, large_mbuf_slab_allocator,
+				largeChunkSize);
+		}
+	}
+
+	void initializeMbufPool(struct MemoryKit::mbuf_pool &pool,
+		struct MemoryKit::slab_allocator &allocator, unsigned int chunkSize)
+	{
+		pool.mbuf_block_chunk_size = chunkSize;
+		MemoryKit::mbuf_pool_init(&pool);
+		if (slabAllocation) {
+			MemoryKit::slab_allocator_init(&allocator, chunkSize, slabHugepages,
+				slabMaxIdleSlabs);
+			pool.slab_allocator = &allocator;
+		}
+	}
+
+	void deinitializeMbufPool(struct MemoryKit::mbuf_pool &pool) {
+		MemoryKit::mbuf_pool_deinit(&pool);
+		if (pool.slab_allocator != NULL) {
+			MemoryKit::slab_allocator_deinit(pool.slab_allocator);
+		}
+	}
+
+	/**
+	 * Returns the mbuf pool whose blocks best fit a read of `expectedSize`
+	 * bytes: the small class if the data fits in a small block, the large
+	 * class if it does not fit in a default block, and the default pool
+	 * otherwise (or if the expected size is unknown, i.e. 0).
+	 */
+	struct MemoryKit::mbuf_pool *getMbufPoolForSize(size_t expectedSize) {
+		if (expectedSize == 0) {
+			return &mbuf_pool;
+		} else if (small_mbuf_pool.mbuf_block_chunk_size != 0
+			&& expectedSize <= MemoryKit::mbuf_pool_data_size(&small_mbuf_pool))
+		{
+			return &small_mbuf_pool;
+		} else if (large_mbuf_pool.mbuf_block_chunk_size != 0
+			&& expectedSize > MemoryKit::mbuf_pool_data_size(&mbuf_pool))
+		{
+			return &large_mbuf_pool;
+		} else {
+			return &mbuf_pool;
+		}
+	}
+
+	/**
+	 * Frees the free blocks of all mbuf size classes. Returns the number
+	 * of blocks freed.
+	 */
+	unsigned int compactMbufPools() {
+		unsigned int count = MemoryKit::mbuf_pool_compact(&mbuf_pool);
+		if (small_mbuf_pool.mbuf_block_chunk_size != 0) {
+			count += MemoryKit::mbuf_pool_compact(&small_mbuf_pool);
+		}
+		if (large_mbuf_pool.mbuf_block_chunk_size != 0) {
+			count += MemoryKit::mbuf_pool_compact(&large_mbuf_pool);
+		}
+		return count;
 	}
 
 	bool configure(const Json::Value &updates, vector<ConfigKit::Error> &errors) {
@@ -116,20 +210,42 @@ public:
 
 	Json::Value inspectStateAsJson() const {
 		Json::Value doc;
+		Json::Value classesDoc(Json::arrayValue);
+
+		doc["mbuf_pool"] = inspectMbufPoolAsJson(mbuf_pool);
+		if (small_mbuf_pool.mbuf_block_chunk_size != 0) {
+			classesDoc.append(inspectMbufPoolAsJson(small_mbuf_pool));
+		}
+		classesDoc.append(doc["mbuf_pool"]);
+		if (large_mbuf_pool.mbuf_block_chunk_size != 0) {
+			classesDoc.append(inspectMbufPoolAsJson(large_mbuf_pool));
+		}
+		doc["mbuf_pool_size_classes"] = classesDoc;
+
+		return doc;
+	}
+
+	static Json::Value inspectMbufPoolAsJson(const struct MemoryKit::mbuf_pool &pool) {
 		Json::Value mbufDoc;
 
-		mbufDoc["free_blocks"] = (Json::UInt) mbuf_pool.nfree_mbuf_blockq;
-		mbufDoc["active_blocks"] = (Json::UInt) mbuf_pool.nactive_mbuf_blockq;
-		mbufDoc["chunk_size"] = (Json::UInt) mbuf_pool.mbuf_block_chunk_size;
-		mbufDoc["offset"] = (Json::UInt) mbuf_pool.mbuf_block_offset;
-		mbufDoc["spare_memory"] = byteSizeToJson(mbuf_pool.nfree_mbuf_blockq
-			* mbuf_pool.mbuf_block_chunk_size);
-		mbufDoc["active_memory"] = byteSizeToJson(mbuf_pool.nactive_mbuf_blockq
-			* mbuf_pool.mbuf_block_chunk_size);
+		mbufDoc["free_blocks"] = (Json::UInt) pool.nfree_mbuf_blockq;
+		mbufDoc["active_blocks"] = (Json::UInt) pool.nactive_mbuf_blockq;
+		mbufDoc["peak_active_blocks"] = (Json::UInt) pool.peak_active_mbuf_blockq;
+		mbufDoc["chunk_size"] = (Json::UInt) pool.mbuf_block_chunk_size;
+		mbufDoc["offset"] = (Json::UInt) pool.mbuf_block_offset;
+		mbufDoc["spare_memory"] = byteSizeToJson(pool.nfree_mbuf_blockq
+			* pool.mbuf_block_chunk_size);
+		mbufDoc["active_memory"] = byteSizeToJson(pool.nactive_mbuf_blockq
+			* pool.mbuf_block_chunk_size);
+		mbufDoc["peak_active_memory"] = byteSizeToJson(pool.peak_active_mbuf_blockq
+			* pool.mbuf_block_chunk_size);
+		if (pool.slab_allocator != NULL) {
+			mbufDoc["slab_allocator"] = inspectSlabAllocatorAsJson(*pool.slab_allocator);
+		}
 		#ifdef MBUF_ENABLE_DEBUGGING
 			struct MemoryKit::active_mbuf_block_list *list =
 				const_cast<struct MemoryKit::active_mbuf_block_list *>(
-					&mbuf_pool.active_mbuf_blockq);
+					&pool.active_mbuf_blockq);
 			struct MemoryKit::mbuf_block *block;
 			Json::Value listJson(Json::arrayValue);
 
@@ -147,7 +263,25 @@ public:
 			mbufDoc["active_blocks_list"] = listJson;
 		#endif
 
-		doc["mbuf_pool"] = mbufDoc;
+		return mbufDoc;
+	}
+
+	static Json::Value inspectSlabAllocatorAsJson(const struct MemoryKit::slab_allocator &allocator) {
+		Json::Value doc;
+
+		doc["object_size"] = (Json::UInt) allocator.object_size;
+		doc["slab_size"] = byteSizeToJson(allocator.slab_size);
+		doc["objects_per_slab"] = MemoryKit::slab_allocator_objects_per_slab(&allocator);
+		doc["hugepages"] = MemoryKit::slab_hugepages_mode_to_string(allocator.hugepages);
+		doc["slabs"] = (Json::UInt) allocator.nslabs;
+		doc["peak_slabs"] = (Json::UInt) allocator.peak_nslabs;
+		doc["hugetlb_slabs"] = (Json::UInt) allocator.nhugetlb_slabs;
+		doc["idle_slabs"] = (Json::UInt) allocator.nempty_slabs;
+		doc["max_idle_slabs"] = allocator.max_idle_slabs;
+		doc["released_slabs"] = (Json::UInt64) allocator.nreleased_slabs;
+		doc["used_objects"] = (Json::UInt64) allocator.nused_objects;
+		doc["reserved_memory"] = byteSizeToJson(
+			MemoryKit::slab_allocator_reserved_size(&allocator));
 
 		return doc;
 	}
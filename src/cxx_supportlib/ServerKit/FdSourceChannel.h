@@ -28,6 +28,9 @@
 
 #include <oxt/macros.hpp>
 #include <boost/move/move.hpp>
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <climits>
 #include <sys/types.h>
 #include <unistd.h>
 #include <ev.h>
@@ -46,6 +49,10 @@ class FdSourceChannel: protected Channel {
 private:
 	ev_io watcher;
 	MemoryKit::mbuf buffer;
+	/** Number of bytes that the owner expects to arrive, or 0 if unknown. */
+	boost::uint64_t readSizeHint;
+	/** Size of the last read, used to pick a buffer size class if there is no hint. */
+	unsigned int lastReadSize;
 
 	static void _onReadable(EV_P_ ev_io *io, int revents) {
 		static_cast<FdSourceChannel *>(io->data)->onReadable(io, revents);
@@ -73,7 +80,8 @@ private:
 
 		for (i = 0; i < burstReadCount && !done; i++) {
 			if (buffer.empty()) {
-				buffer = MemoryKit::mbuf_get(&ctx->mbuf_pool);
+				buffer = MemoryKit::mbuf_get(ctx->getMbufPoolForSize(
+					getExpectedReadSize()));
 			}
 
 			origBufferSize = buffer.size();
@@ -81,6 +89,7 @@ private:
 				ret = ::read(watcher.fd, buffer.start, buffer.size());
 			} while (OXT_UNLIKELY(ret == -1 && errno == EINTR));
 			if (ret > 0) {
+				updateReadSizeStatistics(ret, origBufferSize);
 				MemoryKit::mbuf buffer2(buffer, 0, ret);
 				if (size_t(ret) == size_t(buffer.size())) {
 					// Unref mbuf_block
@@ -125,6 +134,27 @@ private:
 		}
 	}
 
+	size_t getExpectedReadSize() const {
+		if (readSizeHint > 0) {
+			return (size_t) std::min<boost::uint64_t>(readSizeHint, UINT_MAX);
+		} else {
+			return lastReadSize;
+		}
+	}
+
+	void updateReadSizeStatistics(size_t size, size_t bufferSize) {
+		if (readSizeHint > 0) {
+			readSizeHint -= std::min<boost::uint64_t>(readSizeHint, size);
+		}
+		if (size == bufferSize && size < UINT_MAX) {
+			// The buffer was too small to hold everything that was
+			// available, so pick a larger size class next time.
+			lastReadSize = size + 1;
+		} else {
+			lastReadSize = size;
+		}
+	}
+
 	static void onChannelConsumed(Channel *channel, unsigned int size) {
 		FdSourceChannel *self = static_cast<FdSourceChannel *>(channel);
 		self->consumedCallback = NULL;
@@ -135,6 +165,8 @@ private:
 
 	void initialize() {
 		burstReadCount = 1;
+		readSizeHint = 0;
+		lastReadSize = 0;
 		watcher.active = false;
 		watcher.fd = -1;
 		watcher.data = this;
@@ -168,6 +200,8 @@ public:
 	void reinitialize(int fd) {
 		Channel::reinitialize();
 		ev_io_init(&watcher, _onReadable, fd, EV_READ);
+		readSizeHint = 0;
+		lastReadSize = 0;
 	}
 
 	void deinitialize() {
@@ -180,6 +214,16 @@ public:
 		Channel::deinitialize();
 	}
 
+	/**
+	 * Tells the channel how many bytes are expected to arrive next, e.g.
+	 * the Content-Length of a body. This is used to pick an mbuf size class
+	 * for subsequent reads. The hint is decremented as data is read. Pass 0
+	 * to fall back to sizing buffers based on the previous read.
+	 */
+	void setReadSizeHint(boost::uint64_t size) {
+		readSizeHint = size;
+	}
+
 	// May only be called right after the constructor or reinitialize().
 	void startReading() {
 		startReadingInNextTick();
@@ -355,6 +355,10 @@ private:
 				return Channel::Result(ret, false);
 			case Request::PARSING_BODY:
 				SKC_TRACE(client, 2, "Expecting a request body");
+				if (req->aux.bodyInfo.contentLength > buffer.size() - ret) {
+					client->input.setReadSizeHint(req->aux.bodyInfo.contentLength
+						- (buffer.size() - ret));
+				}
 				onRequestBegin(client, req);
 				return Channel::Result(ret, false);
 			case Request::PARSING_CHUNKED_BODY:
@@ -1024,7 +1028,7 @@ public:
 	/***** Server management *****/
 
 	virtual void compact(LoggingKit::Level logLevel = LoggingKit::NOTICE) {
-		ParentClass::compact();
+		ParentClass::compact(logLevel);
 		unsigned int count = freeRequestCount;
 
 		while (!STAILQ_EMPTY(&freeRequests)) {
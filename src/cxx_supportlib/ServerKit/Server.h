@@ -58,6 +58,7 @@
 #include <LoggingKit/LoggingKit.h>
 #include <SafeLibev.h>
 #include <Constants.h>
+#include <MemoryKit/slab.h>
 #include <ServerKit/Context.h>
 #include <ServerKit/Errors.h>
 #include <ServerKit/Hooks.h>
@@ -300,6 +301,8 @@ public:
 
 private:
 	Context *ctx;
+	// Only used if ctx->slabAllocation is true.
+	struct MemoryKit::slab_allocator clientSlabAllocator;
 	unsigned int nextClientNumber: 28;
 	uint8_t nEndpoints: 3;
 	bool accept4Available: 1;
@@ -315,6 +318,11 @@ private:
 		TAILQ_INIT(&activeClients);
 		TAILQ_INIT(&disconnectedClients);
 
+		if (context->slabAllocation) {
+			MemoryKit::slab_allocator_init(&clientSlabAllocator, sizeof(Client),
+				context->slabHugepages, context->slabMaxIdleSlabs);
+		}
+
 		acceptResumptionWatcher.set(context->libev->getLoop());
 		acceptResumptionWatcher.set<
 			BaseServer<DerivedServer, Client>,
@@ -474,7 +482,7 @@ private:
 		Client *client;
 		SKS_TRACE(3, "Creating new client object");
 		try {
-			client = new Client(this);
+			client = allocateClientObject();
 		} catch (const std::bad_alloc &) {
 			return NULL;
 		}
@@ -482,6 +490,32 @@ private:
 		return client;
 	}
 
+	Client *allocateClientObject() {
+		if (!ctx->slabAllocation) {
+			return new Client(this);
+		}
+
+		void *mem = MemoryKit::slab_alloc(&clientSlabAllocator);
+		if (OXT_UNLIKELY(mem == NULL)) {
+			throw std::bad_alloc();
+		}
+		try {
+			return new (mem) Client(this);
+		} catch (...) {
+			MemoryKit::slab_free(&clientSlabAllocator, mem);
+			throw;
+		}
+	}
+
+	void destroyClientObject(Client *client) {
+		if (ctx->slabAllocation) {
+			client->~Client();
+			MemoryKit::slab_free(&clientSlabAllocator, client);
+		} else {
+			delete client;
+		}
+	}
+
 	void clientReachedZeroRefcount(Client *client) {
 		TRACE_POINT();
 		assert(disconnectedClientCount > 0);
@@ -497,7 +531,7 @@ private:
 		} else {
 			SKC_TRACE(client, 3, "Client object destroyed; not added to freelist " <<
 				"because it's full (" << freeClientCount << ")");
-			delete client;
+			destroyClientObject(client);
 		}
 
 		if (serverState == SHUTTING_DOWN
@@ -756,6 +790,9 @@ public:
 
 	virtual ~BaseServer() {
 		P_ASSERT_EQ(serverState, FINISHED_SHUTDOWN);
+		if (ctx->slabAllocation) {
+			MemoryKit::slab_allocator_deinit(&clientSlabAllocator);
+		}
 	}
 
 
@@ -894,12 +931,18 @@ public:
 			client->refcount.store(2, boost::memory_order_relaxed);
 			freeClientCount--;
 			STAILQ_REMOVE_HEAD(&freeClients, nextClient.freeClient);
-			delete client;
+			destroyClientObject(client);
 		}
 		assert(freeClientCount == 0);
 
 		SKS_LOG(logLevel, __FILE__, __LINE__,
 			"Freed " << count << " spare client objects");
+
+		if (ctx->slabAllocation) {
+			count = MemoryKit::slab_allocator_release_idle(&clientSlabAllocator);
+			SKS_LOG(logLevel, __FILE__, __LINE__,
+				"Released " << count << " idle client object slabs");
+		}
 	}
 
 
@@ -1130,6 +1173,10 @@ public:
 		doc["pid"] = (unsigned int) getpid();
 		doc["server_state"] = getServerStateString();
 		doc["free_client_count"] = freeClientCount;
+		if (ctx->slabAllocation) {
+			doc["client_slab_allocator"] = Context::inspectSlabAllocatorAsJson(
+				clientSlabAllocator);
+		}
 		Json::Value &activeClientsDoc = doc["active_clients"] = Json::Value(Json::objectValue);
 		doc["active_client_count"] = activeClientCount;
 		Json::Value &disconnectedClientsDoc = doc["disconnected_clients"] = Json::Value(Json::objectValue);
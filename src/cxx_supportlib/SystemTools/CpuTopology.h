@@ -0,0 +1,183 @@
+/*
+ *  Phusion Passenger - https://www.phusionpassenger.com/
+ *  Copyright (c) 2018 Phusion Holding B.V.
+ *
+ *  "Passenger", "Phusion Passenger" and "Union Station" are registered
+ *  trademarks of Phusion Holding B.V.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef _PASSENGER_SYSTEM_TOOLS_CPU_TOPOLOGY_H_
+#define _PASSENGER_SYSTEM_TOOLS_CPU_TOPOLOGY_H_
+
+#include <boost/predef.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <dirent.h>
+#include <sched.h>
+#include <cstring>
+#include <cstdlib>
+
+#include <StaticString.h>
+#include <Exceptions.h>
+#include <FileTools/FileManip.h>
+#include <StrIntTools/StrIntUtils.h>
+
+namespace Passenger {
+
+using namespace std;
+
+
+/** CPU numbers in a CPU list must be lower than this. */
+#ifdef CPU_SETSIZE
+	static const unsigned int MAX_CPU_LIST_CPU_COUNT = CPU_SETSIZE;
+#else
+	static const unsigned int MAX_CPU_LIST_CPU_COUNT = 1024;
+#endif
+
+/**
+ * Parses a CPU list in the format used by the Linux kernel and taskset,
+ * e.g. "0-3,8,10-11". The resulting CPU numbers are appended to `result`
+ * in ascending order, without duplicates.
+ *
+ * @throws ArgumentException The list is malformed, contains a reversed
+ *   range, or contains a CPU number of MAX_CPU_LIST_CPU_COUNT or higher.
+ */
+inline void
+parseCpuList(const StaticString &str, vector<unsigned int> &result) {
+	vector<string> parts;
+	set<unsigned int> cpus;
+
+	split(strip(str), ',', parts);
+	for (vector<string>::const_iterator it = parts.begin(); it != parts.end(); it++) {
+		string part = strip(*it);
+		if (part.empty()) {
+			continue;
+		}
+
+		string::size_type sep = part.find('-');
+		string first = strip(part.substr(0, sep));
+		string last = (sep == string::npos) ? first : strip(part.substr(sep + 1));
+		// The length check keeps stringToULL() from overflowing.
+		if (!looksLikePositiveNumber(first) || !looksLikePositiveNumber(last)
+		 || first.size() > 18 || last.size() > 18)
+		{
+			throw ArgumentException("Invalid CPU list: '" + str + "'");
+		}
+
+		unsigned long long begin = stringToULL(first);
+		unsigned long long end = stringToULL(last);
+		if (begin > end) {
+			throw ArgumentException("Invalid CPU list: '" + str + "'");
+		}
+		if (end >= MAX_CPU_LIST_CPU_COUNT) {
+			throw ArgumentException("Invalid CPU list: '" + str + "': CPU numbers"
+				" must be lower than " + toString(MAX_CPU_LIST_CPU_COUNT));
+		}
+		for (unsigned int i = (unsigned int) begin; i <= (unsigned int) end; i++) {
+			cpus.insert(i);
+		}
+	}
+
+	result.insert(result.end(), cpus.begin(), cpus.end());
+}
+
+/**
+ * Returns a map from CPU number to NUMA node number, as reported by
+ * /sys/devices/system/node. Returns an empty map if the NUMA topology
+ * is unknown, e.g. on non-Linux systems or on kernels without NUMA support.
+ */
+inline map<unsigned int, unsigned int>
+getCpuToNumaNodeMap() {
+	map<unsigned int, unsigned int> result;
+
+	#if BOOST_OS_LINUX
+		DIR *dir = opendir("/sys/devices/system/node");
+		if (dir == NULL) {
+			return result;
+		}
+
+		struct dirent *ent;
+		while ((ent = readdir(dir)) != NULL) {
+			if (strncmp(ent->d_name, "node", 4) != 0
+			 || !looksLikePositiveNumber(ent->d_name + 4))
+			{
+				continue;
+			}
+
+			unsigned int node = stringToUint(ent->d_name + 4);
+			string path = string("/sys/devices/system/node/") + ent->d_name + "/cpulist";
+			vector<unsigned int> cpus;
+			try {
+				parseCpuList(unsafeReadFile(path), cpus);
+			} catch (const SystemException &) {
+				continue;
+			} catch (const ArgumentException &) {
+				continue;
+			}
+
+			for (vector<unsigned int>::const_iterator it = cpus.begin(); it != cpus.end(); it++) {
+				result[*it] = node;
+			}
+		}
+		closedir(dir);
+	#endif
+
+	return result;
+}
+
+/**
+ * Reorders the given CPUs so that consecutive entries alternate between
+ * NUMA nodes. When assigning threads to `cpus[i % cpus.size()]`, this spreads
+ * the threads (and the memory they first touch) evenly over all nodes
+ * instead of filling up one socket first. CPUs with an unknown node are
+ * treated as belonging to node 0.
+ */
+inline vector<unsigned int>
+interleaveCpusByNumaNode(const vector<unsigned int> &cpus,
+	const map<unsigned int, unsigned int> &cpuToNode)
+{
+	map< unsigned int, vector<unsigned int> > cpusByNode;
+	vector<unsigned int> result;
+
+	for (vector<unsigned int>::const_iterator it = cpus.begin(); it != cpus.end(); it++) {
+		map<unsigned int, unsigned int>::const_iterator nodeIt = cpuToNode.find(*it);
+		unsigned int node = (nodeIt == cpuToNode.end()) ? 0 : nodeIt->second;
+		cpusByNode[node].push_back(*it);
+	}
+
+	result.reserve(cpus.size());
+	for (unsigned int i = 0; result.size() < cpus.size(); i++) {
+		map< unsigned int, vector<unsigned int> >::const_iterator it;
+		for (it = cpusByNode.begin(); it != cpusByNode.end(); it++) {
+			if (i < it->second.size()) {
+				result.push_back(it->second[i]);
+			}
+		}
+	}
+
+	return result;
+}
+
+
+} // namespace Passenger
+
+#endif /* _PASSENGER_SYSTEM_TOOLS_CPU_TOPOLOGY_H_ */
@@ -48,6 +48,7 @@
 #include <signal.h>
 #ifdef __linux__
 	#include <sys/syscall.h>
+	#include <sys/vfs.h>
 	#include <features.h>
 #endif
 #include <vector>
@@ -270,6 +271,33 @@ getSystemTempDir() {
 	return temp_dir;
 }
 
+const char *
+getMemoryBackedTempDir() {
+	const char *temp_dir = getenv("TMPDIR");
+	if (temp_dir != NULL && *temp_dir != '\0') {
+		return temp_dir;
+	}
+
+	#ifdef __linux__
+		// 0x01021994 is TMPFS_MAGIC. We only accept /dev/shm if it is
+		// sticky, just like /tmp, so that users can't remove each
+		// other's files.
+		struct statfs fsinfo;
+		struct stat info;
+		if (statfs("/dev/shm", &fsinfo) == 0
+		 && fsinfo.f_type == 0x01021994
+		 && stat("/dev/shm", &info) == 0
+		 && S_ISDIR(info.st_mode)
+		 && (info.st_mode & S_ISVTX)
+		 && access("/dev/shm", W_OK | X_OK) == 0)
+		{
+			return "/dev/shm";
+		}
+	#endif
+
+	return getSystemTempDir();
+}
+
 void
 prestartWebApps(const ResourceLocator &locator, const string &ruby,
 	const vector<string> &prestartURLs)
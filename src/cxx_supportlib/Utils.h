@@ -124,6 +124,17 @@ mode_t parseModeString(const StaticString &mode);
  */
 const char *getSystemTempDir();
 
+/**
+ * Like getSystemTempDir(), but if the user did not explicitly set $TMPDIR, and
+ * the system has a world-writable memory-backed directory (i.e. /dev/shm on
+ * Linux), then return that instead. Suitable for short-lived, small files
+ * that are frequently created and removed.
+ *
+ * @ensure result != NULL
+ * @ingroup Support
+ */
+const char *getMemoryBackedTempDir();
+
 void prestartWebApps(const ResourceLocator &locator, const string &ruby,
 	const vector<string> &prestartURLs);
 
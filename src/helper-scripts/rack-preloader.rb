@@ -187,6 +187,7 @@ def self.negotiate_spawn_command
 
     LoaderSharedHelpers.run_block_and_record_step_progress('SUBPROCESS_APP_LOAD_OR_EXEC') do
       preload_app
+      PreloaderSharedHelpers.prepare_for_forking
     end
 
     server = nil
@@ -54,20 +54,37 @@ def read_startup_arguments():
 	with open(path, 'r') as f:
 		options = json.load(f)
 
-def record_journey_step_begin(step, state):
-	work_dir = os.getenv('PASSENGER_SPAWN_WORK_DIR')
+def record_journey_step_begin(step, state, work_dir = None):
+	work_dir = work_dir or os.getenv('PASSENGER_SPAWN_WORK_DIR')
 	step_dir = work_dir + '/response/steps/' + step.lower()
 	try_write_file(step_dir + '/state', state)
 	try_write_file(step_dir + '/begin_time', str(time.time()))
 
-def record_journey_step_end(step, state):
-	work_dir = os.getenv('PASSENGER_SPAWN_WORK_DIR')
+def record_journey_step_end(step, state, work_dir = None):
+	work_dir = work_dir or os.getenv('PASSENGER_SPAWN_WORK_DIR')
 	step_dir = work_dir + '/response/steps/' + step.lower()
 	try_write_file(step_dir + '/state', state)
 	if not os.path.exists(step_dir + '/begin_time') and not os.path.exists(step_dir + '/begin_time_monotonic'):
 		try_write_file(step_dir + '/begin_time', str(time.time()))
 	try_write_file(step_dir + '/end_time', str(time.time()))
 
+# The number of threads that handle requests concurrently in each process.
+# Configured through the PASSENGER_WSGI_THREAD_COUNT environment variable
+# (e.g. with `passenger_env_var`). Defaults to 1: one request at a time.
+def determine_thread_count():
+	value = os.getenv('PASSENGER_WSGI_THREAD_COUNT', '')
+	if value == '':
+		return 1
+	try:
+		thread_count = int(value)
+	except ValueError:
+		thread_count = 0
+	if thread_count < 1:
+		logging.warning('Warning: invalid PASSENGER_WSGI_THREAD_COUNT value ' + repr(value) +
+			', using 1 thread')
+		return 1
+	return thread_count
+
 def load_app():
 	global options
 
@@ -75,16 +92,16 @@ def load_app():
 	startup_file = options.get('startup_file', 'passenger_wsgi.py')
 	return imp.load_source('passenger_wsgi', startup_file)
 
-def create_server_socket():
+def create_server_socket(prefix = 'wsgi', tmp_prefix = 'PsgWsgiApp'):
 	global options
 
 	UNIX_PATH_MAX = int(options.get('UNIX_PATH_MAX', 100))
 	if 'socket_dir' in options:
 		socket_dir = options['socket_dir']
-		socket_prefix = 'wsgi'
+		socket_prefix = prefix
 	else:
 		socket_dir = tempfile.gettempdir()
-		socket_prefix = 'PsgWsgiApp'
+		socket_prefix = tmp_prefix
 
 	i = 0
 	while i < 128:
@@ -128,7 +145,7 @@ def debug_and_exit(sig, frame):
 	# handler and no SIGQUIT handler.
 	signal.signal(signal.SIGABRT, debug_and_exit)
 
-def advertise_sockets(socket_filename):
+def advertise_sockets(socket_filename, concurrency = 1):
 	work_dir = os.getenv('PASSENGER_SPAWN_WORK_DIR')
 	path = work_dir + '/response/properties.json'
 	doc = {
@@ -137,8 +154,10 @@ def advertise_sockets(socket_filename):
 				'name': 'main',
 				'address': 'unix:' + socket_filename,
 				'protocol': 'session',
-				'concurrency': 1,
-				'accept_http_requests': True
+				'concurrency': concurrency,
+				'accept_http_requests': True,
+				'framed_request_bodies': True,
+				'binary_session_header_version': BINARY_SESSION_HEADER_VERSION
 			}
 		]
 	}
@@ -174,13 +193,211 @@ def str_to_bytes(s):
 		return s
 
 
+# The interned keys of the binary session protocol header encoding. Keep in
+# sync with the key table in the Passenger core's Controller/SendRequest.cpp.
+SESSION_HEADER_KEYS = (
+	'REQUEST_URI', 'PATH_INFO', 'SCRIPT_NAME', 'QUERY_STRING', 'REQUEST_METHOD',
+	'SERVER_NAME', 'SERVER_PORT', 'SERVER_SOFTWARE', 'SERVER_PROTOCOL',
+	'REMOTE_ADDR', 'REMOTE_PORT', 'REMOTE_USER', 'CONTENT_TYPE', 'CONTENT_LENGTH',
+	'PASSENGER_CONNECT_PASSWORD', 'HTTPS', 'HTTP_CONNECTION', 'HTTP_HOST',
+	'HTTP_USER_AGENT', 'HTTP_ACCEPT', 'HTTP_ACCEPT_ENCODING', 'HTTP_ACCEPT_LANGUAGE',
+	'HTTP_COOKIE', 'HTTP_REFERER', 'HTTP_CACHE_CONTROL', 'HTTP_IF_MODIFIED_SINCE',
+	'HTTP_IF_NONE_MATCH', 'HTTP_AUTHORIZATION', 'HTTP_ORIGIN', 'HTTP_X_FORWARDED_FOR',
+	'HTTP_X_FORWARDED_PROTO', 'HTTP_X_REQUESTED_WITH', 'HTTP_UPGRADE'
+)
+SESSION_HEADER_LITERAL_KEY = 0xFF
+# Parsing the binary encoding is only faster than splitting the NUL-separated
+# encoding if we can index bytes directly, so only ask for it on Python 3.
+if sys.version_info[0] >= 3:
+	BINARY_SESSION_HEADER_VERSION = 1
+else:
+	BINARY_SESSION_HEADER_VERSION = 0
+
+unpack_uint16 = struct.Struct('>H').unpack_from
+unpack_uint32 = struct.Struct('>I').unpack_from
+
+# Parses a request header in the binary session protocol encoding into a
+# dict. Returns None if the header is malformed. Python 3 only.
+def parse_binary_session_header(buf):
+	if buf[0:2] != b'\x00\x01':
+		return None
+	env = {}
+	pos = 2
+	size = len(buf)
+	key_count = len(SESSION_HEADER_KEYS)
+	try:
+		while pos < size:
+			index = buf[pos]
+			pos += 1
+			if index < key_count:
+				key = SESSION_HEADER_KEYS[index]
+			elif index == SESSION_HEADER_LITERAL_KEY:
+				key_end = pos + 2 + unpack_uint16(buf, pos)[0]
+				key = buf[pos + 2:key_end].decode('latin-1')
+				pos = key_end
+			else:
+				return None
+			value_end = pos + 4 + unpack_uint32(buf, pos)[0]
+			env[key] = buf[pos + 4:value_end].decode('latin-1')
+			pos = value_end
+	except struct.error:
+		return None
+	if pos != size:
+		# A key or value extends past the end of the header.
+		return None
+	return env
+
+
+# The object passed to the application as wsgi.input. Unlike a plain socket
+# file object, it never reads past the end of the request body (as given by
+# CONTENT_LENGTH), so that the connection can be reused for the next request.
+# Chunked request bodies are dechunked by the Passenger core and terminated
+# by EOF instead.
+class RequestInput:
+	BLOCK_SIZE = 1024 * 16
+
+	def __init__(self, sock, env):
+		self.sock = sock
+		self.buffer = b''
+		self.eof = False
+		self.truncated = False
+		try:
+			self.remaining = int(env.get('CONTENT_LENGTH') or 0)
+		except ValueError:
+			self.remaining = None
+		if self.remaining == 0 and env.get('HTTP_TRANSFER_ENCODING', '').lower() == 'chunked':
+			self.remaining = None
+
+	# Whether the end of the body is known without waiting for EOF.
+	def is_framed(self):
+		return self.remaining is not None
+
+	# Reads at most `size` more bytes of the body into the buffer.
+	# Returns False if there is nothing more to read.
+	def fill_buffer(self, size):
+		if self.eof:
+			return False
+		if self.remaining is not None:
+			size = min(size, self.remaining)
+			if size == 0:
+				self.eof = True
+				return False
+		data = self.sock.recv(size)
+		if len(data) == 0:
+			self.eof = True
+			self.truncated = bool(self.remaining)
+			return False
+		if self.remaining is not None:
+			self.remaining -= len(data)
+		self.buffer += data
+		return True
+
+	def consume_buffer(self, size):
+		data = self.buffer[:size]
+		self.buffer = self.buffer[size:]
+		return data
+
+	def read(self, size = -1):
+		if size is None or size < 0:
+			chunks = [self.buffer]
+			self.buffer = b''
+			while self.fill_buffer(self.BLOCK_SIZE):
+				chunks.append(self.buffer)
+				self.buffer = b''
+			return b''.join(chunks)
+		else:
+			while len(self.buffer) < size and self.fill_buffer(size - len(self.buffer)):
+				pass
+			return self.consume_buffer(size)
+
+	def readline(self, size = -1):
+		if size is None:
+			size = -1
+		while True:
+			pos = self.buffer.find(b"\n")
+			if pos != -1:
+				end = pos + 1
+				break
+			if (size >= 0 and len(self.buffer) >= size) or not self.fill_buffer(self.BLOCK_SIZE):
+				end = len(self.buffer)
+				break
+		if size >= 0:
+			end = min(end, size)
+		return self.consume_buffer(end)
+
+	def readlines(self, hint = -1):
+		lines = []
+		total = 0
+		while True:
+			line = self.readline()
+			if not line:
+				break
+			lines.append(line)
+			total += len(line)
+			if hint is not None and hint > 0 and total >= hint:
+				break
+		return lines
+
+	def __iter__(self):
+		return self
+
+	def __next__(self):
+		line = self.readline()
+		if not line:
+			raise StopIteration
+		return line
+
+	next = __next__
+
+	# Reads and discards the part of the body that the application did not
+	# read. Returns whether the connection is positioned at the start of
+	# the next request.
+	def drain(self):
+		if self.remaining is None:
+			return False
+		try:
+			self.buffer = b''
+			while self.fill_buffer(self.BLOCK_SIZE):
+				self.buffer = b''
+		except (IOError, OSError):
+			return False
+		return not self.truncated
+
+
 class RequestHandler:
-	def __init__(self, server_socket, owner_pipe, app):
+	def __init__(self, server_socket, owner_pipe, app, thread_count = 1):
 		self.server = server_socket
 		self.owner_pipe = owner_pipe
 		self.app = app
+		self.thread_count = thread_count
 
 	def main_loop(self):
+		if self.thread_count > 1:
+			self.threaded_main_loop()
+		else:
+			self.serve_connections()
+
+	# Runs `thread_count` threads that each accept and process connections
+	# on their own, until the owner pipe is closed. The server socket is
+	# made non-blocking so that threads that lose the race for a connection
+	# go back to waiting on the owner pipe instead of blocking in accept().
+	def threaded_main_loop(self):
+		self.server.setblocking(False)
+		threads = []
+		for i in range(self.thread_count):
+			thread = threading.Thread(target = self.serve_connections,
+				name = 'Worker %d' % (i + 1))
+			thread.daemon = True
+			thread.start()
+			threads.append(thread)
+		try:
+			for thread in threads:
+				while thread.is_alive():
+					thread.join(1)
+		except KeyboardInterrupt:
+			pass
+
+	def serve_connections(self):
 		done = False
 		try:
 			while not done:
@@ -188,44 +405,81 @@ def main_loop(self):
 				if not client:
 					done = True
 					break
-				socket_hijacked = False
-				try:
-					try:
-						env, input_stream = self.parse_request(client)
-						if env:
-							if env['REQUEST_METHOD'] == 'ping':
-								self.process_ping(env, input_stream, client)
-							else:
-								socket_hijacked = self.process_request(env, input_stream, client)
-					except KeyboardInterrupt:
-						done = True
-					except IOError:
-						e = sys.exc_info()[1]
-						if not getattr(e, 'passenger', False) or e.errno != errno.EPIPE:
-							logging.exception("WSGI application raised an I/O exception!")
-					except Exception:
-						logging.exception("WSGI application raised an exception!")
-				finally:
-					if not socket_hijacked:
-						try:
-							# Shutdown the socket like this just in case the app
-							# spawned a child process that keeps it open.
-							client.shutdown(socket.SHUT_WR)
-						except:
-							pass
-						try:
-							client.close()
-						except:
-							pass
+				done = self.process_connection(client)
 		except KeyboardInterrupt:
 			pass
 
+	# Processes requests on the given connection until it's closed or can't
+	# be kept alive. Returns whether the main loop should stop.
+	def process_connection(self, client):
+		done = False
+		socket_hijacked = False
+		try:
+			keepalive = True
+			while keepalive:
+				keepalive = False
+				try:
+					env, input_stream = self.parse_request(client)
+					if env:
+						if env['REQUEST_METHOD'] == 'ping':
+							self.process_ping(env, input_stream, client)
+						else:
+							socket_hijacked, keepalive = self.process_request(env, input_stream, client)
+				except KeyboardInterrupt:
+					done = True
+				except IOError:
+					e = sys.exc_info()[1]
+					if not getattr(e, 'passenger', False) or e.errno != errno.EPIPE:
+						logging.exception("WSGI application raised an I/O exception!")
+				except Exception:
+					logging.exception("WSGI application raised an exception!")
+				if keepalive:
+					keepalive = self.wait_for_next_request(client)
+		finally:
+			if not socket_hijacked:
+				try:
+					# Shutdown the socket like this just in case the app
+					# spawned a child process that keeps it open.
+					client.shutdown(socket.SHUT_WR)
+				except:
+					pass
+				try:
+					client.close()
+				except:
+					pass
+		return done
+
+	# Waits until the Passenger core sends another request over a kept-alive
+	# connection. The core never keeps more idle connections around than our
+	# concurrency, so waiting here doesn't starve new connections. Returns
+	# False if we should shut down instead.
+	def wait_for_next_request(self, client):
+		while True:
+			try:
+				result = select.select([self.owner_pipe, client], [], [])[0]
+			except select.error:
+				e = sys.exc_info()[1]
+				if e.args[0] == errno.EINTR:
+					continue
+				raise
+			return client in result and self.owner_pipe not in result
+
 	def accept_connection(self):
-		result = select.select([self.owner_pipe, self.server.fileno()], [], [])[0]
-		if self.server.fileno() in result:
-			return self.server.accept()
-		else:
-			return (None, None)
+		while True:
+			result = select.select([self.owner_pipe, self.server.fileno()], [], [])[0]
+			if self.server.fileno() in result:
+				try:
+					client, address = self.server.accept()
+				except socket.error:
+					e = sys.exc_info()[1]
+					if e.errno in (errno.EAGAIN, errno.EWOULDBLOCK):
+						# Another thread accepted this connection.
+						continue
+					raise
+				client.setblocking(True)
+				return (client, address)
+			else:
+				return (None, None)
 
 	def parse_request(self, client):
 		buf = b''
@@ -243,6 +497,14 @@ def parse_request(self, client):
 				return (None, None)
 			buf += tmp
 
+		if buf[0:1] == b"\0":
+			# Binary encoding, used because we advertised support for it.
+			env = parse_binary_session_header(buf)
+			if env is None:
+				logging.warning("Received a malformed binary session header")
+				return (None, None)
+			return (env, client)
+
 		headers = buf.split(b"\0")
 		headers.pop() # Remove trailing "\0"
 		env = {}
@@ -253,25 +515,20 @@ def parse_request(self, client):
 
 		return (env, client)
 
-	if hasattr(socket, '_fileobject'):
-		def wrap_input_socket(self, sock):
-			return socket._fileobject(sock, 'rb', 512)
-	else:
-		def wrap_input_socket(self, sock):
-			return socket.socket.makefile(sock, 'rb', 512)
-
+	# Processes a single request. Returns a tuple (socket_hijacked, keepalive).
 	def process_request(self, env, input_stream, output_stream):
 		# The WSGI specification says that the input parameter object passed needs to
-		# implement a few file-like methods. This is the reason why we "wrap" the socket._socket
-		# into the _fileobject to solve this.
+		# implement a few file-like methods. This is the reason why we wrap the socket
+		# into a RequestInput.
 		#
 		# Otherwise, the POST data won't be correctly retrieved by Django.
 		#
 		# See: http://www.python.org/dev/peps/pep-0333/#input-and-error-streams
-		env['wsgi.input']        = self.wrap_input_socket(input_stream)
+		input = RequestInput(input_stream, env)
+		env['wsgi.input']        = input
 		env['wsgi.errors']       = sys.stderr
 		env['wsgi.version']      = (1, 0)
-		env['wsgi.multithread']  = False
+		env['wsgi.multithread']  = self.thread_count > 1
 		env['wsgi.multiprocess'] = True
 		env['wsgi.run_once']	 = False
 		if env.get('HTTPS','off') in ('on', '1', 'true', 'yes'):
@@ -282,22 +539,55 @@ def process_request(self, env, input_stream, output_stream):
 		headers_set = []
 		headers_sent = []
 		is_head = env['REQUEST_METHOD'] == 'HEAD'
-
-		def write(data):
+		# The connection can only be kept alive if both the request body and
+		# the response body have a known length. `response` tracks the
+		# expected and actual response body sizes for that.
+		response = { 'keepalive': False, 'expected_size': None, 'size': 0 }
+
+		def send_headers(body_size):
+			status, response_headers = headers_sent[:] = headers_set
+			expected_size = None
+			keepalive = input.is_framed()
+			for name, value in response_headers:
+				name = name.lower()
+				if name == 'content-length':
+					try:
+						expected_size = int(value)
+					except ValueError:
+						keepalive = False
+				elif name in ('connection', 'transfer-encoding'):
+					keepalive = False
+			add_content_length = False
+			if status[:1] == '1' or status[:3] in ('204', '304'):
+				expected_size = 0
+			elif expected_size is None:
+				expected_size = body_size
+				add_content_length = body_size is not None
+			if expected_size is None:
+				keepalive = False
+
+			lines = ['HTTP/1.1 %s\r\nStatus: %s\r\n' % (status, status)]
+			if not keepalive:
+				lines.append('Connection: close\r\n')
+			for header in response_headers:
+				lines.append('%s: %s\r\n' % header)
+			if keepalive and add_content_length:
+				lines.append('Content-Length: %d\r\n' % body_size)
+			lines.append('\r\n')
+			output_stream.sendall(str_to_bytes(''.join(lines)))
+			response['keepalive'] = keepalive
+			response['expected_size'] = expected_size
+
+		def write(data, body_size = None):
 			try:
 				if not headers_set:
 					raise AssertionError("write() before start_response()")
 				elif not headers_sent:
 					# Before the first output, send the stored headers.
-					status, response_headers = headers_sent[:] = headers_set
-					output_stream.sendall(str_to_bytes(
-						'HTTP/1.1 %s\r\nStatus: %s\r\nConnection: close\r\n' %
-						(status, status)))
-					for header in response_headers:
-						output_stream.sendall(str_to_bytes('%s: %s\r\n' % header))
-					output_stream.sendall(b'\r\n')
+					send_headers(body_size)
 				if not is_head:
 					output_stream.sendall(str_to_bytes(data))
+					response['size'] += len(data)
 			except IOError:
 				# Mark this exception as coming from the Phusion Passenger
 				# socket and not some other socket.
@@ -333,19 +623,30 @@ def hijack(do_it = False):
 		result = self.app(env, start_response)
 		if 'passenger.hijacked_socket' in env:
 			# Socket connection hijacked. Don't do anything.
-			return True
+			return (True, False)
 		try:
+			if isinstance(result, (list, tuple)):
+				# The body size is known upfront, which allows us to
+				# add a Content-Length header if the app didn't.
+				body_size = sum([len(data) for data in result])
+			else:
+				body_size = None
 			for data in result:
 				# Don't send headers until body appears.
 				if data:
-					write(data)
+					write(data, body_size)
 			if not headers_sent:
 				# Send headers now if body was empty.
-				write(b'')
+				write(b'', body_size)
 		finally:
 			if hasattr(result, 'close'):
 				result.close()
-		return False
+
+		keepalive = response['keepalive'] \
+			and 'passenger.hijacked_socket' not in env \
+			and (is_head or response['size'] == response['expected_size']) \
+			and input.drain()
+		return (False, keepalive)
 
 	def process_ping(self, env, input_stream, output_stream):
 		output_stream.sendall(b"pong")
@@ -378,8 +679,10 @@ def process_ping(self, env, input_stream, output_stream):
 	try:
 		socket_filename, server_socket = create_server_socket()
 		install_signal_handlers()
-		handler = RequestHandler(server_socket, sys.stdin, app_module.application)
-		advertise_sockets(socket_filename)
+		thread_count = determine_thread_count()
+		handler = RequestHandler(server_socket, sys.stdin, app_module.application,
+			thread_count)
+		advertise_sockets(socket_filename, thread_count)
 	except Exception:
 		record_journey_step_end('SUBPROCESS_LISTEN', 'STEP_ERRORED')
 		raise
@@ -0,0 +1,289 @@
+#!/usr/bin/env python
+#  Phusion Passenger - https://www.phusionpassenger.com/
+#  Copyright (c) 2010-2017 Phusion Holding B.V.
+#
+#  "Passenger", "Phusion Passenger" and "Union Station" are registered
+#  trademarks of Phusion Holding B.V.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy
+#  of this software and associated documentation files (the "Software"), to deal
+#  in the Software without restriction, including without limitation the rights
+#  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+#  copies of the Software, and to permit persons to whom the Software is
+#  furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in
+#  all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#  THE SOFTWARE.
+
+# Smart spawning support for WSGI apps. This program loads the application
+# once and then forks worker processes on behalf of SpawningKit::SmartSpawner,
+# speaking the same preloader protocol as rack-preloader.rb. The actual
+# request handling is done by the RequestHandler in wsgi-loader.py.
+
+import sys, os, imp, gc, signal, socket, select, json, traceback, errno
+
+loader = imp.load_source('passenger_wsgi_loader',
+	os.path.join(os.path.dirname(os.path.abspath(__file__)), 'wsgi-loader.py'))
+
+def prepare_for_forking():
+	# Collect garbage now and move all surviving objects into a permanent
+	# generation that the collector ignores, so that the workers don't
+	# touch (and thus copy) the preloaded objects' GC headers.
+	gc.collect()
+	if hasattr(gc, 'freeze'):
+		gc.freeze()
+
+def advertise_preloader_socket(socket_filename):
+	work_dir = os.getenv('PASSENGER_SPAWN_WORK_DIR')
+	path = work_dir + '/response/properties.json'
+	doc = {
+		'sockets': [
+			{
+				'name': 'main',
+				'address': 'unix:' + socket_filename,
+				'protocol': 'preloader',
+				'concurrency': 1
+			}
+		]
+	}
+	with open(path, 'w') as f:
+		json.dump(doc, f)
+
+def write_json(client, doc):
+	client.sendall(loader.str_to_bytes(json.dumps(doc)))
+
+def read_command(client):
+	buf = b''
+	while not buf.endswith(b"\n"):
+		tmp = client.recv(1024)
+		if len(tmp) == 0:
+			break
+		buf += tmp
+	if len(buf) == 0:
+		return None
+	return json.loads(loader.bytes_to_str(buf))
+
+def handle_spawn_command(client, doc):
+	work_dir = doc['work_dir']
+	loader.record_journey_step_end('PRELOADER_PREPARATION', 'STEP_PERFORMED', work_dir)
+	loader.record_journey_step_begin('PRELOADER_FORK_SUBPROCESS', 'STEP_IN_PROGRESS', work_dir)
+
+	try:
+		pid = os.fork()
+	except OSError:
+		loader.record_journey_step_end('PRELOADER_FORK_SUBPROCESS', 'STEP_ERRORED', work_dir)
+		raise
+
+	if pid == 0:
+		try:
+			signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+			loader.record_journey_step_end('PRELOADER_FORK_SUBPROCESS', 'STEP_PERFORMED', work_dir)
+			loader.record_journey_step_begin('PRELOADER_SEND_RESPONSE', 'STEP_IN_PROGRESS', work_dir)
+			write_json(client, { 'result': 'ok', 'pid': os.getpid() })
+			loader.record_journey_step_end('PRELOADER_SEND_RESPONSE', 'STEP_PERFORMED', work_dir)
+			loader.record_journey_step_end('PRELOADER_FINISH', 'STEP_PERFORMED', work_dir)
+			return work_dir
+		except BaseException:
+			traceback.print_exc()
+			os._exit(1)
+	else:
+		return None
+
+# Forks one subprocess per work directory in doc['work_dirs'], so that
+# SpawningKit can start many processes with a single round-trip. The
+# response is written by the preloader once it's done forking, and contains
+# one 'spawn'-style result per subprocess.
+def handle_spawn_batch_command(client, doc):
+	forked_work_dirs = []
+	results = []
+
+	for work_dir in doc['work_dirs']:
+		loader.record_journey_step_end('PRELOADER_PREPARATION', 'STEP_PERFORMED', work_dir)
+		loader.record_journey_step_begin('PRELOADER_FORK_SUBPROCESS', 'STEP_IN_PROGRESS', work_dir)
+
+		try:
+			pid = os.fork()
+		except OSError:
+			e = sys.exc_info()[1]
+			loader.record_journey_step_end('PRELOADER_FORK_SUBPROCESS', 'STEP_ERRORED', work_dir)
+			if len(results) == 0:
+				raise
+			results.append({ 'result': 'error', 'message': 'Cannot fork: ' + str(e) })
+			break
+
+		if pid == 0:
+			signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+			loader.record_journey_step_end('PRELOADER_FORK_SUBPROCESS', 'STEP_PERFORMED', work_dir)
+			return work_dir
+		forked_work_dirs.append(work_dir)
+		results.append({ 'result': 'ok', 'pid': pid })
+
+	for work_dir in forked_work_dirs:
+		loader.record_journey_step_begin('PRELOADER_SEND_RESPONSE', 'STEP_IN_PROGRESS', work_dir)
+	write_json(client, { 'result': 'ok', 'results': results })
+	for work_dir in forked_work_dirs:
+		loader.record_journey_step_end('PRELOADER_SEND_RESPONSE', 'STEP_PERFORMED', work_dir)
+		loader.record_journey_step_end('PRELOADER_FINISH', 'STEP_PERFORMED', work_dir)
+	return None
+
+def accept_and_process_next_client(server_socket):
+	client, address = server_socket.accept()
+	try:
+		try:
+			doc = read_command(client)
+		except ValueError:
+			e = sys.exc_info()[1]
+			write_json(client, { 'result': 'error', 'message': 'JSON parse error: ' + str(e) })
+			return None
+		if doc is None:
+			return None
+
+		if doc.get('command') == 'spawn':
+			return handle_spawn_command(client, doc)
+		elif doc.get('command') == 'spawn_batch':
+			return handle_spawn_batch_command(client, doc)
+		else:
+			write_json(client, { 'result': 'error',
+				'message': 'Unknown command ' + repr(doc.get('command')) })
+			return None
+	finally:
+		try:
+			client.close()
+		except socket.error:
+			pass
+
+# Accepts spawn commands until our owner closes our stdin. Returns the work
+# directory of the new worker when running inside a forked subprocess, or
+# None when the preloader should exit.
+def run_main_loop(server_socket, socket_filename):
+	original_pid = os.getpid()
+	try:
+		while True:
+			try:
+				ios = select.select([server_socket, sys.stdin], [], [])[0]
+			except select.error:
+				e = sys.exc_info()[1]
+				if e.args[0] == errno.EINTR:
+					continue
+				raise
+			if server_socket in ios:
+				subprocess_work_dir = accept_and_process_next_client(server_socket)
+				if subprocess_work_dir is not None:
+					return subprocess_work_dir
+			if sys.stdin in ios:
+				break
+		return None
+	finally:
+		server_socket.close()
+		if os.getpid() == original_pid:
+			try:
+				os.remove(socket_filename)
+			except OSError:
+				pass
+
+def reinitialize_std_channels(work_dir):
+	if os.path.exists(work_dir + '/stdin'):
+		fd = os.open(work_dir + '/stdin', os.O_RDONLY)
+		os.dup2(fd, 0)
+		os.close(fd)
+	if os.path.exists(work_dir + '/stdout_and_err'):
+		sys.stdout.flush()
+		sys.stderr.flush()
+		fd = os.open(work_dir + '/stdout_and_err', os.O_WRONLY)
+		os.dup2(fd, 1)
+		os.dup2(fd, 2)
+		os.close(fd)
+
+def negotiate_spawn_command(work_dir, app_module):
+	os.environ['PASSENGER_SPAWN_WORK_DIR'] = work_dir
+
+	loader.record_journey_step_begin('SUBPROCESS_PREPARE_AFTER_FORKING_FROM_PRELOADER',
+		'STEP_IN_PROGRESS')
+	try:
+		loader.read_startup_arguments()
+		reinitialize_std_channels(work_dir)
+		loader.install_signal_handlers()
+	except Exception:
+		loader.record_journey_step_end('SUBPROCESS_PREPARE_AFTER_FORKING_FROM_PRELOADER',
+			'STEP_ERRORED')
+		raise
+	else:
+		loader.record_journey_step_end('SUBPROCESS_PREPARE_AFTER_FORKING_FROM_PRELOADER',
+			'STEP_PERFORMED')
+
+	loader.record_journey_step_begin('SUBPROCESS_LISTEN', 'STEP_IN_PROGRESS')
+	try:
+		socket_filename, server_socket = loader.create_server_socket()
+		thread_count = loader.determine_thread_count()
+		handler = loader.RequestHandler(server_socket, sys.stdin, app_module.application,
+			thread_count)
+		loader.advertise_sockets(socket_filename, thread_count)
+	except Exception:
+		loader.record_journey_step_end('SUBPROCESS_LISTEN', 'STEP_ERRORED')
+		raise
+	else:
+		loader.record_journey_step_end('SUBPROCESS_LISTEN', 'STEP_PERFORMED')
+
+	loader.advertise_readiness()
+	return (handler, socket_filename)
+
+
+if __name__ == "__main__":
+	loader.initialize_logging()
+	loader.record_journey_step_end('SUBPROCESS_EXEC_WRAPPER', 'STEP_PERFORMED')
+	loader.record_journey_step_begin('SUBPROCESS_WRAPPER_PREPARATION', 'STEP_IN_PROGRESS')
+	try:
+		loader.read_startup_arguments()
+	except Exception:
+		loader.record_journey_step_end('SUBPROCESS_WRAPPER_PREPARATION', 'STEP_ERRORED')
+		raise
+	else:
+		loader.record_journey_step_end('SUBPROCESS_WRAPPER_PREPARATION', 'STEP_PERFORMED')
+
+
+	loader.record_journey_step_begin('SUBPROCESS_APP_LOAD_OR_EXEC', 'STEP_IN_PROGRESS')
+	try:
+		app_module = loader.load_app()
+		prepare_for_forking()
+	except Exception:
+		loader.record_journey_step_end('SUBPROCESS_APP_LOAD_OR_EXEC', 'STEP_ERRORED')
+		raise
+	else:
+		loader.record_journey_step_end('SUBPROCESS_APP_LOAD_OR_EXEC', 'STEP_PERFORMED')
+
+
+	loader.record_journey_step_begin('SUBPROCESS_LISTEN', 'STEP_IN_PROGRESS')
+	try:
+		preloader_socket_filename, preloader_socket = loader.create_server_socket(
+			'preloader', 'PsgPreloader')
+		os.chmod(preloader_socket_filename, 0o600)
+		loader.install_signal_handlers()
+		# The workers we fork are not our responsibility: let the kernel
+		# reap them so that they don't linger as zombies.
+		signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+		advertise_preloader_socket(preloader_socket_filename)
+	except Exception:
+		loader.record_journey_step_end('SUBPROCESS_LISTEN', 'STEP_ERRORED')
+		raise
+	else:
+		loader.record_journey_step_end('SUBPROCESS_LISTEN', 'STEP_PERFORMED')
+
+
+	loader.advertise_readiness()
+	subprocess_work_dir = run_main_loop(preloader_socket, preloader_socket_filename)
+	if subprocess_work_dir is not None:
+		# Inside forked subprocess.
+		handler, socket_filename = negotiate_spawn_command(subprocess_work_dir, app_module)
+		handler.main_loop()
+		try:
+			os.remove(socket_filename)
+		except OSError:
+			pass
@@ -110,8 +110,8 @@ set_manifest_autogenerated_global_conf_defaults(manifest_gen_ctx_t *ctx) {
         ctx->global_config_container,
         "passenger_spawn_dir",
         sizeof("passenger_spawn_dir") - 1,
-        "Either $TMPDIR or /tmp",
-        sizeof("Either $TMPDIR or /tmp") - 1);
+        "Either $TMPDIR, /dev/shm, or /tmp (see docs)",
+        sizeof("Either $TMPDIR, /dev/shm, or /tmp (see docs)") - 1);
 
     add_manifest_options_container_static_default_bool(ctx,
         ctx->global_config_container,
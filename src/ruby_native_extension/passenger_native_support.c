@@ -94,6 +94,7 @@
 static VALUE mPassenger;
 static VALUE mNativeSupport;
 static VALUE S_ProcessTimes;
+static VALUE aSessionHeaderKeys;
 #ifdef HAVE_KQUEUE
 	static VALUE cFileSystemWatcher;
 #endif
@@ -146,6 +147,110 @@ split_by_null_into_hash(VALUE self, VALUE data) {
 	return result;
 }
 
+/*
+ * The interned keys of the binary session protocol header encoding. Keep in
+ * sync with the key table in the Passenger core's Controller/SendRequest.cpp.
+ */
+static const char *session_header_keys[] = {
+	"REQUEST_URI",
+	"PATH_INFO",
+	"SCRIPT_NAME",
+	"QUERY_STRING",
+	"REQUEST_METHOD",
+	"SERVER_NAME",
+	"SERVER_PORT",
+	"SERVER_SOFTWARE",
+	"SERVER_PROTOCOL",
+	"REMOTE_ADDR",
+	"REMOTE_PORT",
+	"REMOTE_USER",
+	"CONTENT_TYPE",
+	"CONTENT_LENGTH",
+	"PASSENGER_CONNECT_PASSWORD",
+	"HTTPS",
+	"HTTP_CONNECTION",
+	"HTTP_HOST",
+	"HTTP_USER_AGENT",
+	"HTTP_ACCEPT",
+	"HTTP_ACCEPT_ENCODING",
+	"HTTP_ACCEPT_LANGUAGE",
+	"HTTP_COOKIE",
+	"HTTP_REFERER",
+	"HTTP_CACHE_CONTROL",
+	"HTTP_IF_MODIFIED_SINCE",
+	"HTTP_IF_NONE_MATCH",
+	"HTTP_AUTHORIZATION",
+	"HTTP_ORIGIN",
+	"HTTP_X_FORWARDED_FOR",
+	"HTTP_X_FORWARDED_PROTO",
+	"HTTP_X_REQUESTED_WITH",
+	"HTTP_UPGRADE"
+};
+
+#define SESSION_HEADER_KEY_COUNT (sizeof(session_header_keys) / sizeof(const char *))
+#define SESSION_HEADER_LITERAL_KEY 0xFF
+#define BINARY_SESSION_HEADER_VERSION 1
+
+/**
+ * Parses a request header in the binary session protocol encoding into a hash.
+ * Returns nil if the header is malformed. Interned keys are preallocated frozen
+ * strings, and values are substrings of +data+, so that Ruby can share +data+'s
+ * buffer instead of copying every value.
+ */
+static VALUE
+parse_binary_session_header(VALUE self, VALUE data) {
+	const unsigned char *cdata = (const unsigned char *) RSTRING_PTR(data);
+	unsigned long len          = RSTRING_LEN(data);
+	const unsigned char *current;
+	const unsigned char *end     = cdata + len;
+	unsigned int index, key_size;
+	unsigned long value_size;
+	VALUE result, key, value;
+
+	if (len < 2 || cdata[0] != '\0' || cdata[1] != BINARY_SESSION_HEADER_VERSION) {
+		return Qnil;
+	}
+
+	result  = rb_hash_new();
+	current = cdata + 2;
+	while (current < end) {
+		index = *current++;
+		if (index == SESSION_HEADER_LITERAL_KEY) {
+			if (end - current < 2) {
+				return Qnil;
+			}
+			key_size = ((unsigned int) current[0] << 8) | current[1];
+			current += 2;
+			if ((unsigned long) (end - current) < key_size) {
+				return Qnil;
+			}
+			key = rb_obj_freeze(rb_str_substr(data, current - cdata, key_size));
+			current += key_size;
+		} else if (index < SESSION_HEADER_KEY_COUNT) {
+			key = rb_ary_entry(aSessionHeaderKeys, index);
+		} else {
+			return Qnil;
+		}
+
+		if (end - current < 4) {
+			return Qnil;
+		}
+		value_size = ((unsigned long) current[0] << 24)
+			| ((unsigned long) current[1] << 16)
+			| ((unsigned long) current[2] << 8)
+			| (unsigned long) current[3];
+		current += 4;
+		if ((unsigned long) (end - current) < value_size) {
+			return Qnil;
+		}
+		value = rb_str_substr(data, current - cdata, value_size);
+		current += value_size;
+
+		rb_hash_aset(result, key, value);
+	}
+	return result;
+}
+
 typedef struct {
 	/* The IO vectors in this group. */
 	struct iovec *io_vectors;
@@ -893,6 +998,7 @@ fs_watcher_close(VALUE self) {
 void
 Init_passenger_native_support() {
 	struct sockaddr_un addr;
+	unsigned int i;
 
 	/* Only defined on Ruby >= 1.9.3 */
 	#ifdef RUBY_API_VERSION_CODE
@@ -977,6 +1083,7 @@ Init_passenger_native_support() {
 
 	rb_define_singleton_method(mNativeSupport, "disable_stdio_buffering", disable_stdio_buffering, 0);
 	rb_define_singleton_method(mNativeSupport, "split_by_null_into_hash", split_by_null_into_hash, 1);
+	rb_define_singleton_method(mNativeSupport, "parse_binary_session_header", parse_binary_session_header, 1);
 	rb_define_singleton_method(mNativeSupport, "writev", f_writev, 2);
 	rb_define_singleton_method(mNativeSupport, "writev2", f_writev2, 3);
 	rb_define_singleton_method(mNativeSupport, "writev3", f_writev3, 4);
@@ -999,4 +1106,14 @@ Init_passenger_native_support() {
 	rb_define_const(mNativeSupport, "UNIX_PATH_MAX", INT2NUM(sizeof(addr.sun_path)));
 	/* The maximum size of the data that may be passed to #writev. */
 	rb_define_const(mNativeSupport, "SSIZE_MAX", LL2NUM(SSIZE_MAX));
+
+	/* Only referenced from C otherwise, so keep it alive (and pinned) across GC.compact. */
+	rb_gc_register_address(&aSessionHeaderKeys);
+	aSessionHeaderKeys = rb_ary_new();
+	for (i = 0; i < SESSION_HEADER_KEY_COUNT; i++) {
+		rb_ary_push(aSessionHeaderKeys, rb_obj_freeze(rb_str_new2(session_header_keys[i])));
+	}
+	rb_obj_freeze(aSessionHeaderKeys);
+	/* The interned keys of the binary session protocol header encoding. */
+	rb_define_const(mNativeSupport, "SESSION_HEADER_KEYS", aSessionHeaderKeys);
 }
@@ -226,7 +226,7 @@
     :name      => 'PassengerSpawnDir',
     :type      => :string,
     :context   => :global,
-    :dynamic_default => 'Either $TMPDIR or /tmp',
+    :dynamic_default => 'Either $TMPDIR, /dev/shm, or /tmp (see docs)',
     :desc      => "The directory for #{PROGRAM_NAME} used during child spawning."
   },
   {
@@ -341,6 +341,10 @@ def locate_source_file(path)
     :source   => 'MemoryKit/palloc.cpp',
     :category => :other,
     :optimize => true
+  define_component 'MemoryKit/slab.o',
+    :source   => 'MemoryKit/slab.cpp',
+    :category => :other,
+    :optimize => true
   define_component 'ServerKit/http_parser.o',
     :source   => 'ServerKit/http_parser.cpp',
     :category => :other,
@@ -87,6 +87,11 @@ module SharedConstants
     # also introduce context switching and smaller transfer writes. The size is picked
     # to balance this out.
     DEFAULT_MBUF_CHUNK_SIZE = 1024 * 4
+    # Additional mbuf size classes. Small blocks are used for reads that are
+    # expected to be tiny (e.g. small request bodies), large blocks for streaming
+    # big bodies with fewer read() calls. See ServerKit::Context::getMbufPoolForSize().
+    DEFAULT_SMALL_MBUF_CHUNK_SIZE = 512
+    DEFAULT_LARGE_MBUF_CHUNK_SIZE = 1024 * 64
     # Affects input and output buffering (between app and client). Threshold is picked
     # such that it fits most output (i.e. html page size, not assets), and allows for
     # high concurrency with low mem overhead. On the upload side there is a penalty
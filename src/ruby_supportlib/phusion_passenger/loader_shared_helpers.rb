@@ -275,7 +275,9 @@ def advertise_sockets(_options, request_handler)
           :address => options[:address],
           :protocol => options[:protocol],
           :concurrency => concurrency,
-          :accept_http_requests => !!options[:accept_http_requests]
+          :accept_http_requests => !!options[:accept_http_requests],
+          :framed_request_bodies => !!options[:framed_request_bodies],
+          :binary_session_header_version => options[:binary_session_header_version] || 0
         }
       end
 
@@ -243,7 +243,7 @@
     :name     => 'passenger_spawn_dir',
     :scope    => :global,
     :type     => :string,
-    :dynamic_default => 'Either $TMPDIR or /tmp',
+    :dynamic_default => 'Either $TMPDIR, /dev/shm, or /tmp (see docs)',
     :context  => [:main],
     :struct   => 'NGX_HTTP_MAIN_CONF_OFFSET'
   },
@@ -56,6 +56,32 @@ def init(main_app)
       options
     end
 
+    # Called once after the application has been loaded and before the
+    # preloader starts forking workers. Settles the heap so that forked
+    # workers share as many pages as possible with the preloader:
+    #
+    #  - Ruby >= 3.3 provides Process.warmup, which runs a major GC,
+    #    compacts the heap, promotes surviving objects to the old
+    #    generation, precomputes string coderanges and frees empty pages.
+    #  - On older Rubies we approximate this with a few full GCs (so that
+    #    long-lived objects are promoted and their mark bits stop changing
+    #    in the children) followed by GC.compact where available.
+    #
+    # Failures here are never fatal: worst case the children share fewer
+    # pages with the preloader.
+    def prepare_for_forking
+      if Process.respond_to?(:warmup)
+        Process.warmup
+      else
+        3.times do
+          GC.start(full_mark: true, immediate_sweep: true)
+        end
+        GC.compact if GC.respond_to?(:compact)
+      end
+    rescue NotImplementedError, StandardError => e
+      STDERR.puts "WARNING: unable to prepare the preloader heap for forking: #{e}"
+    end
+
     def accept_and_process_next_client(server_socket)
       client = server_socket.accept
       client.binmode
@@ -76,6 +102,8 @@ def accept_and_process_next_client(server_socket)
 
       if doc['command'] == 'spawn'
         handle_spawn_command(client, doc)
+      elsif doc['command'] == 'spawn_batch'
+        handle_spawn_batch_command(client, doc)
       else
         client.write(Utils::JSON.generate(
           :result => 'error',
@@ -137,6 +165,66 @@ def handle_spawn_command(client, doc)
       end
     end
 
+    # Forks one subprocess per work directory in doc['work_dirs'], so that
+    # SpawningKit can start many processes with a single round-trip.
+    # Unlike with the 'spawn' command, the response is not written by the
+    # subprocesses but by the preloader, once it's done forking. It contains
+    # one 'spawn'-style result per subprocess that it managed to fork.
+    def handle_spawn_batch_command(client, doc)
+      work_dirs = doc['work_dirs']
+      forked_work_dirs = []
+      results = []
+
+      # Improve copy-on-write friendliness.
+      GC.start
+
+      work_dirs.each do |work_dir|
+        LoaderSharedHelpers.record_journey_step_end('PRELOADER_PREPARATION',
+          'STEP_PERFORMED', work_dir)
+        LoaderSharedHelpers.record_journey_step_begin('PRELOADER_FORK_SUBPROCESS',
+          'STEP_IN_PROGRESS', work_dir)
+
+        begin
+          pid = fork
+        rescue SystemCallError => e
+          LoaderSharedHelpers.record_journey_step_end('PRELOADER_FORK_SUBPROCESS',
+            'STEP_ERRORED', work_dir)
+          raise e if results.empty?
+          results << { :result => 'error', :message => "Cannot fork: #{e}" }
+          break
+        end
+
+        if pid.nil?
+          $0 = "#{$0} (forking...)"
+          LoaderSharedHelpers.record_journey_step_end('PRELOADER_FORK_SUBPROCESS',
+            'STEP_PERFORMED', work_dir)
+          return [:forked, work_dir]
+        elsif defined?(NativeSupport)
+          NativeSupport.detach_process(pid)
+        else
+          Process.detach(pid)
+        end
+        forked_work_dirs << work_dir
+        results << { :result => 'ok', :pid => pid }
+      end
+
+      forked_work_dirs.each do |work_dir|
+        LoaderSharedHelpers.record_journey_step_begin('PRELOADER_SEND_RESPONSE',
+          'STEP_IN_PROGRESS', work_dir)
+      end
+      client.write(Utils::JSON.generate(
+        :result => 'ok',
+        :results => results
+      ))
+      forked_work_dirs.each do |work_dir|
+        LoaderSharedHelpers.record_journey_step_end('PRELOADER_SEND_RESPONSE',
+          'STEP_PERFORMED', work_dir)
+        LoaderSharedHelpers.record_journey_step_end('PRELOADER_FINISH',
+          'STEP_PERFORMED', work_dir)
+      end
+      nil
+    end
+
     def advertise_sockets(_options, server)
       json = {
         :sockets => [
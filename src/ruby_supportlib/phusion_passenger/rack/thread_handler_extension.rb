@@ -163,6 +163,9 @@ def process_request(env, connection, socket_wrapper, full_http_response)
           end
           false
         ensure
+          if @keepalive_performed && !rewindable_input.drain
+            @keepalive_performed = false
+          end
           rewindable_input.close
         end
       end
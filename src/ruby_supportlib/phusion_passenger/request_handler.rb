@@ -106,7 +106,9 @@ def initialize(owner_pipe, options = {})
         :socket      => @main_socket,
         :protocol    => @force_http_session ? :http : :session,
         :concurrency => @concurrency,
-        :accept_http_requests => true
+        :accept_http_requests => true,
+        :framed_request_bodies => true,
+        :binary_session_header_version => Utils::NativeSupportUtils::BINARY_SESSION_HEADER_VERSION
       }
 
       @http_socket_address, @http_socket = create_tcp_socket(options)
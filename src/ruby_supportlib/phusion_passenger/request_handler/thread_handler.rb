@@ -215,7 +215,17 @@ def parse_session_request(connection, channel, buffer)
         if headers_data.nil?
           return
         end
-        headers = Utils::NativeSupportUtils.split_by_null_into_hash(headers_data)
+        if headers_data.getbyte(0) == 0
+          # Binary encoding, used if we advertised support for it.
+          headers = Utils::NativeSupportUtils.parse_binary_session_header(headers_data)
+          if headers.nil?
+            warn "*** Passenger RequestHandler warning: " <<
+              "received a malformed binary session header."
+            return
+          end
+        else
+          headers = Utils::NativeSupportUtils.split_by_null_into_hash(headers_data)
+        end
         if @connect_password && headers[PASSENGER_CONNECT_PASSWORD] != @connect_password
           warn "*** Passenger RequestHandler warning: " <<
             "someone tried to connect with an invalid connect password."
@@ -311,9 +321,11 @@ def process_oobw(env, connection)
       def prepare_request(connection, headers)
         transfer_encoding = headers[HTTP_TRANSFER_ENCODING]
         content_length = headers[CONTENT_LENGTH]
+        # Request bodies with a Content-Length are read up to that length
+        # (see TeeInput), so they don't prevent keep-alive. Chunked request
+        # bodies are terminated by a half-close and thus do.
         @can_keepalive = @keepalive_enabled &&
-          !transfer_encoding &&
-          !content_length
+          !transfer_encoding
         @keepalive_performed = false
 
         if !transfer_encoding && !content_length
@@ -300,6 +300,12 @@ module Standalone
         :desc      => "Load shell startup files before loading\n" \
                       'application'
       },
+      {
+        :name      => :python_preloading,
+        :type      => :boolean,
+        :desc      => "Preload Python apps when the spawn\n" \
+                      "method is 'smart'"
+      },
       {
         :name      => :app_file_descriptor_ulimit,
         :type      => :integer,
@@ -394,12 +400,27 @@ module Standalone
         :type      => :integer,
         :type_desc => 'MB',
         :desc      => "Restart application processes that go over\n" \
-                      "the given memory limit (Enterprise only)"
+                      "the given memory limit"
       },
       {
         :name      => :rolling_restarts,
         :type      => :boolean,
-        :desc      => "Enable rolling restarts (Enterprise only)"
+        :desc      => "Replace processes one by one when\n" \
+                      "restarting"
+      },
+      {
+        :name      => :warmup_requests,
+        :type      => :integer,
+        :desc      => "Number of warm-up requests to send to each\n" \
+                      "new process during a rolling restart.\n" \
+                      "Default: 0"
+      },
+      {
+        :name      => :warmup_request_path,
+        :type      => :string,
+        :type_desc => 'PATH',
+        :desc      => "Path to send warm-up requests to.\n" \
+                      "Default: /"
       },
       {
         :name      => :resist_deployment_errors,
@@ -159,6 +159,7 @@ def build_daemon_controller_options
           end
           add_param(command, :force_max_concurrent_requests_per_process, "--force-max-concurrent-requests-per-process")
           add_flag_param(command, :load_shell_envvars, "--load-shell-envvars")
+          add_flag_param(command, :python_preloading, "--python-preloading")
           add_param(command, :max_pool_size, "--max-pool-size")
           add_param(command, :min_instances, "--min-instances")
           add_param(command, :pool_idle_time, "--pool-idle-time")
@@ -168,8 +169,10 @@ def build_daemon_controller_options
           add_enterprise_param(command, :thread_count, "--app-thread-count")
           add_param(command, :max_requests, "--max-requests")
           add_enterprise_param(command, :max_request_time, "--max-request-time")
-          add_enterprise_param(command, :memory_limit, "--memory-limit")
-          add_enterprise_flag_param(command, :rolling_restarts, "--rolling-restarts")
+          add_param(command, :memory_limit, "--memory-limit")
+          add_flag_param(command, :rolling_restarts, "--rolling-restarts")
+          add_param(command, :warmup_requests, "--warmup-requests")
+          add_param(command, :warmup_request_path, "--warmup-request-path")
           add_enterprise_flag_param(command, :resist_deployment_errors, "--resist-deployment-errors")
           add_enterprise_flag_param(command, :debugger, "--debugger")
           add_flag_param(command, :sticky_sessions, "--sticky-sessions")
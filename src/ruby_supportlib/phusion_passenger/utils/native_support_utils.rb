@@ -60,6 +60,72 @@ def process_times
             (times.stime * 1_000_000).to_i)
         end
       end
+
+      if defined?(PhusionPassenger::NativeSupport) &&
+         PhusionPassenger::NativeSupport.respond_to?(:parse_binary_session_header)
+        # The binary session protocol header encoding version to advertise
+        # to the Passenger core.
+        BINARY_SESSION_HEADER_VERSION = 1
+
+        # Parses a request header in the binary session protocol encoding into
+        # a hash. Returns nil if the header is malformed.
+        def parse_binary_session_header(data)
+          return PhusionPassenger::NativeSupport.parse_binary_session_header(data)
+        end
+      else
+        # Parsing the binary encoding in Ruby is slower than splitting the
+        # NUL-separated encoding, so don't ask the Passenger core for it.
+        BINARY_SESSION_HEADER_VERSION = 0
+
+        # The interned keys of the binary session protocol header encoding. Keep
+        # in sync with the key table in the Passenger core's Controller/SendRequest.cpp.
+        SESSION_HEADER_KEYS = %w(
+          REQUEST_URI PATH_INFO SCRIPT_NAME QUERY_STRING REQUEST_METHOD
+          SERVER_NAME SERVER_PORT SERVER_SOFTWARE SERVER_PROTOCOL
+          REMOTE_ADDR REMOTE_PORT REMOTE_USER CONTENT_TYPE CONTENT_LENGTH
+          PASSENGER_CONNECT_PASSWORD HTTPS HTTP_CONNECTION HTTP_HOST
+          HTTP_USER_AGENT HTTP_ACCEPT HTTP_ACCEPT_ENCODING HTTP_ACCEPT_LANGUAGE
+          HTTP_COOKIE HTTP_REFERER HTTP_CACHE_CONTROL HTTP_IF_MODIFIED_SINCE
+          HTTP_IF_NONE_MATCH HTTP_AUTHORIZATION HTTP_ORIGIN HTTP_X_FORWARDED_FOR
+          HTTP_X_FORWARDED_PROTO HTTP_X_REQUESTED_WITH HTTP_UPGRADE
+        ).map { |key| key.freeze }.freeze
+        SESSION_HEADER_LITERAL_KEY = 0xFF
+
+        # Parses a request header in the binary session protocol encoding into
+        # a hash. Returns nil if the header is malformed.
+        def parse_binary_session_header(data)
+          size = data.bytesize
+          if size < 2 || data.getbyte(0) != 0 || data.getbyte(1) != 1
+            return nil
+          end
+
+          result = {}
+          pos = 2
+          while pos < size
+            index = data.getbyte(pos)
+            pos += 1
+            if index == SESSION_HEADER_LITERAL_KEY
+              return nil if pos + 2 > size
+              key_size = data.unpack("@#{pos}n")[0]
+              pos += 2
+              return nil if pos + key_size > size
+              key = data.unpack("@#{pos}a#{key_size}")[0]
+              pos += key_size
+            else
+              key = SESSION_HEADER_KEYS[index]
+              return nil if key.nil?
+            end
+
+            return nil if pos + 4 > size
+            value_size = data.unpack("@#{pos}N")[0]
+            pos += 4
+            return nil if pos + value_size > size
+            result[key] = data.unpack("@#{pos}a#{value_size}")[0]
+            pos += value_size
+          end
+          return result
+        end
+      end
     end
 
   end # module Utils
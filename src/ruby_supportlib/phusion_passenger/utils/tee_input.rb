@@ -154,12 +154,8 @@ def gets
     else
       if @bytes_read == @len
         nil
-      elsif line = @socket.gets
-        if @len
-          max_len = @len - @bytes_read
-          line.slice!(max_len, line.size - max_len)
-        end
-        @bytes_read += line.size
+      elsif line = socket_gets
+        @bytes_read += line.bytesize
         tee(line)
       else
         nil
@@ -197,11 +193,29 @@ def eof?
     socket_drained?
   end
 
+  # Reads and discards the part of the request body that the application
+  # did not read, so that the connection can be reused for the next request.
+  # Returns whether the entire body has been consumed.
+  def drain
+    return true if !@socket
+    return false if !@len
+    junk = ""
+    while @bytes_read < @len
+      return false if !read_exact(16 * 1024, junk)
+    end
+    @socket = nil
+    true
+  rescue SystemCallError, IOError
+    false
+  end
+
 private
 
   def socket_drained?
     if @socket
-      if @socket.eof?
+      # Don't wait for EOF once the whole body has been read: the
+      # connection may be kept alive, in which case EOF never comes.
+      if (@len && @bytes_read >= @len) || @socket.eof?
         @socket = nil
         true
       else
@@ -212,6 +226,18 @@ def socket_drained?
     end
   end
 
+  # Reads the next line from the socket, but never past the end of the
+  # body: when the connection is kept alive, there is no EOF after the body,
+  # so a body whose last line doesn't end with a newline would otherwise
+  # block forever.
+  def socket_gets
+    if @len
+      @socket.gets($/, @len - @bytes_read)
+    else
+      @socket.gets
+    end
+  end
+
   # consumes the stream of the socket
   def consume!
     junk = ""
@@ -169,9 +169,9 @@ def writev3(components, components2, components3)
         raise annotate(e)
       end
 
-      def gets
+      ruby2_keywords def gets(*args)
         return nil if @simulate_eof
-        @socket.gets
+        @socket.gets(*args)
       rescue => e
         raise annotate(e)
       end
@@ -177,7 +177,7 @@ namespace tut {
 			}
 		}
 
-		string sendRequest(const Options &options, const char *path) {
+		void checkoutSession(const Options &options) {
 			int oldNumber = number;
 			pool->asyncGet(options, callback);
 			EVENTUALLY(5,
@@ -188,6 +188,10 @@ namespace tut {
 				abort();
 			}
 			currentSession->initiate();
+		}
+
+		string sendRequest(const Options &options, const char *path) {
+			checkoutSession(options);
 			sendHeaders(currentSession->fd(),
 				"PATH_INFO", path,
 				"REQUEST_METHOD", "GET",
@@ -203,6 +207,67 @@ namespace tut {
 			return body;
 		}
 
+		// Reads a single HTTP response whose size is given by its Content-Length
+		// header from a session protocol connection. Data that arrives after
+		// the response is left in `buffer`.
+		string readResponse(int fd, string &buffer) {
+			char tmp[1024 * 16];
+			string::size_type headerEnd, bodyStart, pos;
+			unsigned long long timeout = 5000000;
+			unsigned int contentLength;
+
+			while ((headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+				ensure("Response headers arrive in time", waitUntilReadable(fd, &timeout));
+				ssize_t ret = read(fd, tmp, sizeof(tmp));
+				ensure("Response headers are complete", ret > 0);
+				buffer.append(tmp, ret);
+			}
+			bodyStart = headerEnd + 4;
+			pos = buffer.find("\r\nContent-Length: ");
+			ensure("Response has a Content-Length header", pos != string::npos && pos < headerEnd);
+			contentLength = stringToUint(buffer.substr(pos + sizeof("\r\nContent-Length: ") - 1));
+
+			while (buffer.size() < bodyStart + contentLength) {
+				ensure("Response body arrives in time", waitUntilReadable(fd, &timeout));
+				ssize_t ret = read(fd, tmp, sizeof(tmp));
+				ensure("Response body is complete", ret > 0);
+				buffer.append(tmp, ret);
+			}
+			string response = buffer.substr(0, bodyStart + contentLength);
+			buffer.erase(0, bodyStart + contentLength);
+			return response;
+		}
+
+		Options createWsgiOptions() {
+			Options options = createOptions();
+			options.appRoot = "stub/wsgi";
+			options.appType = "wsgi";
+			options.startupFile = "passenger_wsgi.py";
+			options.spawnMethod = "direct";
+			return options;
+		}
+
+		// Accepts warm-up connections. If `respond` is true then it reads the
+		// request until the client shuts down its writer side, like an app
+		// that supports keep-alive connections would, and sends a response.
+		// Otherwise it leaves the connections hanging.
+		static void serveWarmupRequests(int serverFd, bool respond, AtomicInt *count) {
+			vector<FileDescriptor> hangingConnections;
+			while (true) {
+				FileDescriptor fd(syscalls::accept(serverFd, NULL, NULL), __FILE__, __LINE__);
+				if (respond) {
+					readAll(fd, 1024 * 1024);
+					writeExact(fd, "HTTP/1.1 200 OK\r\n"
+						"Content-Length: 2\r\n\r\n"
+						"ok");
+					fd.close();
+				} else {
+					hangingConnections.push_back(fd);
+				}
+				(*count)++;
+			}
+		}
+
 		// Ensure that n processes exist.
 		Options ensureMinProcesses(unsigned int n) {
 			Options options = createOptions();
@@ -223,7 +288,7 @@ namespace tut {
 		}
 	};
 
-	DEFINE_TEST_GROUP_WITH_LIMIT(Core_ApplicationPool_PoolTest, 100);
+	DEFINE_TEST_GROUP_WITH_LIMIT(Core_ApplicationPool_PoolTest, 130);
 
 	TEST_METHOD(1) {
 		// Test initial state.
@@ -2088,6 +2153,1155 @@ namespace tut {
 		pool->get(options, &ticket).reset();
 	}
 
+	TEST_METHOD(86) {
+		// If the queueing delay stays above requestQueueTargetDelay, then
+		// requests that have been queued for too long are shed.
+		Options options = createOptions();
+		options.requestQueueTargetDelay = 1;
+		options.currentTime = SystemTime::getUsec() - 100000;
+		pool->setMax(1);
+
+		// This request was queued while the process was being spawned.
+		// It starts the first interval and isn't shed.
+		SessionPtr session = pool->get(options, &ticket);
+		GroupPtr group = pool->findOrCreateGroup(options);
+
+		pool->asyncGet(options, callback);
+		ensure_equals(number, 0);
+		usleep(30000);
+		session.reset();
+
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+		ensure(currentSession == NULL);
+		ensure(dynamic_pointer_cast<RequestQueueOverloadedException>(currentException) != NULL);
+		LockGuard l(pool->syncher);
+		ensure_equals(group->getWaitlist.size(), 0u);
+		ensure_equals(group->getWaitlistDelayMonitor.getShedCount(), 1ull);
+	}
+
+	TEST_METHOD(117) {
+		// If the queueing delay stays above requestQueueTargetDelay, then
+		// requests are shed even if no process becomes available to them.
+		Options options = createOptions();
+		options.requestQueueTargetDelay = 1;
+		pool->setMax(1);
+
+		SessionPtr session = pool->get(options, &ticket);
+		GroupPtr group = pool->findOrCreateGroup(options);
+
+		pool->asyncGet(options, callback);
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+		ensure(currentSession == NULL);
+		ensure(dynamic_pointer_cast<RequestQueueOverloadedException>(currentException) != NULL);
+		LockGuard l(pool->syncher);
+		ensure_equals(group->getWaitlist.size(), 0u);
+		ensure_equals(group->getWaitlistDelayMonitor.getShedCount(), 1ull);
+		ensure_equals(session->getProcess()->sessions, 1);
+	}
+
+	TEST_METHOD(87) {
+		// A queued request that is cancelled is removed from the getWaitlist
+		// without a session being checked out for it.
+		Options options = createOptions();
+		boost::atomic<bool> cancelled(false);
+		pool->setMax(1);
+
+		SessionPtr session = pool->get(options, &ticket);
+		GroupPtr group = pool->findOrCreateGroup(options);
+		ProcessPtr process = session->getProcess()->shared_from_this();
+
+		options.cancelled = &cancelled;
+		pool->asyncGet(options, callback);
+		ensure_equals(number, 0);
+		cancelled.store(true);
+		session.reset();
+
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+		ensure(currentSession == NULL);
+		ensure(dynamic_pointer_cast<GetAbortedException>(currentException) != NULL);
+		ensure(dynamic_pointer_cast<RequestQueueFullException>(currentException) == NULL);
+		LockGuard l(pool->syncher);
+		ensure_equals(group->getWaitlist.size(), 0u);
+		ensure_equals(process->sessions, 0);
+		ensure_equals(process->processed, 1u);
+	}
+
+	TEST_METHOD(88) {
+		// Cancelled requests don't count towards maxRequestQueueSize.
+		Options options = createOptions();
+		boost::atomic<bool> cancelled(false);
+		options.maxRequestQueueSize = 1;
+		pool->setMax(1);
+
+		SessionPtr session = pool->get(options, &ticket);
+		GroupPtr group = pool->findOrCreateGroup(options);
+
+		Options options2 = options;
+		options2.cancelled = &cancelled;
+		pool->asyncGet(options2, callback);
+		cancelled.store(true);
+		pool->asyncGet(options, callback);
+
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+		ensure(dynamic_pointer_cast<RequestQueueFullException>(currentException) == NULL);
+		{
+			LockGuard l(pool->syncher);
+			ensure_equals(group->getWaitlist.size(), 1u);
+		}
+
+		session.reset();
+		EVENTUALLY(5,
+			result = number == 2;
+		);
+		ensure(currentSession != NULL);
+	}
+
+	TEST_METHOD(89) {
+		// Requests that have been queued for longer than maxRequestQueueTime
+		// are removed by the garbage collector, even if no process becomes
+		// available. Queueing such a request wakes up the garbage collector
+		// in time.
+		Options options = createOptions();
+		pool->setMax(1);
+
+		SessionPtr session = pool->get(options, &ticket);
+		GroupPtr group = pool->findOrCreateGroup(options);
+
+		options.maxRequestQueueTime = 50;
+		options.currentTime = SystemTime::getUsec() - 100000;
+		pool->asyncGet(options, callback);
+		options.currentTime = SystemTime::getUsec();
+		options.maxRequestQueueTime = 60000;
+		pool->asyncGet(options, callback);
+
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+		ensure(currentSession == NULL);
+		ensure(dynamic_pointer_cast<RequestQueueTimeoutException>(currentException) != NULL);
+		LockGuard l(pool->syncher);
+		ensure_equals(group->getWaitlist.size(), 1u);
+	}
+
+	TEST_METHOD(90) {
+		// A process that exceeds the memory limit is replaced
+		// if there is spare capacity.
+		Options options = createOptions();
+		options.memoryLimit = 1;
+		SessionPtr session = pool->get(options, &ticket);
+		ProcessPtr process = session->getProcess()->shared_from_this();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		session.reset();
+
+		{
+			boost::container::vector<Callback> actions;
+			LockGuard l(pool->syncher);
+			process->metrics.pid = process->getPid();
+			process->metrics.privateDirty = 512;
+			ensure(!pool->maybeRecycleProcessExceedingMemoryLimit(group, actions));
+
+			process->metrics.privateDirty = 2048;
+			ensure(pool->maybeRecycleProcessExceedingMemoryLimit(group, actions));
+			// It's the sole process, so it keeps serving requests
+			// until its replacement has been spawned.
+			ensure_equals(process->enabled, Process::DISABLING);
+			ensure(group->spawning());
+		}
+
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = process->enabled == Process::DETACHED
+				&& group->enabledCount == 1
+				&& group->enabledProcesses[0] != process;
+		);
+	}
+
+	TEST_METHOD(91) {
+		// A process that exceeds the memory limit is not replaced if the pool
+		// is at full capacity and the group has no other process to absorb
+		// the traffic.
+		Options options = createOptions();
+		options.memoryLimit = 1;
+		pool->setMax(1);
+		SessionPtr session = pool->get(options, &ticket);
+		ProcessPtr process = session->getProcess()->shared_from_this();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		session.reset();
+
+		boost::container::vector<Callback> actions;
+		LockGuard l(pool->syncher);
+		process->metrics.pid = process->getPid();
+		process->metrics.privateDirty = 2048;
+		ensure(!pool->maybeRecycleProcessExceedingMemoryLimit(group, actions));
+		ensure_equals(process->enabled, Process::ENABLED);
+	}
+
+	TEST_METHOD(92) {
+		// A rolling restart replaces the processes one by one, without ever
+		// having fewer enabled processes than before, even if the pool
+		// is at full capacity.
+		Options options = createOptions();
+		options.minProcesses = 2;
+		options.rollingRestart = true;
+		pool->setMax(2);
+		pool->get(options, &ticket).reset();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 2 && !group->spawning();
+		);
+
+		ProcessList oldProcesses;
+		{
+			LockGuard l(pool->syncher);
+			oldProcesses = group->enabledProcesses;
+			group->restart(group->options);
+			ensure(group->rollingRestarting());
+			ensure(!group->restarting());
+		}
+
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			ensure(group->enabledCount >= 2);
+			result = !group->rollingRestarting();
+		);
+
+		LockGuard l(pool->syncher);
+		ensure_equals(group->enabledCount, 2);
+		ensure_equals(group->getProcessCount(), 2u);
+		for (unsigned int i = 0; i < oldProcesses.size(); i++) {
+			ensure_equals(oldProcesses[i]->enabled, Process::DETACHED);
+		}
+	}
+
+	TEST_METHOD(93) {
+		// Outlier ejection: a process that fails too many requests in a row
+		// stops receiving requests until its ejection time has passed. After
+		// that it receives a probe request, and it's readmitted if the probe
+		// succeeds.
+		Options options = createOptions();
+		options.minProcesses = 2;
+		options.outlierEjectionErrors = 2;
+		options.outlierEjectionTime = 1;
+		pool->setMax(2);
+		pool->get(options, &ticket).reset();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 2 && !group->spawning();
+		);
+
+		ProcessPtr process;
+		for (int i = 0; i < 2; i++) {
+			SessionPtr session = pool->get(options, &ticket);
+			if (process == NULL) {
+				process = session->getProcess()->shared_from_this();
+			}
+			ensure_equals(session->getProcess(), process.get());
+			session->reportAppError();
+		}
+		{
+			LockGuard l(pool->syncher);
+			ensure(process->health.isEjected());
+		}
+
+		SessionPtr session = pool->get(options, &ticket);
+		ensure(session->getProcess() != process.get());
+		session.reset();
+
+		usleep(1100000);
+		session = pool->get(options, &ticket);
+		ensure_equals(session->getProcess(), process.get());
+		{
+			LockGuard l(pool->syncher);
+			ensure(process->health.isProbing());
+		}
+		session.reset();
+
+		LockGuard l(pool->syncher);
+		ensure_equals(process->health.getState(), ProcessHealthMonitor::HEALTHY);
+		ensure_equals(process->enabled, Process::ENABLED);
+	}
+
+	TEST_METHOD(94) {
+		// If the pool is full, then the idle process to kill is taken from
+		// the group that exceeds its fair share of the pool the most, even
+		// if another group has an older idle process.
+		Options options = createOptions();
+		pool->setMax(3);
+
+		options.appRoot = "/bar";
+		pool->get(options, &ticket).reset();
+		GroupPtr group1 = pool->findOrCreateGroup(options);
+
+		options.appRoot = "/foo";
+		options.minProcesses = 2;
+		pool->get(options, &ticket).reset();
+		GroupPtr group2 = pool->findOrCreateGroup(options);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group2->enabledCount == 2 && !group2->spawning();
+		);
+
+		options.appRoot = "/baz";
+		options.minProcesses = 1;
+		pool->asyncGet(options, callback);
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+
+		LockGuard l(pool->syncher);
+		ensure_equals(group1->getProcessCount(), 1u);
+		ensure_equals(group2->getProcessCount(), 1u);
+		ensure_equals(group2->processesEvicted, 1u);
+	}
+
+	TEST_METHOD(95) {
+		// If the pool is full, then processes within a group's guaranteed
+		// capacity are not killed to make room for other groups.
+		Options options = createOptions();
+		pool->setMax(3);
+
+		options.appRoot = "/bar";
+		pool->get(options, &ticket).reset();
+		GroupPtr group1 = pool->findOrCreateGroup(options);
+
+		options.appRoot = "/foo";
+		options.minProcesses = 2;
+		options.guaranteedCapacity = 2;
+		pool->get(options, &ticket).reset();
+		GroupPtr group2 = pool->findOrCreateGroup(options);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group2->enabledCount == 2 && !group2->spawning();
+		);
+
+		options.appRoot = "/baz";
+		options.minProcesses = 1;
+		options.guaranteedCapacity = 0;
+		pool->asyncGet(options, callback);
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+
+		LockGuard l(pool->syncher);
+		ensure_equals(group1->getProcessCount(), 0u);
+		ensure_equals(group2->getProcessCount(), 2u);
+	}
+
+	TEST_METHOD(96) {
+		// A group that exceeds its fair share of the pool gives up an idle
+		// process to a group that is waiting for capacity, even if it has
+		// requests queued itself.
+		Options options = createOptions();
+		pool->setMax(2);
+
+		options.appRoot = "/foo";
+		options.minProcesses = 2;
+		pool->get(options, &ticket).reset();
+		GroupPtr group1 = pool->findOrCreateGroup(options);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group1->enabledCount == 2 && !group1->spawning();
+		);
+
+		// Occupy both /foo processes and queue another /foo request.
+		SessionPtr session1 = pool->get(options, &ticket);
+		SessionPtr session2 = pool->get(options, &ticket);
+		pool->asyncGet(options, callback);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group1->getWaitlist.size() == 1;
+		);
+
+		// /bar cannot get capacity because all /foo processes are busy.
+		Options options2 = options;
+		options2.appRoot = "/bar";
+		options2.minProcesses = 1;
+		pool->asyncGet(options2, callback);
+		SHOULD_NEVER_HAPPEN(100,
+			result = number > 0;
+		);
+
+		// When a /foo process becomes idle, it goes to /bar instead of
+		// to the queued /foo request.
+		session1.reset();
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+		{
+			LockGuard l(pool->syncher);
+			ensure_equals(group1->getProcessCount(), 1u);
+			ensure_equals(group1->getWaitlist.size(), 1u);
+		}
+
+		// Without fair sharing, /bar would have to wait until /foo's
+		// queue is empty.
+		session2.reset();
+		EVENTUALLY(5,
+			result = number == 2;
+		);
+	}
+
+	TEST_METHOD(97) {
+		// Requests with a routing hash always go to the same process, as
+		// long as that process isn't loaded much more than the others.
+		Options options = createOptions();
+		options.minProcesses = 3;
+		pool->setMax(3);
+		pool->get(options, &ticket).reset();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 3 && !group->spawning();
+		);
+
+		options.routingHash = 1234;
+		SessionPtr session = pool->get(options, &ticket);
+		Process *process = session->getProcess();
+		session.reset();
+		for (int i = 0; i < 5; i++) {
+			session = pool->get(options, &ticket);
+			ensure_equals(session->getProcess(), process);
+			session.reset();
+		}
+
+		// The process already has more sessions than the load bound
+		// allows, so the next request goes elsewhere.
+		SessionPtr session1 = pool->get(options, &ticket);
+		ensure_equals(session1->getProcess(), process);
+		SessionPtr session2 = pool->get(options, &ticket);
+		ensure(session2->getProcess() != process);
+		session2.reset();
+		session1.reset();
+
+		// Once the load is gone, the key maps back to the same process.
+		session = pool->get(options, &ticket);
+		ensure_equals(session->getProcess(), process);
+	}
+
+	TEST_METHOD(98) {
+		// Out-of-band work is deferred while requests are queued, and
+		// is performed once the queue has drained.
+		Options options = createOptions();
+		initPoolDebugging();
+		debug->restarting = false;
+		debug->spawning = false;
+		debug->oobw = true;
+		pool->setMax(2);
+
+		SessionPtr session1 = pool->get(options, &ticket);
+		SessionPtr session2 = pool->get(options, &ticket);
+		GroupPtr group = pool->findOrCreateGroup(options);
+		pool->asyncGet(options, callback);
+		{
+			LockGuard l(pool->syncher);
+			ensure_equals(group->getWaitlist.size(), 1u);
+		}
+
+		// The queued request is served first.
+		session1->requestOOBW();
+		session1.reset();
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+		SHOULD_NEVER_HAPPEN(100,
+			result = debug->debugger->peek("OOBW request about to start") != NULL;
+		);
+		{
+			LockGuard l(pool->syncher);
+			ensure_equals(group->oobwsDeferred, 1u);
+		}
+
+		{
+			LockGuard l(syncher);
+			currentSession.reset();
+		}
+		debug->debugger->recv("OOBW request about to start");
+		debug->messages->send("Proceed with OOBW request");
+		debug->debugger->recv("OOBW request finished");
+		LockGuard l(pool->syncher);
+		ensure_equals(group->oobwsPerformed, 1u);
+		ensure_equals(group->oobwsDeferred, 1u);
+	}
+
+	TEST_METHOD(99) {
+		// If maxConcurrentRecycles is set, then a process that has processed
+		// maxRequests sessions keeps serving requests until a replacement
+		// has been spawned.
+		Options options = createOptions();
+		options.minProcesses = 0;
+		options.maxRequests = 3;
+		options.maxConcurrentRecycles = 1;
+		pool->setMax(1);
+
+		SessionPtr session = pool->get(options, &ticket);
+		ProcessPtr process = session->getProcess()->shared_from_this();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		session.reset();
+		pool->get(options, &ticket).reset();
+
+		skDebugSupport.dummySpawnDelay = 1000000;
+		pool->get(options, &ticket).reset();
+		{
+			LockGuard l(pool->syncher);
+			ensure(process->recycling);
+			ensure_equals(process->enabled, Process::ENABLED);
+			ensure_equals(group->recyclesInProgress, 1u);
+		}
+
+		// The old process is still used while the replacement spawns.
+		session = pool->get(options, &ticket);
+		ensure_equals(session->getProcess(), process.get());
+		session.reset();
+
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 1
+				&& group->enabledProcesses[0] != process
+				&& group->recyclesInProgress == 0;
+		);
+		LockGuard l(pool->syncher);
+		ensure(process->enabled == Process::DETACHED || !process->isAlive());
+	}
+
+	TEST_METHOD(100) {
+		// recycleLimitJitter lowers each process's limits by a random
+		// amount of up to the given percentage.
+		Options options = createOptions();
+		options.minProcesses = 3;
+		options.recycleLimitJitter = 50;
+		pool->setMax(3);
+		pool->get(options, &ticket).reset();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 3 && !group->spawning();
+		);
+
+		LockGuard l(pool->syncher);
+		set<unsigned long> limits;
+		foreach (const ProcessPtr &process, group->enabledProcesses) {
+			unsigned long limit = group->jitteredLimit(process.get(), 1000000);
+			ensure("(1)", limit > 500000);
+			ensure("(2)", limit <= 1000000);
+			limits.insert(limit);
+		}
+		ensure_equals("(3)", limits.size(), 3u);
+	}
+
+	TEST_METHOD(101) {
+		// The most recently used groups are kept warm: they keep a process
+		// even when idle, and get a new process if they lose it.
+		Options options = createOptions();
+		options.appGroupName = "test1";
+		options.minProcesses = 0;
+		Options options2 = createOptions();
+		options2.appGroupName = "test2";
+		options2.minProcesses = 0;
+
+		pool->setWarmSpares(1);
+		pool->get(options, &ticket).reset();
+		usleep(10000);
+		pool->get(options2, &ticket).reset();
+		pool->setMaxIdleTime(50000);
+
+		EVENTUALLY(2,
+			result = pool->getGroup("test1")->getProcessCount() == 0;
+		);
+		SHOULD_NEVER_HAPPEN(150,
+			LockGuard l(pool->syncher);
+			result = pool->getGroup("test2")->getProcessCount() == 0;
+		);
+
+		ProcessPtr process;
+		{
+			LockGuard l(pool->syncher);
+			process = pool->getGroup("test2")->enabledProcesses[0];
+		}
+		pool->detachProcess(process);
+		EVENTUALLY(2,
+			LockGuard l(pool->syncher);
+			GroupPtr group = pool->getGroup("test2");
+			result = group->enabledCount == 1 && group->enabledProcesses[0] != process;
+		);
+	}
+
+	TEST_METHOD(102) {
+		// It keeps per-step duration histograms of successful spawns.
+		Options options = createOptions();
+		options.appGroupName = "test";
+		skDebugSupport.dummySpawnDelay = 30000;
+		pool->get(options, &ticket).reset();
+
+		Json::Value doc = pool->inspectSpawnTimingsAsJson()["test"];
+		ensure_equals("(1)", doc["spawns"].asUInt(), 1u);
+		ensure("(2)", doc["steps"].isMember("total"));
+
+		Json::Value appLoad = doc["steps"]["subprocess_app_load_or_exec"];
+		ensure_equals("(3)", appLoad["count"].asUInt(), 1u);
+		ensure_equals("(4)", appLoad["max"].asDouble(), 0.03);
+		// 30 msec falls in the 50 msec bucket, and in all buckets after it.
+		ensure_equals("(5)", appLoad["buckets"][4u]["count"].asUInt(), 0u);
+		ensure_equals("(6)", appLoad["buckets"][5u]["le"].asDouble(), 0.05);
+		ensure_equals("(7)", appLoad["buckets"][5u]["count"].asUInt(), 1u);
+		ensure_equals("(8)", appLoad["buckets"][15u]["le"].asString(), "+Inf");
+		ensure_equals("(9)", appLoad["buckets"][15u]["count"].asUInt(), 1u);
+	}
+
+	TEST_METHOD(103) {
+		// A group that needs multiple processes to reach minProcesses spawns
+		// them in batches, if the spawner supports that.
+		Options options = createOptions();
+		options.minProcesses = 5;
+		pool->setMax(6);
+		pool->setSpawnBatchSize(4);
+		skDebugSupport.dummySpawnDelay = 100000;
+		pool->get(options, &ticket).reset();
+
+		GroupPtr group = pool->findOrCreateGroup(options);
+		{
+			LockGuard l(pool->syncher);
+			ensure_equals("(1)", group->enabledCount, 4);
+			ensure_equals("(2)", group->processesBeingSpawned, 1);
+		}
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 5 && !group->spawning();
+		);
+	}
+
+	TEST_METHOD(104) {
+		// Spawn batches respect the pool's capacity.
+		Options options = createOptions();
+		options.minProcesses = 5;
+		pool->setMax(3);
+		pool->setSpawnBatchSize(4);
+		skDebugSupport.dummySpawnDelay = 100000;
+		pool->get(options, &ticket).reset();
+
+		GroupPtr group = pool->findOrCreateGroup(options);
+		LockGuard l(pool->syncher);
+		ensure_equals("(1)", group->enabledCount, 3);
+		ensure_equals("(2)", group->processesBeingSpawned, 0);
+	}
+
+	TEST_METHOD(105) {
+		// The inspection output reports RSS next to PSS so that the amount
+		// of memory shared with the preloader is visible.
+		Options options = createOptions();
+		SessionPtr session = pool->get(options, &ticket);
+		ProcessPtr process = session->getProcess()->shared_from_this();
+		session.reset();
+		{
+			LockGuard l(pool->syncher);
+			process->metrics.pid = process->getPid();
+			process->metrics.rss = 40 * 1024;
+			process->metrics.pss = 15 * 1024;
+			process->metrics.privateDirty = 10 * 1024;
+		}
+
+		string result = pool->inspect();
+		ensure(result.find("    RSS: 40M   PSS: 15M   Private dirty: 10M\n") != string::npos);
+	}
+
+	TEST_METHOD(106) {
+		// Warm-up requests don't rely on the application closing the
+		// connection by itself. They shut down the writer side so that
+		// apps with keep-alive connections close it after responding.
+		DeleteFileEventually d("tmp.warmup");
+		FileDescriptor server(createUnixServer("tmp.warmup"), NULL, 0);
+		AtomicInt warmupCount;
+		TempThread thr(boost::bind(serveWarmupRequests, (int) server, true, &warmupCount));
+		skDebugSupport.dummySocketAddress = "unix:tmp.warmup";
+
+		Options options = createOptions();
+		options.rollingRestart = true;
+		options.warmupRequests = 2;
+		pool->get(options, &ticket).reset();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		ProcessPtr oldProcess;
+		{
+			LockGuard l(pool->syncher);
+			oldProcess = group->enabledProcesses[0];
+			group->restart(group->options);
+			ensure(group->rollingRestarting());
+		}
+
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = !group->rollingRestarting();
+		);
+		ensure_equals(warmupCount.get(), 2);
+		LockGuard l(pool->syncher);
+		ensure_equals(group->enabledCount, 1);
+		ensure_equals(oldProcess->enabled, Process::DETACHED);
+	}
+
+	TEST_METHOD(107) {
+		// A warm-up request that isn't answered within the start timeout
+		// doesn't hold up the rolling restart.
+		DeleteFileEventually d("tmp.warmup");
+		FileDescriptor server(createUnixServer("tmp.warmup"), NULL, 0);
+		AtomicInt warmupCount;
+		TempThread thr(boost::bind(serveWarmupRequests, (int) server, false, &warmupCount));
+		skDebugSupport.dummySocketAddress = "unix:tmp.warmup";
+
+		Options options = createOptions();
+		options.rollingRestart = true;
+		options.warmupRequests = 2;
+		options.startTimeout = 100;
+		pool->get(options, &ticket).reset();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		ProcessPtr oldProcess;
+		{
+			LockGuard l(pool->syncher);
+			oldProcess = group->enabledProcesses[0];
+			group->restart(group->options);
+		}
+
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = !group->rollingRestarting();
+		);
+		// The process is used anyway, and the remaining warm-up
+		// requests are skipped.
+		ensure_equals(warmupCount.get(), 1);
+		LockGuard l(pool->syncher);
+		ensure_equals(group->enabledCount, 1);
+		ensure_equals(oldProcess->enabled, Process::DETACHED);
+	}
+
+	TEST_METHOD(108) {
+		// If the warm-up requests to a recycled process's replacement time
+		// out, then the replacement is used anyway and the recycle state
+		// is cleaned up.
+		DeleteFileEventually d("tmp.warmup");
+		FileDescriptor server(createUnixServer("tmp.warmup"), NULL, 0);
+		AtomicInt warmupCount;
+		TempThread thr(boost::bind(serveWarmupRequests, (int) server, false, &warmupCount));
+		skDebugSupport.dummySocketAddress = "unix:tmp.warmup";
+
+		Options options = createOptions();
+		options.maxRequests = 2;
+		options.maxConcurrentRecycles = 1;
+		options.warmupRequests = 1;
+		options.startTimeout = 100;
+		pool->setMax(1);
+
+		SessionPtr session = pool->get(options, &ticket);
+		ProcessPtr process = session->getProcess()->shared_from_this();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		session.reset();
+		pool->get(options, &ticket).reset();
+
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 1
+				&& group->enabledProcesses[0] != process
+				&& group->recyclesInProgress == 0;
+		);
+		ensure_equals(warmupCount.get(), 1);
+		LockGuard l(pool->syncher);
+		ensure(!process->recycling);
+		ensure(!group->enabledProcesses[0]->recycling);
+	}
+
+	TEST_METHOD(121) {
+		// Warm-up settings from later requests are merged into the group,
+		// and a rolling restart updates the group UUID in the group's options.
+		Options options = createOptions();
+		options.rollingRestart = true;
+		pool->get(options, &ticket).reset();
+		GroupPtr group = pool->findOrCreateGroup(options);
+
+		options.warmupRequests = 1;
+		options.warmupRequestPath = "/warmup";
+		pool->get(options, &ticket).reset();
+		{
+			LockGuard l(pool->syncher);
+			ensure_equals("(1)", group->options.warmupRequests, 1u);
+			ensure_equals("(2)", group->options.warmupRequestPath.toString(), "/warmup");
+			ensure_equals("(3)", group->options.groupUuid.toString(), group->uuid);
+
+			string oldUuid = group->uuid;
+			group->restart(group->options);
+			ensure("(4)", group->rollingRestarting());
+			ensure("(5)", group->uuid != oldUuid);
+			ensure_equals("(6)", group->options.groupUuid.toString(), group->uuid);
+			ensure_equals("(7)", group->options.warmupRequestPath.toString(), "/warmup");
+		}
+
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = !group->rollingRestarting();
+		);
+	}
+
+	TEST_METHOD(110) {
+		// Outlier ejection measures latency up to the start of the response,
+		// so a long-lived session (e.g. a WebSocket) is not an outlier.
+		Options options = createOptions();
+		options.outlierEjectionErrors = 1;
+		options.outlierLatencyThreshold = 50;
+		pool->setMax(1);
+
+		SessionPtr session = pool->get(options, &ticket);
+		ProcessPtr process = session->getProcess()->shared_from_this();
+		session->reportResponseBegin();
+		usleep(150000);
+		session.reset();
+		{
+			LockGuard l(pool->syncher);
+			ensure("(1)", !process->health.isEjected());
+		}
+
+		// A session that takes that long before responding is.
+		session = pool->get(options, &ticket);
+		usleep(150000);
+		session->reportResponseBegin();
+		session.reset();
+		LockGuard l(pool->syncher);
+		ensure("(2)", process->health.isEjected());
+	}
+
+	TEST_METHOD(111) {
+		// A garbage collection run that shuts down idle processes does not
+		// also spawn warm spares, so that the pool doesn't alternate between
+		// killing and spawning processes. The next run spawns them.
+		Options options = createOptions();
+		options.appGroupName = "test1";
+		options.minProcesses = 0;
+		Options options2 = createOptions();
+		options2.appGroupName = "test2";
+		options2.minProcesses = 0;
+
+		pool->setWarmSpares(1);
+		pool->get(options, &ticket).reset();
+		usleep(10000);
+		pool->get(options2, &ticket).reset();
+
+		ProcessPtr process;
+		{
+			LockGuard l(pool->syncher);
+			process = pool->getGroup("test2")->enabledProcesses[0];
+		}
+		pool->detachProcess(process);
+		usleep(1100000);
+
+		// This run shuts down test1's idle process, while test2 (the warm
+		// spare group) has no process.
+		pool->setMaxIdleTime(1000000);
+		EVENTUALLY(2,
+			result = pool->getGroup("test1")->getProcessCount() == 0;
+		);
+		{
+			LockGuard l(pool->syncher);
+			GroupPtr group = pool->getGroup("test2");
+			ensure_equals("(1)", group->getProcessCount(), 0u);
+			ensure("(2)", !group->spawning());
+		}
+
+		EVENTUALLY(3,
+			LockGuard l(pool->syncher);
+			result = pool->getGroup("test2")->enabledCount == 1;
+		);
+	}
+
+	TEST_METHOD(112) {
+		// If all processes that haven't been ejected are totally busy, then
+		// a request goes to an idle ejected process instead of being queued,
+		// regardless of the order of the processes.
+		Options options = createOptions();
+		options.minProcesses = 2;
+		options.outlierEjectionErrors = 2;
+		options.outlierEjectionTime = 100;
+		pool->setMax(2);
+		pool->get(options, &ticket).reset();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 2 && !group->spawning();
+		);
+
+		// Eject the second process in the list.
+		SessionPtr session1 = pool->get(options, &ticket);
+		ProcessPtr process1 = session1->getProcess()->shared_from_this();
+		ProcessPtr process2;
+		for (int i = 0; i < 2; i++) {
+			SessionPtr session = pool->get(options, &ticket);
+			if (process2 == NULL) {
+				process2 = session->getProcess()->shared_from_this();
+			}
+			ensure_equals("(1)", session->getProcess(), process2.get());
+			session->reportAppError();
+		}
+		{
+			LockGuard l(pool->syncher);
+			ensure("(2)", process2->health.isEjected());
+			ensure_equals("(3)", group->enabledProcesses[0], process1);
+		}
+
+		pool->asyncGet(options, callback);
+		EVENTUALLY(5,
+			result = number == 1;
+		);
+		{
+			LockGuard l(syncher);
+			ensure_equals("(4)", currentSession->getProcess(), process2.get());
+		}
+		{
+			LockGuard l(pool->syncher);
+			ensure("(5)", group->getWaitlist.empty());
+		}
+		clearAllSessions();
+
+		// Processes that haven't been ejected are still preferred.
+		session1.reset();
+		SessionPtr session = pool->get(options, &ticket);
+		ensure_equals("(6)", session->getProcess(), process1.get());
+	}
+
+	TEST_METHOD(109) {
+		// If the warm-up requests to a recycled process's replacement fail,
+		// then the replacement is used anyway and the recycle state is
+		// cleaned up.
+		skDebugSupport.dummySocketAddress = "unix:tmp.warmup.nonexistent";
+
+		Options options = createOptions();
+		options.maxRequests = 2;
+		options.maxConcurrentRecycles = 1;
+		options.warmupRequests = 1;
+		pool->setMax(1);
+
+		SessionPtr session = pool->get(options, &ticket);
+		ProcessPtr process = session->getProcess()->shared_from_this();
+		GroupPtr group = pool->findOrCreateGroup(options);
+		session.reset();
+		pool->get(options, &ticket).reset();
+
+		EVENTUALLY(5,
+			LockGuard l(pool->syncher);
+			result = group->enabledCount == 1
+				&& group->enabledProcesses[0] != process
+				&& group->recyclesInProgress == 0;
+		);
+		LockGuard l(pool->syncher);
+		ensure(!process->recycling);
+		ensure(!group->enabledProcesses[0]->recycling);
+	}
+
+
+	/*********** Test the WSGI loader's handling of session protocol connections ***********/
+
+	TEST_METHOD(113) {
+		// The WSGI loader keeps a session protocol connection alive after a
+		// response whose length is known, and serves the next request on it.
+		Options options = createWsgiOptions();
+		checkoutSession(options);
+		ensure("(1)", currentSession->hasFramedRequestBodies());
+		int fd = currentSession->fd();
+		string buffer;
+
+		sendHeaders(fd,
+			"PATH_INFO", "/pid",
+			"REQUEST_METHOD", "GET",
+			NULL);
+		string response = readResponse(fd, buffer);
+		ensure("(2)", !containsSubstring(response, "Connection: close"));
+		ensure_equals("(3)", stripHeaders(response),
+			toString(currentSession->getPid()));
+
+		// The app doesn't set Content-Length here, so the loader adds it.
+		sendHeaders(fd,
+			"PATH_INFO", "/extra_header",
+			"REQUEST_METHOD", "GET",
+			NULL);
+		response = readResponse(fd, buffer);
+		ensure("(4)", !containsSubstring(response, "Connection: close"));
+		ensure("(5)", containsSubstring(response, "X-Foo: Bar\r\n"));
+		ensure_equals("(6)", stripHeaders(response), "ok");
+		ensure("(7)", buffer.empty());
+	}
+
+	TEST_METHOD(114) {
+		// wsgi.input never reads past CONTENT_LENGTH, so a request that
+		// directly follows a request body on the same connection is
+		// served too.
+		Options options = createWsgiOptions();
+		checkoutSession(options);
+		int fd = currentSession->fd();
+		string buffer;
+
+		sendHeaders(fd,
+			"PATH_INFO", "/parameters",
+			"REQUEST_METHOD", "POST",
+			"CONTENT_TYPE", "application/x-www-form-urlencoded",
+			"CONTENT_LENGTH", "20",
+			NULL);
+		writeExact(fd, "first=one&second=two");
+		sendHeaders(fd,
+			"PATH_INFO", "/pid",
+			"REQUEST_METHOD", "GET",
+			NULL);
+
+		ensure_equals("(1)", stripHeaders(readResponse(fd, buffer)),
+			"Method: POST\nFirst: one\nSecond: two\n");
+		ensure_equals("(2)", stripHeaders(readResponse(fd, buffer)),
+			toString(currentSession->getPid()));
+	}
+
+	TEST_METHOD(115) {
+		// The part of a request body that the app did not read is discarded
+		// before the next request on the same connection is processed.
+		Options options = createWsgiOptions();
+		checkoutSession(options);
+		int fd = currentSession->fd();
+		string buffer;
+
+		sendHeaders(fd,
+			"PATH_INFO", "/pid",
+			"REQUEST_METHOD", "POST",
+			"CONTENT_LENGTH", "11",
+			NULL);
+		writeExact(fd, "hello world");
+		string response = readResponse(fd, buffer);
+		ensure("(1)", !containsSubstring(response, "Connection: close"));
+		ensure_equals("(2)", stripHeaders(response), toString(currentSession->getPid()));
+
+		sendHeaders(fd,
+			"PATH_INFO", "/extra_header",
+			"REQUEST_METHOD", "GET",
+			NULL);
+		ensure_equals("(3)", stripHeaders(readResponse(fd, buffer)), "ok");
+	}
+
+	TEST_METHOD(116) {
+		// The WSGI loader closes the connection after a response whose
+		// length isn't known, and after a request whose body is terminated
+		// by EOF.
+		Options options = createWsgiOptions();
+		checkoutSession(options);
+		sendHeaders(currentSession->fd(),
+			"PATH_INFO", "/chunked",
+			"REQUEST_METHOD", "GET",
+			NULL);
+		string response = readAll(currentSession->fd(), 1024 * 1024).first;
+		ensure("(1)", containsSubstring(response, "Connection: close\r\n"));
+		ensure("(2)", containsSubstring(response, "0\r\n\r\n"));
+		clearAllSessions();
+
+		checkoutSession(options);
+		sendHeaders(currentSession->fd(),
+			"PATH_INFO", "/raw_upload_to_file",
+			"REQUEST_METHOD", "POST",
+			"HTTP_TRANSFER_ENCODING", "chunked",
+			"HTTP_X_OUTPUT", "/dev/null",
+			NULL);
+		writeExact(currentSession->fd(), "hello\nworld\n");
+		shutdown(currentSession->fd(), SHUT_WR);
+		response = readAll(currentSession->fd(), 1024 * 1024).first;
+		ensure("(3)", containsSubstring(response, "Connection: close\r\n"));
+		ensure_equals("(4)", stripHeaders(response), "ok");
+	}
+
+	TEST_METHOD(120) {
+		// With PASSENGER_WSGI_THREAD_COUNT > 1, the WSGI loader advertises
+		// that many concurrent sessions and serves them concurrently.
+		string envvars = modp::b64_encode("PASSENGER_WSGI_THREAD_COUNT\0" "3\0",
+			sizeof("PASSENGER_WSGI_THREAD_COUNT\0" "3\0") - 1);
+		Options options = createWsgiOptions();
+		options.maxProcesses = 1;
+		options.environmentVariables = envvars;
+		checkoutSession(options);
+
+		ProcessPtr process = currentSession->getProcess()->shared_from_this();
+		const Socket *socket = process->getSockets().findFirstSocketWithProtocol("session");
+		ensure("(1)", socket != NULL);
+		ensure_equals("(2)", socket->concurrency, 3);
+
+		SessionPtr session2 = pool->get(options, &ticket);
+		ensure_equals("(3)", session2->getPid(), currentSession->getPid());
+		session2->initiate();
+
+		string buffer1, buffer2;
+		sendHeaders(currentSession->fd(),
+			"PATH_INFO", "/sleep",
+			"REQUEST_METHOD", "GET",
+			"HTTP_X_SLEEP", "2",
+			NULL);
+		unsigned long long startTime = SystemTime::getUsec();
+		sendHeaders(session2->fd(),
+			"PATH_INFO", "/pid",
+			"REQUEST_METHOD", "GET",
+			NULL);
+		ensure_equals("(4)", stripHeaders(readResponse(session2->fd(), buffer2)),
+			toString(session2->getPid()));
+		ensure("(5) The second request is not queued behind the first one",
+			SystemTime::getUsec() - startTime < 1000000);
+		ensure_equals("(6)", stripHeaders(readResponse(currentSession->fd(), buffer1)),
+			"ok");
+	}
+
+
+	/*********** Test Python preloading ***********/
+
+	TEST_METHOD(118) {
+		// With Python preloading enabled, WSGI app processes are forked
+		// from a wsgi-preloader.py process.
+		Options options = createWsgiOptions();
+		options.spawnMethod = "smart";
+		options.pythonPreloading = true;
+		checkoutSession(options);
+		pid_t pid = currentSession->getPid();
+		GroupPtr group = currentSession->getGroup()->shared_from_this();
+		currentSession.reset();
+
+		boost::shared_ptr<SpawningKit::SmartSpawner> spawner =
+			dynamic_pointer_cast<SpawningKit::SmartSpawner>(group->spawner);
+		ensure("(1)", spawner != NULL);
+		ensure("(2)", !spawner->isPreloadingFailed());
+		ensure("(3)", spawner->getPreloaderPid() != -1);
+		ensure("(4)", spawner->getPreloaderPid() != pid);
+		ensure_equals("(5)", sendRequest(options, "/pid"), toString(pid));
+	}
+
+	TEST_METHOD(119) {
+		// If the app cannot be preloaded, its processes are spawned
+		// directly instead.
+		TempDirCopy dir("stub/wsgi", "tmp.wsgi");
+		createFile("tmp.wsgi/passenger_wsgi.py",
+			"import sys\n"
+			"if sys.argv[0].endswith('wsgi-preloader.py'):\n"
+			"\traise Exception('this app cannot be preloaded')\n"
+			+ unsafeReadFile("stub/wsgi/passenger_wsgi.py"));
+
+		Options options = createWsgiOptions();
+		options.appRoot = "tmp.wsgi";
+		options.spawnMethod = "smart";
+		options.pythonPreloading = true;
+		checkoutSession(options);
+		pid_t pid = currentSession->getPid();
+		GroupPtr group = currentSession->getGroup()->shared_from_this();
+		currentSession.reset();
+
+		boost::shared_ptr<SpawningKit::SmartSpawner> spawner =
+			dynamic_pointer_cast<SpawningKit::SmartSpawner>(group->spawner);
+		ensure("(1)", spawner != NULL);
+		ensure("(2)", spawner->isPreloadingFailed());
+		ensure_equals("(3)", spawner->getPreloaderPid(), (pid_t) -1);
+		ensure("(4)", !spawner->supportsBatchSpawning());
+		ensure_equals("(5)", sendRequest(options, "/pid"), toString(pid));
+	}
+
 
 	/*****************************/
 }
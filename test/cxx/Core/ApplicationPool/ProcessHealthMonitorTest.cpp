@@ -0,0 +1,99 @@
+#include <TestSupport.h>
+#include <Core/ApplicationPool/ProcessHealthMonitor.h>
+
+using namespace Passenger;
+using namespace Passenger::ApplicationPool2;
+using namespace std;
+
+namespace tut {
+	struct Core_ApplicationPool_ProcessHealthMonitorTest: public TestBase {
+		ProcessHealthMonitor monitor;
+
+		// Reports a request that finished at `now` (in seconds), with 3
+		// consecutive errors, a latency threshold of 100 msec and an
+		// ejection time of 10 seconds.
+		bool report(bool failed, unsigned long long now, unsigned long long latency = 1000) {
+			return monitor.report(failed, latency, now * 1000000, 3, 100, 10);
+		}
+	};
+
+	DEFINE_TEST_GROUP(Core_ApplicationPool_ProcessHealthMonitorTest);
+
+	TEST_METHOD(1) {
+		set_test_name("It only collects statistics if ejection is disabled");
+		for (int i = 0; i < 30; i++) {
+			ensure(!monitor.report(true, 1000, 1000000, 0, 0, 10));
+		}
+		ensure_equals(monitor.getState(), ProcessHealthMonitor::HEALTHY);
+		ensure(monitor.getErrorRate() > 0.99);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("It ejects a process after the given number of consecutive errors");
+		ensure(!report(true, 1));
+		ensure(!report(true, 2));
+		ensure(!report(false, 3));
+		ensure(!report(true, 4));
+		ensure(!report(true, 5));
+		ensure(report(true, 6));
+		ensure(monitor.isEjected());
+		ensure_equals(monitor.getEjectedUntil(), 16000000ull);
+		ensure_equals(monitor.getConsecutiveEjections(), 1u);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("Requests that exceed the latency threshold count as errors");
+		ensure(!report(false, 1, 150000));
+		ensure(!report(false, 2, 150000));
+		ensure(report(false, 3, 150000));
+		ensure(monitor.isEjected());
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("It ejects a process whose error rate is too high,"
+			" even without consecutive errors");
+		bool ejected = false;
+		for (int i = 0; i < 100 && !ejected; i++) {
+			ejected = report(i % 3 != 0, 1);
+		}
+		ensure(ejected);
+
+		monitor = ProcessHealthMonitor();
+		for (int i = 0; i < 100; i++) {
+			ensure(!report(i % 4 == 0, 1));
+		}
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("It probes an ejected process once the ejection time has passed,"
+			" and readmits it if the probe succeeds");
+		report(true, 1);
+		report(true, 1);
+		ensure(report(true, 1));
+		ensure("(1)", !monitor.maybeStartProbing(10 * 1000000));
+		ensure("(2)", !report(false, 10));
+		ensure("(3)", monitor.isEjected());
+		ensure("(4)", monitor.maybeStartProbing(11 * 1000000));
+		ensure("(5)", monitor.isProbing());
+		ensure("(6)", !report(false, 12));
+		ensure_equals(monitor.getState(), ProcessHealthMonitor::HEALTHY);
+		ensure_equals(monitor.getConsecutiveEjections(), 0u);
+	}
+
+	TEST_METHOD(6) {
+		set_test_name("It ejects a process for twice as long if the probe fails");
+		report(true, 1);
+		report(true, 1);
+		ensure(report(true, 1));
+		ensure(monitor.maybeStartProbing(11 * 1000000));
+		ensure(report(true, 11));
+		ensure(monitor.isEjected());
+		ensure_equals(monitor.getEjectedUntil(), 31000000ull);
+		ensure_equals(monitor.getConsecutiveEjections(), 2u);
+
+		ensure(monitor.maybeStartProbing(31 * 1000000));
+		ensure(report(true, 31));
+		ensure_equals(monitor.getEjectedUntil(), 71000000ull);
+		ensure_equals(monitor.getConsecutiveEjections(), 3u);
+	}
+}
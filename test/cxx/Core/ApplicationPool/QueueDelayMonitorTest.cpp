@@ -0,0 +1,97 @@
+#include <TestSupport.h>
+#include <Core/ApplicationPool/QueueDelayMonitor.h>
+
+using namespace Passenger;
+using namespace Passenger::ApplicationPool2;
+using namespace std;
+
+namespace tut {
+	struct Core_ApplicationPool_QueueDelayMonitorTest: public TestBase {
+		QueueDelayMonitor monitor;
+	};
+
+	DEFINE_TEST_GROUP(Core_ApplicationPool_QueueDelayMonitorTest);
+
+	// All times are in microseconds. The target delay is 10 msec,
+	// so the interval is 200 msec.
+
+	TEST_METHOD(1) {
+		set_test_name("It only collects statistics if the target delay is 0");
+		ensure(!monitor.dequeue(5000000, 1000000, 0));
+		ensure(!monitor.dequeue(5000000, 2000000, 0));
+		ensure(!monitor.dequeue(5000000, 3000000, 0));
+		ensure(!monitor.isOverloaded());
+		ensure_equals(monitor.getShedCount(), 0ull);
+		ensure_equals(monitor.getPeakDelay(), 5000000ull);
+		ensure("Average delay", monitor.getAverageDelay() > 4999999
+			&& monitor.getAverageDelay() < 5000001);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("It does not shed bursts that drain within an interval");
+		ensure(!monitor.dequeue(50000, 1000000, 10));
+		ensure(!monitor.dequeue(80000, 1050000, 10));
+		ensure(!monitor.dequeue(5000, 1100000, 10));
+		ensure("(1)", !monitor.dequeue(90000, 1250000, 10));
+		ensure("(2)", !monitor.isOverloaded());
+		ensure_equals(monitor.getShedCount(), 0ull);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("It sheds waiters that have been queued for longer than"
+			" twice the target when the minimum delay stayed above the target"
+			" for an entire interval");
+		ensure(!monitor.dequeue(50000, 1000000, 10));
+		ensure(!monitor.dequeue(30000, 1100000, 10));
+
+		// Next interval: overloaded.
+		ensure("(1)", monitor.dequeue(40000, 1250000, 10));
+		ensure("(2)", monitor.isOverloaded());
+		ensure("(3)", !monitor.dequeue(15000, 1300000, 10));
+		ensure("(4)", monitor.dequeue(25000, 1350000, 10));
+		ensure_equals(monitor.getShedCount(), 2ull);
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("It stops shedding after an interval in which the queue drained");
+		ensure(!monitor.dequeue(50000, 1000000, 10));
+		ensure(monitor.dequeue(50000, 1250000, 10));
+		monitor.bypass(1300000, 10);
+
+		// Next interval: no longer overloaded because a request was served
+		// without queueing in the previous one.
+		ensure("(1)", !monitor.dequeue(50000, 1500000, 10));
+		ensure("(2)", !monitor.isOverloaded());
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("checkHead() sheds the waiter at the head of a queue that"
+			" isn't draining, even if nothing is dequeued");
+		unsigned long long nextCheckTime;
+
+		ensure("(1)", !monitor.checkHead(0, 1000000, 10, nextCheckTime));
+		ensure_equals("(2)", nextCheckTime, 1200000ull);
+		ensure("(3)", !monitor.checkHead(200000, 1200000, 10, nextCheckTime));
+		ensure_equals("(4)", nextCheckTime, 1400000ull);
+
+		// Next interval: the head has been waiting for longer than the
+		// target during the entire previous interval.
+		ensure("(5)", monitor.checkHead(400000, 1400000, 10, nextCheckTime));
+		ensure("(6)", monitor.isOverloaded());
+		ensure_equals("(7)", monitor.getShedCount(), 1ull);
+
+		// The next waiter becomes the head. It can be shed once it has
+		// been queued for longer than twice the target.
+		ensure("(8)", !monitor.checkHead(15000, 1400000, 10, nextCheckTime));
+		ensure_equals("(9)", nextCheckTime, 1405001ull);
+	}
+
+	TEST_METHOD(6) {
+		set_test_name("checkHead() does nothing if the target delay is 0");
+		unsigned long long nextCheckTime = 1;
+		ensure(!monitor.checkHead(5000000, 1000000, 0, nextCheckTime));
+		ensure(!monitor.checkHead(5000000, 9000000, 0, nextCheckTime));
+		ensure_equals(nextCheckTime, 0ull);
+		ensure_equals(monitor.getShedCount(), 0ull);
+	}
+}
@@ -341,6 +341,82 @@ namespace tut {
 	}
 
 
+	TEST_METHOD(3) {
+		set_test_name("Session protocol: binary header encoding with interned keys");
+
+		init();
+		useTestSessionObject();
+		// Apps may support newer versions than we do.
+		testSession.setBinarySessionHeaderVersion(2);
+
+		connectToServer();
+		sendRequest(
+			"GET /hello?foo=bar HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Connection: close\r\n"
+			"\r\n");
+		waitUntilSessionInitiated();
+
+		readPeerRequestHeader();
+		ensure("(1)", startsWith(peerRequestHeader, P_STATIC_STRING("\0\1")));
+		ensure("(2)", containsSubstring(peerRequestHeader,
+			P_STATIC_STRING("\x00\x00\x00\x00\x0e/hello?foo=bar")));
+		ensure("(3)", containsSubstring(peerRequestHeader,
+			P_STATIC_STRING("\x04\x00\x00\x00\x03GET")));
+		ensure("(4)", containsSubstring(peerRequestHeader,
+			P_STATIC_STRING("\x11\x00\x00\x00\x09localhost")));
+		ensure("(5)", !containsSubstring(peerRequestHeader, P_STATIC_STRING("REQUEST_URI")));
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("Session protocol: binary header encoding with literal keys");
+
+		init();
+		useTestSessionObject();
+		testSession.setBinarySessionHeaderVersion(1);
+
+		connectToServer();
+		sendRequest(
+			"GET /hello HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"X-Foo: bar\r\n"
+			"Connection: close\r\n"
+			"\r\n");
+		waitUntilSessionInitiated();
+
+		readPeerRequestHeader();
+		ensure(containsSubstring(peerRequestHeader,
+			P_STATIC_STRING("\xff\x00\x0aHTTP_X_FOO\x00\x00\x00\x03" "bar")));
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("Session protocol: binary header encoding falls back to the"
+			" NUL-separated encoding for keys that don't fit a 16-bit size");
+
+		init();
+		useTestSessionObject();
+		testSession.setBinarySessionHeaderVersion(1);
+
+		// "HTTP_" + 65531 bytes is one byte too many.
+		string request = "GET /hello HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Connection: close\r\n"
+			+ string(65531, 'a') + ": bar\r\n"
+			"\r\n";
+		connectToServer();
+		TempThread writer(boost::bind(&Core_ControllerTest::sendRequest, this,
+			StaticString(request)));
+		waitUntilSessionInitiated();
+
+		readPeerRequestHeader();
+		ensure("(1)", !startsWith(peerRequestHeader, P_STATIC_STRING("\0")));
+		ensure("(2)", containsSubstring(peerRequestHeader,
+			P_STATIC_STRING("REQUEST_METHOD\0GET\0")));
+		ensure("(3)", containsSubstring(peerRequestHeader,
+			"HTTP_" + string(65531, 'A') + string("\0bar\0", 5)));
+	}
+
+
 	/***** Passing request body to the app *****/
 
 	TEST_METHOD(10) {
@@ -549,6 +625,106 @@ namespace tut {
 		ensure_equals(StaticString(buf, 3), "cde");
 	}
 
+	TEST_METHOD(16) {
+		set_test_name("When adaptive body buffering on, Content-Length is small:"
+			" it buffers the request body even without the B flag");
+
+		config["adaptive_request_body_buffering"] = true;
+		init();
+		useTestSessionObject();
+
+		connectToServer();
+		sendRequest(
+			"POST /hello HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Content-Length: 10\r\n"
+			"Connection: close\r\n"
+			"\r\n"
+			"hello");
+		SHOULD_NEVER_HAPPEN(100,
+			result = testSession.fd() != -1;
+		);
+
+		sendRequest("world");
+		waitUntilSessionInitiated();
+
+		Json::Value state = inspectStateAsJson();
+		Json::Value reqState = state["active_clients"]["1-1"]["current_request"];
+		ensure("Body buffering is on", reqState.isMember("body_bytes_buffered"));
+		ensure_equals(state["adaptive_request_body_buffering"]["small_bodies_buffered"].asUInt(), 1u);
+
+		ensure(containsSubstring(readPeerRequestHeader(),
+			P_STATIC_STRING("CONTENT_LENGTH\00010\000")));
+		ensure_equals(readPeerBody(), "helloworld");
+	}
+
+	TEST_METHOD(17) {
+		set_test_name("When adaptive body buffering on, Content-Length is large"
+			" and the client is slow: it buffers the entire request body"
+			" before checking out a session");
+
+		config["adaptive_request_body_buffering"] = true;
+		config["request_body_buffering_memory_threshold"] = 4;
+		config["request_body_buffering_min_upload_speed"] = 1000000000;
+		config["request_body_buffering_probe_time"] = 50;
+		init();
+		useTestSessionObject();
+
+		connectToServer();
+		sendRequest(
+			"POST /hello HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Content-Length: 15\r\n"
+			"Connection: close\r\n"
+			"\r\n"
+			"hello");
+		usleep(60000);
+		sendRequest("hello");
+		SHOULD_NEVER_HAPPEN(100,
+			result = testSession.fd() != -1;
+		);
+		ensure_equals(inspectStateAsJson()["adaptive_request_body_buffering"]
+			["slow_bodies_buffered"].asUInt(), 1u);
+
+		sendRequest("hello");
+		waitUntilSessionInitiated();
+		ensure(containsSubstring(readPeerRequestHeader(),
+			P_STATIC_STRING("CONTENT_LENGTH\00015\000")));
+		ensure_equals(readPeerBody(), "hellohellohello");
+	}
+
+	TEST_METHOD(18) {
+		set_test_name("When adaptive body buffering on, Content-Length is large"
+			" and the client is fast: it checks out a session before the"
+			" request body is fully received, and streams the rest");
+
+		config["adaptive_request_body_buffering"] = true;
+		config["request_body_buffering_memory_threshold"] = 4;
+		config["request_body_buffering_min_upload_speed"] = 1;
+		config["request_body_buffering_probe_time"] = 50;
+		init();
+		useTestSessionObject();
+
+		connectToServer();
+		sendRequest(
+			"POST /hello HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Content-Length: 15\r\n"
+			"Connection: close\r\n"
+			"\r\n"
+			"hello");
+		usleep(60000);
+		sendRequest("hello");
+		waitUntilSessionInitiated();
+		ensure_equals(inspectStateAsJson()["adaptive_request_body_buffering"]
+			["fast_bodies_streamed"].asUInt(), 1u);
+
+		ensure(containsSubstring(readPeerRequestHeader(),
+			P_STATIC_STRING("CONTENT_LENGTH\00015\000")));
+		sendRequest("hello");
+		ensure_equals(readPeerBody(), "hellohellohello");
+	}
+
 
 	/***** Application response body handling *****/
 
@@ -1060,6 +1236,66 @@ namespace tut {
 		ensure(containsSubstring(header, "HTTP/1.1 502"));
 	}
 
+	TEST_METHOD(50) {
+		set_test_name("Session protocol: on requests with fixed body to apps"
+			" that support framed request bodies, it does not pass a half-close"
+			" write event to the app upon reaching the end of the request body"
+			" and keep-alives the application connection");
+
+		init();
+		useTestSessionObject();
+		testSession.setFramedRequestBodies(true);
+
+		connectToServer();
+		sendRequest(
+			"GET /hello HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Content-Length: 2\r\n"
+			"Connection: close\r\n"
+			"\r\n");
+		waitUntilSessionInitiated();
+
+		writeExact(clientConnection, "ok");
+		ensureNeverDrainPeerConnection();
+
+		sendPeerResponse(
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Length: 2\r\n\r\n"
+			"ok");
+		waitUntilSessionClosed();
+		ensure("(1)", testSession.isSuccessful());
+		ensure("(2)", testSession.wantsKeepAlive());
+	}
+
+	TEST_METHOD(51) {
+		set_test_name("Session protocol: on requests with fixed body to apps"
+			" that support framed request bodies, it does not keep-alive the"
+			" application connection if the app responds before the entire"
+			" request body has been sent to it");
+
+		init();
+		useTestSessionObject();
+		testSession.setFramedRequestBodies(true);
+
+		connectToServer();
+		sendRequest(
+			"GET /hello HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Content-Length: 10\r\n"
+			"Connection: close\r\n"
+			"\r\n"
+			"ok");
+		waitUntilSessionInitiated();
+
+		sendPeerResponse(
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Length: 2\r\n\r\n"
+			"ok");
+		waitUntilSessionClosed();
+		ensure("(1)", testSession.isSuccessful());
+		ensure("(2)", !testSession.wantsKeepAlive());
+	}
+
 	TEST_METHOD(55) {
 		set_test_name("Session protocol: if application decides not to "
 			" finish the response (close), and the client is still there "
@@ -1118,4 +1354,31 @@ namespace tut {
 		string header = readResponseHeader();
 		ensure(containsSubstring(header, "HTTP/1.1 502"));
 	}
+
+
+	/***** Configuration *****/
+
+	TEST_METHOD(60) {
+		set_test_name("default_routing_key is validated at config load");
+		const char *valid[] = { "", "header:X-Tenant", "cookie:session", "path:2" };
+		const char *invalid[] = { "header", "header:", "tenant:foo", "path:abc", "path:-1" };
+
+		for (unsigned int i = 0; i < sizeof(valid) / sizeof(const char *); i++) {
+			ConfigKit::Store store(schema);
+			vector<ConfigKit::Error> errors;
+			Json::Value updates = config;
+			updates["default_routing_key"] = valid[i];
+			ensure(string("Accepts ") + valid[i], store.update(updates, errors));
+		}
+
+		for (unsigned int i = 0; i < sizeof(invalid) / sizeof(const char *); i++) {
+			ConfigKit::Store store(schema);
+			vector<ConfigKit::Error> errors;
+			Json::Value updates = config;
+			updates["default_routing_key"] = invalid[i];
+			ensure(string("Rejects ") + invalid[i], !store.update(updates, errors));
+			ensure_equals(errors.size(), 1u);
+			ensure(containsSubstring(errors[0].getMessage(), "default_routing_key"));
+		}
+	}
 }
@@ -5,6 +5,7 @@
 #include <LoggingKit/Context.h>
 #include <FileDescriptor.h>
 #include <IOTools/IOUtils.h>
+#include <SystemTools/UserDatabase.h>
 #include <algorithm>
 #include <fcntl.h>
 
@@ -68,6 +69,24 @@ namespace tut {
 			options.loadShellEnvvars = false;
 			return options;
 		}
+
+		bool stepPerformed(const SpawningKit::Result &result, JourneyStep step) {
+			vector< pair<JourneyStep, unsigned long long> >::const_iterator it,
+				end = result.stepDurations.end();
+			for (it = result.stepDurations.begin(); it != end; it++) {
+				if (it->first == step) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		string getEnvvars(const SpawningKit::Result &result) {
+			FileDescriptor fd(connectToServer(result.sockets[0].address,
+				__FILE__, __LINE__), NULL, 0);
+			writeExact(fd, "envvars\n");
+			return readAll(fd, 1024 * 1024).first;
+		}
 	};
 
 	DEFINE_TEST_GROUP(Core_SpawningKit_DirectSpawnerTest);
@@ -90,4 +109,52 @@ namespace tut {
 		writeExact(fd, "ping\n");
 		ensure_equals(readAll(fd, 1024).first, "pong\n");
 	}
+
+	TEST_METHOD(11) {
+		set_test_name("If the shell envvars cache is enabled, then a second spawn"
+			" does not run the OS shell but applies the cached environment variables");
+		SpawningKit::AppPoolOptions options = createOptions();
+		options.appRoot      = "stub/rack";
+		options.appStartCommand = "ruby start.rb";
+		options.startupFile  = "start.rb";
+		options.loadShellEnvvars = true;
+
+		OsUser osUser;
+		bool found;
+		if (geteuid() == 0) {
+			options.user = testConfig["normal_user_1"].asCString();
+			found = lookupSystemUserByName(options.user, osUser);
+		} else {
+			found = lookupSystemUserByUid(geteuid(), osUser);
+		}
+		string shell = found ? string(osUser.pwd.pw_shell) : string();
+		string shellName = extractBaseName(shell);
+		if (shellName != "bash" && shellName != "zsh" && shellName != "sh") {
+			// The app's user has no login shell, so the OS shell is never run.
+			return;
+		}
+
+		context.shellEnvvarsCache.setTtl(60);
+		SpawnerPtr spawner = createSpawner(options);
+
+		result = spawner->spawn(options);
+		ensure("(1)", stepPerformed(result, SUBPROCESS_OS_SHELL));
+		ensure_equals("(2)", context.shellEnvvarsCache.size(), 1u);
+
+		// Mark the cached environment so that we can tell whether the
+		// next spawn applied it.
+		string key = ShellEnvvarsCache::makeKey(osUser.pwd.pw_name,
+			absolutizePath(options.appRoot), shell);
+		ShellEnvvarsCache::FileStamps stamps = ShellEnvvarsCache::stampStartupFiles(
+			shell, osUser.pwd.pw_dir);
+		Json::Value doc;
+		ensure("(3)", context.shellEnvvarsCache.lookup(key, stamps, doc));
+		doc["set"]["PASSENGER_CACHED_SHELL_ENVVAR"] = "cached";
+		context.shellEnvvarsCache.store(key, doc, stamps);
+
+		result = spawner->spawn(options);
+		ensure("(4)", !stepPerformed(result, SUBPROCESS_OS_SHELL));
+		ensure("(5)", containsSubstring(getEnvvars(result),
+			"PASSENGER_CACHED_SHELL_ENVVAR = cached\n"));
+	}
 }
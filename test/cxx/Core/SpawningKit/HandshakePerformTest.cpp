@@ -189,6 +189,45 @@ namespace tut {
 		);
 	}
 
+	TEST_METHOD(4) {
+		set_test_name("If the app is generic and already pingable, it finishes on the first probe");
+
+		config.genericApp = true;
+		init(SPAWN_DIRECTLY);
+		server.assign(createTcpServer("127.0.0.1", session->expectedStartPort),
+			NULL, 0);
+
+		execute();
+		ensure_equals(counter.get(), 1);
+		ensure_equals(session->result.sockets.size(), 1u);
+		ensure_equals(session->result.sockets[0].address,
+			"tcp://127.0.0.1:" + toString(session->expectedStartPort));
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("If the app is generic and never becomes pingable,"
+			" it keeps probing until the timeout");
+
+		config.genericApp = true;
+		config.startTimeoutMsec = 100;
+		init(SPAWN_DIRECTLY);
+		pid = fork();
+		if (pid == 0) {
+			// Exit child
+			usleep(1000000);
+			_exit(1);
+		}
+
+		try {
+			execute();
+			fail("SpawnException expected");
+		} catch (const SpawnException &e) {
+			ensure_equals(e.getErrorCategory(), TIMEOUT_ERROR);
+			ensure_equals(StaticString(e.what()),
+				"A timeout occurred while spawning an application process.");
+		}
+	}
+
 	TEST_METHOD(10) {
 		set_test_name("It raises an error if the process exits prematurely");
 
@@ -97,6 +97,27 @@ namespace tut {
 		ensure_equals(getFileType(session->workDir->getPath() + "/response"), FT_DIRECTORY);
 	}
 
+	TEST_METHOD(8) {
+		set_test_name("It creates the work directory skeleton for the journey's steps");
+
+		initAndExec(SPAWN_THROUGH_PRELOADER);
+
+		string path = session->workDir->getPath();
+		struct stat buf;
+		ensure_equals(stat((path + "/envdump/annotations").c_str(), &buf), 0);
+		ensure("envdump/annotations is a directory", S_ISDIR(buf.st_mode));
+		ensure_equals("Only the owner has access", buf.st_mode & 0077, (mode_t) 0);
+		ensure_equals(stat((path + "/response/finish").c_str(), &buf), 0);
+		ensure("response/finish is a FIFO", S_ISFIFO(buf.st_mode));
+		ensure_equals(getFileType(path + "/response/error"), FT_DIRECTORY);
+		ensure_equals(getFileType(path + "/response/steps/subprocess_listen"),
+			FT_DIRECTORY);
+		ensure_equals(getFileType(path + "/response/steps/preloader_finish"),
+			FT_DIRECTORY);
+		ensure("Step dir fds are opened",
+			session->stepDirFds.find(SUBPROCESS_LISTEN) != session->stepDirFds.end());
+	}
+
 	#if 0
 	TEST_METHOD(6) {
 		set_test_name("It infers the application code revision from a REVISION file");
@@ -208,4 +229,61 @@ namespace tut {
 			ensure_equals(session->journey.getFirstFailedStep(), SPAWNING_KIT_PREPARATION);
 		}
 	}
+
+	TEST_METHOD(20) {
+		set_test_name("If load_shell_envvars is enabled and the shell envvars cache"
+			" has a valid entry, it passes that entry to the subprocess");
+
+		Json::Value doc;
+		doc["shell"] = "/bin/bash";
+		doc["input_envvars"] = Json::objectValue;
+		doc["set"]["FOO"] = "bar";
+		doc["unset"] = Json::arrayValue;
+
+		config.loadShellEnvvars = true;
+		context.shellEnvvarsCache.setTtl(60);
+		initAndExec(SPAWN_DIRECTLY);
+		ensure("(1)", !session->shellEnvvarsCacheKey.empty());
+		ensure("(2)", !fileExists(session->workDir->getPath() + "/args/shell_envvars_cache.json"));
+
+		context.shellEnvvarsCache.store(session->shellEnvvarsCacheKey, doc,
+			session->shellStartupFileStamps);
+		initAndExec(SPAWN_DIRECTLY);
+		ensure("(3)", fileExists(session->workDir->getPath() + "/args/shell_envvars_cache.json"));
+	}
+
+	TEST_METHOD(21) {
+		set_test_name("Shell envvars cache entries are invalidated when a startup file changes");
+
+		TempDir tmpDir("tmp.homedir");
+		string homedir = absolutizePath("tmp.homedir");
+		Json::Value doc, result;
+		doc["set"]["FOO"] = "bar";
+
+		context.shellEnvvarsCache.setTtl(60);
+		context.shellEnvvarsCache.store("key", doc,
+			ShellEnvvarsCache::stampStartupFiles("/bin/bash", homedir));
+		ensure("(1)", context.shellEnvvarsCache.lookup("key",
+			ShellEnvvarsCache::stampStartupFiles("/bin/bash", homedir), result));
+		ensure_equals("(2)", result["set"]["FOO"].asString(), "bar");
+
+		createFile(homedir + "/.bashrc", "export FOO=baz\n");
+		ensure("(3)", !context.shellEnvvarsCache.lookup("key",
+			ShellEnvvarsCache::stampStartupFiles("/bin/bash", homedir), result));
+		ensure_equals("(4)", context.shellEnvvarsCache.size(), 0u);
+	}
+
+	TEST_METHOD(22) {
+		set_test_name("The shell envvars cache is disabled if its TTL is 0");
+
+		Json::Value doc, result;
+		ShellEnvvarsCache::FileStamps stamps;
+
+		config.loadShellEnvvars = true;
+		initAndExec(SPAWN_DIRECTLY);
+		ensure("(1)", session->shellEnvvarsCacheKey.empty());
+
+		context.shellEnvvarsCache.store("key", doc, stamps);
+		ensure("(2)", !context.shellEnvvarsCache.lookup("key", stamps, result));
+	}
 }
@@ -39,4 +39,21 @@ namespace tut {
 		ensure("(3)", journey.hasStep(SPAWNING_KIT_CONNECT_TO_PRELOADER));
 		ensure("(4)", journey.hasStep(SUBPROCESS_PREPARE_AFTER_FORKING_FROM_PRELOADER));
 	}
+
+	TEST_METHOD(4) {
+		set_test_name("getPerformedStepDurations() returns the durations of performed steps,"
+			" each step ending when the next step begins");
+		Journey journey(SPAWN_DIRECTLY, false);
+		journey.setStepPerformed(SUBPROCESS_OS_SHELL);
+		journey.setStepBeginTime(SUBPROCESS_OS_SHELL, 1000);
+		journey.setStepEndTime(SUBPROCESS_OS_SHELL, 5000);
+		journey.setStepBeginTime(SUBPROCESS_SPAWN_ENV_SETUPPER_AFTER_SHELL, 3000);
+		journey.setStepInProgress(SUBPROCESS_APP_LOAD_OR_EXEC);
+
+		vector< pair<JourneyStep, unsigned long long> > durations;
+		journey.getPerformedStepDurations(durations);
+		ensure_equals(durations.size(), 1u);
+		ensure_equals(durations[0].first, SUBPROCESS_OS_SHELL);
+		ensure_equals(durations[0].second, 2000ull);
+	}
 }
@@ -6,6 +6,7 @@
 #include <LoggingKit/Context.h>
 #include <FileDescriptor.h>
 #include <IOTools/IOUtils.h>
+#include <SystemTools/SystemTime.h>
 #include <unistd.h>
 #include <climits>
 #include <signal.h>
@@ -62,20 +63,36 @@ namespace tut {
 		}
 
 		boost::shared_ptr<SmartSpawner> createSpawner(const SpawningKit::AppPoolOptions &options, bool exitImmediately = false) {
+			vector<string> preloaderArgs;
+			if (exitImmediately) {
+				preloaderArgs.push_back("exit-immediately");
+			}
+			return createSpawner(options, preloaderArgs);
+		}
+
+		boost::shared_ptr<SmartSpawner> createSpawner(const SpawningKit::AppPoolOptions &options,
+			const vector<string> &preloaderArgs)
+		{
 			char buf[PATH_MAX + 1];
 			getcwd(buf, PATH_MAX);
 
 			vector<string> command;
 			command.push_back("ruby");
 			command.push_back(string(buf) + "/support/placebo-preloader.rb");
-			if (exitImmediately) {
-				command.push_back("exit-immediately");
-			}
+			command.insert(command.end(), preloaderArgs.begin(), preloaderArgs.end());
 
 			return boost::make_shared<SmartSpawner>(&context, command,
 				options);
 		}
 
+		void ensureProcessResponds(const SpawningKit::Result &result) {
+			ensure_equals(result.sockets.size(), 1u);
+			FileDescriptor fd(connectToServer(result.sockets[0].address,
+				__FILE__, __LINE__), NULL, 0);
+			writeExact(fd, "pid\n");
+			ensure_equals(readAll(fd, 1024).first, toString(result.pid) + "\n");
+		}
+
 		SpawningKit::AppPoolOptions createOptions() {
 			SpawningKit::AppPoolOptions options;
 			options.appType     = "directly-through-start-command";
@@ -248,4 +265,146 @@ namespace tut {
 			ensure(containsSubstring(e.getSubprocessEnvvars(), "PASSENGER_FOO=foo\n"));
 		}
 	}
+
+	/***** Batch spawning *****/
+
+	TEST_METHOD(15) {
+		set_test_name("spawnBatch() forks all processes with a single command"
+			" and performs their handshakes concurrently");
+		SpawningKit::AppPoolOptions options = createOptions();
+		options.appRoot      = "stub/rack";
+		options.appStartCommand = "sleep 1; exec ruby start.rb";
+		options.startupFile  = "start.rb";
+		boost::shared_ptr<SmartSpawner> spawner = createSpawner(options);
+		spawner->spawn(options);
+
+		MonotonicTimeUsec begin = SystemTime::getMonotonicUsec();
+		vector<SpawningKit::Result> results = spawner->spawnBatch(options, 3);
+		MonotonicTimeUsec end = SystemTime::getMonotonicUsec();
+		ensure_equals("(1)", results.size(), 3u);
+		ensure("(2)", results[0].pid != results[1].pid);
+		ensure("(3)", results[1].pid != results[2].pid);
+		ensure("(4)", results[0].pid != results[2].pid);
+		for (unsigned int i = 0; i < results.size(); i++) {
+			ensureProcessResponds(results[i]);
+		}
+		ensure("(5)", spawner->supportsBatchSpawning());
+		// Handshaking with the processes one by one would take at least
+		// 3 seconds.
+		ensure("(6)", end - begin < 2500000);
+	}
+
+	TEST_METHOD(16) {
+		set_test_name("If the preloader forks only some of the processes in a batch,"
+			" then spawnBatch() returns the processes that it did fork");
+		SpawningKit::AppPoolOptions options = createOptions();
+		options.appRoot      = "stub/rack";
+		options.appStartCommand = "ruby start.rb";
+		options.startupFile  = "start.rb";
+		vector<string> preloaderArgs;
+		preloaderArgs.push_back("spawn-batch-limit=1");
+		boost::shared_ptr<SmartSpawner> spawner = createSpawner(options, preloaderArgs);
+
+		if (defaultLogLevel == (LoggingKit::Level) DEFAULT_LOG_LEVEL) {
+			// If the user did not customize the test's log level,
+			// then we'll want to tone down the noise.
+			LoggingKit::setLevel(LoggingKit::CRIT);
+		}
+
+		vector<SpawningKit::Result> results = spawner->spawnBatch(options, 3);
+		ensure_equals("(1)", results.size(), 1u);
+		ensureProcessResponds(results[0]);
+		ensure("(2)", spawner->supportsBatchSpawning());
+	}
+
+	TEST_METHOD(17) {
+		set_test_name("If some processes in a batch fail their handshake,"
+			" then spawnBatch() returns the other processes");
+		string lockDir = "/tmp/passenger-test-batch." + toString(getpid());
+		// The first process to create the directory fails.
+		string startCommand = "mkdir " + lockDir + " 2>/dev/null && exit 1;"
+			" exec ruby start.rb";
+		rmdir(lockDir.c_str());
+		SpawningKit::AppPoolOptions options = createOptions();
+		options.appRoot      = "stub/rack";
+		options.appStartCommand = startCommand;
+		options.startupFile  = "start.rb";
+		boost::shared_ptr<SmartSpawner> spawner = createSpawner(options);
+
+		if (defaultLogLevel == (LoggingKit::Level) DEFAULT_LOG_LEVEL) {
+			// If the user did not customize the test's log level,
+			// then we'll want to tone down the noise.
+			LoggingKit::setLevel(LoggingKit::CRIT);
+		}
+
+		vector<SpawningKit::Result> results = spawner->spawnBatch(options, 3);
+		rmdir(lockDir.c_str());
+		ensure_equals("(1)", results.size(), 2u);
+		ensureProcessResponds(results[0]);
+		ensureProcessResponds(results[1]);
+	}
+
+	TEST_METHOD(18) {
+		set_test_name("If all processes in a batch fail, then spawnBatch() throws");
+		SpawningKit::AppPoolOptions options = createOptions();
+		options.appRoot      = "stub/rack";
+		options.appStartCommand = "exit 1";
+		options.startupFile  = "start.rb";
+		boost::shared_ptr<SmartSpawner> spawner = createSpawner(options);
+
+		if (defaultLogLevel == (LoggingKit::Level) DEFAULT_LOG_LEVEL) {
+			// If the user did not customize the test's log level,
+			// then we'll want to tone down the noise.
+			LoggingKit::setLevel(LoggingKit::CRIT);
+		}
+
+		try {
+			spawner->spawnBatch(options, 3);
+			fail("SpawnException expected");
+		} catch (const SpawnException &e) {
+			ensure(containsSubstring(e.getSummary(), "exited prematurely"));
+		}
+		ensure(spawner->supportsBatchSpawning());
+	}
+
+	TEST_METHOD(19) {
+		set_test_name("If the preloader does not support the spawn_batch command,"
+			" then spawnBatch() falls back to spawning one process at a time");
+		SpawningKit::AppPoolOptions options = createOptions();
+		options.appRoot      = "stub/rack";
+		options.appStartCommand = "ruby start.rb";
+		options.startupFile  = "start.rb";
+		vector<string> preloaderArgs;
+		preloaderArgs.push_back("no-spawn-batch");
+		boost::shared_ptr<SmartSpawner> spawner = createSpawner(options, preloaderArgs);
+
+		vector<SpawningKit::Result> results = spawner->spawnBatch(options, 3);
+		ensure_equals("(1)", results.size(), 1u);
+		ensureProcessResponds(results[0]);
+		ensure("(2)", !spawner->supportsBatchSpawning());
+
+		results = spawner->spawnBatch(options, 3);
+		ensure_equals("(3)", results.size(), 1u);
+		ensureProcessResponds(results[0]);
+	}
+
+	TEST_METHOD(20) {
+		set_test_name("The Ruby preloader supports the spawn_batch command");
+		SpawningKit::AppPoolOptions options = createOptions();
+		options.appType      = "rack";
+		options.appRoot      = "stub/rack";
+		options.startupFile  = "config.ru";
+		vector<string> command;
+		command.push_back("ruby");
+		command.push_back(resourceLocator->getHelperScriptsDir() + "/rack-preloader.rb");
+		boost::shared_ptr<SmartSpawner> spawner = boost::make_shared<SmartSpawner>(
+			&context, command, options);
+
+		vector<SpawningKit::Result> results = spawner->spawnBatch(options, 3);
+		ensure_equals("(1)", results.size(), 3u);
+		ensure("(2)", results[0].pid != results[1].pid);
+		ensure("(3)", results[1].pid != results[2].pid);
+		ensure("(4)", results[0].pid != results[2].pid);
+		ensure("(5)", spawner->supportsBatchSpawning());
+	}
 }
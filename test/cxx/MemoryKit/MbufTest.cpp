@@ -264,4 +264,22 @@ namespace tut {
 		ensure_equals("(5)", pool.nfree_mbuf_blockq, 0u);
 		ensure_equals("(6)", pool.nactive_mbuf_blockq, 0u);
 	}
+
+	TEST_METHOD(24) {
+		set_test_name("peak_active_mbuf_blockq tracks the high-water mark of active blocks");
+		ensure_equals("(1)", pool.peak_active_mbuf_blockq, 0u);
+		{
+			mbuf buffer1(mbuf_get(&pool));
+			mbuf buffer2(mbuf_get(&pool));
+			ensure_equals("(2)", pool.peak_active_mbuf_blockq, 2u);
+		}
+		ensure_equals("(3)", pool.nactive_mbuf_blockq, 0u);
+		ensure_equals("(4)", pool.peak_active_mbuf_blockq, 2u);
+		{
+			mbuf buffer(mbuf_get(&pool));
+			ensure_equals("(5)", pool.peak_active_mbuf_blockq, 2u);
+		}
+		mbuf_pool_compact(&pool);
+		ensure_equals("(6)", pool.peak_active_mbuf_blockq, 2u);
+	}
 }
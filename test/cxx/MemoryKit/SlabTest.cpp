@@ -0,0 +1,261 @@
+#include <TestSupport.h>
+#include <MemoryKit/slab.h>
+#include <MemoryKit/mbuf.h>
+#include <Constants.h>
+#include <set>
+#include <vector>
+
+using namespace Passenger;
+using namespace Passenger::MemoryKit;
+using namespace std;
+
+namespace tut {
+	struct MemoryKit_SlabTest: public TestBase {
+		struct slab_allocator allocator;
+
+		MemoryKit_SlabTest() {
+			slab_allocator_init(&allocator, 100, SLAB_HUGEPAGES_NONE, 1);
+		}
+
+		~MemoryKit_SlabTest() {
+			slab_allocator_deinit(&allocator);
+		}
+	};
+
+	DEFINE_TEST_GROUP(MemoryKit_SlabTest);
+
+	TEST_METHOD(1) {
+		set_test_name("Initial state");
+		ensure_equals("(1)", allocator.object_size % SLAB_ALIGNMENT, 0u);
+		ensure("(2)", allocator.object_size >= 100);
+		ensure_equals("(3)", allocator.slab_size, (size_t) SLAB_DEFAULT_SIZE);
+		ensure_equals("(4)", allocator.nslabs, 0u);
+		ensure_equals("(5)", slab_allocator_reserved_size(&allocator), 0u);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("Slabs are large enough to hold a minimum number of objects");
+		struct slab_allocator allocator2;
+		slab_allocator_init(&allocator2, SLAB_DEFAULT_SIZE / 2, SLAB_HUGEPAGES_NONE, 0);
+		ensure(slab_allocator_objects_per_slab(&allocator2) >= SLAB_MIN_OBJECTS);
+		ensure_equals(allocator2.slab_size & (allocator2.slab_size - 1), 0u);
+
+		void *object = slab_alloc(&allocator2);
+		ensure(object != NULL);
+		memset(object, 'x', allocator2.object_size);
+		slab_free(&allocator2, object);
+		ensure_equals(allocator2.nslabs, 0u);
+		slab_allocator_deinit(&allocator2);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("slab_alloc() and slab_free()");
+		char *a = (char *) slab_alloc(&allocator);
+		char *b = (char *) slab_alloc(&allocator);
+		ensure("(1)", a != NULL);
+		ensure("(2)", b != NULL);
+		ensure("(3)", a != b);
+		ensure("(4)", (size_t) (b > a ? b - a : a - b) >= allocator.object_size);
+		ensure_equals("(5)", (uintptr_t) a % SLAB_ALIGNMENT, 0u);
+		ensure_equals("(6)", allocator.nslabs, 1u);
+		ensure_equals("(7)", allocator.nused_objects, 2u);
+		memset(a, 'a', 100);
+		memset(b, 'b', 100);
+
+		slab_free(&allocator, a);
+		ensure_equals("(8)", allocator.nused_objects, 1u);
+		ensure_equals("(9)", b[99], 'b');
+
+		// Freed objects are reused.
+		char *c = (char *) slab_alloc(&allocator);
+		ensure("(10)", c == a);
+		slab_free(&allocator, b);
+		slab_free(&allocator, c);
+		ensure_equals("(11)", allocator.nused_objects, 0u);
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("A new slab is created when all slabs are full");
+		unsigned int perSlab = slab_allocator_objects_per_slab(&allocator);
+		vector<void *> objects;
+		set<void *> unique;
+
+		for (unsigned int i = 0; i < perSlab + 1; i++) {
+			void *object = slab_alloc(&allocator);
+			ensure(object != NULL);
+			objects.push_back(object);
+			unique.insert(object);
+		}
+		ensure_equals("(1)", unique.size(), (size_t) perSlab + 1);
+		ensure_equals("(2)", allocator.nslabs, 2u);
+		ensure_equals("(3)", allocator.peak_nslabs, 2u);
+		ensure_equals("(4)", slab_allocator_reserved_size(&allocator),
+			2 * allocator.slab_size);
+
+		for (unsigned int i = 0; i < objects.size(); i++) {
+			slab_free(&allocator, objects[i]);
+		}
+		ensure_equals("(5)", allocator.nused_objects, 0u);
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("Empty slabs beyond max_idle_slabs are released to the OS");
+		unsigned int perSlab = slab_allocator_objects_per_slab(&allocator);
+		vector<void *> objects;
+
+		for (unsigned int i = 0; i < perSlab * 3; i++) {
+			objects.push_back(slab_alloc(&allocator));
+		}
+		ensure_equals("(1)", allocator.nslabs, 3u);
+
+		for (unsigned int i = 0; i < objects.size(); i++) {
+			slab_free(&allocator, objects[i]);
+		}
+		ensure_equals("(2)", allocator.nslabs, 1u);
+		ensure_equals("(3)", allocator.nempty_slabs, 1u);
+		ensure_equals("(4)", allocator.nreleased_slabs, 2u);
+
+		// The idle slab is reused.
+		void *object = slab_alloc(&allocator);
+		ensure_equals("(5)", allocator.nslabs, 1u);
+		ensure_equals("(6)", allocator.nempty_slabs, 0u);
+		slab_free(&allocator, object);
+	}
+
+	TEST_METHOD(6) {
+		set_test_name("slab_allocator_release_idle()");
+		void *object = slab_alloc(&allocator);
+		slab_free(&allocator, object);
+		ensure_equals("(1)", allocator.nempty_slabs, 1u);
+		ensure_equals("(2)", slab_allocator_release_idle(&allocator, 1), 0u);
+		ensure_equals("(3)", slab_allocator_release_idle(&allocator), 1u);
+		ensure_equals("(4)", allocator.nslabs, 0u);
+		ensure_equals("(5)", allocator.nempty_slabs, 0u);
+	}
+
+	TEST_METHOD(7) {
+		set_test_name("Huge page modes");
+		slab_hugepages_mode mode;
+		ensure("(1)", parse_slab_hugepages_mode("none", mode));
+		ensure_equals("(2)", mode, SLAB_HUGEPAGES_NONE);
+		ensure("(3)", parse_slab_hugepages_mode("madvise", mode));
+		ensure_equals("(4)", mode, SLAB_HUGEPAGES_MADVISE);
+		ensure("(5)", parse_slab_hugepages_mode("hugetlb", mode));
+		ensure_equals("(6)", mode, SLAB_HUGEPAGES_HUGETLB);
+		ensure("(7)", !parse_slab_hugepages_mode("always", mode));
+		ensure_equals("(8)", string(slab_hugepages_mode_to_string(SLAB_HUGEPAGES_HUGETLB)),
+			"hugetlb");
+
+		// Allocation must work regardless of whether huge pages are available.
+		struct slab_allocator allocator2;
+		slab_allocator_init(&allocator2, 4096, SLAB_HUGEPAGES_HUGETLB, 0);
+		void *object = slab_alloc(&allocator2);
+		ensure("(9)", object != NULL);
+		memset(object, 'x', 4096);
+		slab_free(&allocator2, object);
+		ensure_equals("(10)", allocator2.nslabs, 0u);
+		slab_allocator_deinit(&allocator2);
+	}
+
+	TEST_METHOD(8) {
+		set_test_name("mbuf pools can carve their blocks out of a slab allocator");
+		struct slab_allocator mbufAllocator;
+		struct mbuf_pool pool;
+
+		pool.mbuf_block_chunk_size = DEFAULT_MBUF_CHUNK_SIZE;
+		mbuf_pool_init(&pool);
+		slab_allocator_init(&mbufAllocator, DEFAULT_MBUF_CHUNK_SIZE, SLAB_HUGEPAGES_NONE, 1);
+		pool.slab_allocator = &mbufAllocator;
+
+		{
+			mbuf buffer1(mbuf_get(&pool));
+			mbuf buffer2(mbuf_get(&pool));
+			memset(buffer1.start, 'x', buffer1.size());
+			memset(buffer2.start, 'y', buffer2.size());
+			ensure_equals("(1)", mbufAllocator.nused_objects, 2u);
+			ensure_equals("(2)", buffer1.start[buffer1.size() - 1], 'x');
+		}
+		// Blocks go back to the mbuf pool's freelist first.
+		ensure_equals("(3)", pool.nfree_mbuf_blockq, 2u);
+		ensure_equals("(4)", mbufAllocator.nused_objects, 2u);
+
+		mbuf_pool_compact(&pool);
+		ensure_equals("(5)", mbufAllocator.nused_objects, 0u);
+		ensure_equals("(6)", mbufAllocator.nslabs, 0u);
+
+		{
+			// Standalone blocks are not allocated from the slab allocator.
+			mbuf buffer(mbuf_get_with_size(&pool, mbuf_pool_data_size(&pool) + 10));
+			ensure_equals("(7)", mbufAllocator.nused_objects, 0u);
+		}
+
+		mbuf_pool_deinit(&pool);
+		slab_allocator_deinit(&mbufAllocator);
+	}
+
+	TEST_METHOD(9) {
+		set_test_name("slab_allocator_deinit() unmaps all slabs");
+		struct slab_allocator allocator2;
+		slab_allocator_init(&allocator2, 100, SLAB_HUGEPAGES_NONE, 2);
+		unsigned int perSlab = slab_allocator_objects_per_slab(&allocator2);
+		vector<void *> objects;
+
+		for (unsigned int i = 0; i < perSlab + 1; i++) {
+			objects.push_back(slab_alloc(&allocator2));
+		}
+		ensure_equals("(1)", allocator2.nslabs, 2u);
+		for (unsigned int i = 0; i < objects.size(); i++) {
+			slab_free(&allocator2, objects[i]);
+		}
+		// Both slabs are kept around as idle slabs.
+		ensure_equals("(2)", allocator2.nslabs, 2u);
+		ensure_equals("(3)", allocator2.nempty_slabs, 2u);
+
+		slab_allocator_deinit(&allocator2);
+		ensure_equals("(4)", allocator2.nslabs, 0u);
+		ensure_equals("(5)", allocator2.nempty_slabs, 0u);
+		ensure_equals("(6)", allocator2.nreleased_slabs, 2u);
+		ensure_equals("(7)", slab_allocator_reserved_size(&allocator2), 0u);
+		ensure("(8)", TAILQ_EMPTY(&allocator2.partial_slabs));
+		ensure("(9)", TAILQ_EMPTY(&allocator2.full_slabs));
+		ensure("(10)", TAILQ_EMPTY(&allocator2.empty_slabs));
+	}
+
+	TEST_METHOD(10) {
+		set_test_name("slab_allocator_deinit() leaves slabs with objects in use mapped");
+		struct slab_allocator allocator2;
+		slab_allocator_init(&allocator2, 100, SLAB_HUGEPAGES_NONE, 1);
+		unsigned int perSlab = slab_allocator_objects_per_slab(&allocator2);
+		vector<void *> objects;
+
+		for (unsigned int i = 0; i < perSlab * 3; i++) {
+			objects.push_back(slab_alloc(&allocator2));
+		}
+		// Leave the first slab full, make the second one partial
+		// and the third one empty.
+		for (unsigned int i = perSlab * 2 - 1; i < perSlab * 3; i++) {
+			slab_free(&allocator2, objects[i]);
+		}
+		objects.resize(perSlab * 2 - 1);
+		ensure_equals("(1)", allocator2.nslabs, 3u);
+		ensure_equals("(2)", allocator2.nempty_slabs, 1u);
+
+		slab_allocator_deinit(&allocator2);
+		ensure_equals("(3)", allocator2.nslabs, 2u);
+		ensure_equals("(4)", allocator2.nempty_slabs, 0u);
+		ensure_equals("(5)", allocator2.nused_objects, perSlab * 2 - 1);
+		ensure("(6)", !TAILQ_EMPTY(&allocator2.full_slabs));
+		ensure("(7)", !TAILQ_EMPTY(&allocator2.partial_slabs));
+		// The objects that are still in use remain accessible.
+		for (unsigned int i = 0; i < objects.size(); i++) {
+			memset(objects[i], 'x', allocator2.object_size);
+		}
+
+		for (unsigned int i = 0; i < objects.size(); i++) {
+			slab_free(&allocator2, objects[i]);
+		}
+		slab_allocator_deinit(&allocator2);
+		ensure_equals("(8)", allocator2.nslabs, 0u);
+		ensure_equals("(9)", allocator2.nused_objects, 0u);
+	}
+}
@@ -0,0 +1,138 @@
+#include <TestSupport.h>
+#include <BackgroundEventLoop.h>
+#include <SafeLibev.h>
+#include <oxt/thread.hpp>
+#include <vector>
+
+using namespace Passenger;
+using namespace std;
+
+namespace tut {
+	struct SafeLibevTest: public TestBase {
+		BackgroundEventLoop bg;
+		boost::mutex syncher;
+		vector<int> log;
+		unsigned int counter;
+
+		SafeLibevTest()
+			: bg(false, false),
+			  counter(0)
+			{ }
+
+		~SafeLibevTest() {
+			bg.stop();
+		}
+
+		void record(int value) {
+			boost::lock_guard<boost::mutex> l(syncher);
+			log.push_back(value);
+			counter++;
+		}
+
+		void produce(int producer, int count) {
+			for (int i = 0; i < count; i++) {
+				bg.safe->runLater(boost::bind(&SafeLibevTest::record, this,
+					producer * 1000000 + i));
+			}
+		}
+
+		void cancelCommandAndStore(unsigned int id, bool *result) {
+			*result = bg.safe->cancelCommand(id);
+		}
+
+		unsigned int getCounter() {
+			boost::lock_guard<boost::mutex> l(syncher);
+			return counter;
+		}
+	};
+
+	DEFINE_TEST_GROUP(SafeLibevTest);
+
+	TEST_METHOD(1) {
+		set_test_name("runLater() callbacks from multiple threads are all run exactly once,"
+			" in per-thread order");
+		const int PRODUCERS = 4;
+		const int COUNT = 5000;
+		vector<oxt::thread *> threads;
+
+		bg.start();
+		for (int i = 0; i < PRODUCERS; i++) {
+			threads.push_back(new oxt::thread(boost::bind(&SafeLibevTest::produce,
+				this, i, COUNT)));
+		}
+		for (int i = 0; i < PRODUCERS; i++) {
+			threads[i]->join();
+			delete threads[i];
+		}
+		EVENTUALLY(5,
+			result = getCounter() == (unsigned int) (PRODUCERS * COUNT);
+		);
+
+		vector<int> expected(PRODUCERS, 0);
+		for (unsigned int i = 0; i < log.size(); i++) {
+			int producer = log[i] / 1000000;
+			ensure_equals(log[i] % 1000000, expected[producer]);
+			expected[producer]++;
+		}
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("More commands than the preallocated pool can be in flight");
+		// The loop is not running yet, so all commands stay queued.
+		produce(0, 3000);
+		bg.start();
+		EVENTUALLY(5,
+			result = getCounter() == 3000;
+		);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("cancelCommand() prevents a queued callback from running");
+		unsigned int id1 = bg.safe->runLater(boost::bind(&SafeLibevTest::record, this, 1));
+		unsigned int id2 = bg.safe->runLater(boost::bind(&SafeLibevTest::record, this, 2));
+		ensure(bg.safe->cancelCommand(id1));
+		bg.start();
+		EVENTUALLY(5,
+			result = getCounter() == 1;
+		);
+		ensure_equals(log[0], 2);
+		ensure(!bg.safe->cancelCommand(id2));
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("runSync() waits for the callback to finish");
+		bg.start();
+		bg.safe->runSync(boost::bind(&SafeLibevTest::record, this, 1));
+		ensure_equals(getCounter(), 1u);
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("cancelCommand() from another thread does not wait for the event loop");
+		unsigned int id1 = bg.safe->runLater(boost::bind(&SafeLibevTest::record, this, 1));
+		unsigned int id2 = bg.safe->runLater(boost::bind(&SafeLibevTest::record, this, 2));
+		bool canceled = false;
+		// The loop is not running, so this would hang forever if it did.
+		TempThread thr(boost::bind(&SafeLibevTest::cancelCommandAndStore, this,
+			id1, &canceled));
+		thr.join();
+		ensure(canceled);
+
+		bg.start();
+		EVENTUALLY(5,
+			result = getCounter() == 1;
+		);
+		ensure_equals(log[0], 2);
+
+		TempThread thr2(boost::bind(&SafeLibevTest::cancelCommandAndStore, this,
+			id2, &canceled));
+		thr2.join();
+		ensure(!canceled);
+
+		bg.stop();
+		unsigned int id3 = bg.safe->runLater(boost::bind(&SafeLibevTest::record, this, 3));
+		TempThread thr3(boost::bind(&SafeLibevTest::cancelCommandAndStore, this,
+			id3, &canceled));
+		thr3.join();
+		ensure(canceled);
+	}
+}
@@ -0,0 +1,154 @@
+#include <TestSupport.h>
+#include <BackgroundEventLoop.h>
+#include <ServerKit/Context.h>
+#include <Constants.h>
+
+using namespace Passenger;
+using namespace Passenger::ServerKit;
+using namespace Passenger::MemoryKit;
+using namespace std;
+
+namespace tut {
+	struct ServerKit_ContextTest: public TestBase {
+		BackgroundEventLoop bg;
+		ServerKit::Schema skSchema;
+		boost::scoped_ptr<ServerKit::Context> context;
+
+		ServerKit_ContextTest()
+			: bg(false, true)
+			{ }
+
+		void init(const Json::Value &config = Json::Value()) {
+			context.reset(new ServerKit::Context(skSchema, config));
+			context->libev = bg.safe;
+			context->libuv = bg.libuv_loop;
+			context->initialize();
+		}
+	};
+
+	DEFINE_TEST_GROUP(ServerKit_ContextTest);
+
+	TEST_METHOD(1) {
+		set_test_name("getMbufPoolForSize() picks the size class that fits the expected size");
+		init();
+
+		ensure_equals("(1)", context->small_mbuf_pool.mbuf_block_chunk_size,
+			(size_t) DEFAULT_SMALL_MBUF_CHUNK_SIZE);
+		ensure_equals("(2)", context->large_mbuf_pool.mbuf_block_chunk_size,
+			(size_t) DEFAULT_LARGE_MBUF_CHUNK_SIZE);
+
+		ensure("(3)", context->getMbufPoolForSize(0) == &context->mbuf_pool);
+		ensure("(4)", context->getMbufPoolForSize(1) == &context->small_mbuf_pool);
+		ensure("(5)", context->getMbufPoolForSize(
+			mbuf_pool_data_size(&context->small_mbuf_pool)) == &context->small_mbuf_pool);
+		ensure("(6)", context->getMbufPoolForSize(
+			mbuf_pool_data_size(&context->small_mbuf_pool) + 1) == &context->mbuf_pool);
+		ensure("(7)", context->getMbufPoolForSize(
+			mbuf_pool_data_size(&context->mbuf_pool)) == &context->mbuf_pool);
+		ensure("(8)", context->getMbufPoolForSize(
+			mbuf_pool_data_size(&context->mbuf_pool) + 1) == &context->large_mbuf_pool);
+		ensure("(9)", context->getMbufPoolForSize(1024 * 1024 * 1024)
+			== &context->large_mbuf_pool);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("Size classes can be disabled");
+		Json::Value config;
+		config["mbuf_small_block_chunk_size"] = 0;
+		config["mbuf_large_block_chunk_size"] = 0;
+		init(config);
+
+		ensure("(1)", context->getMbufPoolForSize(1) == &context->mbuf_pool);
+		ensure("(2)", context->getMbufPoolForSize(1024 * 1024) == &context->mbuf_pool);
+		ensure_equals("(3)", context->inspectStateAsJson()["mbuf_pool_size_classes"].size(), 1u);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("Size classes that are not smaller or larger than the default class are disabled");
+		Json::Value config;
+		config["mbuf_block_chunk_size"] = 1024;
+		config["mbuf_small_block_chunk_size"] = 2048;
+		config["mbuf_large_block_chunk_size"] = 1024;
+		init(config);
+
+		ensure_equals("(1)", context->small_mbuf_pool.mbuf_block_chunk_size, 0u);
+		ensure_equals("(2)", context->large_mbuf_pool.mbuf_block_chunk_size, 0u);
+		ensure("(3)", context->getMbufPoolForSize(1) == &context->mbuf_pool);
+		ensure("(4)", context->getMbufPoolForSize(1024 * 1024) == &context->mbuf_pool);
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("Invalid size class configurations are rejected");
+		Json::Value config;
+		vector<ConfigKit::Error> errors;
+
+		config["mbuf_small_block_chunk_size"] = 16;
+		ConfigKit::Store store(skSchema, config, errors);
+		ensure_equals(errors.size(), 1u);
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("Per-class statistics and compaction");
+		init();
+
+		{
+			mbuf small(mbuf_get(&context->small_mbuf_pool));
+			mbuf large1(mbuf_get(&context->large_mbuf_pool));
+			mbuf large2(mbuf_get(&context->large_mbuf_pool));
+		}
+		{
+			mbuf large(mbuf_get(&context->large_mbuf_pool));
+		}
+
+		Json::Value doc = context->inspectStateAsJson();
+		Json::Value classes = doc["mbuf_pool_size_classes"];
+		ensure_equals("(1)", classes.size(), 3u);
+		ensure_equals("(2)", classes[0]["chunk_size"].asUInt(), (unsigned int) DEFAULT_SMALL_MBUF_CHUNK_SIZE);
+		ensure_equals("(3)", classes[0]["free_blocks"].asUInt(), 1u);
+		ensure_equals("(4)", classes[0]["peak_active_blocks"].asUInt(), 1u);
+		ensure_equals("(5)", classes[1]["chunk_size"].asUInt(), (unsigned int) DEFAULT_MBUF_CHUNK_SIZE);
+		ensure_equals("(6)", classes[1]["peak_active_blocks"].asUInt(), 0u);
+		ensure_equals("(7)", classes[2]["chunk_size"].asUInt(), (unsigned int) DEFAULT_LARGE_MBUF_CHUNK_SIZE);
+		ensure_equals("(8)", classes[2]["free_blocks"].asUInt(), 2u);
+		ensure_equals("(9)", classes[2]["active_blocks"].asUInt(), 0u);
+		ensure_equals("(10)", classes[2]["peak_active_blocks"].asUInt(), 2u);
+		ensure_equals("(11)", doc["mbuf_pool"]["chunk_size"].asUInt(), (unsigned int) DEFAULT_MBUF_CHUNK_SIZE);
+
+		ensure_equals("(12)", context->compactMbufPools(), 3u);
+		ensure_equals("(13)", context->small_mbuf_pool.nfree_mbuf_blockq, 0u);
+		ensure_equals("(14)", context->large_mbuf_pool.nfree_mbuf_blockq, 0u);
+	}
+
+	TEST_METHOD(6) {
+		set_test_name("Slab allocation of mbuf blocks");
+		Json::Value config;
+		config["slab_allocator"] = true;
+		config["slab_allocator_hugepages"] = "none";
+		init(config);
+
+		ensure("(1)", context->mbuf_pool.slab_allocator == &context->mbuf_slab_allocator);
+		ensure("(2)", context->small_mbuf_pool.slab_allocator == &context->small_mbuf_slab_allocator);
+		ensure("(3)", context->large_mbuf_pool.slab_allocator == &context->large_mbuf_slab_allocator);
+		{
+			mbuf buffer(mbuf_get(&context->large_mbuf_pool));
+			ensure_equals("(4)", context->large_mbuf_slab_allocator.nused_objects, 1u);
+		}
+
+		Json::Value doc = context->inspectStateAsJson();
+		ensure_equals("(5)", doc["mbuf_pool_size_classes"][2]["slab_allocator"]["slabs"].asUInt(), 1u);
+		ensure_equals("(6)", doc["mbuf_pool_size_classes"][2]["slab_allocator"]["hugepages"].asString(), "none");
+
+		context->compactMbufPools();
+		ensure_equals("(7)", context->large_mbuf_slab_allocator.nslabs, 0u);
+	}
+
+	TEST_METHOD(7) {
+		set_test_name("Invalid huge page modes are rejected");
+		Json::Value config;
+		vector<ConfigKit::Error> errors;
+
+		config["slab_allocator_hugepages"] = "always";
+		ConfigKit::Store store(skSchema, config, errors);
+		ensure_equals(errors.size(), 1u);
+	}
+}
@@ -25,6 +25,7 @@ namespace tut {
 		Json::Value config;
 		ServerKit::Schema skSchema;
 		ServerKit::Context context;
+		boost::scoped_ptr<ServerKit::Context> slabContext;
 		ServerKit::BaseServerSchema schema;
 		boost::shared_ptr< Server<Client> > server;
 		int serverSocket1, serverSocket2;
@@ -77,6 +78,20 @@ namespace tut {
 			server->listen(serverSocket1);
 		}
 
+		void initWithSlabAllocator() {
+			Json::Value contextConfig;
+			contextConfig["slab_allocator"] = true;
+			contextConfig["slab_allocator_hugepages"] = "none";
+			slabContext.reset(new ServerKit::Context(skSchema, contextConfig));
+			slabContext->libev = bg.safe;
+			slabContext->libuv = bg.libuv_loop;
+			slabContext->initialize();
+
+			server = boost::make_shared< Server<Client> >(slabContext.get(), schema, config);
+			server->initialize();
+			server->listen(serverSocket1);
+		}
+
 		void startServer() {
 			bg.start();
 		}
@@ -148,6 +163,17 @@ namespace tut {
 			*result = server->getActiveClients();
 		}
 
+		Json::Value inspectServerState() {
+			Json::Value result;
+			bg.safe->runSync(boost::bind(&ServerKit_ServerTest::_inspectServerState,
+				this, &result));
+			return result;
+		}
+
+		void _inspectServerState(Json::Value *result) {
+			*result = server->inspectStateAsJson();
+		}
+
 		bool clientIsConnected(Client *client) {
 			bool result;
 			bg.safe->runSync(boost::bind(&ServerKit_ServerTest::_clientIsConnected,
@@ -453,4 +479,27 @@ namespace tut {
 			result = !clientIsConnected(client.get());
 		);
 	}
+
+	TEST_METHOD(29) {
+		set_test_name("Client objects can be allocated from a slab allocator");
+
+		config["client_freelist_limit"] = 0;
+		initWithSlabAllocator();
+		startServer();
+
+		FileDescriptor fd(connectToServer1());
+		EVENTUALLY(5,
+			result = getActiveClientCount() == 1u;
+		);
+		Json::Value doc = inspectServerState();
+		ensure_equals("(1)", doc["client_slab_allocator"]["used_objects"].asUInt(), 1u);
+		ensure_equals("(2)", doc["client_slab_allocator"]["slabs"].asUInt(), 1u);
+
+		fd.close();
+		EVENTUALLY(5,
+			result = inspectServerState()["client_slab_allocator"]["used_objects"].asUInt() == 0u;
+		);
+		doc = inspectServerState();
+		ensure_equals("(3)", doc["client_slab_allocator"]["idle_slabs"].asUInt(), 1u);
+	}
 }
@@ -0,0 +1,107 @@
+#include <TestSupport.h>
+#include <SystemTools/CpuTopology.h>
+
+using namespace Passenger;
+using namespace std;
+
+namespace tut {
+	struct SystemTools_CpuTopologyTest: public TestBase {
+	};
+
+	DEFINE_TEST_GROUP(SystemTools_CpuTopologyTest);
+
+	TEST_METHOD(1) {
+		set_test_name("parseCpuList() parses single CPUs and ranges");
+		vector<unsigned int> cpus;
+		parseCpuList("8, 0-2,10-11", cpus);
+		ensure_equals(cpus.size(), 6u);
+		ensure_equals(cpus[0], 0u);
+		ensure_equals(cpus[1], 1u);
+		ensure_equals(cpus[2], 2u);
+		ensure_equals(cpus[3], 8u);
+		ensure_equals(cpus[4], 10u);
+		ensure_equals(cpus[5], 11u);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("parseCpuList() accepts an empty list");
+		vector<unsigned int> cpus;
+		parseCpuList("", cpus);
+		ensure(cpus.empty());
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("parseCpuList() rejects malformed lists");
+		vector<unsigned int> cpus;
+		try {
+			parseCpuList("0-x", cpus);
+			fail("ArgumentException expected (1)");
+		} catch (const ArgumentException &) {
+			// Pass.
+		}
+		try {
+			parseCpuList("3-1", cpus);
+			fail("ArgumentException expected (2)");
+		} catch (const ArgumentException &) {
+			// Pass.
+		}
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("interleaveCpusByNumaNode() alternates between nodes");
+		vector<unsigned int> cpus;
+		map<unsigned int, unsigned int> cpuToNode;
+		for (unsigned int i = 0; i < 6; i++) {
+			cpus.push_back(i);
+			cpuToNode[i] = (i < 4) ? 0 : 1;
+		}
+
+		vector<unsigned int> result = interleaveCpusByNumaNode(cpus, cpuToNode);
+		ensure_equals(result.size(), 6u);
+		ensure_equals(result[0], 0u);
+		ensure_equals(result[1], 4u);
+		ensure_equals(result[2], 1u);
+		ensure_equals(result[3], 5u);
+		ensure_equals(result[4], 2u);
+		ensure_equals(result[5], 3u);
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("parseCpuList() rejects reversed ranges without adding any CPUs");
+		vector<unsigned int> cpus;
+		try {
+			parseCpuList("0,5-4", cpus);
+			fail("ArgumentException expected");
+		} catch (const ArgumentException &) {
+			ensure(cpus.empty());
+		}
+	}
+
+	TEST_METHOD(6) {
+		set_test_name("parseCpuList() rejects CPU numbers that don't fit in a CPU set");
+		vector<unsigned int> cpus;
+		try {
+			parseCpuList("0-4294967295", cpus);
+			fail("ArgumentException expected (1)");
+		} catch (const ArgumentException &) {
+			// Pass.
+		}
+		try {
+			parseCpuList(toString(MAX_CPU_LIST_CPU_COUNT), cpus);
+			fail("ArgumentException expected (2)");
+		} catch (const ArgumentException &) {
+			// Pass.
+		}
+		try {
+			parseCpuList("0-99999999999999999999999", cpus);
+			fail("ArgumentException expected (3)");
+		} catch (const ArgumentException &) {
+			// Pass.
+		}
+		ensure(cpus.empty());
+
+		parseCpuList(toString(MAX_CPU_LIST_CPU_COUNT - 1), cpus);
+		ensure_equals(cpus.size(), 1u);
+		ensure_equals(cpus[0], MAX_CPU_LIST_CPU_COUNT - 1);
+	}
+}
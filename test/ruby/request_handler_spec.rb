@@ -1086,6 +1086,50 @@ def each(&block)
         end
       end
     end
+
+    context "if the request has a body with Content-Length" do
+      it "discards the unread part of the body and allows keep-alive" do
+        setup do |env|
+          [200, { "Content-Length" => "1" }, [env["rack.input"].read(1)]]
+        end
+        send_binary_request(@client,
+          "REQUEST_METHOD" => "POST",
+          "PATH_INFO" => "/",
+          "CONTENT_LENGTH" => "3")
+        @client.write("abc")
+        send_binary_request(@client,
+          "REQUEST_METHOD" => "POST",
+          "PATH_INFO" => "/",
+          "CONTENT_LENGTH" => "1")
+        @client.write("d")
+        @client.close_write
+        @client.read.should ==
+          "HTTP/1.1 200 Whatever\r\n" \
+          "Content-Length: 1\r\n\r\n" \
+          "a" \
+          "HTTP/1.1 200 Whatever\r\n" \
+          "Content-Length: 1\r\n\r\n" \
+          "d"
+      end
+
+      it "reads the body line by line without waiting for the client to close the connection" do
+        setup do |env|
+          lines = []
+          env["rack.input"].each { |line| lines << line }
+          body = lines.join("|")
+          [200, { "Content-Length" => body.bytesize.to_s }, [body]]
+        end
+        send_binary_request(@client,
+          "REQUEST_METHOD" => "POST",
+          "PATH_INFO" => "/",
+          "CONTENT_LENGTH" => "9")
+        @client.write("x\na=1&b=2")
+        expected = "HTTP/1.1 200 Whatever\r\n" \
+          "Content-Length: 10\r\n\r\n" \
+          "x\n|a=1&b=2"
+        @client.read(expected.bytesize).should == expected
+      end
+    end
   end
 
   describe "HTTP parsing" do
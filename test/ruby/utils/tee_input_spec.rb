@@ -215,6 +215,35 @@ def init_input(data, env = {})
     describe("#gets") { include_examples "TeeInput#gets" }
     describe("#read") { include_examples "TeeInput#read" }
     describe("#size") { include_examples "TeeInput#size" }
+
+    describe "#gets" do
+      it "doesn't wait for more data after the end of the body, even if the last line has no newline" do
+        @input = Utils::TeeInput.new(@sock2, "CONTENT_LENGTH" => 7)
+        @sock.write("a=1&b=2")
+        @input.gets.should == "a=1&b=2"
+        @input.gets.should be_nil
+      end
+    end
+
+    describe "#drain" do
+      it "discards the unread part of the body without reading past Content-Length" do
+        @input = Utils::TeeInput.new(@sock2, "CONTENT_LENGTH" => 5)
+        @sock.write("hello world")
+        @input.read(2).should == "he"
+        @input.drain.should be_true
+        @sock2.read(6).should == " world"
+      end
+
+      it "returns false if the socket is closed before the end of the body" do
+        init_input("hel", "CONTENT_LENGTH" => 5)
+        @input.drain.should be_false
+      end
+
+      it "returns false if the body length is not known" do
+        init_input("hello", "HTTP_TRANSFER_ENCODING" => "chunked")
+        @input.drain.should be_false
+      end
+    end
   end
 
   context "when buffered" do
@@ -23,6 +23,26 @@ module PhusionPassenger
     expect(split_by_null_into_hash("\0\0")).to eq("" => "")
   end
 
+  specify "#parse_binary_session_header works" do
+    expect(parse_binary_session_header("\0\1")).to eq({})
+    expect(parse_binary_session_header(
+      "\0\1" \
+      "\x04\0\0\0\3GET" \
+      "\x11\0\0\0\x09localhost" \
+      "\xff\0\x0aHTTP_X_FOO\0\0\0\0")).to eq(
+      "REQUEST_METHOD" => "GET",
+      "HTTP_HOST" => "localhost",
+      "HTTP_X_FOO" => "")
+  end
+
+  specify "#parse_binary_session_header returns nil on malformed headers" do
+    expect(parse_binary_session_header("")).to be_nil
+    expect(parse_binary_session_header("\0\2")).to be_nil
+    expect(parse_binary_session_header("\0\1\x04\0\0\0\5GET")).to be_nil
+    expect(parse_binary_session_header("\0\1\xfe\0\0\0\0")).to be_nil
+    expect(parse_binary_session_header("\0\1\xff\0\x0aHTTP")).to be_nil
+  end
+
   ######################
 end
 
@@ -154,7 +154,7 @@ def body():
 	elif path == '/sleep':
 		sleep_time = float(env.get('HTTP_X_SLEEP', 5))
 		time.sleep(sleep_time)
-		status = 200
+		status = '200 OK'
 		body = 'ok'
 	elif path == '/blob':
 		size = int(env.get('HTTP_X_SIZE', 1024 * 1024 * 10))
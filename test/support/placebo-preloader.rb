@@ -31,34 +31,59 @@
   f.write('1')
 end
 
-def process_client_command(server, client, data)
-  doc = PhusionPassenger::Utils::JSON.parse(data)
-  if doc['command'] == 'spawn'
-    work_dir = doc['work_dir']
-    options = PhusionPassenger::Utils::JSON.parse(File.read("#{work_dir}/args.json"))
+# Options for testing batch spawning:
+#   no-spawn-batch        - behave like a preloader that predates the
+#                           'spawn_batch' command.
+#   spawn-batch-limit=N   - pretend that forking fails after N processes
+#                           in a 'spawn_batch' command.
+SPAWN_BATCH_SUPPORTED = !ARGV.include?('no-spawn-batch')
+SPAWN_BATCH_LIMIT = ARGV.grep(/\Aspawn-batch-limit=/).map { |x| x.split('=', 2)[1].to_i }.first
 
-    pid = fork
-    if pid.nil?
-      STDIN.reopen("#{work_dir}/stdin", 'r')
-      STDOUT.reopen("#{work_dir}/stdout_and_err", 'w')
-      STDERR.reopen(STDERR)
-      STDOUT.sync = STDERR.sync = true
-      server.close
-      client.close
+def fork_and_exec(server, client, work_dir)
+  options = PhusionPassenger::Utils::JSON.parse(File.read("#{work_dir}/args.json"))
 
-      ENV['PASSENGER_SPAWN_WORK_DIR'] = work_dir
-      exec(options['start_command'])
+  pid = fork
+  if pid.nil?
+    STDIN.reopen("#{work_dir}/stdin", 'r')
+    STDOUT.reopen("#{work_dir}/stdout_and_err", 'w')
+    STDERR.reopen(STDERR)
+    STDOUT.sync = STDERR.sync = true
+    server.close
+    client.close
+
+    ENV['PASSENGER_SPAWN_WORK_DIR'] = work_dir
+    exec(options['start_command'])
+  else
+    if defined?(NativeSupport)
+      NativeSupport.detach_process(pid)
     else
-      client.write(PhusionPassenger::Utils::JSON.generate(
-        :result => 'ok',
-        :pid => pid
-      ))
-      if defined?(NativeSupport)
-        NativeSupport.detach_process(pid)
-      else
-        Process.detach(pid)
+      Process.detach(pid)
+    end
+    pid
+  end
+end
+
+def process_client_command(server, client, data)
+  doc = PhusionPassenger::Utils::JSON.parse(data)
+  if doc['command'] == 'spawn'
+    pid = fork_and_exec(server, client, doc['work_dir'])
+    client.write(PhusionPassenger::Utils::JSON.generate(
+      :result => 'ok',
+      :pid => pid
+    ))
+  elsif doc['command'] == 'spawn_batch' && SPAWN_BATCH_SUPPORTED
+    results = []
+    doc['work_dirs'].each do |work_dir|
+      if SPAWN_BATCH_LIMIT && results.size >= SPAWN_BATCH_LIMIT
+        results << { :result => 'error', :message => 'Cannot fork: simulated failure' }
+        break
       end
+      results << { :result => 'ok', :pid => fork_and_exec(server, client, work_dir) }
     end
+    client.write(PhusionPassenger::Utils::JSON.generate(
+      :result => 'ok',
+      :results => results
+    ))
   elsif doc['command'] == 'pid'
     client.write(PhusionPassenger::Utils::JSON.generate(
       :result => 'ok',